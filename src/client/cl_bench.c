@@ -0,0 +1,256 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+/* cl_bench.c -- per subsystem timings for the headless benchmark */
+
+/*
+ * Only built into QuDos-bench, which links the client against the null
+ * video, input and sound drivers.  "bench <demo> [msec]" plays a demo either
+ * as fast as possible (timedemo) or at a fixed tick (fixedtime) and writes
+ * the timings to bench_report when the demo ends.  All times are inclusive,
+ * e.g. "refdef" contains "entities" which contains "particles".  The timers
+ * are only touched by the main thread, sound is mixed there while a bench
+ * runs (see S_MixerThread).
+ */
+
+#include "client.h"
+
+typedef struct {
+	const char     *name;
+	long long	start;
+	long long	total;
+	long long	max;
+	int		calls;
+} benchtimer_t;
+
+static benchtimer_t bench_timers[BENCH_NUM_SLOTS] = {
+	{"frame"},
+	{"parse"},
+	{"predict"},
+	{"refdef"},
+	{"entities"},
+	{"particles"},
+	{"sound"},
+	{"spatialize"},
+	{"mix"},
+	{"screen"}
+};
+
+static qboolean	bench_running;
+static char	bench_demo[MAX_QPATH];
+static int	bench_tick;		/* msec per frame, 0 = timedemo */
+static long long bench_start;		/* first frame in game */
+
+cvar_t         *bench_report;
+cvar_t         *bench_quit;
+
+/*
+ * ================ CL_BenchRunning ================
+ */
+qboolean
+CL_BenchRunning(void)
+{
+	return bench_running;
+}
+
+/*
+ * ================ CL_BenchBegin ================
+ */
+void
+CL_BenchBegin(benchslot_t slot)
+{
+	if (!bench_running)
+		return;
+
+	/* level loading is not part of the run */
+	if (!bench_start) {
+		if (slot != BENCH_FRAME || cls.state != ca_active || !cl.refresh_prepped)
+			return;
+		bench_start = Sys_Microseconds();
+	}
+
+	bench_timers[slot].start = Sys_Microseconds();
+}
+
+/*
+ * ================ CL_BenchEnd ================
+ */
+void
+CL_BenchEnd(benchslot_t slot)
+{
+	benchtimer_t   *t;
+	long long	usec;
+
+	t = &bench_timers[slot];
+	if (!bench_running || !t->start)
+		return;
+
+	usec = Sys_Microseconds() - t->start;
+	t->start = 0;
+	t->total += usec;
+	if (usec > t->max)
+		t->max = usec;
+	t->calls++;
+}
+
+/*
+ * ================ CL_BenchWriteCSV ================
+ */
+static void
+CL_BenchWriteCSV(FILE * f, int frames, double seconds)
+{
+	benchtimer_t   *t;
+	int		i;
+
+	fprintf(f, "demo,tick_msec,frames,seconds,fps,subsystem,calls,total_ms,avg_us,max_us,per_frame_us\n");
+	for (i = 0, t = bench_timers; i < BENCH_NUM_SLOTS; i++, t++)
+		fprintf(f, "%s,%d,%d,%.3f,%.1f,%s,%d,%.3f,%.2f,%lld,%.2f\n",
+		    bench_demo, bench_tick, frames, seconds, frames / seconds,
+		    t->name, t->calls, t->total / 1000.0,
+		    t->calls ? (double)t->total / t->calls : 0, t->max,
+		    (double)t->total / frames);
+}
+
+/*
+ * ================ CL_BenchWriteJSON ================
+ */
+static void
+CL_BenchWriteJSON(FILE * f, int frames, double seconds)
+{
+	benchtimer_t   *t;
+	int		i;
+
+	fprintf(f, "{\n");
+	fprintf(f, "\t\"demo\": \"%s\",\n", bench_demo);
+	fprintf(f, "\t\"tick_msec\": %d,\n", bench_tick);
+	fprintf(f, "\t\"frames\": %d,\n", frames);
+	fprintf(f, "\t\"seconds\": %.3f,\n", seconds);
+	fprintf(f, "\t\"fps\": %.1f,\n", frames / seconds);
+	fprintf(f, "\t\"subsystems\": {\n");
+	for (i = 0, t = bench_timers; i < BENCH_NUM_SLOTS; i++, t++)
+		fprintf(f, "\t\t\"%s\": {\"calls\": %d, \"total_ms\": %.3f, "
+		    "\"avg_us\": %.2f, \"max_us\": %lld, \"per_frame_us\": %.2f}%s\n",
+		    t->name, t->calls, t->total / 1000.0,
+		    t->calls ? (double)t->total / t->calls : 0, t->max,
+		    (double)t->total / frames, i < BENCH_NUM_SLOTS - 1 ? "," : "");
+	fprintf(f, "\t}\n}\n");
+}
+
+/*
+ * ================ CL_BenchFinish ================
+ *
+ * Called from CL_Disconnect, writes the report once the demo is over.
+ */
+void
+CL_BenchFinish(void)
+{
+	char		path[MAX_OSPATH];
+	char           *ext;
+	double		seconds;
+	int		frames;
+	FILE           *f;
+
+	if (!bench_running || !bench_start)
+		return;
+	bench_running = false;
+
+	seconds = (Sys_Microseconds() - bench_start) / 1000000.0;
+	frames = bench_timers[BENCH_FRAME].calls;
+	if (frames <= 0 || seconds <= 0)
+		return;
+
+	Com_Printf("bench: %s, %d frames, %.3f seconds: %.1f fps\n",
+	    bench_demo, frames, seconds, frames / seconds);
+
+	/* demos can set it too, keep it inside the gamedir */
+	f = NULL;
+	Com_sprintf(path, sizeof(path), "%s/%s", FS_Gamedir(), bench_report->string);
+	if (strstr(bench_report->string, "..") || bench_report->string[0] == '/' ||
+	    strchr(bench_report->string, '\\') || strchr(bench_report->string, ':')) {
+		Com_Printf("bench: refusing to write %s\n", bench_report->string);
+	} else {
+		FS_CreatePath(path);
+		if ((f = fopen(path, "w")) == NULL)
+			Com_Printf("bench: couldn't write %s\n", path);
+	}
+	if (f) {
+		ext = strrchr(bench_report->string, '.');
+		if (ext && !Q_stricmp(ext, ".csv"))
+			CL_BenchWriteCSV(f, frames, seconds);
+		else
+			CL_BenchWriteJSON(f, frames, seconds);
+		fclose(f);
+		Com_Printf("bench: wrote %s\n", path);
+	}
+
+	if (bench_tick)
+		Cvar_Set("fixedtime", "0");
+	else
+		Cvar_Set("timedemo", "0");
+
+	if (bench_quit->value)
+		Cbuf_AddText("quit\n");
+}
+
+/*
+ * ================ CL_Bench_f ================
+ */
+static void
+CL_Bench_f(void)
+{
+	int		i;
+
+	if (Cmd_Argc() < 2) {
+		Com_Printf("Usage: bench <demo> [msec per frame]\n");
+		return;
+	}
+
+	Q_strncpyz(bench_demo, Cmd_Argv(1), sizeof(bench_demo));
+	bench_tick = Cmd_Argc() > 2 ? atoi(Cmd_Argv(2)) : 0;
+
+	for (i = 0; i < BENCH_NUM_SLOTS; i++) {
+		bench_timers[i].start = 0;
+		bench_timers[i].total = 0;
+		bench_timers[i].max = 0;
+		bench_timers[i].calls = 0;
+	}
+
+	if (bench_tick > 0) {
+		Cvar_Set("timedemo", "0");
+		Cvar_SetValue("fixedtime", bench_tick);
+	} else {
+		Cvar_Set("timedemo", "1");
+		Cvar_Set("fixedtime", "0");
+	}
+
+	bench_start = 0;
+	bench_running = true;
+
+	Cbuf_AddText(va("demomap %s\n", bench_demo));
+}
+
+/*
+ * ================ CL_BenchInit ================
+ */
+void
+CL_BenchInit(void)
+{
+	bench_report = Cvar_Get("bench_report", "bench.json", 0);
+	bench_quit = Cvar_Get("bench_quit", "1", 0);
+
+	Cmd_AddCommand("bench", CL_Bench_f);
+}
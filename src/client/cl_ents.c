@@ -1688,7 +1688,9 @@ CL_AddEntities(void)
 	CL_AddPacketEntities(&cl.frame);
 	CL_AddViewLocs();
 	CL_AddTEnts();
+	BENCH_BEGIN(BENCH_PARTICLES);
 	CL_AddParticles();
+	BENCH_END(BENCH_PARTICLES);
 	CL_AddDLights();
 #ifdef QMAX
 	if (cl.refdef.rdflags & RDF_IRGOGGLES) {
@@ -1314,8 +1314,12 @@ CL_ClearParticles(void)
 	free_particles = &particles[0];
 	active_particles = NULL;
 
-	for (i = 0; i < cl_numparticles; i++)
+	for (i = 0; i < cl_numparticles; i++) {
 		particles[i].next = &particles[i + 1];
+#ifdef QMAX
+		particles[i].contents = -1;
+#endif
+	}
 	particles[cl_numparticles - 1].next = NULL;
 }
 
@@ -5786,7 +5790,7 @@ CL_AddParticles(void)
 	cparticle_t    *p, *next;
 	float		alpha, size, light;
 	float		time = 0, time2 = 0;
-	vec3_t		org, color, angle;
+	vec3_t		org, color, angle, delta;
 	int		i, image;
 	cparticle_t    *active, *tail;
 
@@ -5806,6 +5810,7 @@ CL_AddParticles(void)
 			alpha = p->alpha + time * p->alphavel;
 
 			if (alpha <= 0) {	/* faded out */
+				p->contents = -1;
 				p->next = free_particles;
 				free_particles = p;
 				continue;
@@ -5857,7 +5862,18 @@ CL_AddParticles(void)
 			p->thinknext = false;
 			p->think(p, org, angle, &alpha, &size, &image, &time);
 		}
-		V_AddParticle(org, angle, color, alpha, p->blendfunc_src, p->blendfunc_dst, size, image, p->flags);
+		/*
+		 * the renderer sorts particles against the water surface, look
+		 * the contents up again only once the particle has moved a bit
+		 */
+		VectorSubtract(org, p->contentsorg, delta);
+		if (p->contents == -1 || DotProduct(delta, delta) > PARTICLE_CONTENTS_DIST * PARTICLE_CONTENTS_DIST) {
+			p->contents = CM_PointContents(org, 0);
+			VectorCopy(org, p->contentsorg);
+		}
+
+		V_AddParticle(org, angle, color, alpha, p->blendfunc_src, p->blendfunc_dst, size, image, p->flags,
+		    (p->contents & MASK_WATER) != 0);
 
 		if (p->alphavel == INSTANT_PARTICLE) {
 			p->alphavel = 0.0;
@@ -662,6 +662,9 @@ CL_Disconnect(void)
 			Com_Printf("%i frames, %3.1f seconds: %3.1f fps\n", cl.timedemo_frames,
 			    time / 1000.0, cl.timedemo_frames * 1000.0 / time);
 	}
+#ifdef QBENCH_BIN
+	CL_BenchFinish();
+#endif
 	VectorClear(cl.refdef.blend);
 	re.CinematicSetPalette(NULL);
 
@@ -1416,6 +1419,9 @@ CL_InitLocal(void)
 	cls.realtime = Sys_Milliseconds();
 
 	CL_InitInput();
+#ifdef QBENCH_BIN
+	CL_BenchInit();
+#endif
 
 	adr0 = Cvar_Get("adr0", "", CVAR_ARCHIVE);
 	adr1 = Cvar_Get("adr1", "", CVAR_ARCHIVE);
@@ -1824,6 +1830,8 @@ CL_Frame(int msec)
 			return;	/* framerate is too high */
 		}
 	}
+	BENCH_BEGIN(BENCH_FRAME);
+
 	/* let the mouse activate or deactivate */
 	IN_Frame();
 
@@ -1841,13 +1849,17 @@ CL_Frame(int msec)
 		cls.netchan.last_received = Sys_Milliseconds();
 
 	/* fetch results from server */
+	BENCH_BEGIN(BENCH_PARSE);
 	CL_ReadPackets();
+	BENCH_END(BENCH_PARSE);
 
 	/* send a new command message to the server */
 	CL_SendCommand();
 
 	/* predict all unacknowledged movements */
+	BENCH_BEGIN(BENCH_PREDICT);
 	CL_PredictMovement();
+	BENCH_END(BENCH_PREDICT);
 
 	/* allow rendering DLL change */
 	VID_CheckChanges();
@@ -1857,12 +1869,16 @@ CL_Frame(int msec)
 	/* update the screen */
 	if (host_speeds->value)
 		time_before_ref = Sys_Milliseconds();
+	BENCH_BEGIN(BENCH_SCREEN);
 	SCR_UpdateScreen();
+	BENCH_END(BENCH_SCREEN);
 	if (host_speeds->value)
 		time_after_ref = Sys_Milliseconds();
 
 	/* update audio */
+	BENCH_BEGIN(BENCH_SOUND);
 	S_Update(cl.refdef.vieworg, cl.v_forward, cl.v_right, cl.v_up);
+	BENCH_END(BENCH_SOUND);
 
 	CDAudio_Update();
 
@@ -1874,6 +1890,8 @@ CL_Frame(int msec)
 
 	cls.framecount++;
 
+	BENCH_END(BENCH_FRAME);
+
 	if (log_stats->value) {
 		if (cls.state == ca_active) {
 			if (!lasttimecalled) {
@@ -59,6 +59,8 @@ cvar_t         *scr_debuggraph;
 cvar_t         *scr_graphheight;
 cvar_t         *scr_graphscale;
 cvar_t         *scr_graphshift;
+cvar_t         *scr_profgraph;
+cvar_t         *scr_proflog;
 cvar_t         *scr_drawall;
 cvar_t         *con_height;
 cvar_t         *cl_drawclock;
@@ -329,9 +331,195 @@ SCR_DrawDebugGraph_Box(void)
 #endif
 }
 
+/*
+ * ============== Frame profiler ==============
+ * profgraph stacks the client time spent building the refdef and the
+ * renderer sections from gl_profile into one bar per frame, 4 pixels per
+ * msec times graphscale.  proflog writes the same numbers, plus the GPU
+ * times when gl_profile is 2, as CSV to <gamedir>/<proflog>.
+ */
+#define	PROF_HISTORY	256
+#define	PROF_AVERAGE	32	/* frames averaged for the legend */
+
+typedef struct {
+	int		numsections;
+	float		client;
+	float		cpu[MAX_PROFILE_SECTIONS];
+} profsamp_t;
+
+static const int prof_colors[MAX_PROFILE_SECTIONS + 1] = {
+	0x0f, 0xd0, 0xdc, 0xf2, 0x40, 0x73, 0x9f, 0xb4,
+	0x2f, 0x8f, 0x5f, 0xc8, 0x18, 0x68, 0xe0, 0x38, 0x08
+};
+
+float		scr_profclient;	/* msec spent in V_RenderView before RenderFrame */
+
+static refprofile_t prof_last;
+static profsamp_t prof_history[PROF_HISTORY];
+static int	prof_current;
+static FILE    *prof_log;
+static char	prof_logname[MAX_OSPATH];
+static int	prof_lognumsections;
+
+/*
+ * ============== SCR_CloseProfileLog ==============
+ */
+static void
+SCR_CloseProfileLog(void)
+{
+	if (!prof_log)
+		return;
+
+	fclose(prof_log);
+	prof_log = NULL;
+	prof_logname[0] = 0;
+}
+
+/*
+ * ============== SCR_WriteProfileLog ==============
+ */
+static void
+SCR_WriteProfileLog(void)
+{
+	char		path[MAX_OSPATH];
+	int		i;
+
+	if (prof_log && strcmp(prof_logname, scr_proflog->string))
+		SCR_CloseProfileLog();
+
+	if (!prof_log) {
+		/* servers can set it, keep it inside the gamedir */
+		if (strstr(scr_proflog->string, "..") || scr_proflog->string[0] == '/' ||
+		    strchr(scr_proflog->string, '\\') || strchr(scr_proflog->string, ':')) {
+			Com_Printf("Refusing to write %s, proflog disabled\n", scr_proflog->string);
+			Cvar_Set("proflog", "");
+			return;
+		}
+		Com_sprintf(path, sizeof(path), "%s/%s", FS_Gamedir(), scr_proflog->string);
+		FS_CreatePath(path);
+		if ((prof_log = fopen(path, "w")) == NULL) {
+			Com_Printf("Couldn't write %s, proflog disabled\n", path);
+			Cvar_Set("proflog", "");
+			return;
+		}
+		Q_strncpyz(prof_logname, scr_proflog->string, sizeof(prof_logname));
+		prof_lognumsections = -1;
+		Com_Printf("Writing frame timings to %s\n", path);
+	}
+
+	/* a new header whenever gl_profile is switched on or off */
+	if (prof_last.numsections != prof_lognumsections) {
+		prof_lognumsections = prof_last.numsections;
+		fprintf(prof_log, "frame,realtime,client_ms");
+		for (i = 0; i < prof_last.numsections; i++)
+			fprintf(prof_log, ",%s_cpu_ms,%s_gpu_ms", prof_last.names[i], prof_last.names[i]);
+		fprintf(prof_log, "\n");
+	}
+
+	fprintf(prof_log, "%d,%d,%.3f", prof_current, cls.realtime, scr_profclient);
+	for (i = 0; i < prof_last.numsections; i++) {
+		if (prof_last.gpu[i] >= 0)
+			fprintf(prof_log, ",%.3f,%.3f", prof_last.cpu[i], prof_last.gpu[i]);
+		else
+			fprintf(prof_log, ",%.3f,", prof_last.cpu[i]);
+	}
+	fprintf(prof_log, "\n");
+}
+
+/*
+ * ============== SCR_ProfileFrame ==============
+ * Collects the timings of the frame that was just swapped
+ */
+static void
+SCR_ProfileFrame(void)
+{
+	profsamp_t     *samp;
+	int		i;
+
+	if (!scr_profgraph->value && !scr_proflog->string[0]) {
+		SCR_CloseProfileLog();
+		return;
+	}
+
+	re.GetProfile(&prof_last);
+
+	samp = &prof_history[prof_current & (PROF_HISTORY - 1)];
+	samp->numsections = prof_last.numsections;
+	samp->client = scr_profclient;
+	for (i = 0; i < prof_last.numsections; i++)
+		samp->cpu[i] = prof_last.cpu[i];
+
+	if (scr_proflog->string[0])
+		SCR_WriteProfileLog();
+	else
+		SCR_CloseProfileLog();
+
+	prof_current++;
+}
+
+/*
+ * ============== SCR_DrawProfileGraph ==============
+ */
+static void
+SCR_DrawProfileGraph(void)
+{
+	profsamp_t     *samp;
+	float		scale, avg;
+	int		a, i, j, n, x, y, w, h, maxh, top;
+
+	scale = 4 * scr_graphscale->value;
+	w = min(scr_vrect.width, PROF_HISTORY);
+	maxh = scr_vrect.height / 2;
+	x = scr_vrect.x;
+	y = scr_vrect.y + scr_vrect.height;
+
+	for (a = 0; a < w && a < prof_current; a++) {
+		samp = &prof_history[(prof_current - 1 - a) & (PROF_HISTORY - 1)];
+		top = y;
+		for (i = -1; i < samp->numsections && top > y - maxh; i++) {
+			h = (i < 0 ? samp->client : samp->cpu[i]) * scale + 0.5;
+			if (h > top - (y - maxh))
+				h = top - (y - maxh);
+			if (h <= 0)
+				continue;
+			top -= h;
+			re.DrawFill(x + w - 1 - a, top, 1, h, prof_colors[i + 1]);
+		}
+	}
+
+	/* legend with the recent average and the last GPU time */
+	n = min(prof_current, PROF_AVERAGE);
+	if (!n)
+		return;
+
+	y = scr_vrect.y + 8;
+	for (i = -1; i < prof_last.numsections; i++, y += 8) {
+		for (j = 0, avg = 0; j < n; j++) {
+			samp = &prof_history[(prof_current - 1 - j) & (PROF_HISTORY - 1)];
+			if (i < 0)
+				avg += samp->client;
+			else if (i < samp->numsections)
+				avg += samp->cpu[i];
+		}
+		avg /= n;
+
+		re.DrawFill(scr_vrect.x + 8, y, 6, 6, prof_colors[i + 1]);
+		if (i < 0)
+			DrawString(scr_vrect.x + 18, y, va("%-12s %6.2f", "client", avg));
+		else if (prof_last.gpu[i] >= 0)
+			DrawString(scr_vrect.x + 18, y, va("%-12s %6.2f gpu %6.2f",
+			    prof_last.names[i], avg, prof_last.gpu[i]));
+		else
+			DrawString(scr_vrect.x + 18, y, va("%-12s %6.2f", prof_last.names[i], avg));
+	}
+}
+
 void
 SCR_DrawDebugGraph(void)
 {
+	if (scr_profgraph->value)
+		SCR_DrawProfileGraph();
+
 	if (scr_netgraph->value == 1)
 		SCR_DrawDebugGraph_Original();
 	else if (scr_netgraph->value == 2 || scr_netgraph->value == 3)
@@ -593,6 +781,8 @@ SCR_Init(void)
 	scr_graphheight = Cvar_Get("graphheight", "32", 0);
 	scr_graphscale = Cvar_Get("graphscale", "1", 0);
 	scr_graphshift = Cvar_Get("graphshift", "0", 0);
+	scr_profgraph = Cvar_Get("profgraph", "0", 0);
+	scr_proflog = Cvar_Get("proflog", "", 0);
 	scr_drawall = Cvar_Get("scr_drawall", "0", 0);
 
 	con_height = Cvar_Get("con_height", "0.5", CVAR_ARCHIVE);
@@ -1510,7 +1700,8 @@ SCR_UpdateScreen(void)
 
 			V_RenderView(separation[i]);
 
-			if (scr_debuggraph->value || scr_timegraph->value || scr_netgraph->value)
+			if (scr_debuggraph->value || scr_timegraph->value || scr_netgraph->value ||
+			    scr_profgraph->value)
 				SCR_DrawDebugGraph();
 
 			SCR_DrawStats();
@@ -1639,4 +1830,6 @@ SCR_UpdateScreen(void)
 		}
 	}
 	re.EndFrame();
+
+	SCR_ProfileFrame();
 }
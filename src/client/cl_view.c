@@ -165,7 +165,7 @@ V_AddEntity(entity_t * ent)
  */
 #ifdef QMAX
 void
-V_AddParticle(vec3_t org, vec3_t angle, vec3_t color, float alpha, int alpha_src, int alpha_dst, float size, int image, int flags)
+V_AddParticle(vec3_t org, vec3_t angle, vec3_t color, float alpha, int alpha_src, int alpha_dst, float size, int image, int flags, qboolean inwater)
 {
 	int		i;
 	particle_t     *p;
@@ -188,6 +188,7 @@ V_AddParticle(vec3_t org, vec3_t angle, vec3_t color, float alpha, int alpha_src
 	
 	p->blendfunc_src = alpha_src;
 	p->blendfunc_dst = alpha_dst;
+	p->inwater = inwater;
 
 }
 #else
@@ -848,6 +849,7 @@ V_RenderView(float stereo_separation)
 {
 	extern int	entitycmpfnc(const entity_t *, const entity_t *);
 	float		f;
+	long long	start;
 
 	if (cls.state != ca_active)
 		return;
@@ -866,6 +868,8 @@ V_RenderView(float stereo_separation)
 	 * we can't use the old frame if the video mode has changed,
 	 * though...
 	 */
+	BENCH_BEGIN(BENCH_REFDEF);
+	start = Sys_Microseconds();
 	if (cl.frame.valid && (cl.force_refdef || !cl_paused->value)) {
 		cl.force_refdef = false;
 
@@ -874,7 +878,9 @@ V_RenderView(float stereo_separation)
 		/* build a refresh entity list and calc cl.sim* */
 		/* this also calls CL_CalcViewValues which loads */
 		/* v_forward, etc. */
+		BENCH_BEGIN(BENCH_ENTITIES);
 		CL_AddEntities();
+		BENCH_END(BENCH_ENTITIES);
 
 		if (cl_testparticles->value)
 			V_TestParticles();
@@ -965,6 +971,8 @@ V_RenderView(float stereo_separation)
 		qsort(cl.refdef.entities, cl.refdef.num_entities, sizeof(cl.refdef.entities[0]), (int (*) (const void *, const void *))entitycmpfnc);
 	}
 	cl.refdef.rdflags |= RDF_BLOOM;	/* BLOOMS */
+	BENCH_END(BENCH_REFDEF);
+	scr_profclient = (Sys_Microseconds() - start) * 0.001;
 
 	re.RenderFrame(&cl.refdef);
 	if (cl_stats->value)
@@ -532,11 +532,16 @@ typedef struct particle_s {
 	void            (*think) (struct particle_s *p, vec3_t org, vec3_t angle, float *alpha, float *size, 
 	                          int *image, float *mytime);
 	qboolean	thinknext;
+
+	/* water classification for the renderer, -1 until the first frame */
+	int		contents;
+	vec3_t		contentsorg;
 #endif
 } cparticle_t;
 
 
 #define	PARTICLE_GRAVITY		40
+#define	PARTICLE_CONTENTS_DIST		8	/* units moved before the contents are looked up again */
 #define BLASTER_PARTICLE_COLOR		0xe0
 /* PMM */
 #define INSTANT_PARTICLE		-10000.0
@@ -759,7 +764,7 @@ void		V_AddEntity(entity_t * ent);
 
 #ifdef QMAX
 void		V_AddParticle(vec3_t org, vec3_t angle, vec3_t color, float alpha, int alpha_src,
-                              int alpha_dst, float size, int image, int flags);
+                              int alpha_dst, float size, int image, int flags, qboolean inwater);
 #else
 void		V_AddParticle(vec3_t org, int color, float alpha);
 #endif
@@ -828,6 +833,39 @@ void		CL_DrawInventory(void);
 //
 void		CL_PredictMovement(void);
 
+//
+/* cl_bench.c */
+//
+typedef enum {
+	BENCH_FRAME,
+	BENCH_PARSE,
+	BENCH_PREDICT,
+	BENCH_REFDEF,
+	BENCH_ENTITIES,
+	BENCH_PARTICLES,
+	BENCH_SOUND,
+	BENCH_SPATIALIZE,
+	BENCH_MIX,
+	BENCH_SCREEN,
+	BENCH_NUM_SLOTS
+} benchslot_t;
+
+/* the timers compile away outside the headless benchmark build */
+#ifdef QBENCH_BIN
+void		CL_BenchInit(void);
+void		CL_BenchBegin(benchslot_t slot);
+void		CL_BenchEnd(benchslot_t slot);
+void		CL_BenchFinish(void);
+qboolean	CL_BenchRunning(void);
+#define	BENCH_BEGIN(slot)	CL_BenchBegin(slot)
+#define	BENCH_END(slot)		CL_BenchEnd(slot)
+#define	BENCH_RUNNING()		CL_BenchRunning()
+#else
+#define	BENCH_BEGIN(slot)
+#define	BENCH_END(slot)
+#define	BENCH_RUNNING()		false
+#endif
+
 
 #ifdef QMAX
 void		SetParticleImages(void);
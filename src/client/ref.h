@@ -114,6 +114,7 @@ typedef struct {
 	int		image;
 	int		blendfunc_src;
 	int		blendfunc_dst;
+	qboolean	inwater;	/* classified by the client */
 #endif
 } particle_t;
 
@@ -154,7 +155,17 @@ typedef struct {
 	stain_t        *newstains;
 } refdef_t;
 
-#define	API_VERSION		3
+/* per section frame timings in msec, gpu < 0 when it wasn't measured */
+#define	MAX_PROFILE_SECTIONS	16
+
+typedef struct {
+	int		numsections;
+	const char     *names[MAX_PROFILE_SECTIONS];
+	float		cpu[MAX_PROFILE_SECTIONS];
+	float		gpu[MAX_PROFILE_SECTIONS];
+} refprofile_t;
+
+#define	API_VERSION		4
 
 //
 /* these are the functions exported by the refresh module */
@@ -231,6 +242,8 @@ typedef struct {
 	void            (*AddDecal) (vec3_t origin, vec3_t dir, float red, float green, float blue, float alpha, 
 	                             float size, int type, int flags, float angle);
 
+	/* timings of the last finished frame, numsections is 0 when off */
+	void            (*GetProfile) (refprofile_t * profile);
 } refexport_t;
 
 //
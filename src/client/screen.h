@@ -31,6 +31,8 @@ void		SCR_EndLoadingPlaque(void);
 
 void		SCR_DebugGraph(float value, int color);
 
+extern float	scr_profclient;
+
 void		SCR_TouchPics(void);
 
 void		SCR_RunConsole(void);
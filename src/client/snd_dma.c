@@ -71,6 +71,9 @@ int paintedtime;	/* sample PAIRS */
 sfx_t known_sfx[MAX_SFX];
 int num_sfx;
 
+#define SFX_HASH_SIZE	256	/* must be a power of two */
+static sfx_t *sfx_hash[SFX_HASH_SIZE];
+
 #define MAX_PLAYSOUNDS	128
 playsound_t	s_playsounds[MAX_PLAYSOUNDS];
 playsound_t	s_freeplays;
@@ -84,6 +87,9 @@ cvar_t         *s_loadas8bit;
 cvar_t         *s_khz;
 cvar_t         *s_show;
 cvar_t         *s_mixahead;
+cvar_t         *s_mixthread;
+cvar_t         *s_resample;
+cvar_t         *s_resamplecache;
 
 int s_rawend;
 portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
@@ -98,6 +104,109 @@ void (*SNDDMA_BeginPainting)(void);
 void (*SNDDMA_Submit)(void);
 struct sndinfo si;
 
+/* ============ */
+/* Mixer thread */
+/* ============ */
+
+/*
+ * The mixer owns the channels, the playsound lists and the dma buffer.  The
+ * main thread feeds it through a lock free ring of start/stop commands and
+ * a triple buffered frame holding the listener, the entity origins and the
+ * loop sounds.  s_mixlock is held while mixing and by the few operations
+ * that free sound data; when there is no thread the main thread does the
+ * mixing itself through the same path.
+ */
+
+#define MIXER_SLEEP_MSEC	5
+
+#define MAX_SNDCMDS	256	/* must be a power of two */
+
+typedef enum {
+	SNDCMD_START,
+	SNDCMD_STOPALL
+} sndcmdtype_t;
+
+typedef struct {
+	sndcmdtype_t	type;
+	playsound_t	ps;
+} sndcmd_t;
+
+static sndcmd_t	s_cmds[MAX_SNDCMDS];
+static volatile unsigned s_cmdhead;	/* written by the main thread */
+static volatile unsigned s_cmdtail;	/* written by the mixer */
+
+typedef struct {
+	qboolean	silent;		/* loading plaque is up, clear the buffer */
+	qboolean	active;		/* cls.state == ca_active */
+	int		playernum;
+	vec3_t		origin;
+	vec3_t		forward;
+	vec3_t		right;
+	vec3_t		up;
+	int		numloops;
+	sfx_t          *loopsfx[MAX_EDICTS];
+	vec3_t		looporigin[MAX_EDICTS];
+	vec3_t		entorigin[MAX_EDICTS];
+} sndframe_t;
+
+static sndframe_t s_frames[3];
+static volatile int s_framestate;	/* shared index | SNDFRAME_FRESH */
+static int	s_framewrite;		/* main thread */
+static int	s_frameread;		/* mixer */
+static sndframe_t *s_frame;		/* last frame applied by the mixer */
+
+#define SNDFRAME_FRESH	4
+
+static qmutex_t *s_mixlock;
+static qthread_t *s_mixer;
+static volatile qboolean s_mixquit;
+static volatile int s_overflows;
+
+static sndcmd_t *S_AllocCommand(void);
+static void	S_SubmitCommand(void);
+static void	S_RunCommands(void);
+static void	S_ClearSounds(void);
+static void	S_ClearBuffer(void);
+static void	S_MixerThread(void *unused);
+
+static qboolean	s_active;	/* mixer copies of client state */
+static int	s_playernum;
+
+/* S_AddLoopSounds merging, indexed by known_sfx slot */
+typedef struct {
+	sfx_t          *sfx;
+	int		left;
+	int		right;
+} loopgroup_t;
+
+static loopgroup_t s_loopgroups[MAX_EDICTS];
+static int	s_loopbucket[MAX_SFX];
+static int	s_loopstamp[MAX_SFX];
+static int	s_loopframe;
+
+static void S_LockMixer(void)
+{
+	if (s_mixlock)
+		Sys_LockMutex(s_mixlock);
+}
+
+static void S_UnlockMixer(void)
+{
+	if (s_mixlock)
+		Sys_UnlockMutex(s_mixlock);
+}
+
+/* ================ S_PaintChannelsLocked ================
+ * Entry point for drivers that mix from their own callback thread
+ */
+static void S_PaintChannelsLocked(int endtime)
+{
+	S_LockMixer();
+	S_RunCommands();
+	S_PaintChannels(endtime);
+	S_UnlockMixer();
+}
+
 /* ====================== */
 /* User-setable variables */
 /* ====================== */
@@ -114,6 +223,7 @@ void S_SoundInfo_f(void)
 	Com_Printf("Samplebits: %d\n", dma.samplebits);
 	Com_Printf("Submission_chunk: %d\n", dma.submission_chunk);
 	Com_Printf("Speed: %d\n", dma.speed);
+	Com_Printf("Mixer: %s\n", s_mixer ? "thread" : "main loop");
 }
 
 /* ================ S_Init ================ */
@@ -133,6 +243,17 @@ void S_Init(void)
 		s_mixahead = Cvar_Get("s_mixahead", "0.2", CVAR_ARCHIVE);
 		s_show = Cvar_Get("s_show", "0", 0);
 		s_testsound = Cvar_Get("s_testsound", "0", 0);
+		s_mixthread = Cvar_Get("s_mixthread", "1", CVAR_ARCHIVE);
+		s_resample = Cvar_Get("s_resample", "1", CVAR_ARCHIVE);
+		s_resamplecache = Cvar_Get("s_resamplecache", "1", CVAR_ARCHIVE);
+#ifdef QBENCH_BIN
+		SNDDMA_Init = SNDDMA_NullInit;
+		SNDDMA_Shutdown = SNDDMA_NullShutdown;
+		SNDDMA_GetDMAPos = SNDDMA_NullGetDMAPos;
+		SNDDMA_BeginPainting = SNDDMA_NullBeginPainting;
+		SNDDMA_Submit = SNDDMA_NullSubmit;
+		snddriver_active = true;
+#else
 		{
 		    char fn[MAX_OSPATH];
 		    struct stat st;
@@ -176,6 +297,7 @@ void S_Init(void)
 
 		    snddriver_active = true;
 		}
+#endif
 
 		si.dma = &dma;
 		si.sndbits = Cvar_Get("sndbits", "16", CVAR_ARCHIVE);
@@ -184,7 +306,7 @@ void S_Init(void)
 		si.snddevice = Cvar_Get("snddevice", "/dev/dsp", CVAR_ARCHIVE);
 		si.s_khz = Cvar_Get("s_khz", "0", CVAR_ARCHIVE);
 		si.Com_Printf = Com_Printf;
-		si.S_PaintChannels = S_PaintChannels;
+		si.S_PaintChannels = S_PaintChannelsLocked;
 		
 		if (!SNDDMA_Init(&si))
 			return;
@@ -197,6 +319,7 @@ void S_Init(void)
 		Cmd_AddCommand("ogg_shutdown", OGG_Shutdown);
 
 		S_InitScaletable();
+		S_InitMixer();
 
 		sound_started = 1;
 		num_sfx = 0;
@@ -204,10 +327,26 @@ void S_Init(void)
 		soundtime = 0;
 		paintedtime = 0;
 
+		s_cmdhead = s_cmdtail = 0;
+		s_framestate = 2;
+		s_framewrite = 0;
+		s_frameread = 1;
+		s_frame = NULL;
+		s_overflows = 0;
+		S_ClearSounds();
+		S_ClearBuffer();
+
+		s_mixlock = Sys_CreateMutex();
+		if (s_mixthread->value) {
+			s_mixquit = false;
+			s_mixer = Sys_CreateThread(S_MixerThread, NULL);
+			if (!s_mixer)
+				Com_Printf("Couldn't start the mixer thread\n");
+		}
+
 		Com_Printf("Sound sampling rate: %i\n", dma.speed);
 		
 		S_SoundInfo_f();
-		S_StopAllSounds();
 		OGG_Init();
 	}
 	
@@ -232,6 +371,14 @@ void S_Shutdown(void)
 	Cmd_RemoveCommand("ogg_init");
 	Cmd_RemoveCommand("ogg_shutdown");
 
+	if (s_mixer) {
+		s_mixquit = true;
+		Sys_WaitThread(s_mixer);
+		s_mixer = NULL;
+	}
+	Sys_DestroyMutex(s_mixlock);
+	s_mixlock = NULL;
+
 	SNDDMA_Shutdown();
 
 	sound_started = 0;
@@ -251,6 +398,7 @@ void S_Shutdown(void)
 	}
 
 	num_sfx = 0;
+	memset(sfx_hash, 0, sizeof(sfx_hash));
 	
 	if (snddriver_library) {
 	    SNDDMA_Init = NULL;
@@ -271,6 +419,31 @@ void S_Shutdown(void)
 /* Load a sound */
 /* ============ */
 
+/* ================== S_HashSfx ================== */
+static void S_HashSfx(sfx_t *sfx)
+{
+	unsigned hash;
+
+	hash = Com_HashKey(sfx->name, SFX_HASH_SIZE);
+	sfx->hash_next = sfx_hash[hash];
+	sfx_hash[hash] = sfx;
+}
+
+/* ================== S_UnhashSfx ================== */
+static void S_UnhashSfx(sfx_t *sfx)
+{
+	sfx_t **prev;
+
+	prev = &sfx_hash[Com_HashKey(sfx->name, SFX_HASH_SIZE)];
+	for ( ; *prev; prev = &(*prev)->hash_next) {
+		if (*prev == sfx) {
+			*prev = sfx->hash_next;
+			break;
+		}
+	}
+	sfx->hash_next = NULL;
+}
+
 /* ================== S_FindName ================== */
 sfx_t * S_FindName(char *name, qboolean create)
 {
@@ -286,10 +459,10 @@ sfx_t * S_FindName(char *name, qboolean create)
 		Com_Error(ERR_FATAL, "Sound name too long: %s", name);
 
 	/* see if already loaded */
-	for (i = 0; i < num_sfx; i++)
-		if (!strcmp(known_sfx[i].name, name)) {
-			return &known_sfx[i];
-		}
+	for (sfx = sfx_hash[Com_HashKey(name, SFX_HASH_SIZE)]; sfx; sfx = sfx->hash_next)
+		if (!strcmp(sfx->name, name))
+			return sfx;
+
 	if (!create)
 		return NULL;
 
@@ -308,6 +481,7 @@ sfx_t * S_FindName(char *name, qboolean create)
 	memset(sfx, 0, sizeof(*sfx));
 	Q_strncpyz(sfx->name, name, sizeof(sfx->name));
 	sfx->registration_sequence = s_registration_sequence;
+	S_HashSfx(sfx);
 
 	return sfx;
 }
@@ -334,9 +508,11 @@ sfx_t * S_AliasName(char *aliasname, char *truename)
 		num_sfx++;
 	}
 	sfx = &known_sfx[i];
+	memset(sfx, 0, sizeof(*sfx));
 	Q_strncpyz(sfx->name, aliasname, sizeof(sfx->name));
 	sfx->registration_sequence = s_registration_sequence;
 	sfx->truename = s;
+	S_HashSfx(sfx);
 
 	return sfx;
 }
@@ -373,6 +549,9 @@ void S_EndRegistration(void)
 	sfx_t *sfx;
 	int size;
 
+	/* the mixer must not touch sound data while it is freed or loaded */
+	S_LockMixer();
+
 	/* free any sounds not from this registration sequence */
 	for (i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++) {
 		if (!sfx->name[0])
@@ -381,6 +560,7 @@ void S_EndRegistration(void)
 			if (sfx->cache)	/* it is possible to have a leftover */
 				Z_Free(sfx->cache);	/* from a server that
 							 * didn't finish loading */
+			S_UnhashSfx(sfx);
 			memset(sfx, 0, sizeof(*sfx));
 		} else {	/* make sure it is paged in */
 			if (sfx->cache) {
@@ -397,6 +577,8 @@ void S_EndRegistration(void)
 		S_LoadSound(sfx);
 	}
 
+	S_UnlockMixer();
+
 	s_registering = false;
 }
 
@@ -426,7 +608,7 @@ channel_t * S_PickChannel(int entnum, int entchannel)
 			break;
 		}
 		/* don't let monster sounds override player sounds */
-		if (channels[ch_idx].entnum == cl.playernum + 1 && entnum != cl.playernum + 1 && channels[ch_idx].sfx)
+		if (channels[ch_idx].entnum == s_playernum + 1 && entnum != s_playernum + 1 && channels[ch_idx].sfx)
 			continue;
 
 		if (channels[ch_idx].end - paintedtime < life_left) {
@@ -454,7 +636,7 @@ void S_SpatializeOrigin(vec3_t origin, float master_vol, float dist_mult, int *l
 	vec_t lscale, rscale, scale;
 	vec3_t source_vec;
 
-	if (cls.state != ca_active) {
+	if (!s_active) {
 		*left_vol = *right_vol = 255;
 		return;
 	}
@@ -496,15 +678,18 @@ void S_Spatialize(channel_t * ch)
 	vec3_t origin;
 
 	/* anything coming from the view entity will always be full volume */
-	if (ch->entnum == cl.playernum + 1) {
+	if (ch->entnum == s_playernum + 1) {
 		ch->leftvol = ch->master_vol;
 		ch->rightvol = ch->master_vol;
 		return;
 	}
 	if (ch->fixed_origin) {
 		VectorCopy(ch->origin, origin);
+	} else if (s_frame && ch->entnum >= 0 && ch->entnum < MAX_EDICTS) {
+		/* entity origins come from the last frame sent by S_Update */
+		VectorCopy(s_frame->entorigin[ch->entnum], origin);
 	} else
-		CL_GetEntitySoundOrigin(ch->entnum, origin);
+		VectorCopy(listener_origin, origin);
 
 	S_SpatializeOrigin(origin, ch->master_vol, ch->dist_mult, &ch->leftvol, &ch->rightvol);
 }
@@ -550,9 +735,13 @@ void S_IssuePlaysound(playsound_t * ps)
 	channel_t *ch;
 	sfxcache_t *sc;
 
-	if (s_show->value)
-		Com_Printf("Issue %i\n", ps->begin);
-	
+	/* sounds are loaded before they are queued, but may be freed since */
+	sc = ps->sfx->cache;
+	if (!sc) {
+		S_FreePlaysound(ps);
+		return;
+	}
+
 	/* pick a channel to play on */
 	ch = S_PickChannel(ps->entnum, ps->entchannel);
 	if (!ch) {
@@ -575,7 +764,6 @@ void S_IssuePlaysound(playsound_t * ps)
 	S_Spatialize(ch);
 
 	ch->pos = 0;
-	sc = S_LoadSound(ch->sfx);
 	ch->end = paintedtime + sc->length;
 
 	/* free the playsound */
@@ -643,7 +831,8 @@ void S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t * sfx, float
 {
 	sfxcache_t *sc;
 	int vol;
-	playsound_t *ps, *sort;
+	sndcmd_t *cmd;
+	playsound_t *ps;
 	int start;
 
 	if (!sound_started)
@@ -652,6 +841,9 @@ void S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t * sfx, float
 	if (!sfx)
 		return;
 
+	if (entchannel < 0)
+		Com_Error(ERR_DROP, "S_StartSound: entchannel<0");
+
 	if (sfx->name[0] == '*')
 		sfx = S_RegisterSexedSound(&cl_entities[entnum].current, sfx->name);
 
@@ -662,11 +854,14 @@ void S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t * sfx, float
 
 	vol = fvol * 255;
 
-	/* make the playsound_t */
-	ps = S_AllocPlaysound();
-	if (!ps)
+	/* queue the playsound_t for the mixer */
+	cmd = S_AllocCommand();
+	if (!cmd)
 		return;
 
+	cmd->type = SNDCMD_START;
+	ps = &cmd->ps;
+
 	if (origin) {
 		VectorCopy(origin, ps->origin);
 		ps->fixed_origin = true;
@@ -696,16 +891,10 @@ void S_StartSound(vec3_t origin, int entnum, int entchannel, sfx_t * sfx, float
 	else
 		ps->begin = start + timeofs * dma.speed;
 
-	/* sort into the pending sound list */
-	for (sort = s_pendingplays.next;
-	    sort != &s_pendingplays && sort->begin < ps->begin;
-	    sort = sort->next);
-
-	ps->next = sort;
-	ps->prev = sort->prev;
+	if (s_show->value)
+		Com_Printf("Issue %i\n", ps->begin);
 
-	ps->next->prev = ps;
-	ps->prev->next = ps;
+	S_SubmitCommand();
 }
 
 
@@ -727,7 +916,7 @@ void S_StartLocalSound(char *sound)
 
 
 /* ================== S_ClearBuffer ================== */
-void S_ClearBuffer(void)
+static void S_ClearBuffer(void)
 {
 	int clear;
 
@@ -757,14 +946,13 @@ void S_ClearBuffer(void)
 	SNDDMA_Submit();
 }
 
-/* ================== S_StopAllSounds ================== */
-void S_StopAllSounds(void)
+/* ================== S_ClearSounds ==================
+ * Resets the playsounds and the channels, mixer side of S_StopAllSounds
+ */
+static void S_ClearSounds(void)
 {
 	int i;
 
-	if (!sound_started)
-		return;
-
 	/* clear all the playsounds */
 	memset(s_playsounds, 0, sizeof(s_playsounds));
 	s_freeplays.next = s_freeplays.prev = &s_freeplays;
@@ -779,86 +967,87 @@ void S_StopAllSounds(void)
 
 	/* clear all the channels */
 	memset(channels, 0, sizeof(channels));
+}
+
+/* ================== S_StopAllSounds ================== */
+void S_StopAllSounds(void)
+{
+	sndcmd_t *cmd;
+
+	if (!sound_started)
+		return;
+
+	cmd = S_AllocCommand();
+	if (!cmd) {
+		/* queue is full, drain it ourselves */
+		S_LockMixer();
+		S_RunCommands();
+		S_UnlockMixer();
+		cmd = S_AllocCommand();
+	}
 
-	S_ClearBuffer();
+	cmd->type = SNDCMD_STOPALL;
+	S_SubmitCommand();
 }
 
 /* ================== S_AddLoopSounds ==================
  * Entities with a ->sound field will generated looped sounds that are
  * automatically started, stopped, and merged together as the entities are
- * sent to the client
+ * sent to the client.  Runs in the mixer on the loops collected by
+ * S_BuildLoopSounds.
  */
 void S_AddLoopSounds(void)
 {
 	int i, j;
-	int sounds[MAX_EDICTS];
-	int left, right, left_total, right_total;
+	int left, right;
+	int numgroups;
+	int sfxnum;
 	channel_t *ch;
 	sfx_t *sfx;
 	sfxcache_t *sc;
-	int num;
-	entity_state_t *ent;
-
-	if (cl_paused->value)
-		return;
+	loopgroup_t *group;
 
-	if (cls.state != ca_active)
-		return;
-
-	if (!cl.sound_prepped)
-		return;
+	/* group the loops by sound in a single pass, the bucket of each */
+	/* known_sfx slot is valid only if it was stamped this frame */
+	s_loopframe++;
+	numgroups = 0;
 
-	for (i = 0; i < cl.frame.num_entities; i++) {
-		num = (cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1);
-		ent = &cl_parse_entities[num];
-		sounds[i] = ent->sound;
-	}
-
-	for (i = 0; i < cl.frame.num_entities; i++) {
-		if (!sounds[i])
-			continue;
-
-		sfx = cl.sound_precache[sounds[i]];
-		if (!sfx)
-			continue;	/* bad sound effect */
-		sc = sfx->cache;
-		if (!sc)
+	for (i = 0; i < s_frame->numloops; i++) {
+		sfx = s_frame->loopsfx[i];
+		if (!sfx->cache)
 			continue;
 
-		num = (cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1);
-		ent = &cl_parse_entities[num];
+		sfxnum = sfx - known_sfx;
+		if (s_loopstamp[sfxnum] != s_loopframe) {
+			s_loopstamp[sfxnum] = s_loopframe;
+			s_loopbucket[sfxnum] = numgroups;
+			group = &s_loopgroups[numgroups++];
+			group->sfx = sfx;
+			group->left = group->right = 0;
+		} else
+			group = &s_loopgroups[s_loopbucket[sfxnum]];
 
 		/* find the total contribution of all sounds of this type */
-		S_SpatializeOrigin(ent->origin, 255.0, SOUND_LOOPATTENUATE,
-		    &left_total, &right_total);
-		for (j = i + 1; j < cl.frame.num_entities; j++) {
-			if (sounds[j] != sounds[i])
-				continue;
-			sounds[j] = 0;	/* don't check this again later */
-
-			num = (cl.frame.parse_entities + j) & (MAX_PARSE_ENTITIES - 1);
-			ent = &cl_parse_entities[num];
-
-			S_SpatializeOrigin(ent->origin, 255.0, SOUND_LOOPATTENUATE,
-			    &left, &right);
-			left_total += left;
-			right_total += right;
-		}
+		S_SpatializeOrigin(s_frame->looporigin[i], 255.0, SOUND_LOOPATTENUATE,
+		    &left, &right);
+		group->left += left;
+		group->right += right;
+	}
 
-		if (left_total == 0 && right_total == 0)
+	for (j = 0, group = s_loopgroups; j < numgroups; j++, group++) {
+		if (group->left == 0 && group->right == 0)
 			continue;	/* not audible */
 
+		sfx = group->sfx;
+		sc = sfx->cache;
+
 		/* allocate a channel */
 		ch = S_PickChannel(0, 0);
 		if (!ch)
 			return;
 
-		if (left_total > 255)
-			left_total = 255;
-		if (right_total > 255)
-			right_total = 255;
-		ch->leftvol = left_total;
-		ch->rightvol = right_total;
+		ch->leftvol = group->left > 255 ? 255 : group->left;
+		ch->rightvol = group->right > 255 ? 255 : group->right;
 		ch->autosound = true;	/* remove next frame */
 		ch->sfx = sfx;
 
@@ -883,6 +1072,43 @@ void S_AddLoopSounds(void)
 	}
 }
 
+/* ================== S_BuildLoopSounds ==================
+ * Collects the looped sounds of the current client frame for the mixer
+ */
+static void S_BuildLoopSounds(sndframe_t *frame)
+{
+	int i;
+	int num;
+	sfx_t *sfx;
+	entity_state_t *ent;
+
+	frame->numloops = 0;
+
+	if (cl_paused->value)
+		return;
+
+	if (cls.state != ca_active)
+		return;
+
+	if (!cl.sound_prepped)
+		return;
+
+	for (i = 0; i < cl.frame.num_entities; i++) {
+		num = (cl.frame.parse_entities + i) & (MAX_PARSE_ENTITIES - 1);
+		ent = &cl_parse_entities[num];
+		if (!ent->sound)
+			continue;
+
+		sfx = cl.sound_precache[ent->sound];
+		if (!sfx || !sfx->cache)
+			continue;	/* bad sound effect */
+
+		frame->loopsfx[frame->numloops] = sfx;
+		VectorCopy(ent->origin, frame->looporigin[frame->numloops]);
+		frame->numloops++;
+	}
+}
+
 /* ================================================================== */
 
 /* ============ S_RawSamples ============
@@ -892,21 +1118,23 @@ void S_RawSamples(int samples, int rate, int width, int channels, byte * data)
 {
 	int i;
 	int src, dst;
+	int rawend;
 	float scale;
 
 	if (!sound_started)
 		return;
 
-	if (s_rawend < paintedtime)
-		s_rawend = paintedtime;
+	rawend = s_rawend;
+	if (rawend < paintedtime)
+		rawend = paintedtime;
 	scale = (float)rate / dma.speed;
 
 	/* Com_Printf ("%i < %i < %i\n", soundtime, paintedtime, s_rawend); */
 	if (channels == 2 && width == 2) {
 		if (scale == 1.0) {	/* optimized case */
 			for (i = 0; i < samples; i++) {
-				dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-				s_rawend++;
+				dst = rawend & (MAX_RAW_SAMPLES - 1);
+				rawend++;
 				s_rawsamples[dst].left =
 				    LittleShort(((short *)data)[i * 2]) << 8;
 				s_rawsamples[dst].right =
@@ -917,8 +1145,8 @@ void S_RawSamples(int samples, int rate, int width, int channels, byte * data)
 				src = i * scale;
 				if (src >= samples)
 					break;
-				dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-				s_rawend++;
+				dst = rawend & (MAX_RAW_SAMPLES - 1);
+				rawend++;
 				s_rawsamples[dst].left =
 				    LittleShort(((short *)data)[src * 2]) << 8;
 				s_rawsamples[dst].right =
@@ -930,8 +1158,8 @@ void S_RawSamples(int samples, int rate, int width, int channels, byte * data)
 			src = i * scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    LittleShort(((short *)data)[src]) << 8;
 			s_rawsamples[dst].right =
@@ -942,8 +1170,8 @@ void S_RawSamples(int samples, int rate, int width, int channels, byte * data)
 			src = i * scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    ((char *)data)[src * 2] << 16;
 			s_rawsamples[dst].right =
@@ -954,45 +1182,128 @@ void S_RawSamples(int samples, int rate, int width, int channels, byte * data)
 			src = i * scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend & (MAX_RAW_SAMPLES - 1);
-			s_rawend++;
+			dst = rawend & (MAX_RAW_SAMPLES - 1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    (((byte *) data)[src] - 128) << 16;
 			s_rawsamples[dst].right = (((byte *) data)[src] - 128) << 16;
 		}
 	}
+
+	/* the mixer may read the samples as soon as s_rawend moves */
+	Sys_MemoryBarrier();
+	s_rawend = rawend;
 }
 
-/* ============ S_Update ============
- * Called once each time through the main loop
+/* ================================================================== */
+
+/* ================ S_AllocCommand ================
+ * Returns the next free slot of the mixer queue, or NULL if it is full.
+ * Only the main thread queues commands.
  */
-void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+static sndcmd_t *S_AllocCommand(void)
+{
+	if (s_cmdhead - s_cmdtail >= MAX_SNDCMDS)
+		return NULL;
+
+	return &s_cmds[s_cmdhead & (MAX_SNDCMDS - 1)];
+}
+
+static void S_SubmitCommand(void)
+{
+	/* the command must be complete before the mixer can see it */
+	Sys_MemoryBarrier();
+	s_cmdhead++;
+}
+
+/* ================ S_RunCommands ================
+ * Mixer side of the queue, called with s_mixlock held
+ */
+static void S_RunCommands(void)
+{
+	sndcmd_t *cmd;
+	playsound_t *ps, *sort;
+
+	while (s_cmdtail != s_cmdhead) {
+		Sys_MemoryBarrier();
+		cmd = &s_cmds[s_cmdtail & (MAX_SNDCMDS - 1)];
+
+		switch (cmd->type) {
+		case SNDCMD_START:
+			ps = S_AllocPlaysound();
+			if (!ps)
+				break;	/* no free playsounds */
+
+			ps->sfx = cmd->ps.sfx;
+			ps->volume = cmd->ps.volume;
+			ps->attenuation = cmd->ps.attenuation;
+			ps->entnum = cmd->ps.entnum;
+			ps->entchannel = cmd->ps.entchannel;
+			ps->fixed_origin = cmd->ps.fixed_origin;
+			VectorCopy(cmd->ps.origin, ps->origin);
+			ps->begin = cmd->ps.begin;
+
+			/* sort into the pending sound list */
+			for (sort = s_pendingplays.next;
+			    sort != &s_pendingplays && sort->begin < ps->begin;
+			    sort = sort->next);
+
+			ps->next = sort;
+			ps->prev = sort->prev;
+
+			ps->next->prev = ps;
+			ps->prev->next = ps;
+			break;
+
+		case SNDCMD_STOPALL:
+			S_ClearSounds();
+			S_ClearBuffer();
+			break;
+		}
+
+		Sys_MemoryBarrier();
+		s_cmdtail++;
+	}
+}
+
+/* ================ S_ExchangeFrame ================
+ * Swaps a private frame buffer with the shared one
+ */
+static int S_ExchangeFrame(int index)
+{
+	int old;
+
+	do {
+		old = s_framestate;
+	} while (Sys_AtomicCAS(&s_framestate, old, index) != old);
+
+	return old & 3;
+}
+
+/* ================ S_ApplyFrame ================
+ * Picks up the latest frame from S_Update and respatializes the channels,
+ * called with s_mixlock held
+ */
+static void S_ApplyFrame(void)
 {
 	int i;
-	int total;
 	channel_t *ch;
-	channel_t *combine;
 
-	if (!sound_started)
+	if (!(s_framestate & SNDFRAME_FRESH))
 		return;
 
-	/* if the laoding plaque is up, clear everything */
-	/* out to make sure we aren't looping a dirty */
-	/* dma buffer while loading */
-	if (cls.disable_screen) {
-		S_ClearBuffer();
-		return;
-	}
-	/* rebuild scale tables if volume is modified */
-	if (s_volume->modified)
-		S_InitScaletable();
+	s_frameread = S_ExchangeFrame(s_frameread);
+	s_frame = &s_frames[s_frameread];
 
-	VectorCopy(origin, listener_origin);
-	VectorCopy(forward, listener_forward);
-	VectorCopy(right, listener_right);
-	VectorCopy(up, listener_up);
+	if (s_frame->silent)
+		return;
 
-	combine = NULL;
+	s_active = s_frame->active;
+	s_playernum = s_frame->playernum;
+	VectorCopy(s_frame->origin, listener_origin);
+	VectorCopy(s_frame->forward, listener_forward);
+	VectorCopy(s_frame->right, listener_right);
+	VectorCopy(s_frame->up, listener_up);
 
 	/* update spatialization for dynamic sounds	 */
 	ch = channels;
@@ -1013,9 +1324,80 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 
 	/* add loopsounds */
 	S_AddLoopSounds();
+}
+
+/* ================ S_MixerThread ================
+ * Stands aside while a bench runs, S_Update mixes on the main thread then so
+ * the mixing is timed there
+ */
+static void S_MixerThread(void *unused)
+{
+	while (!s_mixquit) {
+		S_LockMixer();
+		if (!BENCH_RUNNING())
+			S_Update_();
+		S_UnlockMixer();
+
+		Sys_Sleep(MIXER_SLEEP_MSEC);
+	}
+}
+
+/* ============ S_Update ============
+ * Called once each time through the main loop
+ */
+void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+{
+	int i;
+	int total;
+	channel_t *ch;
+	sndframe_t *frame;
+	static int overflows;
+
+	if (!sound_started)
+		return;
+
+	frame = &s_frames[s_framewrite];
+
+	/* if the laoding plaque is up, clear everything */
+	/* out to make sure we aren't looping a dirty */
+	/* dma buffer while loading */
+	frame->silent = cls.disable_screen ? true : false;
+
+	if (!frame->silent) {
+		frame->active = (cls.state == ca_active);
+		frame->playernum = cl.playernum;
+		VectorCopy(origin, frame->origin);
+		VectorCopy(forward, frame->forward);
+		VectorCopy(right, frame->right);
+		VectorCopy(up, frame->up);
+
+		for (i = 0; i < MAX_EDICTS; i++)
+			VectorCopy(cl_entities[i].lerp_origin, frame->entorigin[i]);
+
+		S_BuildLoopSounds(frame);
+	}
+
+	/* hand the frame over to the mixer */
+	s_framewrite = S_ExchangeFrame(s_framewrite | SNDFRAME_FRESH);
+
+	if (!s_mixer || BENCH_RUNNING()) {
+		/* mix some sound */
+		S_LockMixer();
+		S_Update_();
+		S_UnlockMixer();
+	}
+
+	if (overflows != s_overflows) {
+		overflows = s_overflows;
+		Com_DPrintf("S_Update_ : overflow\n");
+	}
+
+	if (frame->silent)
+		return;
 
 	/* debugging output */
-    if (s_show->value) {
+	if (s_show->value) {
+		S_LockMixer();
 		total = 0;
 		ch = channels;
 		for (i = 0; i < MAX_CHANNELS; i++, ch++)
@@ -1024,9 +1406,8 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 				total++;
 			}
 		Com_Printf("----(%i)---- painted: %i\n", total, paintedtime);
+		S_UnlockMixer();
 	}
-	/* mix some sound */
-	S_Update_();
 	
 	/* stream music */
 	OGG_Stream();
@@ -1052,7 +1433,8 @@ void GetSoundtime(void)
 						 * avoid 32 bit limits */
 			buffers = 0;
 			paintedtime = fullsamples;
-			S_StopAllSounds();
+			S_ClearSounds();
+			S_ClearBuffer();
 		}
 	}
 	oldsamplepos = samplepos;
@@ -1060,6 +1442,10 @@ void GetSoundtime(void)
 	soundtime = buffers * fullsamples + samplepos / dma.channels;
 }
 
+/* ============ S_Update_ ============
+ * Mixes ahead of the dma position, called with s_mixlock held from the
+ * mixer thread or from S_Update
+ */
 void S_Update_(void)
 {
 	unsigned endtime;
@@ -1068,6 +1454,21 @@ void S_Update_(void)
 	if (!sound_started)
 		return;
 
+	/* rebuild scale tables if volume is modified */
+	if (s_volume->modified)
+		S_InitScaletable();
+
+	S_RunCommands();
+
+	BENCH_BEGIN(BENCH_SPATIALIZE);
+	S_ApplyFrame();
+	BENCH_END(BENCH_SPATIALIZE);
+
+	if (s_frame && s_frame->silent) {
+		S_ClearBuffer();
+		return;
+	}
+
 	SNDDMA_BeginPainting();
 
 	if (!dma.buffer)
@@ -1078,7 +1479,7 @@ void S_Update_(void)
 
 	/* check to make sure that we haven't overshot */
 	if (paintedtime < soundtime) {
-		Com_DPrintf("S_Update_ : overflow\n");
+		s_overflows++;
 		paintedtime = soundtime;
 	}
 	/* mix ahead of current position */
@@ -1092,7 +1493,9 @@ void S_Update_(void)
 	if (endtime - soundtime > samps)
 		endtime = soundtime + samps;
 
+	BENCH_BEGIN(BENCH_MIX);
 	S_PaintChannels(endtime);
+	BENCH_END(BENCH_MIX);
 
 	SNDDMA_Submit();
 }
@@ -39,6 +39,7 @@ typedef struct sfx_s {
 	int		registration_sequence;
 	sfxcache_t     *cache;
 	char           *truename;
+	struct sfx_s   *hash_next;	/* S_FindName hash chain */
 } sfx_t;
 
 /* a playsound_t will be generated by each call to S_StartSound, */
@@ -140,10 +141,23 @@ extern cvar_t  *s_khz;
 extern cvar_t  *s_show;
 extern cvar_t  *s_mixahead;
 extern cvar_t  *s_testsound;
+extern cvar_t  *s_mixthread;
+extern cvar_t  *s_resample;
+extern cvar_t  *s_resamplecache;
 
 wavinfo_t	GetWavinfo(char *name, byte * wav, int wavlength);
 
+#ifdef QBENCH_BIN
+/* null output driver, linked into the benchmark */
+qboolean	SNDDMA_NullInit(struct sndinfo *si);
+int		SNDDMA_NullGetDMAPos(void);
+void		SNDDMA_NullShutdown(void);
+void		SNDDMA_NullBeginPainting(void);
+void		SNDDMA_NullSubmit(void);
+#endif
+
 void		S_InitScaletable(void);
+void		S_InitMixer(void);
 
 sfxcache_t     *S_LoadSound(sfx_t * s);
 
@@ -22,33 +22,203 @@
 #include "client.h"
 #include "snd_loc.h"
 
+#if idsse2
+#include <xmmintrin.h>
+#endif
+
 int		cache_full_cycle;
 
 byte           *S_Alloc(int size);
 
+/*
+ * ===========================================================================
+ * ==
+ *
+ * Sample rate conversion
+ *
+ * Sounds that don't match the output rate are converted once at load time
+ * with a windowed-sinc filter.  The filter is stored as a polyphase table of
+ * SINC_PHASES rows, each holding the taps for one fractional source position,
+ * so every output sample is a single dot product.  s_resample 0 restores the
+ * old nearest-neighbour stepping.
+ *
+ * ===========================================================================
+ * ==
+ */
+
+#define	SINC_PHASES	256
+#define	SINC_MINTAPS	16
+#define	SINC_MAXTAPS	64
+
+static float   *sinc_table;
+static int	sinc_taps;
+static int	sinc_inrate, sinc_outrate;
+
+/*
+ * ================ S_ResampledLength ================
+ */
+static int
+S_ResampledLength(int samples, int inrate)
+{
+	return (int)((long long)samples * dma.speed / inrate);
+}
+
+/*
+ * ================ S_BuildSincTable ================
+ *
+ * Blackman-windowed sinc.  When downsampling the cutoff drops to the output
+ * Nyquist and the kernel widens so it still spans the same number of
+ * zero crossings.  Every phase is normalized to unity gain at DC.
+ */
+static void
+S_BuildSincTable(int inrate, int outrate)
+{
+	float		cutoff, frac, t, x, h, sum;
+	float          *row;
+	int		p, k, half;
+
+	if (sinc_table && sinc_inrate == inrate && sinc_outrate == outrate)
+		return;
+
+	if (sinc_table)
+		Z_Free(sinc_table);
+
+	cutoff = 0.95;
+	if (outrate < inrate)
+		cutoff *= (float)outrate / inrate;
+
+	sinc_taps = ((int)ceil(SINC_MINTAPS / cutoff) + 3) & ~3;
+	if (sinc_taps > SINC_MAXTAPS)
+		sinc_taps = SINC_MAXTAPS;
+	half = sinc_taps / 2;
+
+	sinc_table = Z_Malloc(SINC_PHASES * sinc_taps * sizeof(float));
+	sinc_inrate = inrate;
+	sinc_outrate = outrate;
+
+	for (p = 0; p < SINC_PHASES; p++) {
+		row = sinc_table + p * sinc_taps;
+		frac = (float)p / SINC_PHASES;
+		sum = 0;
+		for (k = 0; k < sinc_taps; k++) {
+			t = (k - half + 1) - frac;
+			x = t / half;
+			if (x <= -1 || x >= 1) {
+				row[k] = 0;
+				continue;
+			}
+			if (t == 0)
+				h = cutoff;
+			else
+				h = sin(M_PI * cutoff * t) / (M_PI * t);
+			h *= 0.42 + 0.5 * cos(M_PI * x) + 0.08 * cos(2 * M_PI * x);
+			row[k] = h;
+			sum += h;
+		}
+		for (k = 0; k < sinc_taps; k++)
+			row[k] /= sum;
+	}
+}
+
+/*
+ * ================ S_SincDot ================
+ *
+ * taps is always a multiple of four.
+ */
+#if idsse2
+static float
+S_SincDot(const float *in, const float *coef, int taps)
+{
+	__m128		acc;
+	float		out[4];
+	int		k;
+
+	acc = _mm_setzero_ps();
+	for (k = 0; k < taps; k += 4)
+		acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(in + k),
+		    _mm_loadu_ps(coef + k)));
+
+	_mm_storeu_ps(out, acc);
+	return (out[0] + out[1]) + (out[2] + out[3]);
+}
+#else
+static float
+S_SincDot(const float *in, const float *coef, int taps)
+{
+	float		a0, a1, a2, a3;
+	int		k;
+
+	a0 = a1 = a2 = a3 = 0;
+	for (k = 0; k < taps; k += 4) {
+		a0 += in[k] * coef[k];
+		a1 += in[k + 1] * coef[k + 1];
+		a2 += in[k + 2] * coef[k + 2];
+		a3 += in[k + 3] * coef[k + 3];
+	}
+	return (a0 + a1) + (a2 + a3);
+}
+#endif
+
+/*
+ * ================ ResampleSinc ================
+ */
+static void
+ResampleSinc(sfxcache_t * sc, int inrate, int inwidth, int insamples, byte * data)
+{
+	float          *in;
+	long long	pos;
+	int		i, idx, phase, half, sample;
+	float		val;
+
+	S_BuildSincTable(inrate, dma.speed);
+	half = sinc_taps / 2;
+
+	/* widen to float with enough silence on both ends for the kernel */
+	in = Z_Malloc((insamples + sinc_taps) * sizeof(float));
+	if (inwidth == 2)
+		for (i = 0; i < insamples; i++)
+			in[half + i] = LittleShort(((short *)data)[i]);
+	else
+		for (i = 0; i < insamples; i++)
+			in[half + i] = (int)((unsigned char)data[i] - 128) << 8;
+
+	for (i = 0; i < sc->length; i++) {
+		pos = (long long)i * inrate;
+		idx = pos / dma.speed;
+		phase = (pos - (long long)idx * dma.speed) * SINC_PHASES / dma.speed;
+
+		val = S_SincDot(in + idx + 1, sinc_table + phase * sinc_taps, sinc_taps);
+		sample = (int)(val < 0 ? val - 0.5 : val + 0.5);
+		if (sample > 32767)
+			sample = 32767;
+		else if (sample < -32768)
+			sample = -32768;
+
+		if (sc->width == 2)
+			((short *)sc->data)[i] = sample;
+		else
+			((signed char *)sc->data)[i] = sample >> 8;
+	}
+
+	Z_Free(in);
+}
+
 /*
  * ================ ResampleSfx ================
  */
-void
-ResampleSfx(sfx_t * sfx, int inrate, int inwidth, byte * data)
+static void
+ResampleSfx(sfxcache_t * sc, int inrate, int inwidth, byte * data)
 {
-	int		outcount;
+	int		insamples;
 	int		srcsample;
 	float		stepscale;
 	int		i;
 	int		sample, samplefrac, fracstep;
-	sfxcache_t     *sc;
-
-	sc = sfx->cache;
-	if (!sc)
-		return;
-
-	stepscale = (float)inrate / dma.speed;	/* this is usually 0.5, 1 or 2 */
 
-	outcount = sc->length / stepscale;
-	sc->length = outcount;
+	insamples = sc->length;
+	sc->length = S_ResampledLength(insamples, inrate);
 	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+		sc->loopstart = S_ResampledLength(sc->loopstart, inrate);
 
 	sc->speed = dma.speed;
 	if (s_loadas8bit->value)
@@ -59,16 +229,19 @@ ResampleSfx(sfx_t * sfx, int inrate, int inwidth, byte * data)
 
 	/* resample / decimate to the current source rate */
 
-	if (stepscale == 1 && inwidth == 1 && sc->width == 1) {
+	if (inrate == dma.speed && inwidth == 1 && sc->width == 1) {
 		/* fast special case */
-		for (i = 0; i < outcount; i++)
+		for (i = 0; i < sc->length; i++)
 			((signed char *)sc->data)[i]
 			    = (int)((unsigned char)(data[i]) - 128);
+	} else if (inrate != dma.speed && s_resample->value) {
+		ResampleSinc(sc, inrate, inwidth, insamples, data);
 	} else {
 		/* general case */
+		stepscale = (float)inrate / dma.speed;
 		samplefrac = 0;
 		fracstep = stepscale * 256;
-		for (i = 0; i < outcount; i++) {
+		for (i = 0; i < sc->length; i++) {
 			srcsample = samplefrac >> 8;
 			samplefrac += fracstep;
 			if (inwidth == 2)
@@ -83,6 +256,121 @@ ResampleSfx(sfx_t * sfx, int inrate, int inwidth, byte * data)
 	}
 }
 
+/*
+ * ===========================================================================
+ * ==
+ *
+ * Converted sample cache
+ *
+ * Resampled PCM is written under <gamedir>/sndcache/ so snd_restart and map
+ * changes don't redo the conversion.  An entry is only used when the source
+ * checksum, output rate, width and resampler all match.
+ *
+ * ===========================================================================
+ * ==
+ */
+
+#define	SNDCACHE_MAGIC		(('C'<<24)+('D'<<16)+('N'<<8)+'S')
+#define	SNDCACHE_VERSION	1
+
+typedef struct {
+	int		magic;
+	int		version;
+	unsigned	checksum;
+	int		speed;
+	int		width;
+	int		resample;
+	int		length;
+	int		loopstart;
+} sndcachehdr_t;
+
+/*
+ * ================ S_SfxCachePath ================
+ */
+static void
+S_SfxCachePath(char *path, int size, const char *name, int width)
+{
+	Com_sprintf(path, size, "%s/sndcache/%s.%d.%d",
+	    FS_Gamedir(), name, dma.speed, width);
+}
+
+/*
+ * ================ S_ReadCachedSfx ================
+ */
+static sfxcache_t *
+S_ReadCachedSfx(const char *name, unsigned checksum, int width)
+{
+	char		path[MAX_OSPATH];
+	sndcachehdr_t	hdr;
+	sfxcache_t     *sc;
+	FILE           *f;
+
+	S_SfxCachePath(path, sizeof(path), name, width);
+	if ((f = fopen(path, "rb")) == NULL)
+		return NULL;
+
+	if (fread(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    hdr.magic != SNDCACHE_MAGIC ||
+	    hdr.version != SNDCACHE_VERSION ||
+	    hdr.checksum != checksum ||
+	    hdr.speed != dma.speed ||
+	    hdr.width != width ||
+	    hdr.resample != (int)s_resample->value ||
+	    hdr.length <= 0 || hdr.length > (1 << 26)) {
+		fclose(f);
+		return NULL;
+	}
+
+	sc = Z_Malloc(hdr.length * width + sizeof(sfxcache_t));
+	if (fread(sc->data, width, hdr.length, f) != hdr.length) {
+		fclose(f);
+		Z_Free(sc);
+		return NULL;
+	}
+	fclose(f);
+
+	sc->length = hdr.length;
+	sc->loopstart = hdr.loopstart;
+	sc->speed = hdr.speed;
+	sc->width = hdr.width;
+	sc->stereo = 0;
+
+	return sc;
+}
+
+/*
+ * ================ S_WriteCachedSfx ================
+ */
+static void
+S_WriteCachedSfx(const char *name, unsigned checksum, sfxcache_t * sc)
+{
+	char		path[MAX_OSPATH];
+	sndcachehdr_t	hdr;
+	FILE           *f;
+
+	S_SfxCachePath(path, sizeof(path), name, sc->width);
+	FS_CreatePath(path);
+	if ((f = fopen(path, "wb")) == NULL)
+		return;
+
+	hdr.magic = SNDCACHE_MAGIC;
+	hdr.version = SNDCACHE_VERSION;
+	hdr.checksum = checksum;
+	hdr.speed = sc->speed;
+	hdr.width = sc->width;
+	hdr.resample = (int)s_resample->value;
+	hdr.length = sc->length;
+	hdr.loopstart = sc->loopstart;
+
+	if (fwrite(&hdr, sizeof(hdr), 1, f) != 1 ||
+	    fwrite(sc->data, sc->width, sc->length, f) != sc->length) {
+		fclose(f);
+		remove(path);
+		return;
+	}
+	fclose(f);
+}
+
 /*
  * ===========================================================================
  * ==
@@ -98,7 +386,9 @@ S_LoadSound(sfx_t * s)
 	byte           *data;
 	wavinfo_t	info;
 	int		len;
-	float		stepscale;
+	int		width;
+	unsigned	checksum;
+	qboolean	usecache;
 	sfxcache_t     *sc;
 	int		size;
 	char           *name;
@@ -137,12 +427,27 @@ S_LoadSound(sfx_t * s)
 		FS_FreeFile(data);
 		return NULL;
 	}
-	stepscale = (float)info.rate / dma.speed;
-	len = info.samples / stepscale;
 
+	width = s_loadas8bit->value ? 1 : info.width;
+
+	/* only conversions are worth caching, a straight copy is cheaper */
+	usecache = s_resamplecache->value && info.rate != dma.speed;
+	checksum = 0;
+	if (usecache) {
+		checksum = Com_BlockChecksum(data, size);
+		sc = S_ReadCachedSfx(namebuffer, checksum, width);
+		if (sc) {
+			FS_FreeFile(data);
+			Sys_MemoryBarrier();
+			s->cache = sc;
+			return sc;
+		}
+	}
+
+	len = S_ResampledLength(info.samples, info.rate);
 	len = len * info.width * info.channels;
 
-	sc = s->cache = Z_Malloc(len + sizeof(sfxcache_t));
+	sc = Z_Malloc(len + sizeof(sfxcache_t));
 	if (!sc) {
 		FS_FreeFile(data);
 		return NULL;
@@ -153,10 +458,17 @@ S_LoadSound(sfx_t * s)
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	ResampleSfx(s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx(sc, sc->speed, sc->width, data + info.dataofs);
 
 	FS_FreeFile(data);
 
+	if (usecache)
+		S_WriteCachedSfx(namebuffer, checksum, sc);
+
+	/* the mixer thread may pick this up as soon as it is visible */
+	Sys_MemoryBarrier();
+	s->cache = sc;
+
 	return sc;
 }
 
@@ -22,6 +22,13 @@
 #include "client.h"
 #include "snd_loc.h"
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+#if idavx2
+#include <immintrin.h>
+#endif
+
 #define	PAINTBUFFER_SIZE 2048
 portable_samplepair_t paintbuffer[PAINTBUFFER_SIZE];
 int snd_scaletable[32][256];
@@ -30,30 +37,282 @@ short *snd_out;
 
 void S_WriteLinearBlastStereo16(void);
 
-#if !((defined __unix__) && defined __i386__) || defined C_ONLY
-#if !id386
-void S_WriteLinearBlastStereo16(void)
+/*
+ * ============================================================================
+ * MIXING KERNELS
+ *
+ * The paint kernels add (sample * vol) >> 8 into the paintbuffer, the clip
+ * kernel turns the paintbuffer back into 16 bit output.  The C versions are
+ * the reference, the SSE2 and AVX2 versions give the same results.
+ * ============================================================================
+ */
+
+static qboolean snd_avx2;
+
+static void S_PaintSamples16_C(portable_samplepair_t *samp, const short *sfx, int count, int leftvol, int rightvol)
+{
+	int i;
+	int data;
+
+	for (i = 0; i < count; i++, samp++) {
+		data = sfx[i];
+		samp->left += (data * leftvol) >> 8;
+		samp->right += (data * rightvol) >> 8;
+	}
+}
+
+static void S_PaintSamples8_C(portable_samplepair_t *samp, const signed char *sfx, int count, int lscale, int rscale)
+{
+	int i;
+	int data;
+
+	for (i = 0; i < count; i++, samp++) {
+		data = sfx[i];
+		samp->left += data * lscale;
+		samp->right += data * rscale;
+	}
+}
+
+static void S_ClipSamples16_C(short *out, const int *in, int count)
 {
 	int i;
 	int val;
 
-	for (i = 0; i < snd_linear_count; i += 2) {
-		val = snd_p[i] >> 8;
+	for (i = 0; i < count; i++) {
+		val = in[i] >> 8;
 		if (val > 0x7fff)
-			snd_out[i] = 0x7fff;
+			out[i] = 0x7fff;
 		else if (val < (short)0x8000)
-			snd_out[i] = (short)0x8000;
+			out[i] = (short)0x8000;
 		else
-			snd_out[i] = val;
+			out[i] = val;
+	}
+}
 
-		val = snd_p[i + 1] >> 8;
-		if (val > 0x7fff)
-			snd_out[i + 1] = 0x7fff;
-		else if (val < (short)0x8000)
-			snd_out[i + 1] = (short)0x8000;
-		else
-			snd_out[i + 1] = val;
+#if idsse2
+/*
+ * Mixes four samples, each duplicated into a left/right pair, with 16 bit
+ * multiplies only: (d * vol) >> 8 == d * (vol >> 8) + ((d * (vol & 255)) >> 8)
+ */
+static inline void S_MixPairs_SSE2(portable_samplepair_t *samp, __m128i dd, __m128i vh, __m128i vl)
+{
+	__m128i lo, hi, flo, fhi;
+	__m128i *p = (__m128i *)samp;
+
+	lo = _mm_mullo_epi16(dd, vh);
+	hi = _mm_mulhi_epi16(dd, vh);
+	flo = _mm_mullo_epi16(dd, vl);
+	fhi = _mm_mulhi_epi16(dd, vl);
+
+	_mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p),
+	    _mm_add_epi32(_mm_unpacklo_epi16(lo, hi),
+	    _mm_srai_epi32(_mm_unpacklo_epi16(flo, fhi), 8))));
+	_mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1),
+	    _mm_add_epi32(_mm_unpackhi_epi16(lo, hi),
+	    _mm_srai_epi32(_mm_unpackhi_epi16(flo, fhi), 8))));
+}
+
+static void S_PaintSamples16_SSE2(portable_samplepair_t *samp, const short *sfx, int count, int leftvol, int rightvol)
+{
+	int i;
+	__m128i vh, vl, d;
+
+	vh = _mm_setr_epi16(leftvol >> 8, rightvol >> 8, leftvol >> 8, rightvol >> 8,
+	    leftvol >> 8, rightvol >> 8, leftvol >> 8, rightvol >> 8);
+	vl = _mm_setr_epi16(leftvol & 255, rightvol & 255, leftvol & 255, rightvol & 255,
+	    leftvol & 255, rightvol & 255, leftvol & 255, rightvol & 255);
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		d = _mm_loadu_si128((const __m128i *)(sfx + i));
+		S_MixPairs_SSE2(samp + i, _mm_unpacklo_epi16(d, d), vh, vl);
+		S_MixPairs_SSE2(samp + i + 4, _mm_unpackhi_epi16(d, d), vh, vl);
+	}
+
+	S_PaintSamples16_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+/* 8 bit samples are widened to d << 8, so the 16 bit path yields d * scale */
+static void S_PaintSamples8_SSE2(portable_samplepair_t *samp, const signed char *sfx, int count, int lscale, int rscale)
+{
+	int i;
+	__m128i vh, vl, b, w, zero;
+
+	vh = _mm_setr_epi16(lscale >> 8, rscale >> 8, lscale >> 8, rscale >> 8,
+	    lscale >> 8, rscale >> 8, lscale >> 8, rscale >> 8);
+	vl = _mm_setr_epi16(lscale & 255, rscale & 255, lscale & 255, rscale & 255,
+	    lscale & 255, rscale & 255, lscale & 255, rscale & 255);
+	zero = _mm_setzero_si128();
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		b = _mm_loadu_si128((const __m128i *)(sfx + i));
+		w = _mm_unpacklo_epi8(zero, b);
+		S_MixPairs_SSE2(samp + i, _mm_unpacklo_epi16(w, w), vh, vl);
+		S_MixPairs_SSE2(samp + i + 4, _mm_unpackhi_epi16(w, w), vh, vl);
+		w = _mm_unpackhi_epi8(zero, b);
+		S_MixPairs_SSE2(samp + i + 8, _mm_unpacklo_epi16(w, w), vh, vl);
+		S_MixPairs_SSE2(samp + i + 12, _mm_unpackhi_epi16(w, w), vh, vl);
+	}
+
+	S_PaintSamples8_C(samp + i, sfx + i, count - i, lscale, rscale);
+}
+
+static void S_ClipSamples16_SSE2(short *out, const int *in, int count)
+{
+	int i;
+	__m128i a, b;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		a = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i)), 8);
+		b = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(in + i + 4)), 8);
+		_mm_storeu_si128((__m128i *)(out + i), _mm_packs_epi32(a, b));
+	}
+
+	S_ClipSamples16_C(out + i, in + i, count - i);
+}
+#endif
+
+#if idavx2
+static inline AVX2_FUNC void S_MixSamples_AVX2(portable_samplepair_t *samp, __m256i d, __m256i lvol, __m256i rvol, __m128i shift)
+{
+	__m256i l, r, lo, hi;
+	__m256i *p = (__m256i *)samp;
+
+	l = _mm256_sra_epi32(_mm256_mullo_epi32(d, lvol), shift);
+	r = _mm256_sra_epi32(_mm256_mullo_epi32(d, rvol), shift);
+	lo = _mm256_unpacklo_epi32(l, r);
+	hi = _mm256_unpackhi_epi32(l, r);
+
+	_mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p),
+	    _mm256_permute2x128_si256(lo, hi, 0x20)));
+	_mm256_storeu_si256(p + 1, _mm256_add_epi32(_mm256_loadu_si256(p + 1),
+	    _mm256_permute2x128_si256(lo, hi, 0x31)));
+}
+
+static AVX2_FUNC void S_PaintSamples16_AVX2(portable_samplepair_t *samp, const short *sfx, int count, int leftvol, int rightvol)
+{
+	int i;
+	__m256i lvol, rvol;
+
+	lvol = _mm256_set1_epi32(leftvol);
+	rvol = _mm256_set1_epi32(rightvol);
+
+	for (i = 0; i + 8 <= count; i += 8)
+		S_MixSamples_AVX2(samp + i, _mm256_cvtepi16_epi32(
+		    _mm_loadu_si128((const __m128i *)(sfx + i))), lvol, rvol,
+		    _mm_cvtsi32_si128(8));
+
+	S_PaintSamples16_C(samp + i, sfx + i, count - i, leftvol, rightvol);
+}
+
+static AVX2_FUNC void S_PaintSamples8_AVX2(portable_samplepair_t *samp, const signed char *sfx, int count, int lscale, int rscale)
+{
+	int i;
+	__m256i lvol, rvol;
+
+	lvol = _mm256_set1_epi32(lscale);
+	rvol = _mm256_set1_epi32(rscale);
+
+	for (i = 0; i + 8 <= count; i += 8)
+		S_MixSamples_AVX2(samp + i, _mm256_cvtepi8_epi32(
+		    _mm_loadl_epi64((const __m128i *)(sfx + i))), lvol, rvol,
+		    _mm_setzero_si128());
+
+	S_PaintSamples8_C(samp + i, sfx + i, count - i, lscale, rscale);
+}
+
+static AVX2_FUNC void S_ClipSamples16_AVX2(short *out, const int *in, int count)
+{
+	int i;
+	__m256i a, b;
+
+	for (i = 0; i + 16 <= count; i += 16) {
+		a = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)(in + i)), 8);
+		b = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)(in + i + 8)), 8);
+		/* packs works per 128 bit lane, put the quadwords back in order */
+		_mm256_storeu_si256((__m256i *)(out + i),
+		    _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b), 0xd8));
+	}
+
+	S_ClipSamples16_C(out + i, in + i, count - i);
+}
+#endif
+
+/* the SSE2 kernels split vol into two 16 bit halves */
+#define SND_SIMD_VOL(v)	((v) >= 0 && (v) < (1 << 23))
+
+static void S_PaintSamples16(portable_samplepair_t *samp, const short *sfx, int count, int leftvol, int rightvol)
+{
+#if idavx2
+	if (snd_avx2) {
+		S_PaintSamples16_AVX2(samp, sfx, count, leftvol, rightvol);
+		return;
 	}
+#endif
+#if idsse2
+	if (SND_SIMD_VOL(leftvol) && SND_SIMD_VOL(rightvol)) {
+		S_PaintSamples16_SSE2(samp, sfx, count, leftvol, rightvol);
+		return;
+	}
+#endif
+	S_PaintSamples16_C(samp, sfx, count, leftvol, rightvol);
+}
+
+static void S_PaintSamples8(portable_samplepair_t *samp, const signed char *sfx, int count, int lscale, int rscale)
+{
+#if idavx2
+	if (snd_avx2) {
+		S_PaintSamples8_AVX2(samp, sfx, count, lscale, rscale);
+		return;
+	}
+#endif
+#if idsse2
+	if (SND_SIMD_VOL(lscale) && SND_SIMD_VOL(rscale)) {
+		S_PaintSamples8_SSE2(samp, sfx, count, lscale, rscale);
+		return;
+	}
+#endif
+	S_PaintSamples8_C(samp, sfx, count, lscale, rscale);
+}
+
+static void S_ClipSamples16(short *out, const int *in, int count)
+{
+#if idavx2
+	if (snd_avx2) {
+		S_ClipSamples16_AVX2(out, in, count);
+		return;
+	}
+#endif
+#if idsse2
+	S_ClipSamples16_SSE2(out, in, count);
+#else
+	S_ClipSamples16_C(out, in, count);
+#endif
+}
+
+/* ================ S_InitMixer ================
+ * Picks the mixing kernels for this cpu
+ */
+void S_InitMixer(void)
+{
+#if idavx2
+	snd_avx2 = Sys_HaveAVX2() ? true : false;
+	if (snd_avx2) {
+		Com_Printf("Sound mixer: AVX2\n");
+		return;
+	}
+#endif
+#if idsse2
+	Com_Printf("Sound mixer: SSE2\n");
+#else
+	Com_Printf("Sound mixer: C\n");
+#endif
+}
+
+#if !((defined __unix__) && defined __i386__) || defined C_ONLY
+#if !id386
+void S_WriteLinearBlastStereo16(void)
+{
+	S_ClipSamples16(snd_out, snd_p, snd_linear_count);
 }
 #endif
 #endif
@@ -166,6 +425,7 @@ void S_PaintChannels(int endtime)
 	channel_t *ch;
 	sfxcache_t *sc;
 	int ltime, count;
+	int rawend;
 	playsound_t *ps;
 
 	snd_vol = s_volume->value * 256;
@@ -207,14 +467,16 @@ void S_PaintChannels(int endtime)
 		}
 
 		/* clear the paint buffer */
-		if (s_rawend < paintedtime) {
+		rawend = s_rawend;
+		Sys_MemoryBarrier();	/* see the samples written up to rawend */
+		if (rawend < paintedtime) {
 			memset(paintbuffer, 0, (end - paintedtime) * sizeof(portable_samplepair_t));
 		} else {
 			/* copy from the streaming sound source */
 			int s;
 			int stop;
 
-			stop = (end < s_rawend) ? end : s_rawend;
+			stop = (end < rawend) ? end : rawend;
 
 			for (i = paintedtime; i < stop; i++) {
 				s = i & (MAX_RAW_SAMPLES - 1);
@@ -245,9 +507,12 @@ void S_PaintChannels(int endtime)
 				if (ch->end - ltime < count)
 					count = ch->end - ltime;
 
-				sc = S_LoadSound(ch->sfx);
-				if (!sc)
+				/* only cached sounds reach the mixer, never load here */
+				sc = ch->sfx->cache;
+				if (!sc) {
+					ch->sfx = NULL;
 					break;
+				}
 
 				if (count > 0 && ch->sfx) {
 					if (sc->width == 1)	
@@ -299,12 +564,6 @@ void S_InitScaletable(void)
 #if	!id386
 void S_PaintChannelFrom8(channel_t * ch, sfxcache_t * sc, int count, int offset)
 {
-	int data;
-	int *lscale, *rscale;
-	byte *sfx;
-	int i;
-	portable_samplepair_t *samp;
-
 	if (ch->leftvol > 255)
 		ch->leftvol = 255;
 	if (ch->rightvol > 255)
@@ -312,17 +571,10 @@ void S_PaintChannelFrom8(channel_t * ch, sfxcache_t * sc, int count, int offset)
 
 	/* ZOID-- >>11 has been changed to >>3, >>11 didn't make much sense */
 	/* as it would always be zero. */
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = (byte *)sc->data + ch->pos;
-
-	samp = &paintbuffer[offset];
-
-	for (i = 0; i < count; i++, samp++) {
-		data = sfx[i];
-		samp->left += lscale[data];
-		samp->right += rscale[data];
-	}
+	/* row [1] of the scale table holds the plain scale factor */
+	S_PaintSamples8(&paintbuffer[offset], (signed char *)sc->data + ch->pos,
+	    count, snd_scaletable[ch->leftvol >> 3][1],
+	    snd_scaletable[ch->rightvol >> 3][1]);
 
 	ch->pos += count;
 }
@@ -331,25 +583,8 @@ void S_PaintChannelFrom8(channel_t * ch, sfxcache_t * sc, int count, int offset)
 
 void S_PaintChannelFrom16(channel_t * ch, sfxcache_t * sc, int count, int offset)
 {
-	int data;
-	int left, right;
-	int leftvol, rightvol;
-	signed short *sfx;
-	int i;
-	portable_samplepair_t *samp;
-
-	leftvol = ch->leftvol * snd_vol;
-	rightvol = ch->rightvol * snd_vol;
-	sfx = (signed short *)sc->data + ch->pos;
-
-	samp = &paintbuffer[offset];
-	for (i = 0; i < count; i++, samp++) {
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		samp->left += left;
-		samp->right += right;
-	}
+	S_PaintSamples16(&paintbuffer[offset], (signed short *)sc->data + ch->pos,
+	    count, ch->leftvol * snd_vol, ch->rightvol * snd_vol);
 
 	ch->pos += count;
 }
@@ -34,21 +34,77 @@
 extern int	sound_started;		/* Sound initialization flag. */
 extern cvar_t	*fs_basedir;		/* Path to "music". */
 
+/*
+ * Decoding runs on its own thread, ahead of the mixer, into ogg_ring.  The
+ * main thread only copies from the ring into s_rawsamples in OGG_Stream.
+ * ogg_lock guards the tracks, but isn't held while decoding: the decoder
+ * sets ogg_busy instead and whoever wants to touch an open track waits for
+ * it with OGG_LockIdle.  The ring itself is single producer, single consumer
+ * and needs no lock.  Tracks are decoded from memory through seekable
+ * callbacks, so their length is known.
+ */
+
+#define	OGG_RING_SAMPLES	65536	/* Stereo samples, power of two. */
+#define	OGG_CHUNK_SAMPLES	1024	/* Samples per ov_read() call. */
+#define	OGG_PREFETCH_TIME	10	/* Seconds left when the next track is loaded. */
+
+typedef enum {
+	TRACK_EMPTY,
+	TRACK_LOADED,		/* File in memory, not opened yet. */
+	TRACK_OPEN,
+	TRACK_FAILED,		/* ov_open() failed on the decoder thread. */
+	TRACK_DONE		/* Finished, buffer still to be freed. */
+} ogg_trackstate_t;
+
+typedef struct {
+	OggVorbis_File	 vf;		/* Ogg Vorbis file. */
+	byte		*buffer;	/* File buffer. */
+	int		 size;		/* File size. */
+	int		 file;		/* Index in ogg_filelist. */
+	int		 section;	/* Position in Ogg Vorbis file. */
+	long		 pos;		/* Read position in buffer. */
+	ogg_trackstate_t state;
+} ogg_track_t;
+
 qboolean	ogg_first_init = true;	/* First initialization flag. */
 qboolean	ogg_started = false;	/* Initialization flag. */
-byte		*ogg_buffer;		/* File buffer. */
 char		**ogg_filelist;		/* List of Ogg Vorbis files. */
-char		ovBuf[4096];		/* Buffer for sound. */
+char		ovBuf[OGG_CHUNK_SAMPLES * 4];	/* Buffer for sound. */
 int		ogg_curfile;		/* Index of currently played file. */
 int		ogg_numfiles;		/* Number of Ogg Vorbis files. */
-int		ovSection;		/* Position in Ogg Vorbis file. */
 ogg_status_t	ogg_status;		/* Status indicator. */
 cvar_t		*ogg_autoplay;		/* Play this song when started. */
 cvar_t		*ogg_check;		/* Check Ogg files or not. */
 cvar_t		*ogg_playlist;		/* Playlist. */
 cvar_t		*ogg_sequence;		/* Sequence play indicator. */
 cvar_t		*ogg_volume;		/* Music volume. */
-OggVorbis_File	ovFile;			/* Ogg Vorbis file. */
+cvar_t		*ogg_thread;		/* Decode on a separate thread. */
+
+ogg_track_t	ogg_tracks[2];		/* Current and prefetched track. */
+ogg_track_t	*ogg_cur = &ogg_tracks[0];
+ogg_track_t	*ogg_next = &ogg_tracks[1];
+qboolean	ogg_prefetched;		/* Next track already requested. */
+volatile qboolean ogg_eof;		/* Current track ended with nothing queued. */
+volatile qboolean ogg_switched;		/* Decoder moved on to ogg_next. */
+
+short		ogg_ring[OGG_RING_SAMPLES * 2];	/* Decoded PCM. */
+volatile unsigned ogg_ringwrite;	/* Advanced by the decoder only. */
+volatile unsigned ogg_ringread;		/* Advanced by OGG_Stream only. */
+
+qthread_t	*ogg_decoder;		/* Decoder thread, NULL if inline. */
+qmutex_t	*ogg_lock;		/* Guards ogg_tracks and ogg_status. */
+qcond_t		*ogg_idle;		/* Signalled when ogg_busy clears. */
+qboolean	ogg_busy;		/* Decoder is using a track unlocked. */
+volatile qboolean ogg_quit;		/* Tells the decoder to exit. */
+volatile int	ogg_msecleft;		/* Left to decode in the current track. */
+
+/* Decoder statistics for ogg_status. */
+int		ogg_stat_chunks;
+long long	ogg_stat_usec;
+int		ogg_stat_maxusec;
+long long	ogg_stat_samples;
+int		ogg_stat_underruns;
+int		ogg_stat_prefetches;
 
 /*
 ==========
@@ -79,6 +135,7 @@ void OGG_Init(void)
 	ogg_playlist = Cvar_Get("ogg_playlist", "playlist", CVAR_ARCHIVE);
 	ogg_sequence = Cvar_Get("ogg_sequence", "next", CVAR_ARCHIVE);
 	ogg_volume = Cvar_Get("ogg_volume", "0.7", CVAR_ARCHIVE);
+	ogg_thread = Cvar_Get("ogg_thread", "1", CVAR_ARCHIVE);
 
 	/* Console commands. */
 	Cmd_AddCommand("ogg_list", OGG_ListCmd);
@@ -108,7 +165,6 @@ void OGG_Init(void)
 	/* Initialize variables. */
 	if (ogg_first_init) {
 		srand(time(NULL));
-		ogg_buffer = NULL;
 		ogg_curfile = -1;
 		ogg_status = STOP;
 		ogg_first_init = false;
@@ -116,6 +172,15 @@ void OGG_Init(void)
 
 	ogg_started = true;
 
+	/* Start the decoder. */
+	ogg_lock = Sys_CreateMutex();
+	ogg_idle = Sys_CreateCond();
+	ogg_busy = false;
+	ogg_quit = false;
+	ogg_decoder = NULL;
+	if (ogg_thread->value)
+		ogg_decoder = Sys_CreateThread(OGG_DecodeThread, NULL);
+
 	Com_Printf("%d Ogg Vorbis files found.\n", ogg_numfiles);
 
 	/* Autoplay support. */
@@ -140,6 +205,19 @@ void OGG_Shutdown(void)
 
 	OGG_Stop();
 
+	/* Stop the decoder. */
+	if (ogg_decoder != NULL) {
+		ogg_quit = true;
+		Sys_WaitThread(ogg_decoder);
+		ogg_decoder = NULL;
+	}
+	if (ogg_lock != NULL) {
+		Sys_DestroyCond(ogg_idle);
+		Sys_DestroyMutex(ogg_lock);
+		ogg_idle = NULL;
+		ogg_lock = NULL;
+	}
+
 	/* Free the list of files. */
 	FS_FreeList(ogg_filelist, ogg_numfiles + 1);
 
@@ -170,6 +248,112 @@ void OGG_Reinit(void)
 	OGG_Init();
 }
 
+/*
+==========
+OGG_MemRead, OGG_MemSeek, OGG_MemTell
+
+Callbacks reading a track from its file buffer.
+==========
+*/
+static size_t OGG_MemRead(void *ptr, size_t size, size_t nmemb, void *datasource)
+{
+	ogg_track_t	*track = datasource;
+	size_t		 n;	/* Whole items left. */
+
+	if (size == 0)
+		return (0);
+	n = (track->size - track->pos) / size;
+	if (nmemb > n)
+		nmemb = n;
+	memcpy(ptr, track->buffer + track->pos, nmemb * size);
+	track->pos += nmemb * size;
+
+	return (nmemb);
+}
+
+static int OGG_MemSeek(void *datasource, ogg_int64_t offset, int whence)
+{
+	ogg_track_t	*track = datasource;
+	ogg_int64_t	 pos;	/* New position. */
+
+	switch (whence) {
+	case SEEK_SET:
+		pos = offset;
+		break;
+	case SEEK_CUR:
+		pos = track->pos + offset;
+		break;
+	case SEEK_END:
+		pos = track->size + offset;
+		break;
+	default:
+		return (-1);
+	}
+	if (pos < 0 || pos > track->size)
+		return (-1);
+	track->pos = pos;
+
+	return (0);
+}
+
+static long OGG_MemTell(void *datasource)
+{
+
+	return (((ogg_track_t *)datasource)->pos);
+}
+
+/*
+==========
+OGG_OpenTrack
+
+Open the track from its buffer.
+==========
+*/
+static int OGG_OpenTrack(ogg_track_t *track)
+{
+	ov_callbacks	cb;
+
+	cb.read_func = OGG_MemRead;
+	cb.seek_func = OGG_MemSeek;
+	cb.close_func = NULL;		/* The buffer is freed with the track. */
+	cb.tell_func = OGG_MemTell;
+
+	track->pos = 0;
+	track->section = 0;
+
+	return (ov_open_callbacks(track, &track->vf, NULL, 0, cb));
+}
+
+/*
+==========
+OGG_TimeLeft
+
+Update ogg_msecleft for the track being played.
+==========
+*/
+static void OGG_TimeLeft(ogg_track_t *track)
+{
+	double	left;	/* Seconds left. */
+
+	left = ov_time_total(&track->vf, -1) - ov_time_tell(&track->vf);
+	ogg_msecleft = left > 0 ? left * 1000 : 0;
+}
+
+/*
+==========
+OGG_LockIdle
+
+Take ogg_lock once the decoder is done with the tracks.
+==========
+*/
+static void OGG_LockIdle(void)
+{
+
+	Sys_LockMutex(ogg_lock);
+	while (ogg_busy)
+		Sys_CondWait(ogg_idle, ogg_lock);
+}
+
 /*
 ==========
 OGG_Check
@@ -210,21 +394,26 @@ void OGG_Seek(ogg_seek_t type, double offset)
 {
 	double pos;	/* Position in file (in seconds). */
 	double total;	/* Length of file (in seconds). */
+	OggVorbis_File	*vf;
+
+	OGG_LockIdle();
+	vf = &ogg_cur->vf;
 
 	/* Check if the file is seekable. */
-	if (ov_seekable(&ovFile) == 0) {
+	if (ogg_cur->state != TRACK_OPEN || ov_seekable(vf) == 0) {
+		Sys_UnlockMutex(ogg_lock);
 		Com_Printf("OGG_Seek: file is not seekable.\n");
 		return;
 	}
 
 	/* Get file information. */
-	pos = ov_time_tell(&ovFile);
-	total = ov_time_total(&ovFile, -1);
+	pos = ov_time_tell(vf);
+	total = ov_time_total(vf, -1);
 
 	switch (type) {
 	case ABS:
 		if (offset >= 0 && offset <= total) {
-			if (ov_time_seek(&ovFile, offset) != 0)
+			if (ov_time_seek(vf, offset) != 0)
 				Com_Printf("OGG_Seek: could not seek.\n");
 			else
 				Com_Printf("%0.2f -> %0.2f of %0.2f.\n", pos, offset, total);
@@ -233,7 +422,7 @@ void OGG_Seek(ogg_seek_t type, double offset)
 		break;
 	case REL:
 		if (pos + offset >= 0 && pos + offset <= total) {
-			if (ov_time_seek(&ovFile, pos + offset) != 0)
+			if (ov_time_seek(vf, pos + offset) != 0)
 				Com_Printf("OGG_Seek: could not seek.\n");
 			else
 				Com_Printf("%0.2f -> %0.2f of %0.2f.\n", pos, pos + offset, total);
@@ -241,6 +430,13 @@ void OGG_Seek(ogg_seek_t type, double offset)
 			Com_Printf("OGG_Seek: invalid offset.\n");
 		break;
 	}
+
+	/* Drop what was decoded before the seek. */
+	OGG_TimeLeft(ogg_cur);
+	ogg_ringread = ogg_ringwrite;
+	ogg_eof = false;
+
+	Sys_UnlockMutex(ogg_lock);
 }
 
 /*
@@ -339,9 +535,11 @@ Play Ogg Vorbis file (with absolute or relative index).
 */
 qboolean OGG_Open(ogg_seek_t type, int offset)
 {
+	byte		*buffer;	/* File buffer. */
 	int		 size;		/* File size. */
 	int		 pos;		/* Absolute position. */
 	int		 res;		/* Error indicator. */
+	ogg_track_t	*track;		/* Track to open. */
 
 	pos = -1;
 
@@ -367,30 +565,40 @@ qboolean OGG_Open(ogg_seek_t type, int offset)
 	}
 
 	/* Check running music. */
-	if (ogg_status == PLAY) {
-		if (ogg_curfile == pos)
-			return (true);
-		else
-			OGG_Stop();
-	}
+	if (ogg_status == PLAY && ogg_curfile == pos)
+		return (true);
+	OGG_Stop();
 
 	/* Find file. */
-	if ((size = FS_LoadFile(ogg_filelist[pos], (void **)&ogg_buffer)) == -1) {
+	if ((size = FS_LoadFile(ogg_filelist[pos], (void **)&buffer)) == -1) {
 		Com_Printf("OGG_Open: could not open %d (%s): %s.\n", pos, ogg_filelist[pos], strerror(errno));
 		return (false);
 	}
 
+	/* The decoder is idle while stopped, the track is ours. */
+	track = ogg_cur;
+
 	/* Open ogg vorbis file. */
-	if ((res = ov_open(NULL, &ovFile, (char *)ogg_buffer, size)) < 0) {
+	track->buffer = buffer;
+	track->size = size;
+	if ((res = OGG_OpenTrack(track)) < 0) {
 		Com_Printf("OGG_Open: '%s' is not a valid Ogg Vorbis file (error %i).\n", ogg_filelist[pos], res);
-		FS_FreeFile(ogg_buffer);
+		FS_FreeFile(buffer);
+		track->buffer = NULL;
 		return (false);
 	}
 
+	track->file = pos;
+	track->state = TRACK_OPEN;
+	OGG_TimeLeft(track);
+
 	/* Play file. */
-	ovSection = 0;
+	Sys_LockMutex(ogg_lock);
 	ogg_curfile = pos;
+	ogg_prefetched = false;
+	ogg_eof = false;
 	ogg_status = PLAY;
+	Sys_UnlockMutex(ogg_lock);
 
 	Com_Printf("Playing file %d '%s'\n", pos, ogg_filelist[pos]);
 
@@ -427,26 +635,191 @@ qboolean OGG_OpenName(char *filename)
 ==========
 OGG_Read
 
-Play a portion of the currently opened file.
+Decode a portion of the current file into the ring, from the decoder thread
+or from OGG_Stream when there is none.  ogg_lock is dropped while decoding.
 ==========
 */
 int OGG_Read(void)
 {
-	int res;	/* Number of bytes read. */
+	ogg_track_t	*track;		/* Track being decoded. */
+	long long	 start;		/* Decode start time. */
+	unsigned	 write;		/* Ring write position. */
+	int		 res;		/* Number of bytes read. */
+	int		 i, n;		/* Sample counters. */
+	int		 usec;		/* Decode time. */
+
+	Sys_LockMutex(ogg_lock);
+
+	/* Open a prefetched file, this parses the headers. */
+	if (ogg_next->state == TRACK_LOADED) {
+		track = ogg_next;
+		ogg_busy = true;
+		Sys_UnlockMutex(ogg_lock);
+
+		res = OGG_OpenTrack(track);
+
+		Sys_LockMutex(ogg_lock);
+		ogg_busy = false;
+		Sys_CondBroadcast(ogg_idle);
+		track->state = res < 0 ? TRACK_FAILED : TRACK_OPEN;
+	}
 
-	/* Read and resample. */
-	res = ov_read(&ovFile, ovBuf, sizeof(ovBuf), 0, 2, 1, &ovSection);
-	S_RawSamplesVol(res>>2, 44100, 2, 2, (byte*)ovBuf, ogg_volume->value);
+	if (ogg_status != PLAY || ogg_eof || ogg_cur->state != TRACK_OPEN ||
+	    OGG_RING_SAMPLES - (ogg_ringwrite - ogg_ringread) < OGG_CHUNK_SAMPLES) {
+		Sys_UnlockMutex(ogg_lock);
+		return (0);
+	}
+
+	track = ogg_cur;
+	ogg_busy = true;
+	Sys_UnlockMutex(ogg_lock);
+
+	/* Decode. */
+	start = Sys_Microseconds();
+	res = ov_read(&track->vf, ovBuf, sizeof(ovBuf), 0, 2, 1, &track->section);
+	usec = Sys_Microseconds() - start;
+
+	if (res > 0) {
+		n = res >> 2;
+		write = ogg_ringwrite;
+		for (i = 0; i < n; i++, write++) {
+			ogg_ring[(write & (OGG_RING_SAMPLES - 1)) * 2] = ((short *)ovBuf)[i * 2];
+			ogg_ring[(write & (OGG_RING_SAMPLES - 1)) * 2 + 1] = ((short *)ovBuf)[i * 2 + 1];
+		}
+
+		/* OGG_Stream may copy the samples as soon as the index moves. */
+		Sys_MemoryBarrier();
+		ogg_ringwrite = write;
+
+		OGG_TimeLeft(track);
+
+		ogg_stat_chunks++;
+		ogg_stat_usec += usec;
+		ogg_stat_samples += n;
+		if (usec > ogg_stat_maxusec)
+			ogg_stat_maxusec = usec;
+	}
+
+	Sys_LockMutex(ogg_lock);
+	ogg_busy = false;
+	Sys_CondBroadcast(ogg_idle);
 
 	/* Check for end of file. */
 	if (res == 0) {
-		OGG_Stop();
-		OGG_Sequence();
+		if (ogg_next->state == TRACK_OPEN) {
+			/* Continue with the next track without a gap. */
+			ov_clear(&track->vf);
+			track->state = TRACK_DONE;
+			ogg_cur = ogg_next;
+			ogg_next = track;
+			ogg_switched = true;
+			OGG_TimeLeft(ogg_cur);
+		} else
+			ogg_eof = true;
 	}
+	Sys_UnlockMutex(ogg_lock);
 
 	return (res);
 }
 
+/*
+==========
+OGG_DecodeThread
+
+Keep the ring full while playing.
+==========
+*/
+void OGG_DecodeThread(void *arg)
+{
+
+	while (!ogg_quit) {
+		/* Idle, paused or the ring is full. */
+		if (OGG_Read() <= 0)
+			Sys_Sleep(5);
+	}
+}
+
+/*
+==========
+OGG_SequenceIndex
+
+Index of the file to play after the current one, or -1.
+==========
+*/
+int OGG_SequenceIndex(void)
+{
+
+	if (strcmp(ogg_sequence->string, "next") == 0)
+		return ((ogg_curfile + 1) % ogg_numfiles);
+	else if (strcmp(ogg_sequence->string, "prev") == 0)
+		return ((ogg_curfile + ogg_numfiles - 1) % ogg_numfiles);
+	else if (strcmp(ogg_sequence->string, "random") == 0)
+		return (rand() % ogg_numfiles);
+	else if (strcmp(ogg_sequence->string, "loop") == 0)
+		return (ogg_curfile);
+
+	return (-1);
+}
+
+/*
+==========
+OGG_Prefetch
+
+Load the next file in sequence shortly before the current one ends, the
+decoder opens it and switches over at the end of the file.  Called every
+frame, ogg_lock is only ever held briefly by the decoder.
+==========
+*/
+void OGG_Prefetch(void)
+{
+	byte		*buffer;	/* File buffer. */
+	double		 left;		/* Time left in current file. */
+	int		 pos;		/* Next file. */
+	int		 size;		/* File size. */
+
+	/* Clean up after the decoder. */
+	Sys_LockMutex(ogg_lock);
+	if (ogg_switched) {
+		ogg_curfile = ogg_cur->file;
+		ogg_prefetched = false;
+		ogg_switched = false;
+		Com_Printf("Playing file %d '%s'\n", ogg_curfile, ogg_filelist[ogg_curfile]);
+	}
+	if (ogg_next->state == TRACK_DONE || ogg_next->state == TRACK_FAILED) {
+		if (ogg_next->state == TRACK_FAILED)
+			Com_Printf("OGG_Prefetch: '%s' is not a valid Ogg Vorbis file.\n",
+			    ogg_filelist[ogg_next->file]);
+		FS_FreeFile(ogg_next->buffer);
+		ogg_next->buffer = NULL;
+		ogg_next->state = TRACK_EMPTY;
+	}
+
+	if (ogg_prefetched || ogg_status != PLAY || ogg_cur->state != TRACK_OPEN) {
+		Sys_UnlockMutex(ogg_lock);
+		return;
+	}
+	left = ogg_msecleft / 1000.0;
+	Sys_UnlockMutex(ogg_lock);
+
+	if (left > OGG_PREFETCH_TIME)
+		return;
+
+	ogg_prefetched = true;
+	if ((pos = OGG_SequenceIndex()) < 0)
+		return;
+	if ((size = FS_LoadFile(ogg_filelist[pos], (void **)&buffer)) == -1)
+		return;
+
+	Sys_LockMutex(ogg_lock);
+	ogg_next->buffer = buffer;
+	ogg_next->size = size;
+	ogg_next->file = pos;
+	ogg_next->state = TRACK_LOADED;
+	Sys_UnlockMutex(ogg_lock);
+
+	ogg_stat_prefetches++;
+}
+
 /*
 ==========
 OGG_Sequence
@@ -480,17 +853,28 @@ Stop playing the current file.
 */
 void OGG_Stop(void)
 {
+	ogg_track_t	*track;	/* Track being released. */
+	int		 i;	/* Loop counter. */
 
-	if (ogg_status == STOP)
+	if (ogg_status == STOP || ogg_lock == NULL)
 		return;
 
-	ov_clear(&ovFile);
+	OGG_LockIdle();
 	ogg_status = STOP;
-
-	if (ogg_buffer != NULL) {
-		FS_FreeFile(ogg_buffer);
-		ogg_buffer = NULL;
+	for (i = 0, track = ogg_tracks; i < 2; i++, track++) {
+		if (track->state == TRACK_OPEN)
+			ov_clear(&track->vf);
+		if (track->buffer != NULL) {
+			FS_FreeFile(track->buffer);
+			track->buffer = NULL;
+		}
+		track->state = TRACK_EMPTY;
 	}
+	ogg_ringread = ogg_ringwrite;
+	ogg_prefetched = false;
+	ogg_switched = false;
+	ogg_eof = false;
+	Sys_UnlockMutex(ogg_lock);
 }
 
 /*
@@ -502,12 +886,49 @@ Stream music.
 */
 void OGG_Stream(void)
 {
+	unsigned	read;	/* Ring read position. */
+	unsigned	avail;	/* Decoded samples in the ring. */
 
 	if (!ogg_started)
 		return;
 
-	while (ogg_status == PLAY && paintedtime + MAX_RAW_SAMPLES - 2048 > s_rawend)
-		OGG_Read();
+	if (ogg_status == PLAY)
+		OGG_Prefetch();
+
+	while (ogg_status == PLAY && paintedtime + MAX_RAW_SAMPLES - 2048 > s_rawend) {
+		read = ogg_ringread;
+		avail = ogg_ringwrite - read;
+		Sys_MemoryBarrier();
+
+		if (avail == 0) {
+			if (ogg_eof) {
+				OGG_Stop();
+				OGG_Sequence();
+				continue;
+			}
+			if (ogg_decoder == NULL) {
+				OGG_Read();
+				if (ogg_ringwrite != read || ogg_eof)
+					continue;
+			}
+			/* The decoder fell behind and the mixer ran dry. */
+			if (s_rawend <= paintedtime)
+				ogg_stat_underruns++;
+			break;
+		}
+
+		if (avail > OGG_CHUNK_SAMPLES)
+			avail = OGG_CHUNK_SAMPLES;
+		if (avail > OGG_RING_SAMPLES - (read & (OGG_RING_SAMPLES - 1)))
+			avail = OGG_RING_SAMPLES - (read & (OGG_RING_SAMPLES - 1));
+
+		S_RawSamplesVol(avail, 44100, 2, 2,
+		    (byte *)&ogg_ring[(read & (OGG_RING_SAMPLES - 1)) * 2], ogg_volume->value);
+
+		/* Hand the space back to the decoder. */
+		Sys_MemoryBarrier();
+		ogg_ringread = read + avail;
+	}
 }
 
 /*
@@ -521,13 +942,15 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 {
 	int	i;
 	int	src, dst;
+	int	rawend;
 	float	scale;
 
 	if (!sound_started)
 		return;
 
-	if (s_rawend < paintedtime)
-		s_rawend = paintedtime;
+	rawend = s_rawend;
+	if (rawend < paintedtime)
+		rawend = paintedtime;
 
 	scale = (float)rate / dma.speed;
 
@@ -538,8 +961,8 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 		{	// optimized case
 			for (i=0 ; i<samples ; i++)
 			{
-				dst = s_rawend&(MAX_RAW_SAMPLES-1);
-				s_rawend++;
+				dst = rawend&(MAX_RAW_SAMPLES-1);
+				rawend++;
 				s_rawsamples[dst].left =
 				    (int)(volume * LittleShort(((short *)data)[i*2])) << 8;
 				s_rawsamples[dst].right =
@@ -553,8 +976,8 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 				src = i*scale;
 				if (src >= samples)
 					break;
-				dst = s_rawend&(MAX_RAW_SAMPLES-1);
-				s_rawend++;
+				dst = rawend&(MAX_RAW_SAMPLES-1);
+				rawend++;
 				s_rawsamples[dst].left =
 				    (int)(volume * LittleShort(((short *)data)[src*2])) << 8;
 				s_rawsamples[dst].right =
@@ -569,8 +992,8 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 			src = i*scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend&(MAX_RAW_SAMPLES-1);
-			s_rawend++;
+			dst = rawend&(MAX_RAW_SAMPLES-1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    (int)(volume * LittleShort(((short *)data)[src])) << 8;
 			s_rawsamples[dst].right =
@@ -584,8 +1007,8 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 			src = i*scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend&(MAX_RAW_SAMPLES-1);
-			s_rawend++;
+			dst = rawend&(MAX_RAW_SAMPLES-1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    (int)(volume * ((char *)data)[src*2]) << 16;
 			s_rawsamples[dst].right =
@@ -599,14 +1022,18 @@ void S_RawSamplesVol (int samples, int rate, int width, int channels, byte *data
 			src = i*scale;
 			if (src >= samples)
 				break;
-			dst = s_rawend&(MAX_RAW_SAMPLES-1);
-			s_rawend++;
+			dst = rawend&(MAX_RAW_SAMPLES-1);
+			rawend++;
 			s_rawsamples[dst].left =
 			    (int)(volume * (((byte *)data)[src]-128)) << 16;
 			s_rawsamples[dst].right = 
 				(int)(volume * (((byte *)data)[src]-128)) << 16;
 		}
 	}
+
+	/* the mixer may read the samples as soon as s_rawend moves */
+	Sys_MemoryBarrier();
+	s_rawend = rawend;
 }
 
 /* Console commands. */
@@ -751,15 +1178,20 @@ Display status.
 */
 void OGG_StatusCmd(void)
 {
+	double	pos;	/* Decoder position (in seconds). */
+
+	OGG_LockIdle();
+	pos = ogg_cur->state == TRACK_OPEN ? ov_time_tell(&ogg_cur->vf) : 0;
+	Sys_UnlockMutex(ogg_lock);
 
 	switch (ogg_status) {
 	case PLAY:
 		Com_Printf("Playing file %d (%s) at %0.2f seconds.\n",
-		    ogg_curfile+1, ogg_filelist[ogg_curfile], ov_time_tell(&ovFile));
+		    ogg_curfile+1, ogg_filelist[ogg_curfile], pos);
 		break;
 	case PAUSE:
 		Com_Printf("Paused file %d (%s) at %0.2f seconds.\n",
-		    ogg_curfile+1, ogg_filelist[ogg_curfile], ov_time_tell(&ovFile));
+		    ogg_curfile+1, ogg_filelist[ogg_curfile], pos);
 		break;
 	case STOP:
 		if (ogg_curfile == -1)
@@ -769,4 +1201,16 @@ void OGG_StatusCmd(void)
 			    ogg_curfile+1, ogg_filelist[ogg_curfile]);
 		break;
 	}
+
+	/* Decoder statistics. */
+	Com_Printf("Decoder: %s, %d of %d samples buffered, %d prefetched.\n",
+	    ogg_decoder != NULL ? "thread" : "inline",
+	    ogg_ringwrite - ogg_ringread, OGG_RING_SAMPLES, ogg_stat_prefetches);
+	if (ogg_stat_chunks > 0)
+		Com_Printf("Decode: %d chunks, %0.3f ms avg, %0.3f ms max, %0.1fx realtime, %d underruns.\n",
+		    ogg_stat_chunks,
+		    ogg_stat_usec / 1000.0 / ogg_stat_chunks,
+		    ogg_stat_maxusec / 1000.0,
+		    ogg_stat_usec > 0 ? (ogg_stat_samples / 44100.0) / (ogg_stat_usec / 1000000.0) : 0,
+		    ogg_stat_underruns);
 }
@@ -49,6 +49,9 @@ void		OGG_LoadPlaylist(char *name);
 qboolean	OGG_Open(ogg_seek_t type, int offset);
 qboolean	OGG_OpenName(char *filename);
 int		OGG_Read   (void);
+void		OGG_DecodeThread(void *arg);
+void		OGG_Prefetch(void);
+int		OGG_SequenceIndex(void);
 void		OGG_Sequence(void);
 void		OGG_Stop  (void);
 void		OGG_Stream(void);
@@ -993,6 +993,26 @@ Q_strcasecmp(char *s1, char *s2)
 }
 
 
+/*
+ * ============ Com_HashKey ============
+ * Hash for the name registries, "Foo\\bar" and "foo/bar" land in the same
+ * bucket so lookups can still be resolved with Q_stricmp
+ */
+unsigned
+Com_HashKey(const char *string, int hashsize)
+{
+	unsigned	hash = 0;
+	int		c;
+
+	while ((c = *string++) != 0) {
+		if (c == '\\')
+			c = '/';
+		hash = hash * 31 + tolower(c);
+	}
+
+	return (hash ^ (hash >> 10) ^ (hash >> 20)) & (hashsize - 1);
+}
+
 void
 Q_strncpyz(char *dest, const char *src, size_t size)
 {
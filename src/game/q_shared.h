@@ -39,6 +39,21 @@
 #define idaxp	0
 #endif
 
+/* SSE2 is always there on x86-64, AVX2 kernels are selected at runtime */
+#if defined __SSE2__ && !defined C_ONLY
+#define idsse2	1
+#else
+#define idsse2	0
+#endif
+
+#if idsse2 && defined __GNUC__ && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define idavx2	1
+#define AVX2_FUNC	__attribute__((target("avx2")))
+#define Sys_HaveAVX2()	__builtin_cpu_supports("avx2")
+#else
+#define idavx2	0
+#endif
+
 typedef unsigned char byte;
 
 typedef enum {
@@ -215,6 +230,9 @@ void		Com_sprintf(char *dest, int size, char *fmt,...);
 void		Com_PageInMemory(byte * buffer, int size);
 void		COM_MakePrintable(char *s);
 
+/* case and slash insensitive, hashsize must be a power of two */
+unsigned	Com_HashKey(const char *string, int hashsize);
+
 /* ============================================= */
 
 /* portable case insensitive compare */
@@ -266,6 +284,7 @@ qboolean	Info_Validate(char *s);
 extern int	curtime;	/* time returned by last Sys_Milliseconds */
 
 int		Sys_Milliseconds(void);
+long long	Sys_Microseconds(void);
 void		Sys_Mkdir (char *path);
 void		Sys_Rmdir (char *path);
 
@@ -290,6 +309,30 @@ char           *Sys_FindNext(unsigned musthave, unsigned canthave);
 void		Sys_FindClose(void);
 
 
+/* threads and synchronization */
+typedef struct qthread_s	qthread_t;
+typedef struct qmutex_s		qmutex_t;
+typedef struct qcond_s		qcond_t;
+
+qthread_t      *Sys_CreateThread(void (*func)(void *), void *arg);
+void		Sys_WaitThread(qthread_t *thread);
+qmutex_t       *Sys_CreateMutex(void);
+void		Sys_DestroyMutex(qmutex_t *mutex);
+void		Sys_LockMutex(qmutex_t *mutex);
+void		Sys_UnlockMutex(qmutex_t *mutex);
+qcond_t        *Sys_CreateCond(void);
+void		Sys_DestroyCond(qcond_t *cond);
+void		Sys_CondWait(qcond_t *cond, qmutex_t *mutex);
+void		Sys_CondSignal(qcond_t *cond);
+void		Sys_CondBroadcast(qcond_t *cond);
+void		Sys_Sleep(int msec);
+int		Sys_CPUCount(void);
+
+/* full memory barrier atomics (gcc builtins) */
+#define Sys_MemoryBarrier()		__sync_synchronize()
+#define Sys_AtomicAdd(ptr, val)		__sync_add_and_fetch((ptr), (val))
+#define Sys_AtomicCAS(ptr, old, new)	__sync_val_compare_and_swap((ptr), (old), (new))
+
 /* this is only here so the functions in q_shared.c and q_shwin.c can link */
 void		Sys_Error (char *error,...);
 void		Com_Printf(char *msg,...);
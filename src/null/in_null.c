@@ -21,9 +21,16 @@
 
 #include "../client/client.h"
 
+#ifdef Joystick
+cvar_t         *in_joystick;
+#endif
+
 void
 IN_Init(void)
 {
+#ifdef Joystick
+	in_joystick = Cvar_Get("in_joystick", "0", CVAR_ARCHIVE);
+#endif
 }
 
 void
@@ -0,0 +1,233 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+/* ref_null.c -- refresh that draws nothing, statically linked by vid_null.c */
+
+#include "../client/client.h"
+
+/*
+ * Registered names get distinct handles so the client can still tell models
+ * apart (cl_mod_powerscreen and friends are compared by pointer).
+ */
+#define	MAX_NULL_HANDLES	2048
+#define	NULL_HASH_SIZE		512
+
+typedef struct nullhandle_s {
+	char		name[MAX_QPATH];
+	struct nullhandle_s *hash_next;
+} nullhandle_t;
+
+static nullhandle_t null_handles[MAX_NULL_HANDLES];
+static nullhandle_t *null_hash[NULL_HASH_SIZE];
+static int	null_numhandles;
+
+static void   *
+R_NullHandle(char *name)
+{
+	nullhandle_t   *h;
+	unsigned	hash;
+
+	if (!name || !name[0])
+		return NULL;
+
+	hash = Com_HashKey(name, NULL_HASH_SIZE);
+	for (h = null_hash[hash]; h; h = h->hash_next)
+		if (!Q_stricmp(h->name, name))
+			return h;
+
+	if (null_numhandles == MAX_NULL_HANDLES)
+		return NULL;
+
+	h = &null_handles[null_numhandles++];
+	Q_strncpyz(h->name, name, sizeof(h->name));
+	h->hash_next = null_hash[hash];
+	null_hash[hash] = h;
+
+	return h;
+}
+
+static int
+R_NullInit(void *hinstance, void *wndproc)
+{
+	null_numhandles = 0;
+	memset(null_hash, 0, sizeof(null_hash));
+	return 0;
+}
+
+static void
+R_NullShutdown(void)
+{
+}
+
+static void
+R_NullBeginRegistration(char *map)
+{
+}
+
+static struct model_s *
+R_NullRegisterModel(char *name)
+{
+	return R_NullHandle(name);
+}
+
+static struct image_s *
+R_NullRegisterImage(char *name)
+{
+	return R_NullHandle(name);
+}
+
+static void
+R_NullSetSky(char *name, float rotate, vec3_t axis)
+{
+}
+
+static void
+R_NullEndRegistration(void)
+{
+}
+
+static void
+R_NullRenderFrame(refdef_t * fd)
+{
+}
+
+#ifdef QMAX
+static void
+R_NullSetParticlePicture(int num, char *name)
+{
+}
+#endif
+
+static void
+R_NullDrawChar(int x, int y, int num, int alpha)
+{
+}
+
+static void
+R_NullDrawStretchPic(int x, int y, int w, int h, char *name, float alpha)
+{
+}
+
+static void
+R_NullDrawScaledPic(int x, int y, float scale, float alpha, char *pic,
+    float red, float green, float blue, qboolean fixcoords, qboolean repscale)
+{
+}
+
+static void
+R_NullDrawGetPicSize(int *w, int *h, char *name)
+{
+	*w = *h = 0;
+}
+
+static void
+R_NullDrawPic(int x, int y, char *name, float alpha)
+{
+}
+
+static void
+R_NullDrawTileClear(int x, int y, int w, int h, char *name)
+{
+}
+
+static void
+R_NullDrawFill(int x, int y, int w, int h, int c)
+{
+}
+
+static void
+R_NullDrawFadeScreen(void)
+{
+}
+
+static void
+R_NullDrawStretchRaw(int x, int y, int w, int h, int cols, int rows, byte * data)
+{
+}
+
+static void
+R_NullCinematicSetPalette(const unsigned char *palette)
+{
+}
+
+static void
+R_NullBeginFrame(float camera_separation)
+{
+}
+
+static void
+R_NullEndFrame(void)
+{
+}
+
+static void
+R_NullAppActivate(qboolean activate)
+{
+}
+
+static void
+R_NullAddDecal(vec3_t origin, vec3_t dir, float red, float green, float blue,
+    float alpha, float size, int type, int flags, float angle)
+{
+}
+
+static void
+R_NullGetProfile(refprofile_t * profile)
+{
+	profile->numsections = 0;
+}
+
+/*
+ * Fills in the exports instead of returning them like a loadable refresh's
+ * GetRefAPI, there is no library boundary to keep.
+ */
+void
+R_NullGetRefAPI(refimport_t rimp, refexport_t * rexp)
+{
+	memset(rexp, 0, sizeof(*rexp));
+
+	rexp->api_version = API_VERSION;
+
+	rexp->Init = R_NullInit;
+	rexp->Shutdown = R_NullShutdown;
+	rexp->BeginRegistration = R_NullBeginRegistration;
+	rexp->RegisterModel = R_NullRegisterModel;
+	rexp->RegisterSkin = R_NullRegisterImage;
+	rexp->RegisterPic = R_NullRegisterImage;
+	rexp->SetSky = R_NullSetSky;
+	rexp->EndRegistration = R_NullEndRegistration;
+	rexp->RenderFrame = R_NullRenderFrame;
+#ifdef QMAX
+	rexp->SetParticlePicture = R_NullSetParticlePicture;
+#endif
+	rexp->DrawChar = R_NullDrawChar;
+	rexp->DrawStretchPic = R_NullDrawStretchPic;
+	rexp->DrawScaledPic = R_NullDrawScaledPic;
+	rexp->DrawGetPicSize = R_NullDrawGetPicSize;
+	rexp->DrawPic = R_NullDrawPic;
+	rexp->DrawTileClear = R_NullDrawTileClear;
+	rexp->DrawFill = R_NullDrawFill;
+	rexp->DrawFadeScreen = R_NullDrawFadeScreen;
+	rexp->DrawStretchRaw = R_NullDrawStretchRaw;
+	rexp->CinematicSetPalette = R_NullCinematicSetPalette;
+	rexp->BeginFrame = R_NullBeginFrame;
+	rexp->EndFrame = R_NullEndFrame;
+	rexp->AppActivate = R_NullAppActivate;
+	rexp->AddDecal = R_NullAddDecal;
+	rexp->GetProfile = R_NullGetProfile;
+
+}
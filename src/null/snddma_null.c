@@ -21,32 +21,81 @@
 /* snddma_null.c */
 /* all other sound mixing is portable */
 
+/*
+ * Output driver that mixes into memory and throws the result away.  The DMA
+ * position follows the wall clock, so the mixer does the same amount of work
+ * as with a real device.  Linked into the headless benchmark.
+ */
+
 #include "../client/client.h"
 #include "../client/snd_loc.h"
 
+#define	NULL_DMA_SAMPLES	32768	/* mono samples, power of two */
+
+static dma_t   *null_dma;
+static int	null_start;
+
 qboolean
-SNDDMA_Init(void)
+SNDDMA_NullInit(struct sndinfo * si)
 {
-	return false;
+	null_dma = si->dma;
+
+	switch ((int)si->s_khz->value) {
+	case 48:
+		null_dma->speed = 48000;
+		break;
+	case 44:
+		null_dma->speed = 44100;
+		break;
+	case 22:
+		null_dma->speed = 22050;
+		break;
+	default:
+		null_dma->speed = 11025;
+		break;
+	}
+	null_dma->samplebits = si->sndbits->value == 8 ? 8 : 16;
+	null_dma->channels = 2;
+	null_dma->samples = NULL_DMA_SAMPLES;
+	null_dma->samplepos = 0;
+	null_dma->submission_chunk = 1;
+	null_dma->buffer = malloc(NULL_DMA_SAMPLES * (null_dma->samplebits / 8));
+	if (null_dma->buffer == NULL)
+		return false;
+
+	null_start = Sys_Milliseconds();
+
+	si->Com_Printf("\nInitializing null sound output\n");
+
+	return true;
 }
 
 int
-SNDDMA_GetDMAPos(void)
+SNDDMA_NullGetDMAPos(void)
 {
-	return 0;
+	long long	pos;
+
+	pos = (long long)(Sys_Milliseconds() - null_start) * null_dma->speed / 1000;
+	null_dma->samplepos = (pos * null_dma->channels) & (null_dma->samples - 1);
+
+	return null_dma->samplepos;
 }
 
 void
-SNDDMA_Shutdown(void)
+SNDDMA_NullShutdown(void)
 {
+	if (null_dma != NULL && null_dma->buffer != NULL) {
+		free(null_dma->buffer);
+		null_dma->buffer = NULL;
+	}
 }
 
 void
-SNDDMA_BeginPainting(void)
+SNDDMA_NullBeginPainting(void)
 {
 }
 
 void
-SNDDMA_Submit(void)
+SNDDMA_NullSubmit(void)
 {
 }
@@ -26,7 +26,10 @@ viddef_t	viddef;		/* global video state */
 
 refexport_t	re;
 
-refexport_t	GetRefAPI(refimport_t rimp);
+void		R_NullGetRefAPI(refimport_t rimp, refexport_t * rexp);
+
+/* polled by Sys_SendKeyEvents, there is no keyboard */
+void            (*KBD_Update_fp) (void);
 
 /*
  * ==========================================================================
@@ -135,8 +138,13 @@ VID_Init(void)
 	ri.Cvar_Set = Cvar_Set;
 	ri.Cvar_SetValue = Cvar_SetValue;
 	ri.Vid_GetModeInfo = VID_GetModeInfo;
+	ri.Vid_MenuInit = VID_MenuInit;
+	ri.CL_IsVisible = CL_IsVisible;
+#ifdef QMAX
+	ri.SetParticlePics = SetParticleImages;
+#endif
 
-	re = GetRefAPI(ri);
+	R_NullGetRefAPI(ri, &re);
 
 	if (re.api_version != API_VERSION)
 		Com_Error(ERR_FATAL, "Re has incompatible api_version");
@@ -173,3 +181,9 @@ VID_MenuKey(int k)
 {
 	return NULL;
 }
+
+char           *
+Sys_GetClipboardData(void)
+{
+	return NULL;
+}
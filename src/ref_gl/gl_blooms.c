@@ -21,6 +21,10 @@
 
 #include "gl_local.h"
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+
 /*
  *
  * ============================================================================
@@ -511,8 +515,16 @@ R_BloomBlend(refdef_t * fd)
 /*
  * ================================== GLARES
  * ==================================
+ *
+ * The glare view is rendered small, read back and blurred on the CPU.  With
+ * gl_glares_async the readback goes through two pixel buffer objects that
+ * are mapped a frame later, the blur runs on a worker thread and its result
+ * is uploaded once done, so the glare trails the view by a frame or two
+ * instead of stalling the pipeline every frame.
  */
 
+#define	GLARE_MAX	256
+
 byte
 mulc(int i1, const float mult)
 {
@@ -528,9 +540,38 @@ mulc(int i1, const float mult)
 void
 ProcessGlare(byte glarepixels[][4], int width, int height, const float mult)
 {
-	int		i;
+	int		i = 0;
+
+#if idsse2
+	/* black stays black, so it needs no special case here */
+	if (mult >= 0) {
+		__m128		m = _mm_set1_ps(mult), top = _mm_set1_ps(255);
+		__m128i		zero = _mm_setzero_si128();
+		__m128i		amask = _mm_set1_epi32(0xff000000);
+		__m128i		px, lo, hi, c0, c1, c2, c3;
+
+#define	GLARE_SCALE(v)	_mm_cvttps_epi32(_mm_min_ps(_mm_mul_ps(_mm_cvtepi32_ps(v), m), top))
+
+		for (; i + 4 <= width * height; i += 4) {
+			px = _mm_loadu_si128((__m128i *) glarepixels[i]);
+			lo = _mm_unpacklo_epi8(px, zero);
+			hi = _mm_unpackhi_epi8(px, zero);
+			c0 = GLARE_SCALE(_mm_unpacklo_epi16(lo, zero));
+			c1 = GLARE_SCALE(_mm_unpackhi_epi16(lo, zero));
+			c2 = GLARE_SCALE(_mm_unpacklo_epi16(hi, zero));
+			c3 = GLARE_SCALE(_mm_unpackhi_epi16(hi, zero));
+			c0 = _mm_packus_epi16(_mm_packs_epi32(c0, c1), _mm_packs_epi32(c2, c3));
+
+			/* alpha is left alone */
+			c0 = _mm_or_si128(_mm_andnot_si128(amask, c0), _mm_and_si128(amask, px));
+			_mm_storeu_si128((__m128i *) glarepixels[i], c0);
+		}
+
+#undef GLARE_SCALE
+	}
+#endif
 
-	for (i = 0; i < width * height; i++) {
+	for (; i < width * height; i++) {
 
 		if ((glarepixels[i][0] != 0) ||
 		    (glarepixels[i][1] != 0) ||
@@ -556,91 +597,114 @@ typedef struct bytecolor_s {
 	byte		r , g, b, a;
 } bytecolor_t;
 
+/* GLARE_MAX * GLARE_MAX * 255 still fits */
 typedef struct longcolor_s {
-	unsigned long	r, g, b, a;
+	unsigned	r, g, b, a;
 } longcolor_t;
 
+/*
+ * Summed area table: every entry is the sum of all source pixels above and
+ * to the left of it, itself included.  Built a row at a time as the running
+ * sum of the row plus the entry above.  Alpha isn't summed.
+ */
 void
 DoPreComputation(bytecolor_t * src, int src_w, int src_h, longcolor_t * dst)
 {
-	longcolor_t	tot;
 	int		y         , x;
+#if idsse2
+	__m128i		zero = _mm_setzero_si128();
+	__m128i		rgbmask = _mm_set1_epi32(0x00ffffff);
+	__m128i		run, v;
 
 	for (y = 0; y < src_h; y++) {
-		for (x = 0; x < src_w; x++) {
-			tot.r = src[0].r;
-			tot.g = src[0].g;
-			tot.b = src[0].b;
-			tot.a = 255;
-
-			if (x > 0) {
-				tot.r += dst[-1].r;
-				tot.g += dst[-1].g;
-				tot.b += dst[-1].b;
-			}
+		run = zero;
+		for (x = 0; x < src_w; x++, src++, dst++) {
+			v = _mm_and_si128(_mm_cvtsi32_si128(*(int *)src), rgbmask);
+			v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(v, zero), zero);
+			run = _mm_add_epi32(run, v);
+			v = y ? _mm_add_epi32(run, _mm_loadu_si128((__m128i *) (dst - src_w))) : run;
+			_mm_storeu_si128((__m128i *) dst, v);
+		}
+	}
+#else
+	longcolor_t	run;
+
+	for (y = 0; y < src_h; y++) {
+		run.r = run.g = run.b = 0;
+		for (x = 0; x < src_w; x++, src++, dst++) {
+			run.r += src->r;
+			run.g += src->g;
+			run.b += src->b;
+
+			dst->r = run.r;
+			dst->g = run.g;
+			dst->b = run.b;
+			dst->a = 0;
 			if (y > 0) {
-				tot.r += dst[-src_w].r;
-				tot.g += dst[-src_w].g;
-				tot.b += dst[-src_w].b;
-			}
-			if (x > 0 && y > 0) {
-				tot.r -= dst[-src_w - 1].r;
-				tot.g -= dst[-src_w - 1].g;
-				tot.b -= dst[-src_w - 1].b;
+				dst->r += dst[-src_w].r;
+				dst->g += dst[-src_w].g;
+				dst->b += dst[-src_w].b;
 			}
-			dst->r = tot.r;
-			dst->g = tot.g;
-			dst->b = tot.b;
-			dst->a = 255;
-			dst++;
-			src++;
 		}
 	}
-}
-
-/* this is a utility function used by DoBoxBlur below */
-longcolor_t    *
-ReadP(longcolor_t * p, int w, int h, int x, int y)
-{
-	if (x < 0)
-		x = 0;
-	else if (x >= w)
-		x = w - 1;
-	if (y < 0)
-		y = 0;
-	else if (y >= h)
-		y = h - 1;
-	return &p[x + y * w];
+#endif
 }
 
 /* the main meat of the algorithm lies here */
 void
 DoBoxBlur(bytecolor_t * src, int src_w, int src_h, bytecolor_t * dst, longcolor_t * p, int boxw, int boxh)
 {
-	longcolor_t    *to1, *to2, *to3, *to4;
+	longcolor_t    *ra, *rb;
+	int		xa[GLARE_MAX], xb[GLARE_MAX];
 	int		y         , x;
 	float		mul;
+#if idsse2
+	__m128		vmul;
+	__m128i		sum, alpha = _mm_set1_epi32(0xff000000);
+#else
+	longcolor_t    *to1, *to2, *to3, *to4;
+#endif
 
 	if (boxw < 0 || boxh < 0) {
 		memcpy(dst, src, src_w * src_h * 4);	/* deal with degenerate kernel sizes */
 		return;
 	}
 	mul = 1.0 / ((boxw * 2 + 1) * (boxh * 2 + 1));
+
+	/* the box corners, clamped to the edges */
+	for (x = 0; x < src_w; x++) {
+		xa[x] = min(x + boxw, src_w - 1);
+		xb[x] = max(x - boxw, 0);
+	}
+
+#if idsse2
+	vmul = _mm_set1_ps(mul);
+#endif
 	for (y = 0; y < src_h; y++) {
-		for (x = 0; x < src_w; x++) {
-			to1 = ReadP(p, src_w, src_h, x + boxw, y + boxh);
-			to2 = ReadP(p, src_w, src_h, x - boxw, y - boxh);
-			to3 = ReadP(p, src_w, src_h, x - boxw, y + boxh);
-			to4 = ReadP(p, src_w, src_h, x + boxw, y - boxh);
+		ra = p + min(y + boxh, src_h - 1) * src_w;
+		rb = p + max(y - boxh, 0) * src_w;
+
+		for (x = 0; x < src_w; x++, dst++) {
+#if idsse2
+			sum = _mm_add_epi32(_mm_loadu_si128((__m128i *) & ra[xa[x]]),
+			    _mm_loadu_si128((__m128i *) & rb[xb[x]]));
+			sum = _mm_sub_epi32(sum, _mm_loadu_si128((__m128i *) & ra[xb[x]]));
+			sum = _mm_sub_epi32(sum, _mm_loadu_si128((__m128i *) & rb[xa[x]]));
+			sum = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(sum), vmul));
+			sum = _mm_packus_epi16(_mm_packs_epi32(sum, sum), sum);
+			*(int *)dst = _mm_cvtsi128_si32(_mm_or_si128(sum, alpha));
+#else
+			to1 = &ra[xa[x]];
+			to2 = &rb[xb[x]];
+			to3 = &ra[xb[x]];
+			to4 = &rb[xa[x]];
 
 			dst->r = (to1->r + to2->r - to3->r - to4->r) * mul;
 			dst->g = (to1->g + to2->g - to3->g - to4->g) * mul;
 			dst->b = (to1->b + to2->b - to3->b - to4->b) * mul;
 
 			dst->a = 255;
-
-			dst++;
-			src++;
+#endif
 		}
 	}
 }
@@ -661,9 +725,9 @@ R_RenderPic(int x, int y, int w, int h)
 	qglEnd();
 }
 
-byte	imagepixels[256 * 256][4];
-byte	glareblurpixels[256 * 256][4];
-long	glaresum  [256 * 256][4];
+byte	imagepixels[GLARE_MAX * GLARE_MAX][4];
+byte	glareblurpixels[GLARE_MAX * GLARE_MAX][4];
+longcolor_t glaresum[GLARE_MAX * GLARE_MAX];
 
 const int 
 powerof2s[] = {
@@ -696,6 +760,238 @@ CalcFov(float fov_x, float width, float height)
 	return a;
 }
 
+/*
+ * ================ R_BlurGlare
+ *
+ * imagepixels to glareblurpixels, safe to run off the main thread.
+ * ================
+ */
+static void
+R_BlurGlare(int size, float intens, qboolean twice)
+{
+	ProcessGlare(imagepixels, size, size, 1 + intens * .5);
+	DoPreComputation((bytecolor_t *) imagepixels, size, size, glaresum);
+	DoBoxBlur((bytecolor_t *) imagepixels, size, size,
+	    (bytecolor_t *) glareblurpixels, glaresum,
+	    intens * 3, intens * 3);
+
+	if (twice)
+		ProcessGlare(glareblurpixels, size, size, 1 + intens / 3);
+}
+
+/*
+ * ================ R_UploadGlare
+ *
+ * The texture is only (re)allocated when its size changes.
+ * ================
+ */
+static int	glare_texnum, glare_texsize;
+
+static void
+R_UploadGlare(int size)
+{
+	GL_Bind(r_lblendimage->texnum);
+
+	if (glare_texnum != r_lblendimage->texnum || glare_texsize != size) {
+		qglTexImage2D(GL_TEXTURE_2D, 0, 4, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, glareblurpixels);
+		glare_texnum = r_lblendimage->texnum;
+		glare_texsize = size;
+	} else {
+		qglTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, glareblurpixels);
+	}
+
+	r_lblendimage->upload_width = size;
+	r_lblendimage->upload_height = size;
+}
+
+/*
+ * ================ GLARE WORKER ================
+ *
+ * One job at a time: the main thread fills imagepixels and queues it while
+ * the worker is idle, the worker blurs it into glareblurpixels and the main
+ * thread uploads that once it is done.  Neither buffer is touched by the
+ * main thread while a job is queued or running.
+ */
+enum {
+	GLARE_IDLE,
+	GLARE_BUSY,
+	GLARE_DONE
+};
+
+static qthread_t *glare_thread;
+static qmutex_t *glare_lock;
+static qcond_t *glare_wake;
+static qboolean	glare_quit;
+static qboolean	glare_nothread;		/* creating it failed, don't retry */
+static int	glare_state;
+
+/* the queued job */
+static int	glare_jobsize;
+static float	glare_jobintens;
+static qboolean	glare_jobtwice;
+
+/* the readback pixel buffers, used in turn */
+static GLuint	glare_pbo[2];
+static int	glare_pbosize[2];	/* 0 while nothing was read into it */
+static int	glare_pbocur;
+
+static void
+R_GlareWorker(void *arg)
+{
+	Sys_LockMutex(glare_lock);
+	while (1) {
+		while (!glare_quit && glare_state != GLARE_BUSY)
+			Sys_CondWait(glare_wake, glare_lock);
+		if (glare_quit)
+			break;
+		Sys_UnlockMutex(glare_lock);
+
+		R_BlurGlare(glare_jobsize, glare_jobintens, glare_jobtwice);
+
+		Sys_LockMutex(glare_lock);
+		glare_state = GLARE_DONE;
+	}
+	Sys_UnlockMutex(glare_lock);
+}
+
+static qboolean
+R_StartGlareWorker(void)
+{
+	if (glare_thread)
+		return true;
+	if (glare_nothread)
+		return false;
+
+	glare_lock = Sys_CreateMutex();
+	glare_wake = Sys_CreateCond();
+	glare_quit = false;
+	glare_state = GLARE_IDLE;
+
+	glare_thread = Sys_CreateThread(R_GlareWorker, NULL);
+	if (!glare_thread) {
+		ri.Con_Printf(PRINT_DEVELOPER, "Couldn't start the glare worker, blurring inline\n");
+		Sys_DestroyCond(glare_wake);
+		Sys_DestroyMutex(glare_lock);
+		glare_wake = NULL;
+		glare_lock = NULL;
+		glare_nothread = true;
+		return false;
+	}
+	return true;
+}
+
+static void
+R_StopGlareWorker(void)
+{
+	if (!glare_thread)
+		return;
+
+	Sys_LockMutex(glare_lock);
+	glare_quit = true;
+	Sys_CondSignal(glare_wake);
+	Sys_UnlockMutex(glare_lock);
+
+	Sys_WaitThread(glare_thread);
+	glare_thread = NULL;
+
+	Sys_DestroyCond(glare_wake);
+	Sys_DestroyMutex(glare_lock);
+	glare_wake = NULL;
+	glare_lock = NULL;
+
+	glare_pbosize[0] = glare_pbosize[1] = 0;
+}
+
+/*
+ * ================ R_ShutdownGlares ================
+ */
+void
+R_ShutdownGlares(void)
+{
+	R_StopGlareWorker();
+
+	if (glare_pbo[0]) {
+		qglDeleteBuffersARB(2, glare_pbo);
+		glare_pbo[0] = glare_pbo[1] = 0;
+	}
+	glare_texnum = glare_texsize = 0;
+	glare_nothread = false;
+}
+
+/*
+ * ================ R_GlareAsync
+ *
+ * Uploads a finished blur, hands last frame's readback to the worker if it
+ * is free and starts reading this frame's view.  A readback the worker had
+ * no time for is simply overwritten by a newer one.
+ * ================
+ */
+static void
+R_GlareAsync(int size)
+{
+	void           *data;
+	int		prev, state;
+	qboolean	queue = false;
+
+	Sys_LockMutex(glare_lock);
+	state = glare_state;
+	if (state == GLARE_DONE)
+		glare_state = GLARE_IDLE;
+	Sys_UnlockMutex(glare_lock);
+
+	if (state == GLARE_DONE) {
+		R_UploadGlare(glare_jobsize);
+		state = GLARE_IDLE;
+	}
+
+	if (!gl_state.pbo) {
+		/* the read still waits for the GPU, but the blur doesn't */
+		if (state == GLARE_IDLE) {
+			qglReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, imagepixels);
+			glare_jobsize = size;
+			queue = true;
+		}
+	} else {
+		if (!glare_pbo[0]) {
+			qglGenBuffersARB(2, glare_pbo);
+			for (prev = 0; prev < 2; prev++) {
+				qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, glare_pbo[prev]);
+				qglBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, sizeof(imagepixels), NULL, GL_STREAM_READ_ARB);
+				glare_pbosize[prev] = 0;
+			}
+		}
+
+		prev = glare_pbocur ^ 1;
+		if (state == GLARE_IDLE && glare_pbosize[prev]) {
+			qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, glare_pbo[prev]);
+			data = qglMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+			if (data) {
+				memcpy(imagepixels, data, glare_pbosize[prev] * glare_pbosize[prev] * 4);
+				qglUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+				glare_jobsize = glare_pbosize[prev];
+				queue = true;
+			}
+			glare_pbosize[prev] = 0;
+		}
+
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, glare_pbo[glare_pbocur]);
+		qglReadPixels(0, 0, size, size, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+		glare_pbosize[glare_pbocur] = size;
+		glare_pbocur = prev;
+	}
+
+	if (!queue)
+		return;
+
+	Sys_LockMutex(glare_lock);
+	glare_jobintens = gl_glares_intens->value;
+	glare_jobtwice = gl_glares->value != 1;
+	glare_state = GLARE_BUSY;
+	Sys_CondSignal(glare_wake);
+	Sys_UnlockMutex(glare_lock);
+}
+
 void
 R_PreRenderDynamic(refdef_t * fd)
 {
@@ -705,6 +1001,9 @@ R_PreRenderDynamic(refdef_t * fd)
 	if (fd->rdflags & RDF_NOWORLDMODEL)
 		return;
 
+	if (!gl_glares_async->value || !gl_glares->value)
+		R_StopGlareWorker();
+
 	if (gl_glares->value) {
 		int	width = checkResolution(gl_glares_size->value);
 		int	height = checkResolution(gl_glares_size->value);
@@ -726,23 +1025,13 @@ R_PreRenderDynamic(refdef_t * fd)
 		R_Clear();
 		R_RenderView(&refdef);
 
-		GL_Bind(r_lblendimage->texnum);
-
-		qglReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, imagepixels);
-
-		ProcessGlare(imagepixels, width, height, 1 + gl_glares_intens->value * .5);
-		DoPreComputation((bytecolor_t *) imagepixels, width, height, (longcolor_t *) glaresum);
-		DoBoxBlur((bytecolor_t *) imagepixels, width, height,
-		    (bytecolor_t *) glareblurpixels, (longcolor_t *) glaresum, 
-		    gl_glares_intens->value * 3, gl_glares_intens->value * 3);
-		    
-		if (gl_glares->value != 1)
-			ProcessGlare(glareblurpixels, width, height, 1 + gl_glares_intens->value / 3);
-			
-		qglTexImage2D(GL_TEXTURE_2D, 0, 4, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, glareblurpixels);
-
-		r_lblendimage->upload_width = width;
-		r_lblendimage->upload_height = height;
+		if (gl_glares_async->value && R_StartGlareWorker()) {
+			R_GlareAsync(width);
+		} else {
+			qglReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, imagepixels);
+			R_BlurGlare(width, gl_glares_intens->value, gl_glares->value != 1);
+			R_UploadGlare(width);
+		}
 	}
 	R_Clear();
 }
@@ -30,8 +30,20 @@
 #define DECAL_BHOLE	1
 #define	DECAL_BLOOD	2
 
-typedef struct cdecal_t {
-	struct cdecal_t *prev, *next;
+#define	DECAL_TYPES	3
+
+/*
+ * Decals are linked into the leaf they were clipped in, so drawing only
+ * visits leafs that hold some and are in the PVS, and into one list that
+ * is also their expiry queue: every decal lives for gl_decals_time, so the
+ * oldest is always at the tail.  What is visible is drawn with one vertex
+ * array per texture.
+ */
+
+typedef struct cdecal_s {
+	struct cdecal_s *prev, *next;	/* active list, newest first */
+	struct cdecal_s *leafnext, **leafprev;
+	mleaf_t        *leaf;
 	float		time;
 
 	int		numverts;
@@ -59,6 +71,16 @@ typedef struct {
 static cdecal_t	decals[MAX_DECALS];
 static cdecal_t	active_decals, *free_decals;
 
+/* leafs with decals, or that had some since the last compaction */
+static mleaf_t *decal_leafs[MAX_DECALS];
+static int	decal_numleafs;
+static int	decal_generation = 1;
+
+/* visible decals by texture, and the stream they are drawn from */
+static cdecal_t *decal_visible[DECAL_TYPES][MAX_DECALS];
+static int	decal_numvisible[DECAL_TYPES];
+static unsigned	decal_indexes[MAX_DECALS * (MAX_DECAL_VERTS - 2) * 3];
+
 static int	R_GetClippedFragments(vec3_t origin, float radius, mat3_t axis, int maxfverts, vec3_t * fverts, int maxfragments, fragment_t * fragments);
 
 /*
@@ -82,6 +104,69 @@ GL_ClearDecals(void)
 	active_decals.next = &active_decals;
 	for (i = 0; i < MAX_DECALS - 1; i++)
 		decals[i].next = &decals[i + 1];
+
+	/* whatever the leafs still point at is stale now */
+	decal_numleafs = 0;
+	decal_generation++;
+}
+
+/*
+ * ================= R_CompactDecalLeafs
+ *
+ * Drops the leafs whose decals have all gone. =================
+ */
+static void
+R_CompactDecalLeafs(void)
+{
+	mleaf_t        *leaf;
+	int		i;
+
+	for (i = 0; i < decal_numleafs;) {
+		leaf = decal_leafs[i];
+		if (leaf->decals) {
+			i++;
+			continue;
+		}
+		leaf->decalgen = 0;
+		decal_leafs[i] = decal_leafs[--decal_numleafs];
+	}
+}
+
+/*
+ * ================= R_LinkDecal =================
+ */
+static void
+R_LinkDecal(cdecal_t * dl, mleaf_t * leaf)
+{
+	if (leaf->decalgen != decal_generation) {
+		if (decal_numleafs == MAX_DECALS)
+			R_CompactDecalLeafs();
+		leaf->decals = NULL;
+		leaf->decalgen = decal_generation;
+		decal_leafs[decal_numleafs++] = leaf;
+	}
+
+	dl->leaf = leaf;
+	dl->leafnext = leaf->decals;
+	dl->leafprev = &leaf->decals;
+	if (leaf->decals)
+		leaf->decals->leafprev = &dl->leafnext;
+	leaf->decals = dl;
+}
+
+/*
+ * ================= R_UnlinkDecal =================
+ */
+static void
+R_UnlinkDecal(cdecal_t * dl)
+{
+	if (!dl->leaf)
+		return;
+
+	*dl->leafprev = dl->leafnext;
+	if (dl->leafnext)
+		dl->leafnext->leafprev = dl->leafprev;
+	dl->leaf = NULL;
 }
 
 /*
@@ -101,6 +186,7 @@ GL_AllocDecal(void)
 		dl = active_decals.prev;
 		dl->prev->next = dl->next;
 		dl->next->prev = dl->prev;
+		R_UnlinkDecal(dl);
 	}
 
 	/* put the decal at the start of the list */
@@ -124,12 +210,42 @@ GL_FreeDecal(cdecal_t * dl)
 	/* remove from linked active list */
 	dl->prev->next = dl->next;
 	dl->next->prev = dl->prev;
+	R_UnlinkDecal(dl);
 
 	/* insert into linked free list */
 	dl->next = free_decals;
 	free_decals = dl;
 }
 
+/*
+ * ================= R_ExpireDecals
+ *
+ * The oldest decals are at the tail, stop at the first one still alive.
+ * =================
+ */
+static void
+R_ExpireDecals(void)
+{
+	cdecal_t       *dl;
+
+	while ((dl = active_decals.prev) != &active_decals) {
+		if (dl->time + gl_decals_time->value > r_refdef.time &&
+		    dl->time <= r_refdef.time)
+			break;
+		GL_FreeDecal(dl);
+	}
+}
+
+/*
+ * ================= R_DecalImage =================
+ */
+static image_t *
+R_DecalImage(int type)
+{
+	/* blood has no picture of its own yet */
+	return r_bholetexture;
+}
+
 
 /*
  * =============== makeDecal ===============
@@ -167,6 +283,9 @@ R_AddDecal(vec3_t origin, vec3_t dir, float red, float green, float blue, float
 	VectorScale(axis[1], 0.5 / size, axis[1]);
 	VectorScale(axis[2], 0.5 / size, axis[2]);
 
+	if (flags & DF_SHADE)
+		R_LightPoint(origin, shade);
+
 	for (i = 0, fr = fragments; i < numfragments; i++, fr++) {
 		if (fr->numverts > MAX_DECAL_VERTS)
 			fr->numverts = MAX_DECAL_VERTS;
@@ -180,6 +299,7 @@ R_AddDecal(vec3_t origin, vec3_t dir, float red, float green, float blue, float
 
 		d->numverts = fr->numverts;
 		d->node = fr->node;
+		R_LinkDecal(d, (mleaf_t *) fr->node);
 
 		VectorCopy(fr->surf->plane->normal, d->direction);
 		/* reverse direction */
@@ -190,12 +310,10 @@ R_AddDecal(vec3_t origin, vec3_t dir, float red, float green, float blue, float
 		VectorCopy(origin, d->org);
 
 		if (flags & DF_SHADE) {
-			R_LightPoint(origin, shade);
-
 			for (j = 0; j < 3; j++)
 				d->color[j] = (d->color[j] * shade[j] * 0.6) + (d->color[j] * 0.4);
 		}
-		d->type = type;
+		d->type = (unsigned)type < DECAL_TYPES ? type : 0;
 		d->flags = flags;
 
 		for (j = 0; j < fr->numverts; j++) {
@@ -210,6 +328,47 @@ R_AddDecal(vec3_t origin, vec3_t dir, float red, float green, float blue, float
 }
 
 
+/*
+ * =============== R_DrawDecalStream ===============
+ */
+static void
+R_DrawDecalStream(cdecal_t ** list, int count)
+{
+	cdecal_t       *dl;
+	float		time, alpha;
+	int		i, j, numverts, numindexes;
+
+	numverts = numindexes = 0;
+	for (i = 0; i < count; i++) {
+		dl = list[i];
+
+		if (numverts + dl->numverts > MAX_ARRAY) {
+			qglDrawElements(GL_TRIANGLES, numindexes, GL_UNSIGNED_INT, decal_indexes);
+			numverts = numindexes = 0;
+		}
+
+		alpha = dl->color[3];
+		time = dl->time + gl_decals_time->value - r_refdef.time;
+		if (time < 1.5)
+			alpha *= time / 1.5;
+
+		/* fans become triangles so everything goes in one call */
+		for (j = 2; j < dl->numverts; j++) {
+			decal_indexes[numindexes++] = numverts;
+			decal_indexes[numindexes++] = numverts + j - 1;
+			decal_indexes[numindexes++] = numverts + j;
+		}
+		for (j = 0; j < dl->numverts; j++, numverts++) {
+			VA_SetElem2(tex_array[numverts], dl->stcoords[j][0], dl->stcoords[j][1]);
+			VA_SetElem3(vert_array[numverts], dl->verts[j][0], dl->verts[j][1], dl->verts[j][2]);
+			VA_SetElem4(col_array[numverts], dl->color[0], dl->color[1], dl->color[2], alpha);
+		}
+	}
+
+	if (numindexes)
+		qglDrawElements(GL_TRIANGLES, numindexes, GL_UNSIGNED_INT, decal_indexes);
+}
+
 /*
  * =============== CL_AddDecals ===============
  */
@@ -218,68 +377,72 @@ extern int	r_visframecount;
 void
 R_AddDecals(void)
 {
-	cdecal_t       *dl, *next, *active;
-	float		mindist, time;
-	int		i, r_numdecals = 0;
+	cdecal_t       *dl;
+	mleaf_t        *leaf;
+	float		mindist;
+	int		i, type, numvisible;
 	vec3_t		v;
-	vec4_t		color;
 
 	if (!gl_decals->value)
 		return;
 
-	active = &active_decals;
+	R_ExpireDecals();
+	R_CompactDecalLeafs();
 
 	mindist = DotProduct(r_origin, vpn) + 4.0;
 
-	qglEnable(GL_POLYGON_OFFSET_FILL);
-	qglPolygonOffset(-1, -2);
-
-	qglDepthMask(GL_FALSE);
-	qglEnable(GL_BLEND);
-	GL_TexEnv(GL_MODULATE);
-	GL_Bind(r_bholetexture->texnum);
-
-	for (dl = active->next; dl != active; dl = next) {
-		next = dl->next;
-
-		if (dl->time + gl_decals_time->value <= r_refdef.time) {
-			GL_FreeDecal(dl);
+	numvisible = 0;
+	memset(decal_numvisible, 0, sizeof(decal_numvisible));
+	for (i = 0; i < decal_numleafs; i++) {
+		leaf = decal_leafs[i];
+		if (leaf->visframe != r_visframecount)
 			continue;
-		}
-		if (dl->node == NULL || dl->node->visframe != r_visframecount)
+		if (R_CullBox(leaf->minmaxs, leaf->minmaxs + 3))
 			continue;
 
-		/* do not render if the decal is behind the view */
-		if (DotProduct(dl->org, vpn) < mindist)
-			continue;
+		for (dl = leaf->decals; dl; dl = dl->leafnext) {
+			/* do not render if the decal is behind the view */
+			if (DotProduct(dl->org, vpn) < mindist)
+				continue;
 
-		/* do not render if the view origin is behind the decal */
-		VectorSubtract(dl->org, r_origin, v);
-		if (DotProduct(dl->direction, v) < 0)
-			continue;
+			/* do not render if the view origin is behind the decal */
+			VectorSubtract(dl->org, r_origin, v);
+			if (DotProduct(dl->direction, v) < 0)
+				continue;
 
-		Vector4Copy(dl->color, color);
+			decal_visible[dl->type][decal_numvisible[dl->type]++] = dl;
+			numvisible++;
+		}
+	}
+	if (!numvisible)
+		return;
 
-		time = dl->time + gl_decals_time->value - r_refdef.time;
+	qglEnable(GL_POLYGON_OFFSET_FILL);
+	qglPolygonOffset(-1, -2);
 
-		if (time < 1.5)
-			color[3] *= time / 1.5;
+	qglDepthMask(GL_FALSE);
+	qglEnable(GL_BLEND);
+	GL_TexEnv(GL_MODULATE);
 
-		/* Draw it */
-		qglColor4fv(color);
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglEnableClientState(GL_COLOR_ARRAY);
 
-		qglBegin(GL_TRIANGLE_FAN);
-		for (i = 0; i < dl->numverts; i++) {
-			qglTexCoord2fv(dl->stcoords[i]);
-			qglVertex3fv(dl->verts[i]);
-		}
-		qglEnd();
+	qglTexCoordPointer(2, GL_FLOAT, sizeof(tex_array[0]), tex_array[0]);
+	qglVertexPointer(3, GL_FLOAT, sizeof(vert_array[0]), vert_array[0]);
+	qglColorPointer(4, GL_FLOAT, sizeof(col_array[0]), col_array[0]);
 
-		r_numdecals++;
-		if (r_numdecals >= MAX_DECALS)
-			break;
+	for (type = 0; type < DECAL_TYPES; type++) {
+		if (!decal_numvisible[type])
+			continue;
+		GL_Bind(R_DecalImage(type)->texnum);
+		R_DrawDecalStream(decal_visible[type], decal_numvisible[type]);
 	}
 
+	qglDisableClientState(GL_VERTEX_ARRAY);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglDisableClientState(GL_COLOR_ARRAY);
+
 	GL_TexEnv(GL_REPLACE);
 	qglDisable(GL_BLEND);
 	qglColor4f(1, 1, 1, 1);
@@ -31,6 +31,129 @@ float		col_array[MAX_ARRAY][4];
 extern qboolean	scrap_dirty;
 void		Scrap_Upload(void);
 
+/*
+ * 2D batching.  Console text, HUD pics, layouts and menus are queued as quads
+ * and only drawn when the texture or blend state changes, the batch is full,
+ * or someone else is about to touch the GL state (R_SetGL2D, R_RenderFrame,
+ * R_EndFrame and the direct draws below).  Colour is per vertex so tinted
+ * and faded pics don't break a batch; with most small pics in the scrap a
+ * full console or scoreboard ends up as a handful of draw calls.
+ */
+#define	DRAW2D_BLEND		1
+#define	DRAW2D_ALPHATEST	2
+
+#define	MAX_DRAW2D_QUADS	2048
+
+static float	draw2d_tex[MAX_DRAW2D_QUADS * 4][2];
+static float	draw2d_vert[MAX_DRAW2D_QUADS * 4][2];
+static float	draw2d_col[MAX_DRAW2D_QUADS * 4][4];
+static int	draw2d_numverts;
+static int	draw2d_texnum;		/* 0 = untextured */
+static int	draw2d_state;
+
+/*
+ * ================ Draw_Flush2D ================
+ */
+void
+Draw_Flush2D(void)
+{
+	if (!draw2d_numverts)
+		return;
+
+	R_ProfileBegin(PROF_2D);
+	if (draw2d_texnum) {
+		GL_Bind(draw2d_texnum);
+		GL_TexEnv(GL_MODULATE);
+	} else
+		qglDisable(GL_TEXTURE_2D);
+	if (!(draw2d_state & DRAW2D_ALPHATEST))
+		qglDisable(GL_ALPHA_TEST);
+	if (draw2d_state & DRAW2D_BLEND) {
+		qglEnable(GL_BLEND);
+		qglDepthMask(false);
+	}
+
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglEnableClientState(GL_COLOR_ARRAY);
+	qglVertexPointer(2, GL_FLOAT, sizeof(draw2d_vert[0]), draw2d_vert[0]);
+	qglColorPointer(4, GL_FLOAT, sizeof(draw2d_col[0]), draw2d_col[0]);
+	if (draw2d_texnum) {
+		qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		qglTexCoordPointer(2, GL_FLOAT, sizeof(draw2d_tex[0]), draw2d_tex[0]);
+	}
+
+	qglDrawArrays(GL_QUADS, 0, draw2d_numverts);
+
+	if (draw2d_texnum)
+		qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglDisableClientState(GL_COLOR_ARRAY);
+	qglDisableClientState(GL_VERTEX_ARRAY);
+
+	/* back to the R_SetGL2D defaults */
+	if (draw2d_state & DRAW2D_BLEND) {
+		qglDepthMask(true);
+		qglDisable(GL_BLEND);
+	}
+	if (!(draw2d_state & DRAW2D_ALPHATEST))
+		qglEnable(GL_ALPHA_TEST);
+	if (draw2d_texnum)
+		GL_TexEnv(GL_REPLACE);
+	else
+		qglEnable(GL_TEXTURE_2D);
+	qglColor4f(1, 1, 1, 1);
+
+	draw2d_numverts = 0;
+	R_ProfileEnd(PROF_2D);
+}
+
+/*
+ * ================ Draw_AddQuad ================
+ * Queues an axis aligned quad, flushing first if it can't join the batch
+ */
+static void
+Draw_AddQuad(int texnum, int state, float x1, float y1, float x2, float y2,
+    float s1, float t1, float s2, float t2, float r, float g, float b, float a)
+{
+	int		i;
+
+	if (draw2d_numverts && (texnum != draw2d_texnum || state != draw2d_state))
+		Draw_Flush2D();
+	else if (draw2d_numverts + 4 > MAX_DRAW2D_QUADS * 4)
+		Draw_Flush2D();
+
+	draw2d_texnum = texnum;
+	draw2d_state = state;
+
+	i = draw2d_numverts;
+	VA_SetElem2(draw2d_vert[i], x1, y1);
+	VA_SetElem2(draw2d_tex[i], s1, t1);
+	VA_SetElem2(draw2d_vert[i + 1], x2, y1);
+	VA_SetElem2(draw2d_tex[i + 1], s2, t1);
+	VA_SetElem2(draw2d_vert[i + 2], x2, y2);
+	VA_SetElem2(draw2d_tex[i + 2], s2, t2);
+	VA_SetElem2(draw2d_vert[i + 3], x1, y2);
+	VA_SetElem2(draw2d_tex[i + 3], s1, t2);
+	for (; i < draw2d_numverts + 4; i++)
+		VA_SetElem4(draw2d_col[i], r, g, b, a);
+
+	draw2d_numverts += 4;
+}
+
+/*
+ * ================ Draw_PicState ================
+ * Blend state for a pic, including the MCD/Rendition alpha test workaround
+ */
+static int
+Draw_PicState(image_t * gl, qboolean blend)
+{
+	if (blend)
+		return DRAW2D_BLEND;
+	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION))
+	    && !gl->has_alpha)
+		return 0;
+	return DRAW2D_ALPHATEST;
+}
+
 /*
  * =============== RefreshFont ===============
  */
@@ -108,38 +231,8 @@ Draw_Char(int x, int y, int num, int alpha)
 	fcol = col * 0.0625;
 	size = 0.0625;
 
-	{
-		/* GLSTATE_DISABLE_ALPHATEST */
-		qglDisable(GL_ALPHA_TEST);
-		GL_TexEnv(GL_MODULATE);
-		qglColor4ub(255, 255, 255, alpha);
-		/* GLSTATE_ENABLE_BLEND */
-		qglEnable(GL_BLEND);
-		qglDepthMask(false);
-	}
-
-	GL_Bind(draw_chars->texnum);
-
-	qglBegin(GL_QUADS);
-	qglTexCoord2f(fcol, frow);
-	qglVertex2f(x, y);
-	qglTexCoord2f(fcol + size, frow);
-	qglVertex2f(x + 8, y);
-	qglTexCoord2f(fcol + size, frow + size);
-	qglVertex2f(x + 8, y + 8);
-	qglTexCoord2f(fcol, frow + size);
-	qglVertex2f(x, y + 8);
-	qglEnd();
-
-	{
-		qglDepthMask(true);
-		GL_TexEnv(GL_REPLACE);
-		/* GLSTATE_DISABLE_BLEND */
-		qglDisable(GL_BLEND);
-		qglColor4f(1,1,1,1);
-		/* GLSTATE_ENABLE_ALPHATEST */
-		qglEnable(GL_ALPHA_TEST);
-	}
+	Draw_AddQuad(draw_chars->texnum, DRAW2D_BLEND, x, y, x + 8, y + 8,
+	    fcol, frow, fcol + size, frow + size, 1, 1, 1, alpha * DIV255);
 }
 
 /*
@@ -160,6 +253,25 @@ Draw_FindPic(char *name)
 	return gl;
 }
 
+/*
+ * ============= Draw_FindWholePic =============
+ *
+ * Like Draw_FindPic, but keeps the pic out of the scrap so it can be bound
+ * as a whole, repeating texture.  A pic already loaded into the scrap by a
+ * plain Draw_FindPic stays there.
+ */
+image_t        *
+Draw_FindWholePic(char *name)
+{
+	image_t        *gl;
+
+	scrap_skip = true;
+	gl = Draw_FindPic(name);
+	scrap_skip = false;
+
+	return gl;
+}
+
 /*
  * ============= Draw_GetPicSize =============
  */
@@ -185,6 +297,7 @@ void
 Draw_StretchPic(int x, int y, int w, int h, char *pic, float alpha)
 {
 	image_t        *gl;
+	qboolean	blend;
 
 	gl = Draw_FindPic(pic);
 	if (!gl) {
@@ -194,46 +307,11 @@ Draw_StretchPic(int x, int y, int w, int h, char *pic, float alpha)
 	if (scrap_dirty)
 		Scrap_Upload();
 
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION))
-	    && !gl->has_alpha)
-		qglDisable(GL_ALPHA_TEST);
-
 	/* add alpha support */
-	if (gl->has_alpha || alpha < 1) {
-		qglDisable(GL_ALPHA_TEST);
+	blend = gl->has_alpha || alpha < 1;
 
-		GL_Bind(gl->texnum);
-
-		GL_TexEnv(GL_MODULATE);
-		qglColor4f(1, 1, 1, alpha);
-		qglEnable(GL_BLEND);
-		qglDepthMask(false);
-	} else
-		GL_Bind(gl->texnum);
-
-	qglBegin(GL_QUADS);
-	qglTexCoord2f(gl->sl, gl->tl);
-	qglVertex2f(x, y);
-	qglTexCoord2f(gl->sh, gl->tl);
-	qglVertex2f(x + w, y);
-	qglTexCoord2f(gl->sh, gl->th);
-	qglVertex2f(x + w, y + h);
-	qglTexCoord2f(gl->sl, gl->th);
-	qglVertex2f(x, y + h);
-	qglEnd();
-
-	/* add alpha support */
-	if (gl->has_alpha || alpha < 1) {
-		qglDepthMask(true);
-		GL_TexEnv(GL_REPLACE);
-		qglDisable(GL_BLEND);
-		qglColor4f(1, 1, 1, 1);
-
-		qglEnable(GL_ALPHA_TEST);
-	}
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION))
-	    && !gl->has_alpha)
-		qglEnable(GL_ALPHA_TEST);
+	Draw_AddQuad(gl->texnum, Draw_PicState(gl, blend), x, y, x + w, y + h,
+	    gl->sl, gl->tl, gl->sh, gl->th, 1, 1, 1, blend ? alpha : 1);
 }
 
 /*
@@ -252,45 +330,9 @@ Draw_Pic(int x, int y, char *pic, float alpha)
 	if (scrap_dirty)
 		Scrap_Upload();
 
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !gl->has_alpha)
-		qglDisable(GL_ALPHA_TEST);
-
-	/* add alpha support */
-	{
-		qglDisable(GL_ALPHA_TEST);
-
-		qglBindTexture(GL_TEXTURE_2D, gl->texnum);
-
-		GL_TexEnv(GL_MODULATE);
-		qglColor4f(1, 1, 1, 0.999);	/* need <1 for trans to work */
-		qglEnable(GL_BLEND);
-		qglDepthMask(false);
-	}
-
-	GL_Bind(gl->texnum);
-	qglBegin(GL_QUADS);
-	qglTexCoord2f(gl->sl, gl->tl);
-	qglVertex2f(x, y);
-	qglTexCoord2f(gl->sh, gl->tl);
-	qglVertex2f(x + gl->width, y);
-	qglTexCoord2f(gl->sh, gl->th);
-	qglVertex2f(x + gl->width, y + gl->height);
-	qglTexCoord2f(gl->sl, gl->th);
-	qglVertex2f(x, y + gl->height);
-	qglEnd();
-
-	/* add alpha support */
-	{
-		qglDepthMask(true);
-		GL_TexEnv(GL_REPLACE);
-		qglDisable(GL_BLEND);
-		qglColor4f(1, 1, 1, 1);
-
-		qglEnable(GL_ALPHA_TEST);
-	}
-
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !gl->has_alpha)
-		qglEnable(GL_ALPHA_TEST);
+	/* need <1 for trans to work */
+	Draw_AddQuad(gl->texnum, DRAW2D_BLEND, x, y, x + gl->width, y + gl->height,
+	    gl->sl, gl->tl, gl->sh, gl->th, 1, 1, 1, 0.999);
 }
 
 /*
@@ -311,71 +353,25 @@ Draw_ScaledPic(int x, int y, float scale, float alpha, char *pic, float red, flo
 	if (scrap_dirty)
 		Scrap_Upload();
 
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !gl->has_alpha)
-		qglDisable(GL_ALPHA_TEST);
-
-	/* add alpha support */
-	{
-		qglDisable(GL_ALPHA_TEST);
-
-		qglBindTexture(GL_TEXTURE_2D, gl->texnum);
-
-		GL_TexEnv(GL_MODULATE);
-		qglColor4f(red, green, blue, alpha);
-		qglEnable(GL_BLEND);
-		qglDepthMask(false);
-	}
-
 	/* NOTE: replace this with shaders as soon as they are supported */
 	if (repscale)
 		scale *= gl->replace_scale;	/* scale down if replacing a pcx image */
 
 	if (fixcoords) {	/* Knightmare- whether to adjust coordinates for scaling */
-
 		xoff = (gl->width * scale - gl->width) / 2;
 		yoff = (gl->height * scale - gl->height) / 2;
 
-		GL_Bind(gl->texnum);
-		qglBegin(GL_QUADS);
-		qglTexCoord2f(gl->sl, gl->tl);
-		qglVertex2f(x - xoff, y - yoff);
-		qglTexCoord2f(gl->sh, gl->tl);
-		qglVertex2f(x + gl->width + xoff, y - yoff);
-		qglTexCoord2f(gl->sh, gl->th);
-		qglVertex2f(x + gl->width + xoff, y + gl->height + yoff);
-		qglTexCoord2f(gl->sl, gl->th);
-		qglVertex2f(x - xoff, y + gl->height + yoff);
-		qglEnd();
-
+		Draw_AddQuad(gl->texnum, DRAW2D_BLEND, x - xoff, y - yoff,
+		    x + gl->width + xoff, y + gl->height + yoff,
+		    gl->sl, gl->tl, gl->sh, gl->th, red, green, blue, alpha);
 	} else {
 		xoff = gl->width * scale - gl->width;
 		yoff = gl->height * scale - gl->height;
 
-		GL_Bind(gl->texnum);
-		qglBegin(GL_QUADS);
-		qglTexCoord2f(gl->sl, gl->tl);
-		qglVertex2f(x, y);
-		qglTexCoord2f(gl->sh, gl->tl);
-		qglVertex2f(x + gl->width + xoff, y);
-		qglTexCoord2f(gl->sh, gl->th);
-		qglVertex2f(x + gl->width + xoff, y + gl->height + yoff);
-		qglTexCoord2f(gl->sl, gl->th);
-		qglVertex2f(x, y + gl->height + yoff);
-		qglEnd();
-	}
-
-	/* add alpha support */
-	{
-		qglDepthMask(true);
-		GL_TexEnv(GL_REPLACE);
-		qglDisable(GL_BLEND);
-		qglColor4f(1, 1, 1, 1);
-
-		qglEnable(GL_ALPHA_TEST);
+		Draw_AddQuad(gl->texnum, DRAW2D_BLEND, x, y,
+		    x + gl->width + xoff, y + gl->height + yoff,
+		    gl->sl, gl->tl, gl->sh, gl->th, red, green, blue, alpha);
 	}
-
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !gl->has_alpha)
-		qglEnable(GL_ALPHA_TEST);
 }
 
 
@@ -390,28 +386,14 @@ Draw_TileClear(int x, int y, int w, int h, char *pic)
 {
 	image_t        *image;
 
-	image = Draw_FindPic(pic);
+	image = Draw_FindWholePic(pic);
 	if (!image) {
 		ri.Con_Printf(PRINT_ALL, "Can't find pic: %s\n", pic);
 		return;
 	}
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !image->has_alpha)
-		qglDisable(GL_ALPHA_TEST);
-
-	GL_Bind(image->texnum);
-	qglBegin(GL_QUADS);
-	qglTexCoord2f(x / 64.0, y / 64.0);
-	qglVertex2f(x, y);
-	qglTexCoord2f((x + w) / 64.0, y / 64.0);
-	qglVertex2f(x + w, y);
-	qglTexCoord2f((x + w) / 64.0, (y + h) / 64.0);
-	qglVertex2f(x + w, y + h);
-	qglTexCoord2f(x / 64.0, (y + h) / 64.0);
-	qglVertex2f(x, y + h);
-	qglEnd();
 
-	if (((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION)) && !image->has_alpha)
-		qglEnable(GL_ALPHA_TEST);
+	Draw_AddQuad(image->texnum, Draw_PicState(image, false), x, y, x + w, y + h,
+	    x / 64.0, y / 64.0, (x + w) / 64.0, (y + h) / 64.0, 1, 1, 1, 1);
 }
 
 
@@ -431,22 +413,10 @@ Draw_Fill(int x, int y, int w, int h, int c)
 	if ((unsigned)c > 255)
 		ri.Sys_Error(ERR_FATAL, "Draw_Fill: bad color");
 
-	qglDisable(GL_TEXTURE_2D);
-
 	color.c = d_8to24table[c];
 
-	qglColor3f(color.v[0] / 255.0, color.v[1] / 255.0, color.v[2] / 255.0);
-
-	qglBegin(GL_QUADS);
-
-	qglVertex2f(x, y);
-	qglVertex2f(x + w, y);
-	qglVertex2f(x + w, y + h);
-	qglVertex2f(x, y + h);
-
-	qglEnd();
-	qglColor3f(1, 1, 1);
-	qglEnable(GL_TEXTURE_2D);
+	Draw_AddQuad(0, DRAW2D_ALPHATEST, x, y, x + w, y + h, 0, 0, 0, 0,
+	    color.v[0] * DIV255, color.v[1] * DIV255, color.v[2] * DIV255, 1);
 }
 
 /*
@@ -462,22 +432,61 @@ Draw_Fill(int x, int y, int w, int h, int c)
 void
 Draw_FadeScreen(void)
 {
-	qglEnable(GL_BLEND);
-	qglDisable(GL_TEXTURE_2D);
-	qglColor4f(0, 0, 0, 0.8);
-	qglBegin(GL_QUADS);
+	Draw_AddQuad(0, DRAW2D_BLEND | DRAW2D_ALPHATEST, 0, 0, vid.width, vid.height,
+	    0, 0, 0, 0, 0, 0, 0, 0.8);
+}
 
-	qglVertex2f(0, 0);
-	qglVertex2f(vid.width, 0);
-	qglVertex2f(vid.width, vid.height);
-	qglVertex2f(0, vid.height);
+/*
+ * ================ Draw_LoadingProgress ================
+ * Registration keeps the client from drawing, so this redraws the loading
+ * plaque with a progress bar under it and swaps on its own
+ */
+void
+Draw_LoadingProgress(int done, int total)
+{
+	static int	lastdraw;
+	int		w, h, x, y, barwidth;
 
-	qglEnd();
-	qglColor4f(1, 1, 1, 1);
-	qglEnable(GL_TEXTURE_2D);
+	if (!gl_loadprogress->value || total <= 0)
+		return;
+	if (done < total && Sys_Milliseconds() - lastdraw < 100)
+		return;
+	lastdraw = Sys_Milliseconds();
+
+	Draw_Flush2D();
+	qglViewport(0, 0, vid.width, vid.height);
+	qglMatrixMode(GL_PROJECTION);
+	qglLoadIdentity();
+	qglOrtho(0, vid.width, vid.height, 0, -99999, 99999);
+	qglMatrixMode(GL_MODELVIEW);
+	qglLoadIdentity();
+	qglDisable(GL_DEPTH_TEST);
+	qglDisable(GL_CULL_FACE);
 	qglDisable(GL_BLEND);
-}
+	qglEnable(GL_ALPHA_TEST);
+	qglColor4f(1, 1, 1, 1);
 
+	qglClearColor(0, 0, 0, 1);
+	qglClear(GL_COLOR_BUFFER_BIT);
+	qglClearColor(1, 0, 0.5, 0.5);
+
+	Draw_GetPicSize(&w, &h, "loading");
+	if (w > 0) {
+		Draw_Pic((vid.width - w) / 2, (vid.height - h) / 2, "loading", 1.0);
+		barwidth = w;
+	} else {
+		h = 0;
+		barwidth = vid.width / 3;
+	}
+
+	x = (vid.width - barwidth) / 2;
+	y = (vid.height + h) / 2 + 8;
+	Draw_Fill(x, y, barwidth, 6, 4);
+	Draw_Fill(x, y, barwidth * done / total, 6, 15);
+
+	Draw_Flush2D();
+	GLimp_EndFrame();
+}
 
 /* ==================================================================== */
 
@@ -499,6 +508,8 @@ Draw_StretchRaw(int x, int y, int w, int h, int cols, int rows, byte * data)
 	int		row;
 	float		t;
 
+	Draw_Flush2D();
+	R_ProfileBegin(PROF_2D);
 	GL_Bind(0);
 
 	if (rows <= 256) {
@@ -573,6 +584,7 @@ Draw_StretchRaw(int x, int y, int w, int h, int cols, int rows, byte * data)
 
 	if ((gl_config.renderer == GL_RENDERER_MCD) || (gl_config.renderer & GL_RENDERER_RENDITION))
 		qglEnable(GL_ALPHA_TEST);
+	R_ProfileEnd(PROF_2D);
 }
 
 static vec3_t	modelorg;	/* relative to viewpoint */
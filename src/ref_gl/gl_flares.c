@@ -19,18 +19,150 @@
 
 #include "gl_local.h"
 
+/*
+ * Flares behind walls are found either with occlusion queries, read back a
+ * frame late so the pipeline never stalls, or with a trace that is only
+ * redone when the view moves to another leaf.  A few cached traces are
+ * refreshed every frame so doors and the like are noticed eventually.
+ * Flares outside the PVS are skipped either way.
+ */
+
+#define	FLARE_RETRACES	16	/* cached traces refreshed per frame */
+
 int		r_numflares;
 flare_t		*r_flares[MAX_FLARES];
 
+static image_t *r_flareimages[FLARE_STYLES + 1];
+static GLuint	r_flarequeries[MAX_FLARES];
+static int	r_flareretrace;
+
+/*
+ * ================ R_FlareQueries
+ *
+ * Collects last frame's results and issues this frame's queries, a small
+ * quad at each flare tested against the depth buffer.  The quad is kept at
+ * least a pixel across so distant flares still pass samples.
+ * ================
+ */
+static void
+R_FlareQueries(void)
+{
+	flare_t        *light;
+	GLuint		result;
+	vec3_t		point;
+	float		pixel, size;
+	int		i;
+
+	if (!r_flarequeries[0])
+		qglGenQueriesARB(MAX_FLARES, r_flarequeries);
+
+	/* a reflection has its own view, it just uses what the main view saw */
+	if (g_drawing_refl)
+		return;
+
+	/* world units per pixel at distance 1 */
+	pixel = 2 * tan(r_refdef.fov_x * M_PI / 360) / r_refdef.width;
+
+	qglColorMask(0, 0, 0, 0);
+	qglDisable(GL_TEXTURE_2D);
+
+	for (i = 0; i < r_numflares; i++) {
+		light = r_flares[i];
+
+		if (light->querying) {
+			qglGetQueryObjectuivARB(r_flarequeries[i], GL_QUERY_RESULT_AVAILABLE_ARB, &result);
+			if (!result)
+				continue;	/* keep the old answer until it comes */
+			qglGetQueryObjectuivARB(r_flarequeries[i], GL_QUERY_RESULT_ARB, &result);
+			light->visible = result != 0;
+			light->querying = false;
+		}
+
+		if (light->leaf->visframe != r_visframecount) {
+			light->visible = false;
+			continue;
+		}
+
+		VectorSubtract(light->origin, r_origin, point);
+		size = max(1, DotProduct(point, vpn) * pixel);
+
+		qglBeginQueryARB(GL_SAMPLES_PASSED_ARB, r_flarequeries[i]);
+		qglBegin(GL_QUADS);
+		VectorMA(light->origin, -size, vup, point);
+		VectorMA(point, size, vright, point);
+		qglVertex3fv(point);
+		VectorMA(point, -2 * size, vright, point);
+		qglVertex3fv(point);
+		VectorMA(point, 2 * size, vup, point);
+		qglVertex3fv(point);
+		VectorMA(point, 2 * size, vright, point);
+		qglVertex3fv(point);
+		qglEnd();
+		qglEndQueryARB(GL_SAMPLES_PASSED_ARB);
+		light->querying = true;
+	}
+
+	qglColorMask(1, 1, 1, 1);
+}
+
+/*
+ * ================ R_FlareTraces ================
+ */
+static void
+R_FlareTraces(void)
+{
+	flare_t        *light;
+	mleaf_t        *viewleaf;
+	int		i, retrace;
+
+	viewleaf = Mod_PointInLeaf(r_origin, r_worldmodel);
+
+	for (i = 0; i < r_numflares; i++) {
+		light = r_flares[i];
+		light->querying = false;
+
+		if (light->leaf->visframe != r_visframecount) {
+			light->visible = false;
+			light->visleaf = NULL;
+			continue;
+		}
+		if (light->visleaf == viewleaf)
+			continue;
+
+		light->visible = ri.CL_IsVisible(r_origin, light->origin);
+		light->visleaf = viewleaf;
+	}
+
+	/* catch what moved in between */
+	retrace = min(FLARE_RETRACES, r_numflares);
+	for (i = 0; i < retrace; i++) {
+		r_flareretrace = (r_flareretrace + 1) % r_numflares;
+		light = r_flares[r_flareretrace];
+		if (light->visleaf)
+			light->visible = ri.CL_IsVisible(r_origin, light->origin);
+	}
+}
+
 void
 R_RenderFlares(void)
 {
 	int		i;
 
-	if (gl_flares->value == 0)
+	if (gl_flares->value == 0 || !r_numflares ||
+	    (r_refdef.rdflags & RDF_NOWORLDMODEL))
 		return;
 
+	for (i = 0; i < r_numflares; i++)
+		if (!r_flares[i]->leaf)
+			r_flares[i]->leaf = Mod_PointInLeaf(r_flares[i]->origin, r_worldmodel);
+
 	qglDepthMask(0);
+
+	if (gl_state.occlusion && gl_flares_occlusion->value)
+		R_FlareQueries();
+	else
+		R_FlareTraces();
+
 	qglDisable(GL_TEXTURE_2D);
 	qglShadeModel(GL_SMOOTH);
 	qglEnable(GL_BLEND);
@@ -39,7 +171,7 @@ R_RenderFlares(void)
 	qglBlendFunc(GL_SRC_ALPHA, GL_ONE);
 
 	for (i = 0; i < r_numflares; i++)
-		if (ri.CL_IsVisible(r_origin, r_flares[i]->origin))
+		if (r_flares[i]->visible)
 			R_RenderFlare(r_flares[i]);
 
 	qglColor3f(1, 1, 1);
@@ -52,9 +184,7 @@ R_RenderFlares(void)
 void
 R_RenderFlare(flare_t *light)
 {
-	char		pathname[MAX_QPATH];	/* Flare image path. */
 	int		size;			/* Flare size. */
-	int		style;			/* Flare style. */
 	float		dist;			/* Distance to flare. */
 	image_t        *flare;			/* Flare image. */
 	vec3_t		color;			/* Flare color. */
@@ -64,22 +194,9 @@ R_RenderFlare(flare_t *light)
 	/* Check for flare style override. */
 	if (gl_flare_force_style->value > 0 &&
 	    gl_flare_force_style->value <= FLARE_STYLES)
-		style = gl_flare_force_style->value;
-	else
-		style = light->style;
-
-	/* Check if style is valid. */
-	if (style > 0 && style <= FLARE_STYLES)
-		Com_sprintf(pathname, sizeof(pathname),
-		    "gfx/flare%d.png", style);
+		flare = r_flareimages[(int)gl_flare_force_style->value];
 	else
-		ri.Sys_Error(ERR_DROP,
-		    "R_RenderFlare: invalid flare style: %d", style);
-
-	flare = GL_FindImage(pathname, it_sprite);
-
-	if (flare == NULL)
-		flare = r_notexture;
+		flare = light->image;
 
 	/* Check for flare size override. */
 	if (gl_flare_force_size->value != 0)
@@ -154,6 +271,7 @@ R_RenderFlare(flare_t *light)
 void
 GL_AddFlareSurface(msurface_t * surf)
 {
+	int		i;
 	int		intens;	/* Light intensity. */
 	flare_t        *light;	/* New flare. */
 	vec3_t		origin;	/* Center of surface. */
@@ -177,8 +295,18 @@ GL_AddFlareSurface(msurface_t * surf)
 		return;
 	}
 
+	/* Find the images once, the style can be forced later. */
+	if (!r_flareimages[1]) {
+		for (i = 1; i <= FLARE_STYLES; i++) {
+			r_flareimages[i] = GL_FindImage(va("gfx/flare%d.png", i), it_sprite);
+			if (r_flareimages[i] == NULL)
+				r_flareimages[i] = r_notexture;
+		}
+	}
+
 	/* Create new flare. */
 	light = Hunk_Alloc(sizeof(flare_t));
+	memset(light, 0, sizeof(flare_t));
 	r_flares[r_numflares++] = light;
 
 	VectorCopy(surf->center, origin);
@@ -217,6 +345,7 @@ GL_AddFlareSurface(msurface_t * surf)
 	VectorCopy(origin, light->origin);
 
 	light->style = r_numflares % FLARE_STYLES + 1;	/* Pseudo-random. */
+	light->image = r_flareimages[light->style];
 	light->size = intens / 1000;
 	
 	ri.Con_Printf(PRINT_DEVELOPER, "Added flare on light surface %d: "
@@ -225,3 +354,48 @@ GL_AddFlareSurface(msurface_t * surf)
 	    light->style, light->color[0], light->color[1], light->color[2],
 	    light->origin[0], light->origin[1], light->origin[2]);
 }
+
+/*
+ * ================ GL_ClearFlares
+ *
+ * Called when a new map's faces are loaded.  The images are looked up again
+ * since the old ones may not survive the registration.
+ * ================
+ */
+void
+GL_ClearFlares(void)
+{
+	r_numflares = 0;
+	r_flareretrace = 0;
+	memset(r_flareimages, 0, sizeof(r_flareimages));
+}
+
+/*
+ * ================ GL_RegisterFlares
+ *
+ * Keeps the flare images through GL_FreeUnusedImages.  A map that is
+ * registered again keeps its faces, so they are not looked up again.
+ * ================
+ */
+void
+GL_RegisterFlares(void)
+{
+	int		i;
+
+	for (i = 1; i <= FLARE_STYLES; i++)
+		if (r_flareimages[i])
+			r_flareimages[i]->registration_sequence = registration_sequence;
+}
+
+/*
+ * ================ GL_ShutdownFlares ================
+ */
+void
+GL_ShutdownFlares(void)
+{
+	if (r_flarequeries[0]) {
+		qglDeleteQueriesARB(MAX_FLARES, r_flarequeries);
+		memset(r_flarequeries, 0, sizeof(r_flarequeries));
+	}
+	GL_ClearFlares();
+}
@@ -21,10 +21,144 @@
 #include "gl_local.h"
 #include "gl_refl.h"		/* MPO */
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+#if idavx2
+#include <immintrin.h>
+#endif
+
 image_t gltextures[MAX_GLTEXTURES];
 int numgltextures;
 int base_textureid;		/* gltextures[i] = base_textureid+i */
 
+#define	IMAGE_HASH_SIZE		256
+static image_t *image_hash[IMAGE_HASH_SIZE];
+
+/*
+ * Names that could not be loaded, so replacement probes and missing pics
+ * don't hit the filesystem again.  Forgotten on every registration, which
+ * is when downloads and game directory changes can make them appear.
+ */
+#define	MAX_FAILED_PROBES	1024
+#define	FAILED_PROBE_HASH	256
+
+typedef struct failedprobe_s {
+	char		name[MAX_QPATH];
+	struct failedprobe_s *hash_next;
+} failedprobe_t;
+
+static failedprobe_t failed_probes[MAX_FAILED_PROBES];
+static failedprobe_t *failed_probe_hash[FAILED_PROBE_HASH];
+static int	num_failed_probes;
+
+typedef struct {
+	int		level;		/* print level, -1 if there is nothing to say */
+	qboolean	drop;		/* raise ERR_DROP instead of printing */
+	char		text[MAX_QPATH * 2];
+} imagemsg_t;
+
+/* a 32 bit image scaled and lit for upload, see GL_PrepareUpload32 */
+typedef struct {
+	int		maxsize;	/* GL_MAX_TEXTURE_SIZE */
+	int		picmip;
+	qboolean	lightscale;
+	qboolean	buildmips;	/* build the mip chain here instead of in GL */
+
+	unsigned       *data;		/* level 0, followed by the other levels */
+	qboolean	freedata;	/* data isn't the caller's buffer */
+	int		width, height;
+	int		numlevels;
+	int		samples;
+	qboolean	mipmap;
+} imageupload_t;
+
+/*
+ * Images queued by GL_QueueImage during registration.  The files are read
+ * on the main thread, since the filesystem isn't thread safe, and decoded
+ * and prepared for upload by the workers.  GL_FindImage picks the result up
+ * and only does the GL upload itself.
+ */
+#define	MAX_IMAGE_JOBS		512
+#define	IMAGE_JOBS_AHEAD	16	/* decoded but unclaimed images, per worker */
+#define	MAX_IMAGE_WORKERS	8
+
+typedef enum {
+	IJOB_QUEUED,
+	IJOB_RUNNING,
+	IJOB_DONE
+} imagejobstate_t;
+
+typedef struct imagejob_s {
+	char		name[MAX_QPATH];
+	imagetype_t	type;
+	byte	       *raw;		/* file contents, freed on the main thread */
+	int		rawlen;
+	imagejobstate_t	state;
+	qboolean	claimed;
+
+	byte	       *pic;
+	int		width, height;
+	imageupload_t	upload;
+	imagemsg_t	msg;
+
+	char		cachepath[MAX_OSPATH];	/* empty when gl_texcache is off */
+	unsigned	lighttables;	/* GL_LightTablesKey when light scaled */
+	float		saturation;
+
+	struct imagejob_s *hash_next;
+} imagejob_t;
+
+/*
+ * Processed texture cache, one file per 32 bit image under
+ * <gamedir>/texcache.  The header is followed by the upload levels exactly
+ * as they go to glTexImage2D, largest first, so the file can be read (or
+ * mapped) and handed over without touching the texels.  Any difference in
+ * the key fields means the entry is stale and gets rewritten.
+ */
+#define	TEXCACHE_IDENT		(('1'<<24)+('C'<<16)+('T'<<8)+'Q')	/* "QTC1" */
+#define	TEXCACHE_VERSION	1
+
+typedef struct {
+	int		ident;
+	int		version;
+	char		name[MAX_QPATH];
+
+	/* key */
+	unsigned	checksum;	/* of the source file */
+	int		srclen;
+	unsigned	lighttables;
+	float		saturation;
+	int		picmip;
+	int		maxsize;
+	int		mipmap;
+	int		buildmips;
+
+	/* contents */
+	int		srcwidth, srcheight;
+	int		width, height;
+	int		numlevels;
+	int		hasalpha;
+	int		datasize;
+	int		pad;
+} texcacheheader_t;
+
+static unsigned image_lighttables;
+static qboolean texcache_dir_made;
+
+static imagejob_t image_jobs[MAX_IMAGE_JOBS];
+static imagejob_t *image_job_hash[IMAGE_HASH_SIZE];
+static int	num_image_jobs;
+static int	next_image_job;		/* next one for the workers */
+static int	num_claimed_jobs;
+
+static qthread_t *image_workers[MAX_IMAGE_WORKERS];
+static int	num_image_workers;
+static qboolean	image_workers_quit;
+static qmutex_t *image_job_lock;
+static qcond_t *image_job_queued;
+static qcond_t *image_job_done;
+
 static byte	intensitytable[256];
 static unsigned char gammatable[256];
 
@@ -366,13 +500,15 @@ void GL_ImageList_f(void) {
  */
 
 #define	MAX_SCRAPS 1
-#define	BLOCK_WIDTH 256
-#define	BLOCK_HEIGHT 256
+#define	BLOCK_WIDTH 512
+#define	BLOCK_HEIGHT 256	/* GL_Upload8 takes at most 512*256 */
+#define	SCRAP_MAXPIC 128	/* pics smaller than this go into the scrap */
 #define	IMAGERESMAX 1024
 
 int scrap_allocated[MAX_SCRAPS][BLOCK_WIDTH];
 byte scrap_texels[MAX_SCRAPS][BLOCK_WIDTH * BLOCK_HEIGHT];
 qboolean scrap_dirty;
+qboolean scrap_skip;	/* set while loading pics that are tiled or bound whole */
 
 /* returns a texture number and the position inside it */
 int Scrap_AllocBlock(int w, int h, int *x, int *y) {
@@ -420,6 +556,41 @@ void Scrap_Upload(void) {
 	scrap_dirty = false;
 }
 
+/*
+ * =====================================================================
+ * DECODER MESSAGES
+ *
+ * The decoders can run on the image worker threads, so they leave their
+ * complaint here and the main thread prints it (or drops) afterwards.
+ * =====================================================================
+ */
+
+static void R_ClearImageMsg(imagemsg_t *msg) {
+	msg->level = -1;
+	msg->drop = false;
+	msg->text[0] = 0;
+}
+
+static void R_ImageMsg(imagemsg_t *msg, int level, qboolean drop, char *fmt,...) {
+	va_list argptr;
+
+	if (msg->drop)
+		return;		/* keep the fatal one */
+
+	msg->level = level;
+	msg->drop = drop;
+	va_start(argptr, fmt);
+	vsnprintf(msg->text, sizeof(msg->text), fmt, argptr);
+	va_end(argptr);
+}
+
+static void R_ReportImageMsg(imagemsg_t *msg) {
+	if (msg->drop)
+		ri.Sys_Error(ERR_DROP, "%s", msg->text);
+	else if (msg->level >= 0)
+		ri.Con_Printf(msg->level, "%s", msg->text);
+}
+
 /*
  * =====================================================================
  * PCX LOADING
@@ -544,21 +715,15 @@ typedef struct _TargaHeader {
 #define MAXCOLORS 		16384
 
 /*
- * == LoadTGA NiceAss: LoadTGA() from Q2Ice, it supports more formats ==
+ * == R_DecodeTGA NiceAss: LoadTGA() from Q2Ice, it supports more formats ==
  */
-void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
+static byte *R_DecodeTGA(char *filename, byte *data, int len, int *width, int *height, imagemsg_t *msg) {
 	int w, h, x, y, i, temp1, temp2;
 	int realrow, truerow, baserow, size, interleave, origin;
 	int pixel_size, map_idx, mapped, rlencoded, RLE_count, RLE_flag;
 	TargaHeader	header;
 	byte		tmp[2], r, g, b, a, j, k, l;
-	byte           *dst, *ColorMap, *data, *pdata;
-
-	/* load file */
-	ri.FS_LoadFile(filename, (void **)&data);
-
-	if (!data)
-		return;
+	byte           *dst, *ColorMap, *pdata, *pic;
 
 	pdata = data;
 
@@ -599,8 +764,8 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 	case TGA_RLEMono:
 		break;
 	default:
-		ri.Sys_Error(ERR_DROP, "LoadTGA: Only type 1 (map), 2 (RGB), 3 (mono), 9 (RLEmap), 10 (RLERGB), 11 (RLEmono) TGA images supported\n");
-		return;
+		R_ImageMsg(msg, PRINT_ALL, true, "LoadTGA: Only type 1 (map), 2 (RGB), 3 (mono), 9 (RLEmap), 10 (RLERGB), 11 (RLEmono) TGA images supported\n");
+		return NULL;
 	}
 
 	/* validate color depth */
@@ -612,8 +777,8 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 	case 32:
 		break;
 	default:
-		ri.Sys_Error(ERR_DROP, "LoadTGA: Only 8, 15, 16, 24 and 32 bit images (with colormaps) supported\n");
-		return;
+		R_ImageMsg(msg, PRINT_ALL, true, "LoadTGA: Only 8, 15, 16, 24 and 32 bit images (with colormaps) supported\n");
+		return NULL;
 	}
 
 	r = g = b = a = l = 0;
@@ -630,16 +795,14 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 		case 24:
 			break;
 		default:
-			ri.Sys_Error(ERR_DROP, "LoadTGA: Only 8, 16, 24 and 32 bit colormaps supported\n");
-			return;
+			R_ImageMsg(msg, PRINT_ALL, true, "LoadTGA: Only 8, 16, 24 and 32 bit colormaps supported\n");
+			return NULL;
 		}
 
 		temp1 = header.colormap_index;
 		temp2 = header.colormap_length;
-		if ((temp1 + temp2 + 1) >= MAXCOLORS) {
-			ri.FS_FreeFile(data);
-			return;
-		}
+		if ((temp1 + temp2 + 1) >= MAXCOLORS)
+			return NULL;
 		ColorMap = (byte *) malloc(MAXCOLORS * 4);
 		map_idx = 0;
 		for (i = temp1; i < temp1 + temp2; ++i, map_idx += 4) {
@@ -703,9 +866,9 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 		*height = h;
 
 	size = w * h * 4;
-	*pic = (byte *) malloc(size);
+	pic = (byte *) malloc(size);
 
-	memset(*pic, 0, size);
+	memset(pic, 0, size);
 
 	/* read the Targa file body and convert to portable format */
 	pixel_size = header.pixel_size;
@@ -718,7 +881,7 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 		if (origin == TGA_O_UPPER)
 			realrow = h - realrow - 1;
 
-		dst = *pic + realrow * w * 4;
+		dst = pic + realrow * w * 4;
 
 		for (x = 0; x < w; x++) {
 			/* check if run length encoded */
@@ -784,8 +947,11 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 				l = 0;
 				break;
 			default:
-				ri.Sys_Error(ERR_DROP, "Illegal pixel_size '%d' in file '%s'\n", filename);
-				return;
+				R_ImageMsg(msg, PRINT_ALL, true, "Illegal pixel_size '%d' in file '%s'\n", pixel_size, filename);
+				if (mapped)
+					free(ColorMap);
+				free(pic);
+				return NULL;
 			}
 
 	PixEncode:
@@ -817,7 +983,25 @@ void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
 	if (mapped)
 		free(ColorMap);
 
+	return pic;
+}
+
+/* ============= LoadTGA ============= */
+void LoadTGA(char *filename, byte ** pic, int *width, int *height) {
+	imagemsg_t msg;
+	byte *data;
+	int len;
+
+	/* load file */
+	len = ri.FS_LoadFile(filename, (void **)&data);
+
+	if (!data)
+		return;
+
+	R_ClearImageMsg(&msg);
+	*pic = R_DecodeTGA(filename, data, len, width, height, &msg);
 	ri.FS_FreeFile(data);
+	R_ReportImageMsg(&msg);
 }
 
 /*
@@ -832,7 +1016,7 @@ void jpg_null(j_decompress_ptr cinfo) {
 }
 
 boolean jpg_fill_input_buffer(j_decompress_ptr cinfo) {
-	ri.Con_Printf(PRINT_ALL, "Premature end of JPEG data\n");
+	R_ImageMsg(cinfo->client_data, PRINT_ALL, false, "Premature end of JPEG data\n");
 	return 1;
 }
 
@@ -842,7 +1026,7 @@ void jpg_skip_input_data(j_decompress_ptr cinfo, long num_bytes) {
 	cinfo->src->bytes_in_buffer -= (size_t) num_bytes;
 
 	if (cinfo->src->bytes_in_buffer < 0)
-		ri.Con_Printf(PRINT_ALL, "Premature end of JPEG data\n");
+		R_ImageMsg(cinfo->client_data, PRINT_ALL, false, "Premature end of JPEG data\n");
 }
 
 void jpeg_mem_src(j_decompress_ptr cinfo, unsigned char * mem, unsigned long len) {
@@ -856,32 +1040,26 @@ void jpeg_mem_src(j_decompress_ptr cinfo, unsigned char * mem, unsigned long len
 	cinfo->src->next_input_byte = mem;
 }
 
-/* ============== LoadJPG ============== */
-void LoadJPG(char *filename, byte ** pic, int *width, int *height) {
+/* ============== R_DecodeJPG ============== */
+static byte *R_DecodeJPG(char *filename, byte *rawdata, int rawsize, int *width, int *height, imagemsg_t *msg) {
 	struct jpeg_decompress_struct cinfo;
 	struct jpeg_error_mgr jerr;
-	byte *rawdata, *rgbadata, *scanline, *p, *q;
-	int rawsize, i;
-
-	*pic = NULL;
-
-	/* Load JPEG file into memory */
-	rawsize = ri.FS_LoadFile(filename, (void **)&rawdata);
-	if (!rawdata)
-		return;
+	byte *rgbadata, *scanline, *p, *q;
+	int i;
 
 	/* Knightmare- check for bad data  */
-	if (rawdata[6] != 'J'
+	if (rawsize < 10
+	    || rawdata[6] != 'J'
 	    || rawdata[7] != 'F'
 	    || rawdata[8] != 'I'
 	    || rawdata[9] != 'F') {
-		ri.Con_Printf(PRINT_ALL, "Bad jpg file %s\n", filename);
-		ri.FS_FreeFile(rawdata);
-		return;
+		R_ImageMsg(msg, PRINT_ALL, false, "Bad jpg file %s\n", filename);
+		return NULL;
 	}
 	/* Initialise libJpeg Object */
 	cinfo.err = jpeg_std_error(&jerr);
 	jpeg_create_decompress(&cinfo);
+	cinfo.client_data = msg;
 
 	/* Feed JPEG memory into the libJpeg Object */
 	jpeg_mem_src(&cinfo, rawdata, rawsize);
@@ -894,18 +1072,16 @@ void LoadJPG(char *filename, byte ** pic, int *width, int *height) {
 
 	/* Check Colour Components */
 	if (cinfo.output_components != 3) {
-		ri.Con_Printf(PRINT_ALL, "Invalid JPEG colour components\n");
+		R_ImageMsg(msg, PRINT_ALL, false, "Invalid JPEG colour components\n");
 		jpeg_destroy_decompress(&cinfo);
-		ri.FS_FreeFile(rawdata);
-		return;
+		return NULL;
 	}
 	/* Allocate Memory for decompressed image */
 	rgbadata = malloc(cinfo.output_width * cinfo.output_height * 4);
 	if (!rgbadata) {
-		ri.Con_Printf(PRINT_ALL, "Insufficient RAM for JPEG buffer\n");
+		R_ImageMsg(msg, PRINT_ALL, false, "Insufficient RAM for JPEG buffer\n");
 		jpeg_destroy_decompress(&cinfo);
-		ri.FS_FreeFile(rawdata);
-		return;
+		return NULL;
 	}
 	/* Pass sizes to output */
 	*width = cinfo.output_width;
@@ -914,11 +1090,10 @@ void LoadJPG(char *filename, byte ** pic, int *width, int *height) {
 	/* Allocate Scanline buffer */
 	scanline = malloc(cinfo.output_width * 3);
 	if (!scanline) {
-		ri.Con_Printf(PRINT_ALL, "Insufficient RAM for JPEG scanline buffer\n");
+		R_ImageMsg(msg, PRINT_ALL, false, "Insufficient RAM for JPEG scanline buffer\n");
 		free(rgbadata);
 		jpeg_destroy_decompress(&cinfo);
-		ri.FS_FreeFile(rawdata);
-		return;
+		return NULL;
 	}
 	/* Read Scanlines, and expand from RGB to RGBA */
 	q = rgbadata;
@@ -947,7 +1122,26 @@ void LoadJPG(char *filename, byte ** pic, int *width, int *height) {
 	jpeg_destroy_decompress(&cinfo);
 
 	/* Return the 'rgbadata' */
-	*pic = rgbadata;
+	return rgbadata;
+}
+
+/* ============== LoadJPG ============== */
+void LoadJPG(char *filename, byte ** pic, int *width, int *height) {
+	imagemsg_t msg;
+	byte *rawdata;
+	int rawsize;
+
+	*pic = NULL;
+
+	/* Load JPEG file into memory */
+	rawsize = ri.FS_LoadFile(filename, (void **)&rawdata);
+	if (!rawdata)
+		return;
+
+	R_ClearImageMsg(&msg);
+	*pic = R_DecodeJPG(filename, rawdata, rawsize, width, height, &msg);
+	ri.FS_FreeFile(rawdata);
+	R_ReportImageMsg(&msg);
 }
 
 
@@ -982,10 +1176,9 @@ typedef struct png_s {			/* TPng = class(TGraphic) */
 	int Transparent;
 } png_t;
 
-png_t *my_png = 0;
 unsigned char *pngbytes;
 
-void InitializeDemData() {
+void InitializeDemData(png_t *my_png) {
 	long *cvaluep;/* ub */
 	long y;
 
@@ -1009,29 +1202,21 @@ void InitializeDemData() {
 	}
 }
 
-void mypng_struct_create() {
-	if (my_png)
-		return;
-	my_png = malloc(sizeof(png_t));
-	my_png->Data = 0;
-	my_png->FRowPtrs = 0;
-	my_png->Height = 0;
-	my_png->Width = 0;
+void mypng_struct_create(png_t *my_png) {
+	memset(my_png, 0, sizeof(*my_png));
 	my_png->ColorType = PNG_COLOR_TYPE_RGB;
 	my_png->Interlace = PNG_INTERLACE_NONE;
 	my_png->Compression = PNG_COMPRESSION_TYPE_DEFAULT;
 	my_png->Filter = PNG_FILTER_TYPE_DEFAULT;
 }
 
-void mypng_struct_destroy(qboolean keepData) {
-	if (!my_png)
-		return;
+void mypng_struct_destroy(png_t *my_png, qboolean keepData) {
 	if (my_png->Data && !keepData)
 		free(my_png->Data);
 	if (my_png->FRowPtrs)
 		free(my_png->FRowPtrs);
-	free(my_png);
-	my_png = 0;
+	my_png->Data = 0;
+	my_png->FRowPtrs = 0;
 }
 
 /*
@@ -1042,6 +1227,7 @@ void mypng_struct_destroy(qboolean keepData) {
 
 void PNGAPI fReadData(png_structp png, png_bytep data, png_size_t length) {
 	/* called by pnglib */
+	png_t *my_png = png_get_io_ptr(png);
 	int i;
 
 	for (i = 0; i < length; i++)
@@ -1050,55 +1236,47 @@ void PNGAPI fReadData(png_structp png, png_bytep data, png_size_t length) {
 
 /*
  * =====================================================================
- * LoadPNG
+ * R_DecodePNG
+ * The png_t lives on the stack, so several images can be decoded at once
  * =====================================================================
  */
 
-void LoadPNG(char *filename, byte ** pic, int *width, int *height) {
+static byte *R_DecodePNG(char *filename, byte *raw, int len, int *width, int *height, imagemsg_t *msg) {
 	png_structp png;
 	png_infop pnginfo;
-	byte ioBuffer  [8192];
-	int len;
-	byte *raw;
-
-	*pic = 0;
+	png_t my_png;
+	byte *pic;
 
-	len = ri.FS_LoadFile(filename, (void **)&raw);
-
-	if (!raw) {
-		ri.Con_Printf(PRINT_DEVELOPER, "Bad png file %s\n", filename);
-		return;
-	}
-	if (png_sig_cmp(raw, 0, 4))
-		return;
+	if (len < 4 || png_sig_cmp(raw, 0, 4))
+		return NULL;
 
 	png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0, 0, 0);
 	if (!png)
-		return;
+		return NULL;
 
 	pnginfo = png_create_info_struct(png);
 
 	if (!pnginfo) {
 		png_destroy_read_struct(&png, &pnginfo, 0);
-		return;
+		return NULL;
 	}
 	png_set_sig_bytes(png, 0 /* sizeof( sig ) */ );
 
-	mypng_struct_create();	/* creates the my_png struct */
+	mypng_struct_create(&my_png);	/* creates the my_png struct */
 
-	my_png->tmpBuf = (char *)raw;	/* buf = whole file content */
-	my_png->tmpi = 0;
+	my_png.tmpBuf = (char *)raw;	/* buf = whole file content */
+	my_png.tmpi = 0;
 
-	png_set_read_fn(png, ioBuffer, fReadData);
+	png_set_read_fn(png, &my_png, fReadData);
 
 	png_read_info(png, pnginfo);
 
-	png_get_IHDR(png, pnginfo, &my_png->Width, &my_png->Height, &my_png->BitDepth, &my_png->ColorType, &my_png->Interlace, &my_png->Compression, &my_png->Filter);
+	png_get_IHDR(png, pnginfo, &my_png.Width, &my_png.Height, &my_png.BitDepth, &my_png.ColorType, &my_png.Interlace, &my_png.Compression, &my_png.Filter);
 	
 	/* ...removed bgColor code here... */
-	if (my_png->ColorType == PNG_COLOR_TYPE_PALETTE)
+	if (my_png.ColorType == PNG_COLOR_TYPE_PALETTE)
 		png_set_palette_to_rgb(png);
-	if (my_png->ColorType == PNG_COLOR_TYPE_GRAY && my_png->BitDepth < 8)
+	if (my_png.ColorType == PNG_COLOR_TYPE_GRAY && my_png.BitDepth < 8)
 		png_set_gray_1_2_4_to_8(png);
 
 	/* Add alpha channel if present */
@@ -1106,25 +1284,25 @@ void LoadPNG(char *filename, byte ** pic, int *width, int *height) {
 		png_set_tRNS_to_alpha(png);
 
 	/* hax: expand 24bit to 32bit */
-	if (my_png->BitDepth == 8 && my_png->ColorType == PNG_COLOR_TYPE_RGB)
+	if (my_png.BitDepth == 8 && my_png.ColorType == PNG_COLOR_TYPE_RGB)
 		png_set_filler(png, 255, PNG_FILLER_AFTER);
 
-	if ((my_png->ColorType == PNG_COLOR_TYPE_GRAY) || (my_png->ColorType == PNG_COLOR_TYPE_GRAY_ALPHA))
+	if ((my_png.ColorType == PNG_COLOR_TYPE_GRAY) || (my_png.ColorType == PNG_COLOR_TYPE_GRAY_ALPHA))
 		png_set_gray_to_rgb(png);
 
 
-	if (my_png->BitDepth < 8)
+	if (my_png.BitDepth < 8)
 		png_set_expand(png);
 
 	/* update the info structure */
 	png_read_update_info(png, pnginfo);
 
-	my_png->FRowBytes = png_get_rowbytes(png, pnginfo);
-	my_png->BytesPerPixel = png_get_channels(png, pnginfo);	/* DL Added 30/08/2000 */
+	my_png.FRowBytes = png_get_rowbytes(png, pnginfo);
+	my_png.BytesPerPixel = png_get_channels(png, pnginfo);	/* DL Added 30/08/2000 */
 
-	InitializeDemData();
-	if ((my_png->Data) && (my_png->FRowPtrs))
-		png_read_image(png, (png_bytepp) my_png->FRowPtrs);
+	InitializeDemData(&my_png);
+	if ((my_png.Data) && (my_png.FRowPtrs))
+		png_read_image(png, (png_bytepp) my_png.FRowPtrs);
 
 	png_read_end(png, pnginfo);	/* read last information chunks */
 
@@ -1132,18 +1310,44 @@ void LoadPNG(char *filename, byte ** pic, int *width, int *height) {
 
 
 	/* only load 32 bit by now... */
-	if (my_png->BitDepth == 8) {
-		*pic = (byte *)my_png->Data;
-		*width = my_png->Width;
-		*height = my_png->Height;
+	if (my_png.BitDepth == 8) {
+		pic = (byte *)my_png.Data;
+		*width = my_png.Width;
+		*height = my_png.Height;
 	} else {
-		ri.Con_Printf(PRINT_DEVELOPER, "Bad png color depth: %s\n", filename);
-		*pic = NULL;
-		free(my_png->Data);
+		R_ImageMsg(msg, PRINT_DEVELOPER, false, "Bad png color depth: %s\n", filename);
+		pic = NULL;
+		free(my_png.Data);
+	}
+
+	mypng_struct_destroy(&my_png, true);
+	return pic;
+}
+
+/*
+ * =====================================================================
+ * LoadPNG
+ * =====================================================================
+ */
+
+void LoadPNG(char *filename, byte ** pic, int *width, int *height) {
+	imagemsg_t msg;
+	int len;
+	byte *raw;
+
+	*pic = 0;
+
+	len = ri.FS_LoadFile(filename, (void **)&raw);
+
+	if (!raw) {
+		ri.Con_Printf(PRINT_DEVELOPER, "Bad png file %s\n", filename);
+		return;
 	}
 
-	mypng_struct_destroy(true);
+	R_ClearImageMsg(&msg);
+	*pic = R_DecodePNG(filename, raw, len, width, height, &msg);
 	ri.FS_FreeFile((void *)raw);
+	R_ReportImageMsg(&msg);
 }
 
 /*
@@ -1226,69 +1430,191 @@ void R_FloodFillSkin(byte * skin, int skinwidth, int skinheight) {
 /* ================================================================== */
 
 
+/*
+ * ================================================================
+ * Image kernels.  The C versions are the reference and the fallback, SSE2
+ * is used on x86-64 and AVX2 is picked at runtime.  "imagebench" times the
+ * levels against each other and checks them against C.
+ * ================================================================
+ */
+enum {
+	IMAGE_KERNEL_C,
+	IMAGE_KERNEL_SSE2,
+	IMAGE_KERNEL_AVX2
+};
+
+static int	image_kernel, image_best_kernel;
+static const char *image_kernel_names[] = {"C", "SSE2", "AVX2"};
+
+/*
+ * GL_LightScaleTexture as one lookup per channel into whole texel words,
+ * [only_gamma][channel], built by GL_BuildLightScaleTables
+ */
+static unsigned	lightscale_tables[2][3][256];
+
+/*
+ * ================ GL_InitImageKernels ================
+ */
+static void GL_InitImageKernels(void) {
+	image_best_kernel = IMAGE_KERNEL_C;
+#if idsse2
+	image_best_kernel = IMAGE_KERNEL_SSE2;
+#endif
+#if idavx2
+	if (Sys_HaveAVX2())
+		image_best_kernel = IMAGE_KERNEL_AVX2;
+#endif
+	image_kernel = image_best_kernel;
+	ri.Con_Printf(PRINT_ALL, "Image kernels: %s\n", image_kernel_names[image_kernel]);
+}
+
+/*
+ * ================ GL_ResampleRow_C ================
+ * p1 and p2 are texel indexes into the two source rows
+ */
+static void GL_ResampleRow_C(const unsigned *inrow, const unsigned *inrow2,
+                             const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth) {
+	const byte *pix1, *pix2, *pix3, *pix4;
+	byte *o;
+	int j;
+
+	for (j = 0; j < outwidth; j++) {
+		pix1 = (const byte *)(inrow + p1[j]);
+		pix2 = (const byte *)(inrow + p2[j]);
+		pix3 = (const byte *)(inrow2 + p1[j]);
+		pix4 = (const byte *)(inrow2 + p2[j]);
+		o = (byte *)(out + j);
+		o[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0]) >> 2;
+		o[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1]) >> 2;
+		o[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2]) >> 2;
+		o[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3]) >> 2;
+	}
+}
+
+#if idsse2
+#define	GATHER4(row, p, j)	_mm_setr_epi32((int)(row)[(p)[(j)]], (int)(row)[(p)[(j) + 1]], \
+				               (int)(row)[(p)[(j) + 2]], (int)(row)[(p)[(j) + 3]])
+
+static void GL_ResampleRow_SSE2(const unsigned *inrow, const unsigned *inrow2,
+                                const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i a, b, c, d, lo, hi;
+	int j;
+
+	for (j = 0; j + 4 <= outwidth; j += 4) {
+		a = GATHER4(inrow, p1, j);
+		b = GATHER4(inrow, p2, j);
+		c = GATHER4(inrow2, p1, j);
+		d = GATHER4(inrow2, p2, j);
+		lo = _mm_add_epi16(_mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero)),
+		                   _mm_add_epi16(_mm_unpacklo_epi8(c, zero), _mm_unpacklo_epi8(d, zero)));
+		hi = _mm_add_epi16(_mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero)),
+		                   _mm_add_epi16(_mm_unpackhi_epi8(c, zero), _mm_unpackhi_epi8(d, zero)));
+		_mm_storeu_si128((__m128i *)(out + j),
+		                 _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2)));
+	}
+
+	GL_ResampleRow_C(inrow, inrow2, p1 + j, p2 + j, out + j, outwidth - j);
+}
+
+#undef GATHER4
+#endif
+
+#if idavx2
+static AVX2_FUNC void GL_ResampleRow_AVX2(const unsigned *inrow, const unsigned *inrow2,
+                                          const unsigned *p1, const unsigned *p2, unsigned *out, int outwidth) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i i1, i2, a, b, c, d, lo, hi;
+	int j;
+
+	for (j = 0; j + 8 <= outwidth; j += 8) {
+		i1 = _mm256_loadu_si256((const __m256i *)(p1 + j));
+		i2 = _mm256_loadu_si256((const __m256i *)(p2 + j));
+		a = _mm256_i32gather_epi32((const int *)inrow, i1, 4);
+		b = _mm256_i32gather_epi32((const int *)inrow, i2, 4);
+		c = _mm256_i32gather_epi32((const int *)inrow2, i1, 4);
+		d = _mm256_i32gather_epi32((const int *)inrow2, i2, 4);
+		/* unpack and pack both stay within lanes, so the order survives */
+		lo = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpacklo_epi8(a, zero), _mm256_unpacklo_epi8(b, zero)),
+		                      _mm256_add_epi16(_mm256_unpacklo_epi8(c, zero), _mm256_unpacklo_epi8(d, zero)));
+		hi = _mm256_add_epi16(_mm256_add_epi16(_mm256_unpackhi_epi8(a, zero), _mm256_unpackhi_epi8(b, zero)),
+		                      _mm256_add_epi16(_mm256_unpackhi_epi8(c, zero), _mm256_unpackhi_epi8(d, zero)));
+		_mm256_storeu_si256((__m256i *)(out + j),
+		                    _mm256_packus_epi16(_mm256_srli_epi16(lo, 2), _mm256_srli_epi16(hi, 2)));
+	}
+
+	GL_ResampleRow_C(inrow, inrow2, p1 + j, p2 + j, out + j, outwidth - j);
+}
+#endif
+
 /* ================ GL_ResampleTexture ================ */
 void GL_ResampleTexture(unsigned *in, int inwidth, int inheight, unsigned *out, int outwidth, int outheight) {
-	int i, j;
+	int i;
 	unsigned *inrow, *inrow2;
 	unsigned frac, fracstep;
-	unsigned p1[1024], p2[1024];
-	byte *pix1, *pix2, *pix3, *pix4;
+	unsigned stack1[1024], stack2[1024], *p1, *p2;
+
+	/* column tables, on the heap for anything wider than the stack ones */
+	if (outwidth > 1024) {
+		p1 = malloc(outwidth * 2 * sizeof(*p1));
+		p2 = p1 + outwidth;
+	} else {
+		p1 = stack1;
+		p2 = stack2;
+	}
 
 	fracstep = inwidth * 0x10000 / outwidth;
 
 	frac = fracstep >> 2;
 	for (i = 0; i < outwidth; i++) {
-		p1[i] = 4 * (frac >> 16);
+		p1[i] = frac >> 16;
 		frac += fracstep;
 	}
 	frac = 3 * (fracstep >> 2);
 	for (i = 0; i < outwidth; i++) {
-		p2[i] = 4 * (frac >> 16);
+		p2[i] = frac >> 16;
 		frac += fracstep;
 	}
 
 	for (i = 0; i < outheight; i++, out += outwidth) {
 		inrow = in + inwidth * (int)((i + 0.25) * inheight / outheight);
 		inrow2 = in + inwidth * (int)((i + 0.75) * inheight / outheight);
-		frac = fracstep >> 1;
-		for (j = 0; j < outwidth; j++) {
-			pix1 = (byte *) inrow + p1[j];
-			pix2 = (byte *) inrow + p2[j];
-			pix3 = (byte *) inrow2 + p1[j];
-			pix4 = (byte *) inrow2 + p2[j];
-			((byte *) (out + j))[0] = (pix1[0] + pix2[0] + pix3[0] + pix4[0]) >> 2;
-			((byte *) (out + j))[1] = (pix1[1] + pix2[1] + pix3[1] + pix4[1]) >> 2;
-			((byte *) (out + j))[2] = (pix1[2] + pix2[2] + pix3[2] + pix4[2]) >> 2;
-			((byte *) (out + j))[3] = (pix1[3] + pix2[3] + pix3[3] + pix4[3]) >> 2;
+
+		switch (image_kernel) {
+#if idavx2
+		case IMAGE_KERNEL_AVX2:
+			GL_ResampleRow_AVX2(inrow, inrow2, p1, p2, out, outwidth);
+			break;
+#endif
+#if idsse2
+		case IMAGE_KERNEL_SSE2:
+			GL_ResampleRow_SSE2(inrow, inrow2, p1, p2, out, outwidth);
+			break;
+#endif
+		default:
+			GL_ResampleRow_C(inrow, inrow2, p1, p2, out, outwidth);
+			break;
 		}
 	}
+
+	if (p1 != stack1)
+		free(p1);
 }
 
 /*
- * ================ GL_LightScaleTexture ================
- * Scale up the pixel values in a texture to increase the lighting range
+ * ================ GL_LightScale_C ================
  */
-void GL_LightScaleTexture(unsigned *in, int inwidth, int inheight, qboolean only_gamma) {
-	if (only_gamma) {
-		double i, c;
-		byte *p;
-
-		p = (byte *) in;
+static void GL_LightScale_C(byte *p, int count, qboolean only_gamma) {
+	int i;
 
-		c = inwidth * inheight;
-		for (i = 0; i < c; i++, p += 4) {
+	if (only_gamma) {
+		for (i = 0; i < count; i++, p += 4) {
 			p[0] = gammatable[p[0]];
 			p[1] = gammatable[p[1]];
 			p[2] = gammatable[p[2]];
 		}
 	} else {
-		double i, c;
-		byte *p;
-
-		p = (byte *) in;
-
-		c = inwidth * inheight;
-		for (i = 0; i < c; i++, p += 4) {
+		for (i = 0; i < count; i++, p += 4) {
 			p[0] = gammatable[intensitytable[p[0]]];
 			p[1] = gammatable[intensitytable[p[1]]];
 			p[2] = gammatable[intensitytable[p[2]]];
@@ -1297,26 +1623,79 @@ void GL_LightScaleTexture(unsigned *in, int inwidth, int inheight, qboolean only
 }
 
 /*
- * ================ GL_MipMap ================
- * Operates in place, quartering the size of the texture
+ * ================ GL_LightScale_Words ================
+ * Looks up whole little endian texels in the word tables instead of single
+ * bytes.  Plain C: SSE2 has no byte shuffle or gather to vectorize it with,
+ * so the SSE2 level uses it as is, and the AVX2 kernel for its tail.
  */
-void GL_MipMap(byte * in, int width, int height) {
-	int i, j;
-	byte *out;
-
-	width <<= 2;
-	height >>= 1;
-	out = in;
-	for (i = 0; i < height; i++, in += width) {
-		for (j = 0; j < width; j += 8, out += 4, in += 8) {
-			out[0] = (in[0] + in[4] + in[width + 0] + in[width + 4]) >> 2;
-			out[1] = (in[1] + in[5] + in[width + 1] + in[width + 5]) >> 2;
-			out[2] = (in[2] + in[6] + in[width + 2] + in[width + 6]) >> 2;
-			out[3] = (in[3] + in[7] + in[width + 3] + in[width + 7]) >> 2;
+static void GL_LightScale_Words(unsigned *data, int count, qboolean only_gamma) {
+	const unsigned (*t)[256] = lightscale_tables[only_gamma ? 1 : 0];
+	unsigned c;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		c = data[i];
+		data[i] = t[0][c & 255] | t[1][(c >> 8) & 255] | t[2][(c >> 16) & 255] | (c & 0xff000000);
+	}
+}
+
+/*
+ * ================ GL_BuildLightScaleTables ================
+ */
+static void GL_BuildLightScaleTables(void) {
+	int i, k;
+
+	for (i = 0; i < 256; i++) {
+		for (k = 0; k < 3; k++) {
+			lightscale_tables[1][k][i] = (unsigned)gammatable[i] << (k * 8);
+			lightscale_tables[0][k][i] = (unsigned)gammatable[intensitytable[i]] << (k * 8);
 		}
 	}
 }
 
+#if idavx2
+static AVX2_FUNC void GL_LightScale_AVX2(unsigned *data, int count, qboolean only_gamma) {
+	const unsigned (*t)[256] = lightscale_tables[only_gamma ? 1 : 0];
+	__m256i mask = _mm256_set1_epi32(255);
+	__m256i amask = _mm256_set1_epi32((int)0xff000000);
+	__m256i c, r, g, b;
+	int i;
+
+	for (i = 0; i + 8 <= count; i += 8) {
+		c = _mm256_loadu_si256((const __m256i *)(data + i));
+		r = _mm256_i32gather_epi32((const int *)t[0], _mm256_and_si256(c, mask), 4);
+		g = _mm256_i32gather_epi32((const int *)t[1], _mm256_and_si256(_mm256_srli_epi32(c, 8), mask), 4);
+		b = _mm256_i32gather_epi32((const int *)t[2], _mm256_and_si256(_mm256_srli_epi32(c, 16), mask), 4);
+		_mm256_storeu_si256((__m256i *)(data + i),
+		                    _mm256_or_si256(_mm256_or_si256(r, g), _mm256_or_si256(b, _mm256_and_si256(c, amask))));
+	}
+
+	GL_LightScale_Words(data + i, count - i, only_gamma);
+}
+#endif
+
+/*
+ * ================ GL_LightScaleTexture ================
+ * Scale up the pixel values in a texture to increase the lighting range
+ */
+void GL_LightScaleTexture(unsigned *in, int inwidth, int inheight, qboolean only_gamma) {
+	switch (image_kernel) {
+#if idavx2
+	case IMAGE_KERNEL_AVX2:
+		GL_LightScale_AVX2(in, inwidth * inheight, only_gamma);
+		break;
+#endif
+#if idsse2
+	case IMAGE_KERNEL_SSE2:
+		GL_LightScale_Words(in, inwidth * inheight, only_gamma);
+		break;
+#endif
+	default:
+		GL_LightScale_C((byte *)in, inwidth * inheight, only_gamma);
+		break;
+	}
+}
+
 /*
  * =============== GL_Upload32 ===============
  * Returns has_alpha
@@ -1365,100 +1744,384 @@ int nearest_power_of_2(int size) {
 }
 
 extern cvar_t *gl_lightmap_texture_saturation;						/* jitsaturation */
-void desaturate_texture(unsigned *udata, int width, int height) {	/* jitsaturation */
-	int i, size;
-	float r, g, b, v, s;
-	unsigned char *data;
-
-	data = (unsigned char *)udata;
-
-	s = gl_lightmap_texture_saturation->value;
-
-	size = width * height * 4;
-
-	for (i = 0; i < size; i += 4) {
-		r = data[i];
-		g = data[i + 1];
-		b = data[i + 2];
-		v = r * 0.30 + g * 0.59 + b * 0.11;
-
-		data[i] = (1 - s) * v + s * r;
-		data[i + 1] = (1 - s) * v + s * g;
-		data[i + 2] = (1 - s) * v + s * b;
-	}
-}
 
 /*
- * =============== GL_Upload32 ===============
- * Returns has_alpha
+ * ================ GL_Desaturate_C ================
+ * Blends toward the luminance by s, in float so the SIMD levels match
  */
-qboolean GL_Upload32(unsigned *data, int width, int height, qboolean mipmap) {
-	int samples;
-	unsigned *scaled;
-	int scaled_width = 0, scaled_height = 0;
-	int i, c;
-	byte *scan;
-	int comp = 0;
-
-	uploaded_paletted = false;
-
-	/* don't ever bother with maxtexsize textures */
-	if (qglColorTableEXT && gl_ext_palettedtexture->value) {
-		/* palettedtexture is limited to 256 */
-		clamp(scaled_width, 1, 256);
-		clamp(scaled_height, 1, 256);
-	} else {
-		clamp(scaled_width, 1, gl_state.maxtexsize);
-		clamp(scaled_height, 1, gl_state.maxtexsize);
-	}
-
-	/* scan the texture for any non-255 alpha */
-	c = width * height;
-	scan = ((byte *) data) + 3;
-	samples = gl_solid_format;
-	for (i = 0; i < c; i++, scan += 4) {
-		if (*scan != 255) {
-			samples = gl_alpha_format;
-			break;
+static void GL_Desaturate_C(byte *data, int count, float s) {
+	float r, g, b, v, c[3];
+	int i, k;
+
+	for (i = 0; i < count; i++, data += 4) {
+		r = data[0];
+		g = data[1];
+		b = data[2];
+		v = r * 0.30f + g * 0.59f + b * 0.11f;
+
+		c[0] = (1 - s) * v + s * r;
+		c[1] = (1 - s) * v + s * g;
+		c[2] = (1 - s) * v + s * b;
+		for (k = 0; k < 3; k++) {
+			if (c[k] < 0)
+				c[k] = 0;
+			if (c[k] > 255)
+				c[k] = 255;
+			data[k] = (byte)c[k];
 		}
 	}
+}
 
-	/* Heffo - ARB Texture Compression */
-	qglHint(GL_TEXTURE_COMPRESSION_HINT_ARB, GL_NICEST);
-	if (samples == gl_solid_format)
-		comp = (gl_state.texture_compression) ? GL_COMPRESSED_RGB_ARB : gl_tex_solid_format;
-	else if (samples == gl_alpha_format)
-		comp = (gl_state.texture_compression) ? GL_COMPRESSED_RGBA_ARB : gl_tex_alpha_format;
+#if idsse2
+static void GL_Desaturate_SSE2(unsigned *data, int count, float s) {
+	__m128i mask = _mm_set1_epi32(255);
+	__m128i amask = _mm_set1_epi32((int)0xff000000);
+	__m128 wr = _mm_set1_ps(0.30f), wg = _mm_set1_ps(0.59f), wb = _mm_set1_ps(0.11f);
+	__m128 vs = _mm_set1_ps(s), vis = _mm_set1_ps(1 - s);
+	__m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255);
+	__m128 r, g, b, v;
+	__m128i c, nr, ng, nb;
+	int i;
 
+	for (i = 0; i + 4 <= count; i += 4) {
+		c = _mm_loadu_si128((const __m128i *)(data + i));
+		r = _mm_cvtepi32_ps(_mm_and_si128(c, mask));
+		g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 8), mask));
+		b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(c, 16), mask));
+		v = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, wr), _mm_mul_ps(g, wg)), _mm_mul_ps(b, wb));
+		v = _mm_mul_ps(vis, v);
 
-	/* find sizes to scale to */
-	{
-		int max_size;
+		nr = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(v, _mm_mul_ps(vs, r)), lo), hi));
+		ng = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(v, _mm_mul_ps(vs, g)), lo), hi));
+		nb = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_add_ps(v, _mm_mul_ps(vs, b)), lo), hi));
+		_mm_storeu_si128((__m128i *)(data + i),
+		                 _mm_or_si128(_mm_or_si128(nr, _mm_slli_epi32(ng, 8)),
+		                              _mm_or_si128(_mm_slli_epi32(nb, 16), _mm_and_si128(c, amask))));
+	}
+
+	GL_Desaturate_C((byte *)(data + i), count - i, s);
+}
+#endif
 
-		qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
-		scaled_width = nearest_power_of_2(width);
-		scaled_height = nearest_power_of_2(height);
+#if idavx2
+static AVX2_FUNC void GL_Desaturate_AVX2(unsigned *data, int count, float s) {
+	__m256i mask = _mm256_set1_epi32(255);
+	__m256i amask = _mm256_set1_epi32((int)0xff000000);
+	__m256 wr = _mm256_set1_ps(0.30f), wg = _mm256_set1_ps(0.59f), wb = _mm256_set1_ps(0.11f);
+	__m256 vs = _mm256_set1_ps(s), vis = _mm256_set1_ps(1 - s);
+	__m256 lo = _mm256_setzero_ps(), hi = _mm256_set1_ps(255);
+	__m256 r, g, b, v;
+	__m256i c, nr, ng, nb;
+	int i;
 
-		if (scaled_width > max_size)
-			scaled_width = max_size;
-		if (scaled_height > max_size)
-			scaled_height = max_size;
+	for (i = 0; i + 8 <= count; i += 8) {
+		c = _mm256_loadu_si256((const __m256i *)(data + i));
+		r = _mm256_cvtepi32_ps(_mm256_and_si256(c, mask));
+		g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 8), mask));
+		b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 16), mask));
+		v = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(r, wr), _mm256_mul_ps(g, wg)), _mm256_mul_ps(b, wb));
+		v = _mm256_mul_ps(vis, v);
 
-		if (scaled_width < 2)
-			scaled_width = 2;
-		if (scaled_height < 2)
-			scaled_height = 2;
+		nr = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(v, _mm256_mul_ps(vs, r)), lo), hi));
+		ng = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(v, _mm256_mul_ps(vs, g)), lo), hi));
+		nb = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_add_ps(v, _mm256_mul_ps(vs, b)), lo), hi));
+		_mm256_storeu_si256((__m256i *)(data + i),
+		                    _mm256_or_si256(_mm256_or_si256(nr, _mm256_slli_epi32(ng, 8)),
+		                                    _mm256_or_si256(_mm256_slli_epi32(nb, 16), _mm256_and_si256(c, amask))));
 	}
 
-	/* let people sample down the world textures for speed */
-	if (mipmap && (int)gl_picmip->value > 0) {
-		int maxsize;
+	GL_Desaturate_C((byte *)(data + i), count - i, s);
+}
+#endif
 
-		if ((int)gl_picmip->value == 1)
-			/* clamp to 512x512 */
-			maxsize = 512;
-		else if ((int)gl_picmip->value == 2)
-			/* clamp to 256x256 */
+/*
+ * ================ GL_Desaturate ================
+ */
+static void GL_Desaturate(unsigned *data, int count, float s) {
+	switch (image_kernel) {
+#if idavx2
+	case IMAGE_KERNEL_AVX2:
+		GL_Desaturate_AVX2(data, count, s);
+		break;
+#endif
+#if idsse2
+	case IMAGE_KERNEL_SSE2:
+		GL_Desaturate_SSE2(data, count, s);
+		break;
+#endif
+	default:
+		GL_Desaturate_C((byte *)data, count, s);
+		break;
+	}
+}
+
+void desaturate_texture(unsigned *udata, int width, int height) {	/* jitsaturation */
+	GL_Desaturate(udata, width * height, gl_lightmap_texture_saturation->value);
+}
+
+/*
+ * ================ GL_HalveRow_C ================
+ * Box filters two source rows into one row of outwidth texels
+ */
+static void GL_HalveRow_C(const byte *row0, const byte *row1, byte *out, int outwidth) {
+	int j, k;
+
+	for (j = 0; j < outwidth; j++, row0 += 8, row1 += 8, out += 4)
+		for (k = 0; k < 4; k++)
+			out[k] = (row0[k] + row0[k + 4] + row1[k] + row1[k + 4]) >> 2;
+}
+
+#if idsse2
+/*
+ * Adding the rows in 16 bits leaves neighbouring texels in the two halves
+ * of each register, so the horizontal pair is a 64 bit unpack and an add
+ */
+static void GL_HalveRow_SSE2(const byte *row0, const byte *row1, byte *out, int outwidth) {
+	__m128i zero = _mm_setzero_si128();
+	__m128i a0, a1, b0, b1, s0, s1, s2, s3, o0, o1;
+	int j;
+
+	for (j = 0; j + 4 <= outwidth; j += 4, row0 += 32, row1 += 32, out += 16) {
+		a0 = _mm_loadu_si128((const __m128i *)row0);
+		a1 = _mm_loadu_si128((const __m128i *)(row0 + 16));
+		b0 = _mm_loadu_si128((const __m128i *)row1);
+		b1 = _mm_loadu_si128((const __m128i *)(row1 + 16));
+		s0 = _mm_add_epi16(_mm_unpacklo_epi8(a0, zero), _mm_unpacklo_epi8(b0, zero));
+		s1 = _mm_add_epi16(_mm_unpackhi_epi8(a0, zero), _mm_unpackhi_epi8(b0, zero));
+		s2 = _mm_add_epi16(_mm_unpacklo_epi8(a1, zero), _mm_unpacklo_epi8(b1, zero));
+		s3 = _mm_add_epi16(_mm_unpackhi_epi8(a1, zero), _mm_unpackhi_epi8(b1, zero));
+		o0 = _mm_add_epi16(_mm_unpacklo_epi64(s0, s1), _mm_unpackhi_epi64(s0, s1));
+		o1 = _mm_add_epi16(_mm_unpacklo_epi64(s2, s3), _mm_unpackhi_epi64(s2, s3));
+		_mm_storeu_si128((__m128i *)out, _mm_packus_epi16(_mm_srli_epi16(o0, 2), _mm_srli_epi16(o1, 2)));
+	}
+
+	GL_HalveRow_C(row0, row1, out, outwidth - j);
+}
+#endif
+
+#if idavx2
+static AVX2_FUNC void GL_HalveRow_AVX2(const byte *row0, const byte *row1, byte *out, int outwidth) {
+	__m256i zero = _mm256_setzero_si256();
+	__m256i a0, a1, b0, b1, s0, s1, s2, s3, o0, o1;
+	int j;
+
+	for (j = 0; j + 8 <= outwidth; j += 8, row0 += 64, row1 += 64, out += 32) {
+		a0 = _mm256_loadu_si256((const __m256i *)row0);
+		a1 = _mm256_loadu_si256((const __m256i *)(row0 + 32));
+		b0 = _mm256_loadu_si256((const __m256i *)row1);
+		b1 = _mm256_loadu_si256((const __m256i *)(row1 + 32));
+		s0 = _mm256_add_epi16(_mm256_unpacklo_epi8(a0, zero), _mm256_unpacklo_epi8(b0, zero));
+		s1 = _mm256_add_epi16(_mm256_unpackhi_epi8(a0, zero), _mm256_unpackhi_epi8(b0, zero));
+		s2 = _mm256_add_epi16(_mm256_unpacklo_epi8(a1, zero), _mm256_unpacklo_epi8(b1, zero));
+		s3 = _mm256_add_epi16(_mm256_unpackhi_epi8(a1, zero), _mm256_unpackhi_epi8(b1, zero));
+		o0 = _mm256_add_epi16(_mm256_unpacklo_epi64(s0, s1), _mm256_unpackhi_epi64(s0, s1));
+		o1 = _mm256_add_epi16(_mm256_unpacklo_epi64(s2, s3), _mm256_unpackhi_epi64(s2, s3));
+		/* lanes come out as texels 0-1 4-5 | 2-3 6-7 */
+		_mm256_storeu_si256((__m256i *)out,
+		                    _mm256_permute4x64_epi64(_mm256_packus_epi16(_mm256_srli_epi16(o0, 2),
+		                                                                 _mm256_srli_epi16(o1, 2)),
+		                                             _MM_SHUFFLE(3, 1, 2, 0)));
+	}
+
+	GL_HalveRow_C(row0, row1, out, outwidth - j);
+}
+#endif
+
+/*
+ * =============== GL_HalveTexture ===============
+ * Next level of a mip chain.  Copes with levels that are only one texel
+ * wide or high.  out may be in, every texel is written at or before the
+ * ones it was averaged from.
+ */
+static void GL_HalveTexture(byte *in, int width, int height, byte *out) {
+	int i, j, k, outwidth, outheight, dx, dy;
+	byte *p;
+
+	outwidth = width > 1 ? width >> 1 : 1;
+	outheight = height > 1 ? height >> 1 : 1;
+	dx = width > 1 ? 4 : 0;
+	dy = height > 1 ? width * 4 : 0;
+
+	for (i = 0; i < outheight; i++) {
+		p = in + i * (dy << 1);
+		if (dx && dy) {
+			switch (image_kernel) {
+#if idavx2
+			case IMAGE_KERNEL_AVX2:
+				GL_HalveRow_AVX2(p, p + dy, out, outwidth);
+				break;
+#endif
+#if idsse2
+			case IMAGE_KERNEL_SSE2:
+				GL_HalveRow_SSE2(p, p + dy, out, outwidth);
+				break;
+#endif
+			default:
+				GL_HalveRow_C(p, p + dy, out, outwidth);
+				break;
+			}
+			out += outwidth * 4;
+			continue;
+		}
+		for (j = 0; j < outwidth; j++, out += 4, p += dx << 1)
+			for (k = 0; k < 4; k++)
+				out[k] = (p[k] + p[k + dx + dy]) >> 1;
+	}
+}
+
+/*
+ * ================ GL_MipMap ================
+ * Operates in place, quartering the size of the texture
+ */
+void GL_MipMap(byte * in, int width, int height) {
+	GL_HalveTexture(in, width, height, in);
+}
+
+/*
+ * ================ GL_ImageBenchRun ================
+ */
+static void GL_ImageBenchRun(int op, unsigned *src, unsigned *dst, int size) {
+	switch (op) {
+	case 0:	/* non power of two replacement up to size */
+		GL_ResampleTexture(src, size * 3 / 4, size * 3 / 4, dst, size, size);
+		break;
+	case 1:
+		GL_HalveTexture((byte *)src, size, size, (byte *)dst);
+		break;
+	case 2:
+		GL_LightScaleTexture(dst, size, size, false);
+		break;
+	case 3:
+		GL_Desaturate(dst, size * size, 0.5f);
+		break;
+	}
+}
+
+/*
+ * ================ GL_ImageBench_f ================
+ * Times every kernel level on square textures and checks the results
+ * against the C reference
+ */
+void GL_ImageBench_f(void) {
+	static const int sizes[] = {256, 1024, 2048, 4096};
+	static const char *ops[] = {"resample", "mipmap", "lightscale", "desaturate"};
+	unsigned *src, *dst, *ref, seed;
+	int i, k, n, op, rep, reps, size, saved, len;
+	double msec[IMAGE_KERNEL_AVX2 + 1];
+	long long start;
+	char line[256];
+
+	saved = image_kernel;
+	ri.Con_Printf(PRINT_ALL, "imagebench: msec per call, C up to %s\n", image_kernel_names[image_best_kernel]);
+
+	for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		size = sizes[i];
+		n = size * size;
+		src = malloc(n * 4);
+		dst = malloc(n * 4);
+		ref = malloc(n * 4);
+		if (!src || !dst || !ref) {
+			ri.Con_Printf(PRINT_ALL, "imagebench: out of memory at %dx%d\n", size, size);
+			free(src);
+			free(dst);
+			free(ref);
+			break;
+		}
+
+		for (k = 0, seed = 0x12345678; k < n; k++) {
+			seed = seed * 1664525 + 1013904223;
+			src[k] = seed;
+		}
+		reps = n < (1 << 22) ? (1 << 22) / n : 1;
+
+		for (op = 0; op < sizeof(ops) / sizeof(ops[0]); op++) {
+			Com_sprintf(line, sizeof(line), "%4d %-10s", size, ops[op]);
+
+			for (k = IMAGE_KERNEL_C; k <= image_best_kernel; k++) {
+				image_kernel = k;
+
+				/* check against the C result first */
+				memcpy(dst, src, n * 4);
+				GL_ImageBenchRun(op, src, dst, size);
+				if (k == IMAGE_KERNEL_C)
+					memcpy(ref, dst, n * 4);
+				else if (memcmp(ref, dst, n * 4))
+					ri.Con_Printf(PRINT_ALL, "imagebench: %s %s differs from C at %dx%d\n",
+					              ops[op], image_kernel_names[k], size, size);
+
+				start = Sys_Microseconds();
+				for (rep = 0; rep < reps; rep++)
+					GL_ImageBenchRun(op, src, dst, size);
+				msec[k] = (Sys_Microseconds() - start) / (1000.0 * reps);
+
+				len = strlen(line);
+				if (k == IMAGE_KERNEL_C)
+					Com_sprintf(line + len, sizeof(line) - len, "  %s %.3f",
+					            image_kernel_names[k], msec[k]);
+				else
+					Com_sprintf(line + len, sizeof(line) - len, "  %s %.3f (x%.1f)",
+					            image_kernel_names[k], msec[k],
+					            msec[k] > 0 ? msec[IMAGE_KERNEL_C] / msec[k] : 0);
+			}
+			ri.Con_Printf(PRINT_ALL, "%s\n", line);
+		}
+
+		free(src);
+		free(dst);
+		free(ref);
+	}
+
+	image_kernel = saved;
+}
+
+/*
+ * =============== GL_PrepareUpload32 ===============
+ * Everything GL_Upload32 does before talking to GL: picks the upload size,
+ * resamples, desaturates and light scales, and optionally builds the mip
+ * chain.  Doesn't touch GL or change any state, so the image workers can
+ * run it.  up->maxsize, picmip, lightscale and buildmips are set by the
+ * caller.
+ */
+static void GL_PrepareUpload32(unsigned *data, int width, int height, qboolean mipmap, imageupload_t *up) {
+	unsigned *scaled;
+	int scaled_width, scaled_height;
+	int i, c, size, w, h;
+	byte *scan;
+
+	/* scan the texture for any non-255 alpha */
+	c = width * height;
+	scan = ((byte *) data) + 3;
+	up->samples = gl_solid_format;
+	for (i = 0; i < c; i++, scan += 4) {
+		if (*scan != 255) {
+			up->samples = gl_alpha_format;
+			break;
+		}
+	}
+
+	/* find sizes to scale to */
+	scaled_width = nearest_power_of_2(width);
+	scaled_height = nearest_power_of_2(height);
+
+	if (scaled_width > up->maxsize)
+		scaled_width = up->maxsize;
+	if (scaled_height > up->maxsize)
+		scaled_height = up->maxsize;
+
+	if (scaled_width < 2)
+		scaled_width = 2;
+	if (scaled_height < 2)
+		scaled_height = 2;
+
+	/* let people sample down the world textures for speed */
+	if (mipmap && up->picmip > 0) {
+		int maxsize;
+
+		if (up->picmip == 1)
+			/* clamp to 512x512 */
+			maxsize = 512;
+		else if (up->picmip == 2)
+			/* clamp to 256x256 */
 			maxsize = 256;
 		else
 			/* clamp to 128x128 */
@@ -1471,50 +2134,107 @@ qboolean GL_Upload32(unsigned *data, int width, int height, qboolean mipmap) {
 			scaled_height >>= 1;
 		}
 	}
-	if (scaled_width != width || scaled_height != height) {
-		scaled = malloc((scaled_width * scaled_height) * 4);
-		GL_ResampleTexture(data, width, height, scaled, scaled_width, scaled_height);
+
+	/* room for the whole chain when it's built here */
+	size = scaled_width * scaled_height;
+	up->numlevels = 1;
+	if (mipmap && up->buildmips) {
+		for (w = scaled_width, h = scaled_height; w > 1 || h > 1; up->numlevels++) {
+			w = w > 1 ? w >> 1 : 1;
+			h = h > 1 ? h >> 1 : 1;
+			size += w * h;
+		}
+	}
+
+	if (scaled_width != width || scaled_height != height || up->numlevels > 1) {
+		scaled = malloc(size * 4);
+		if (scaled_width != width || scaled_height != height)
+			GL_ResampleTexture(data, width, height, scaled, scaled_width, scaled_height);
+		else
+			memcpy(scaled, data, width * height * 4);
+		up->freedata = true;
 	} else {
-		scaled_width = width;
-		scaled_height = height;
 		scaled = data;
+		up->freedata = false;
 	}
 
 	if (gl_lightmap_texture_saturation->value < 1)	/* jitsaturation */
 		desaturate_texture(scaled, scaled_width, scaled_height);
 
-	if (mipmap) {
-		if (!gl_state.hwgamma)
-			if (brightenTexture)
-				GL_LightScaleTexture(scaled, scaled_width, scaled_height, !mipmap);
+	if (up->lightscale)
+		GL_LightScaleTexture(scaled, scaled_width, scaled_height, !mipmap);
+
+	/* each level is a box filter of the one before */
+	if (up->numlevels > 1) {
+		byte *level = (byte *)scaled;
+
+		for (w = scaled_width, h = scaled_height; w > 1 || h > 1;) {
+			GL_HalveTexture(level, w, h, level + w * h * 4);
+			level += w * h * 4;
+			w = w > 1 ? w >> 1 : 1;
+			h = h > 1 ? h >> 1 : 1;
+		}
+	}
+
+	up->data = scaled;
+	up->width = scaled_width;
+	up->height = scaled_height;
+	up->mipmap = mipmap;
+}
+
+/*
+ * =============== GL_FinishUpload32 ===============
+ * Uploads a prepared image to the bound texture and frees the scaled copy
+ * Returns has_alpha
+ */
+static qboolean GL_FinishUpload32(imageupload_t *up) {
+	int comp = 0;
+	int i, w, h;
+	byte *level;
+
+	uploaded_paletted = false;
 
+	/* Heffo - ARB Texture Compression */
+	qglHint(GL_TEXTURE_COMPRESSION_HINT_ARB, GL_NICEST);
+	if (up->samples == gl_solid_format)
+		comp = (gl_state.texture_compression) ? GL_COMPRESSED_RGB_ARB : gl_tex_solid_format;
+	else if (up->samples == gl_alpha_format)
+		comp = (gl_state.texture_compression) ? GL_COMPRESSED_RGBA_ARB : gl_tex_alpha_format;
+
+	if (up->mipmap && up->numlevels > 1) {
+		level = (byte *)up->data;
+		for (i = 0, w = up->width, h = up->height; i < up->numlevels; i++) {
+			qglTexImage2D(GL_TEXTURE_2D, i, comp, w, h, 0,
+			              GL_RGBA, GL_UNSIGNED_BYTE, level);
+			level += w * h * 4;
+			w = w > 1 ? w >> 1 : 1;
+			h = h > 1 ? h >> 1 : 1;
+		}
+	} else if (up->mipmap) {
 		if (gl_state.sgis_mipmap) {
 			qglTexParameteri(GL_TEXTURE_2D, GL_GENERATE_MIPMAP_SGIS, true);
-			qglTexImage2D(GL_TEXTURE_2D, 0, comp, scaled_width, scaled_height, 0, 
-			              GL_RGBA, GL_UNSIGNED_BYTE, scaled);
+			qglTexImage2D(GL_TEXTURE_2D, 0, comp, up->width, up->height, 0, 
+			              GL_RGBA, GL_UNSIGNED_BYTE, up->data);
 		} else
-			gluBuild2DMipmaps(GL_TEXTURE_2D, samples, scaled_width, scaled_height, 
-			                  GL_RGBA, GL_UNSIGNED_BYTE, scaled);
+			gluBuild2DMipmaps(GL_TEXTURE_2D, up->samples, up->width, up->height, 
+			                  GL_RGBA, GL_UNSIGNED_BYTE, up->data);
 	} else {
-		if (!gl_state.hwgamma)
-			if (brightenTexture)
-				GL_LightScaleTexture(scaled, scaled_width, scaled_height, !mipmap);
-		qglTexImage2D(GL_TEXTURE_2D, 0, comp, scaled_width, scaled_height, 0, 
-		              GL_RGBA, GL_UNSIGNED_BYTE, scaled);
+		qglTexImage2D(GL_TEXTURE_2D, 0, comp, up->width, up->height, 0, 
+		              GL_RGBA, GL_UNSIGNED_BYTE, up->data);
 	}
 
-	if (scaled_width != width || scaled_height != height)
-		free(scaled);
+	if (up->freedata)
+		free(up->data);
+	up->data = NULL;
 
+	upload_width = up->width;
+	upload_height = up->height;
 
-	upload_width = scaled_width;
-	upload_height = scaled_height;
-
-	qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (mipmap) ? gl_filter_min : gl_filter_max);
+	qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, (up->mipmap) ? gl_filter_min : gl_filter_max);
 	qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
 
 
-	if (mipmap) {
+	if (up->mipmap) {
 
 		/* Set anisotropic filter if supported and enabled Knightmare */
 		if (gl_config.anisotropic && gl_anisotropic->value)
@@ -1523,7 +2243,23 @@ qboolean GL_Upload32(unsigned *data, int width, int height, qboolean mipmap) {
 			qglTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, gl_filter_max);
 
 	}
-	return (samples == gl_alpha_format);
+	return (up->samples == gl_alpha_format);
+}
+
+/*
+ * =============== GL_Upload32 ===============
+ * Returns has_alpha
+ */
+qboolean GL_Upload32(unsigned *data, int width, int height, qboolean mipmap) {
+	imageupload_t up;
+
+	qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &up.maxsize);
+	up.picmip = (int)gl_picmip->value;
+	up.lightscale = !gl_state.hwgamma && brightenTexture;
+	up.buildmips = false;
+
+	GL_PrepareUpload32(data, width, height, mipmap, &up);
+	return GL_FinishUpload32(&up);
 }
 
 
@@ -1585,12 +2321,66 @@ qboolean GL_Upload8(byte * data, int width, int height, qboolean mipmap, qboolea
 }
 
 /*
- * ================ GL_LoadPic ================
- * This is also used as an entry point for the generated r_notexture
+ * ================ R_ProbeFailed ================
  */
-image_t * GL_LoadPic(char *name, byte * pic, int width, int height, imagetype_t type, int bits) {
+qboolean R_ProbeFailed(char *name) {
+	failedprobe_t *probe;
+
+	for (probe = failed_probe_hash[Com_HashKey(name, FAILED_PROBE_HASH)]; probe; probe = probe->hash_next)
+		if (!strcmp(probe->name, name))
+			return true;
+	return false;
+}
+
+/*
+ * ================ R_MarkProbeFailed ================
+ */
+void R_MarkProbeFailed(char *name) {
+	failedprobe_t *probe;
+	unsigned hash;
+
+	if (num_failed_probes == MAX_FAILED_PROBES || strlen(name) >= MAX_QPATH || R_ProbeFailed(name))
+		return;
+
+	hash = Com_HashKey(name, FAILED_PROBE_HASH);
+	probe = &failed_probes[num_failed_probes++];
+	Q_strncpyz(probe->name, name, sizeof(probe->name));
+	probe->hash_next = failed_probe_hash[hash];
+	failed_probe_hash[hash] = probe;
+}
+
+/*
+ * ================ R_ClearFailedProbes ================
+ */
+void R_ClearFailedProbes(void) {
+	num_failed_probes = 0;
+	memset(failed_probe_hash, 0, sizeof(failed_probe_hash));
+}
+
+/*
+ * ================ GL_UnlinkImage ================
+ */
+static void GL_UnlinkImage(image_t *image) {
+	image_t **link;
+
+	for (link = &image_hash[Com_HashKey(image->name, IMAGE_HASH_SIZE)]; *link; link = &(*link)->hash_next) {
+		if (*link == image) {
+			*link = image->hash_next;
+			break;
+		}
+	}
+	image->hash_next = NULL;
+}
+
+/*
+ * ================ GL_CreateImage ================
+ * Takes either an 8 or 32 bit pic, or an image the workers already prepared
+ */
+static image_t * GL_CreateImage(char *name, byte * pic, int width, int height, imagetype_t type, int bits,
+    imageupload_t *prepared) {
 	image_t *image;
 	int i;
+	unsigned hash;
 #ifdef RETEX
 	/* NiceAss: Nexus'added vars for texture scaling */
 	miptex_t *mt;
@@ -1615,6 +2405,10 @@ image_t * GL_LoadPic(char *name, byte * pic, int width, int height, imagetype_t
 	Q_strncpyz(image->name, name, sizeof(image->name));
 	image->registration_sequence = registration_sequence;
 
+	hash = Com_HashKey(image->name, IMAGE_HASH_SIZE);
+	image->hash_next = image_hash[hash];
+	image_hash[hash] = image;
+
 	image->width = width;
 	image->height = height;
 	image->type = type;
@@ -1664,7 +2458,8 @@ image_t * GL_LoadPic(char *name, byte * pic, int width, int height, imagetype_t
 		R_FloodFillSkin(pic, width, height);
 
 	/* load little pics into the scrap */
-	if (image->type == it_pic && bits == 8 && image->width < 64 && image->height < 64) {
+	if (image->type == it_pic && bits == 8 && !scrap_skip &&
+	    image->width < SCRAP_MAXPIC && image->height < SCRAP_MAXPIC) {
 		int x, y;
 		int i, j, k;
 		int texnum;
@@ -1684,14 +2479,16 @@ image_t * GL_LoadPic(char *name, byte * pic, int width, int height, imagetype_t
 		image->has_alpha = true;
 		image->sl = (x + 0.01) / (float)BLOCK_WIDTH;
 		image->sh = (x + image->width - 0.01) / (float)BLOCK_WIDTH;
-		image->tl = (y + 0.01) / (float)BLOCK_WIDTH;
-		image->th = (y + image->height - 0.01) / (float)BLOCK_WIDTH;
+		image->tl = (y + 0.01) / (float)BLOCK_HEIGHT;
+		image->th = (y + image->height - 0.01) / (float)BLOCK_HEIGHT;
 	} else {
 nonscrap:
 		image->scrap = false;
 		image->texnum = TEXNUM_IMAGES + (image - gltextures);
 		GL_Bind(image->texnum);
-		if (bits == 8)
+		if (prepared)
+			image->has_alpha = GL_FinishUpload32(prepared);
+		else if (bits == 8)
 			image->has_alpha =
 			    GL_Upload8(pic, width, height, (image->type != it_pic && image->type != it_sky),
 			    image->type == it_sky);
@@ -1711,6 +2508,14 @@ nonscrap:
 	return image;
 }
 
+/*
+ * ================ GL_LoadPic ================
+ * This is also used as an entry point for the generated r_notexture
+ */
+image_t * GL_LoadPic(char *name, byte * pic, int width, int height, imagetype_t type, int bits) {
+	return GL_CreateImage(name, pic, width, height, type, bits, NULL);
+}
+
 /* ================ GL_LoadWal ================ */
 image_t * GL_LoadWal(char *name) {
 	miptex_t *mt;
@@ -1745,8 +2550,520 @@ char *image_types[IMAGETYPES] = {
 	".jpg"
 };
 
+/*
+ * =====================================================================
+ * IMAGE WORKERS
+ * =====================================================================
+ */
+
+/*
+ * ================ GL_ImageChecksum ================
+ * FNV-1a, only has to notice that a replacement file changed
+ */
+static unsigned GL_ImageChecksum(byte *data, int len) {
+	unsigned hash = 2166136261u;
+	int i;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ data[i]) * 16777619u;
+	return hash;
+}
+
+/*
+ * ================ GL_LightTablesKey ================
+ * Cache key for the gamma and intensity tables GL_LightScaleTexture uses
+ */
+static unsigned GL_LightTablesKey(void) {
+	return GL_ImageChecksum(gammatable, sizeof(gammatable))
+	    ^ (GL_ImageChecksum(intensitytable, sizeof(intensitytable)) * 31);
+}
+
+/*
+ * ================ GL_TexCacheKey ================
+ */
+static void GL_TexCacheKey(imagejob_t *job, unsigned checksum, texcacheheader_t *h) {
+	memset(h, 0, sizeof(*h));
+	h->ident = TEXCACHE_IDENT;
+	h->version = TEXCACHE_VERSION;
+	Q_strncpyz(h->name, job->name, sizeof(h->name));
+	h->checksum = checksum;
+	h->srclen = job->rawlen;
+	h->lighttables = job->upload.lightscale ? job->lighttables : 0;
+	h->saturation = job->saturation < 1 ? job->saturation : 1;
+	h->picmip = job->upload.mipmap ? job->upload.picmip : 0;
+	h->maxsize = job->upload.maxsize;
+	h->mipmap = job->upload.mipmap;
+	h->buildmips = job->upload.buildmips;
+}
+
+/*
+ * ================ GL_TexCacheSize ================
+ * Bytes taken by the upload levels, -1 if the header can't be right
+ */
+static int GL_TexCacheSize(int width, int height, int numlevels, int maxsize) {
+	long long size;
+	int i;
+
+	if (width <= 0 || height <= 0 || width > maxsize || height > maxsize
+	    || numlevels <= 0 || numlevels > 32)
+		return -1;
+
+	size = 0;
+	for (i = 0; i < numlevels; i++) {
+		size += (long long)width * height * 4;
+		width = width > 1 ? width >> 1 : 1;
+		height = height > 1 ? height >> 1 : 1;
+	}
+	return size > 0x7fffffff ? -1 : (int)size;
+}
+
+/*
+ * ================ GL_ReadTexCache ================
+ */
+static qboolean GL_ReadTexCache(imagejob_t *job, texcacheheader_t *key) {
+	texcacheheader_t h;
+	FILE *f;
+
+	if (!(f = fopen(job->cachepath, "rb")))
+		return false;
+
+	if (fread(&h, sizeof(h), 1, f) != 1
+	    || h.ident != key->ident || h.version != key->version
+	    || strcmp(h.name, key->name)
+	    || h.checksum != key->checksum || h.srclen != key->srclen
+	    || h.lighttables != key->lighttables || h.saturation != key->saturation
+	    || h.picmip != key->picmip || h.maxsize != key->maxsize
+	    || h.mipmap != key->mipmap || h.buildmips != key->buildmips
+	    || h.datasize <= 0
+	    || h.datasize != GL_TexCacheSize(h.width, h.height, h.numlevels, key->maxsize)
+	    || !(job->upload.data = malloc(h.datasize))) {
+		fclose(f);
+		return false;
+	}
+
+	if (fread(job->upload.data, h.datasize, 1, f) != 1) {
+		free(job->upload.data);
+		job->upload.data = NULL;
+		fclose(f);
+		return false;
+	}
+	fclose(f);
+
+	job->width = h.srcwidth;
+	job->height = h.srcheight;
+	job->upload.freedata = true;
+	job->upload.width = h.width;
+	job->upload.height = h.height;
+	job->upload.numlevels = h.numlevels;
+	job->upload.samples = h.hasalpha ? gl_alpha_format : gl_solid_format;
+	return true;
+}
+
+/*
+ * ================ GL_WriteTexCache ================
+ * Written to a temporary file and renamed, so a half written entry is
+ * never picked up
+ */
+static void GL_WriteTexCache(imagejob_t *job, texcacheheader_t *h) {
+	char tmppath[MAX_OSPATH];
+	FILE *f;
+
+	h->srcwidth = job->width;
+	h->srcheight = job->height;
+	h->width = job->upload.width;
+	h->height = job->upload.height;
+	h->numlevels = job->upload.numlevels;
+	h->hasalpha = (job->upload.samples == gl_alpha_format);
+	h->datasize = GL_TexCacheSize(h->width, h->height, h->numlevels, h->maxsize);
+	if (h->datasize <= 0)
+		return;
+
+	Com_sprintf(tmppath, sizeof(tmppath), "%s.tmp", job->cachepath);
+	if (!(f = fopen(tmppath, "wb")))
+		return;
+	if (fwrite(h, sizeof(*h), 1, f) != 1 || fwrite(job->upload.data, h->datasize, 1, f) != 1) {
+		fclose(f);
+		remove(tmppath);
+		return;
+	}
+	fclose(f);
+	rename(tmppath, job->cachepath);
+}
+
+/*
+ * ================ GL_RunImageJob ================
+ * Decode and prepare, runs on a worker or on the main thread when it
+ * gets to a job before the workers do
+ */
+static void GL_RunImageJob(imagejob_t *job) {
+	texcacheheader_t key;
+	char *ext;
+
+	if (job->cachepath[0]) {
+		GL_TexCacheKey(job, GL_ImageChecksum(job->raw, job->rawlen), &key);
+		if (GL_ReadTexCache(job, &key))
+			return;
+	}
+
+	ext = job->name + strlen(job->name) - 4;
+	if (!strcmp(ext, ".png"))
+		job->pic = R_DecodePNG(job->name, job->raw, job->rawlen, &job->width, &job->height, &job->msg);
+	else if (!strcmp(ext, ".tga"))
+		job->pic = R_DecodeTGA(job->name, job->raw, job->rawlen, &job->width, &job->height, &job->msg);
+	else if (!strcmp(ext, ".jpg"))
+		job->pic = R_DecodeJPG(job->name, job->raw, job->rawlen, &job->width, &job->height, &job->msg);
+
+	if (!job->pic)
+		return;
+
+	GL_PrepareUpload32((unsigned *)job->pic, job->width, job->height, job->upload.mipmap, &job->upload);
+
+	if (job->cachepath[0])
+		GL_WriteTexCache(job, &key);
+}
+
+/*
+ * ================ GL_NextImageJob ================
+ * Called with image_job_lock held.  Workers only run a bounded distance
+ * ahead of GL_FindImage, so a big batch doesn't sit decoded in memory.
+ */
+static imagejob_t *GL_NextImageJob(void) {
+	imagejob_t *job;
+
+	while (next_image_job < num_image_jobs
+	    && next_image_job < num_claimed_jobs + IMAGE_JOBS_AHEAD * num_image_workers) {
+		job = &image_jobs[next_image_job++];
+		if (job->state == IJOB_QUEUED)
+			return job;
+	}
+	return NULL;
+}
+
+static void GL_ImageWorker(void *arg) {
+	imagejob_t *job;
+
+	Sys_LockMutex(image_job_lock);
+	while (!image_workers_quit) {
+		if (!(job = GL_NextImageJob())) {
+			Sys_CondWait(image_job_queued, image_job_lock);
+			continue;
+		}
+		job->state = IJOB_RUNNING;
+		Sys_UnlockMutex(image_job_lock);
+
+		GL_RunImageJob(job);
+
+		Sys_LockMutex(image_job_lock);
+		job->state = IJOB_DONE;
+		Sys_CondBroadcast(image_job_done);
+	}
+	Sys_UnlockMutex(image_job_lock);
+}
+
+/*
+ * ================ GL_StartImageWorkers ================
+ */
+static void GL_StartImageWorkers(void) {
+	int count;
+
+	count = (int)gl_imagethreads->value;
+	if (count < 0)
+		count = Sys_CPUCount() - 1;
+	if (count > MAX_IMAGE_WORKERS)
+		count = MAX_IMAGE_WORKERS;
+	gl_imagethreads->modified = false;
+
+	if (count <= 0)
+		return;
+
+	image_job_lock = Sys_CreateMutex();
+	image_job_queued = Sys_CreateCond();
+	image_job_done = Sys_CreateCond();
+	image_workers_quit = false;
+
+	for (num_image_workers = 0; num_image_workers < count; num_image_workers++) {
+		image_workers[num_image_workers] = Sys_CreateThread(GL_ImageWorker, NULL);
+		if (!image_workers[num_image_workers])
+			break;
+	}
+
+	if (num_image_workers)
+		ri.Con_Printf(PRINT_DEVELOPER, "Image decoding on %d worker threads\n", num_image_workers);
+}
+
+/*
+ * ================ GL_StopImageWorkers ================
+ */
+static void GL_StopImageWorkers(void) {
+	int i;
+
+	if (!image_job_lock)
+		return;
+
+	GL_FinishImageJobs();
+
+	Sys_LockMutex(image_job_lock);
+	image_workers_quit = true;
+	Sys_CondBroadcast(image_job_queued);
+	Sys_UnlockMutex(image_job_lock);
+
+	for (i = 0; i < num_image_workers; i++)
+		Sys_WaitThread(image_workers[i]);
+	num_image_workers = 0;
+
+	Sys_DestroyCond(image_job_done);
+	Sys_DestroyCond(image_job_queued);
+	Sys_DestroyMutex(image_job_lock);
+	image_job_done = image_job_queued = NULL;
+	image_job_lock = NULL;
+}
+
+/*
+ * ================ GL_FindImageJob ================
+ */
+static imagejob_t *GL_FindImageJob(char *name, imagetype_t type) {
+	imagejob_t *job;
+
+	for (job = image_job_hash[Com_HashKey(name, IMAGE_HASH_SIZE)]; job; job = job->hash_next)
+		if (job->type == type && !strcmp(job->name, name))
+			return job;
+	return NULL;
+}
+
+/*
+ * ================ GL_TexCachePath ================
+ * Flat directory, the image path with slashes turned into underscores
+ */
+static void GL_TexCachePath(char *name, char *path, int size) {
+	char *p;
+	int len;
+
+	if (!gl_texcache->value) {
+		path[0] = 0;
+		return;
+	}
+
+	if (!texcache_dir_made) {
+		Com_sprintf(path, size, "%s/texcache", ri.FS_Gamedir());
+		Sys_Mkdir(path);
+		texcache_dir_made = true;
+	}
+
+	Com_sprintf(path, size, "%s/texcache/", ri.FS_Gamedir());
+	len = strlen(path);
+	Com_sprintf(path + len, size - len, "%s.tc", name);
+	for (p = path + len; *p; p++)
+		if (*p == '/' || *p == ':')
+			*p = '_';
+}
+
+/*
+ * ================ GL_InitImageJob ================
+ * Upload settings are taken now, on the main thread, not when a worker
+ * gets to the job
+ */
+static void GL_InitImageJob(imagejob_t *job, char *name, imagetype_t type, byte *raw, int len) {
+	memset(job, 0, sizeof(*job));
+	Q_strncpyz(job->name, name, sizeof(job->name));
+	job->type = type;
+	job->raw = raw;
+	job->rawlen = len;
+	R_ClearImageMsg(&job->msg);
+
+	qglGetIntegerv(GL_MAX_TEXTURE_SIZE, &job->upload.maxsize);
+	job->upload.picmip = (int)gl_picmip->value;
+	job->upload.lightscale = !gl_state.hwgamma && brightenTexture;
+	job->upload.buildmips = !gl_state.sgis_mipmap;
+	job->upload.mipmap = (type != it_pic && type != it_sky);
+
+	job->lighttables = image_lighttables;
+	job->saturation = gl_lightmap_texture_saturation->value;
+	GL_TexCachePath(name, job->cachepath, sizeof(job->cachepath));
+}
+
+/*
+ * ================ GL_FinishImageJob ================
+ * Main thread half of a job, creates the image from the prepared upload
+ */
+static image_t *GL_FinishImageJob(imagejob_t *job, imagetype_t type) {
+	image_t *image;
+
+	ri.FS_FreeFile(job->raw);
+	job->raw = NULL;
+
+	image = NULL;
+	if (job->upload.data)
+		image = GL_CreateImage(job->name, NULL, job->width, job->height, type, 32, &job->upload);
+	else
+		R_MarkProbeFailed(job->name);
+
+	if (job->pic) {
+		free(job->pic);
+		job->pic = NULL;
+	}
+
+	R_ReportImageMsg(&job->msg);
+	return image;
+}
+
+/*
+ * ================ GL_QueueImageFile ================
+ * Returns false if the file doesn't exist
+ */
+static qboolean GL_QueueImageFile(char *name, imagetype_t type) {
+	imagejob_t *job;
+	image_t *image;
+	unsigned hash;
+	byte *raw;
+	int len;
+
+	hash = Com_HashKey(name, IMAGE_HASH_SIZE);
+	for (image = image_hash[hash]; image; image = image->hash_next)
+		if (!strcmp(image->name, name))
+			return true;
+	if (R_ProbeFailed(name))
+		return false;
+	if (GL_FindImageJob(name, type) || num_image_jobs == MAX_IMAGE_JOBS)
+		return true;	/* GL_FindImage will sort it out */
+
+	len = ri.FS_LoadFile(name, (void **)&raw);
+	if (!raw) {
+		R_MarkProbeFailed(name);
+		return false;
+	}
+
+	Sys_LockMutex(image_job_lock);
+
+	job = &image_jobs[num_image_jobs];
+	GL_InitImageJob(job, name, type, raw, len);
+	job->state = IJOB_QUEUED;
+
+	job->hash_next = image_job_hash[hash];
+	image_job_hash[hash] = job;
+	num_image_jobs++;
+
+	Sys_CondSignal(image_job_queued);
+	Sys_UnlockMutex(image_job_lock);
+
+	return true;
+}
+
+/*
+ * ================ GL_QueueImage ================
+ * Tells the workers about an image GL_FindImage is going to be asked for
+ * shortly, following the same replacement rules.  Only the 32 bit
+ * replacements are decoded in the background, .pcx and .wal files are
+ * cheap and stay on the main thread.  Returns false if neither the image
+ * nor a replacement exists.  Callers finish the batch with
+ * GL_FinishImageJobs.
+ */
+qboolean GL_QueueImage(char *name, imagetype_t type) {
+	char path[MAX_QPATH], *ext, *ptr;
+	int i, len;
+
+	if (!num_image_jobs && gl_imagethreads->modified)
+		GL_StopImageWorkers();
+	if (!image_job_lock)
+		GL_StartImageWorkers();
+	if (!num_image_workers)
+		return true;
+
+	len = strlen(name);
+	if (len < 5 || len >= MAX_QPATH - 4)
+		return true;
+
+	Q_strncpyz(path, name, sizeof(path));
+	while ((ptr = strchr(path, '\\')))
+		*ptr = '/';
+
+	ext = path + len - 4;
+	if (!strcmp(ext, ".pcx") || !strcmp(ext, ".wal")) {
+		for (i = 0; i < IMAGETYPES; i++) {
+			strcpy(ext, image_types[i]);
+			if (GL_QueueImageFile(path, type))
+				return true;
+		}
+		/* the original is loaded on demand */
+		Q_strncpyz(path, name, sizeof(path));
+		return !R_ProbeFailed(path);
+	}
+
+	if (!strcmp(ext, ".png") || !strcmp(ext, ".tga") || !strcmp(ext, ".jpg"))
+		return GL_QueueImageFile(path, type);
+
+	return true;
+}
+
+/*
+ * ================ GL_ClaimImageJob ================
+ */
+static image_t *GL_ClaimImageJob(imagejob_t *job, imagetype_t type) {
+	image_t *image;
+
+	Sys_LockMutex(image_job_lock);
+	if (job->state == IJOB_QUEUED) {
+		/* nobody got to it yet, don't wait */
+		job->state = IJOB_RUNNING;
+		Sys_UnlockMutex(image_job_lock);
+		GL_RunImageJob(job);
+		Sys_LockMutex(image_job_lock);
+		job->state = IJOB_DONE;
+	}
+	while (job->state != IJOB_DONE)
+		Sys_CondWait(image_job_done, image_job_lock);
+	job->claimed = true;
+	num_claimed_jobs++;
+	Sys_CondBroadcast(image_job_queued);	/* the window moved */
+	Sys_UnlockMutex(image_job_lock);
+
+	image = GL_FinishImageJob(job, type);
+
+	if (r_registering)
+		Draw_LoadingProgress(num_claimed_jobs, num_image_jobs);
+
+	return image;
+}
+
+/*
+ * ================ GL_FinishImageJobs ================
+ * Ends a GL_QueueImage batch, dropping whatever wasn't asked for
+ */
+void GL_FinishImageJobs(void) {
+	imagejob_t *job;
+	int i;
+
+	if (!num_image_jobs)
+		return;
+
+	Sys_LockMutex(image_job_lock);
+	for (i = 0, job = image_jobs; i < num_image_jobs; i++, job++) {
+		if (job->state == IJOB_QUEUED)
+			job->state = IJOB_DONE;
+		while (job->state != IJOB_DONE)
+			Sys_CondWait(image_job_done, image_job_lock);
+	}
+	Sys_UnlockMutex(image_job_lock);
+
+	for (i = 0, job = image_jobs; i < num_image_jobs; i++, job++) {
+		if (job->raw)
+			ri.FS_FreeFile(job->raw);
+		if (job->claimed)
+			continue;
+		if (job->upload.data && job->upload.freedata)
+			free(job->upload.data);
+		if (job->pic)
+			free(job->pic);
+	}
+
+	num_image_jobs = 0;
+	next_image_job = 0;
+	num_claimed_jobs = 0;
+	memset(image_job_hash, 0, sizeof(image_job_hash));
+}
+
 image_t * GL_FindImage(char *name, imagetype_t type) {
 	image_t *image;
+	imagejob_t *job;
 	int i, len;
 	byte *pic, *palette;
 	int width, height;
@@ -1766,13 +3083,21 @@ image_t * GL_FindImage(char *name, imagetype_t type) {
 	}
 		 
 	/* look for it */
-	for (i = 0, image = gltextures; i < numgltextures; i++, image++) {
+	for (image = image_hash[Com_HashKey(name, IMAGE_HASH_SIZE)]; image; image = image->hash_next) {
 		if (!strcmp(name, image->name)) {
 			image->registration_sequence = registration_sequence;
 			return image;
 		}
 	}
 
+	/* already known to be missing */
+	if (R_ProbeFailed(name))
+		return !strcmp(name + len - 4, ".wal") ? r_notexture : NULL;
+
+	/* decoded in the background by GL_QueueImage */
+	if (num_image_jobs && (job = GL_FindImageJob(name, type)) && !job->claimed)
+		return GL_ClaimImageJob(job, type);
+
 	/* load the pic from disk */
 	pic = NULL;
 	palette = NULL;
@@ -1792,9 +3117,9 @@ image_t * GL_FindImage(char *name, imagetype_t type) {
 
 		if (!image) {
 			LoadPCX(name, &pic, &palette, &width, &height);
-			if (!pic)
-				return NULL;	/* ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
-			image = GL_LoadPic(name, pic, width, height, type, 8);
+			if (pic)
+				image = GL_LoadPic(name, pic, width, height, type, 8);
+			/* else ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
 		}
 	} else if (!strcmp(name + len - 4, ".wal")) {
 		char		basename[MAX_QPATH];
@@ -1808,30 +3133,30 @@ image_t * GL_FindImage(char *name, imagetype_t type) {
 
 		if (!image) {
 			image = GL_LoadWal(name);
+			if (image == r_notexture)
+				R_MarkProbeFailed(name);
 		}
-	} else {
-		if (!strcmp(name + len - 4, ".png")) {	/* heffo hax0r */
-			LoadPNG(name, &pic, &width, &height);
-			if (!pic)
-				return NULL;	
-				/* ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
-			image = GL_LoadPic(name, pic, width, height, type, 32);
-		} else if (!strcmp(name + len - 4, ".tga")) {
-			LoadTGA(name, &pic, &width, &height);
-			if (!pic)
-				return NULL;	
-				/* ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
-			image = GL_LoadPic(name, pic, width, height, type, 32);
-		} else if (!strcmp(name + len - 4, ".jpg")) {
-			LoadJPG(name, &pic, &width, &height);
-			if (!pic)
-				return NULL;	
-				/* ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
-			image = GL_LoadPic(name, pic, width, height, type, 32);
-		} else
-			return NULL;	
-			/* ri.Sys_Error (ERR_DROP, "GL_FindImage: bad extension on: %s", name); */
-	}
+	} else if (!strcmp(name + len - 4, ".png") || !strcmp(name + len - 4, ".tga") ||
+	           !strcmp(name + len - 4, ".jpg")) {	/* heffo hax0r */
+		imagejob_t sync;
+		byte *raw;
+		int rawlen;
+
+		/* same path as the workers, so the texture cache applies */
+		rawlen = ri.FS_LoadFile(name, (void **)&raw);
+		if (raw) {
+			GL_InitImageJob(&sync, name, type, raw, rawlen);
+			GL_RunImageJob(&sync);
+			image = GL_FinishImageJob(&sync, type);
+		} else if (!strcmp(name + len - 4, ".png"))
+			ri.Con_Printf(PRINT_DEVELOPER, "Bad png file %s\n", name);
+		/* else ri.Sys_Error (ERR_DROP, "GL_FindImage: can't load %s", name); */
+	} else
+		return NULL;	
+		/* ri.Sys_Error (ERR_DROP, "GL_FindImage: bad extension on: %s", name); */
+
+	if (!image)
+		R_MarkProbeFailed(name);
 
 	if (pic)
 		free(pic);
@@ -1885,6 +3210,7 @@ void GL_FreeUnusedImages(void) {
 			continue;	/* don't free pics */
 		/* free it */
 		qglDeleteTextures(1, (GLuint *)&image->texnum);
+		GL_UnlinkImage(image);
 		memset(image, 0, sizeof(*image));
 	}
 }
@@ -2013,6 +3339,9 @@ void GL_InitImages(void)
 	float g = vid_gamma->value;
 
 	registration_sequence = 1;
+	memset(image_hash, 0, sizeof(image_hash));
+	R_ClearFailedProbes();
+	GL_InitImageKernels();
 
 	/* init intensity conversions */
 	/* Vic - begin */
@@ -2059,6 +3388,9 @@ void GL_InitImages(void)
 			j = 255;
 		intensitytable[i] = j;
 	}
+	GL_BuildLightScaleTables();
+	image_lighttables = GL_LightTablesKey();
+	texcache_dir_made = false;
 
 	R_InitBloomTextures();		/* BLOOMS */
 }
@@ -2075,4 +3407,9 @@ void GL_ShutdownImages(void) {
 		qglDeleteTextures(1, (GLuint *)&image->texnum);
 		memset(image, 0, sizeof(*image));
 	}
+
+	GL_StopImageWorkers();
+
+	memset(image_hash, 0, sizeof(image_hash));
+	R_ClearFailedProbes();
 }
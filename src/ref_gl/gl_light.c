@@ -21,6 +21,10 @@
 
 #include "gl_local.h"
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+
 int		r_dlightframecount;
 extern cvar_t  *gl_lightmap_saturation;	/* jitlight */
 
@@ -338,25 +342,105 @@ R_LightPoint(vec3_t p, vec3_t color)
 
 /* =================================================================== */
 
-static float	s_blocklights[34 * 34 * 3];
+#define	MAX_BLOCKLIGHTS		(34 * 34)
+
+static float	s_blocklights[MAX_BLOCKLIGHTS * 3];
+
+/*
+ * ================ R_AddLightRow_C ================
+ * Texels s to smax of one lightmap row of R_AddDynamicLights, td is the
+ * distance along t
+ */
+static void
+R_AddLightRow_C(float *bl, int s, int smax, float ls, int td, float frad, float fminlight, const float *color)
+{
+	int		sd;
+	float		fsacc, fdist;
+
+	for (fsacc = s * 16, bl += s * 3; s < smax; s++, fsacc += 16, bl += 3) {
+		sd = Q_ftol(ls - fsacc);
+
+		if (sd < 0)
+			sd = -sd;
+
+		if (sd > td)
+			fdist = sd + (td >> 1);
+		else
+			fdist = td + (sd >> 1);
+
+		if (fdist < fminlight) {
+			bl[0] += (frad - fdist) * color[0];
+			bl[1] += (frad - fdist) * color[1];
+			bl[2] += (frad - fdist) * color[2];
+		}
+	}
+}
+
+#if idsse2
+/*
+ * Four texels are twelve interleaved floats, so the per texel values and
+ * the colour are spread over three registers as rgbr gbrg brgb
+ */
+#define	SPREAD3(v, v0, v1, v2)	(v0 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 0, 0)), \
+				 v1 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 1, 1)), \
+				 v2 = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 2)))
+
+static void
+R_AddLightRow_SSE2(float *bl, int smax, float ls, int td, float frad, float fminlight, const float *color)
+{
+	__m128		c0 = _mm_setr_ps(color[0], color[1], color[2], color[0]);
+	__m128		c1 = _mm_setr_ps(color[1], color[2], color[0], color[1]);
+	__m128		c2 = _mm_setr_ps(color[2], color[0], color[1], color[2]);
+	__m128		vls = _mm_set1_ps(ls), step = _mm_set1_ps(64);
+	__m128		fsacc = _mm_setr_ps(0, 16, 32, 48);
+	__m128		rad = _mm_set1_ps(frad), minl = _mm_set1_ps(fminlight);
+	__m128i		vtd = _mm_set1_epi32(td), htd = _mm_set1_epi32(td >> 1);
+	__m128		fd, lit, add, a0, a1, a2;
+	__m128i		sd, sign, far;
+	float          *p;
+	int		s;
+
+	for (s = 0, p = bl; s + 4 <= smax; s += 4, p += 12, fsacc = _mm_add_ps(fsacc, step)) {
+		sd = _mm_cvttps_epi32(_mm_sub_ps(vls, fsacc));
+		sign = _mm_srai_epi32(sd, 31);
+		sd = _mm_sub_epi32(_mm_xor_si128(sd, sign), sign);
+
+		far = _mm_cmpgt_epi32(sd, vtd);
+		fd = _mm_cvtepi32_ps(_mm_or_si128(_mm_and_si128(far, _mm_add_epi32(sd, htd)),
+		    _mm_andnot_si128(far, _mm_add_epi32(vtd, _mm_srai_epi32(sd, 1)))));
+
+		lit = _mm_cmplt_ps(fd, minl);
+		if (!_mm_movemask_ps(lit))
+			continue;
+		add = _mm_and_ps(lit, _mm_sub_ps(rad, fd));
+
+		SPREAD3(add, a0, a1, a2);
+		_mm_storeu_ps(p, _mm_add_ps(_mm_loadu_ps(p), _mm_mul_ps(a0, c0)));
+		_mm_storeu_ps(p + 4, _mm_add_ps(_mm_loadu_ps(p + 4), _mm_mul_ps(a1, c1)));
+		_mm_storeu_ps(p + 8, _mm_add_ps(_mm_loadu_ps(p + 8), _mm_mul_ps(a2, c2)));
+	}
+
+	R_AddLightRow_C(bl, s, smax, ls, td, frad, fminlight, color);
+}
+#endif
 
 /*
  * =============== R_AddDynamicLights ===============
  */
-void
-R_AddDynamicLights(msurface_t * surf)
+static void
+R_AddDynamicLights(msurface_t * surf, float *blocklights)
 {
 	int		lnum;
-	int		sd        , td;
+	int		td;
 	float		fdist   , frad, fminlight;
 	vec3_t		impact , local;
-	int		s         , t;
+	int		t;
 	int		i;
 	int		smax      , tmax;
 	mtexinfo_t     *tex;
 	dlight_t       *dl;
 	float          *pfBL;
-	float		fsacc   , ftacc;
+	float		ftacc;
 
 	smax = (surf->extents[0] >> 4) + 1;
 	tmax = (surf->extents[1] >> 4) + 1;
@@ -390,29 +474,16 @@ R_AddDynamicLights(msurface_t * surf)
 		local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
 		local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
 
-		pfBL = s_blocklights;
-		for (t = 0, ftacc = 0; t < tmax; t++, ftacc += 16) {
+		pfBL = blocklights;
+		for (t = 0, ftacc = 0; t < tmax; t++, ftacc += 16, pfBL += smax * 3) {
 			td = local[1] - ftacc;
 			if (td < 0)
 				td = -td;
-
-			for (s = 0, fsacc = 0; s < smax; s++, fsacc += 16, pfBL += 3) {
-				sd = Q_ftol(local[0] - fsacc);
-
-				if (sd < 0)
-					sd = -sd;
-
-				if (sd > td)
-					fdist = sd + (td >> 1);
-				else
-					fdist = td + (sd >> 1);
-
-				if (fdist < fminlight) {
-					pfBL[0] += (frad - fdist) * dl->color[0];
-					pfBL[1] += (frad - fdist) * dl->color[1];
-					pfBL[2] += (frad - fdist) * dl->color[2];
-				}
-			}
+#if idsse2
+			R_AddLightRow_SSE2(pfBL, smax, local[0], td, frad, fminlight, dl->color);
+#else
+			R_AddLightRow_C(pfBL, 0, smax, local[0], td, frad, fminlight, dl->color);
+#endif
 		}
 	}
 }
@@ -432,34 +503,194 @@ R_SetCacheState(msurface_t * surf)
 }
 
 /*
- * =============== R_BuildLightMap
+ * ================ R_AccumulateLightMap ================
+ * bl[i] += lightmap[i] * scale[i % 3] for size texels
+ */
+static void
+R_AccumulateLightMap(float *bl, const byte *lightmap, int size, const float *scale)
+{
+	int		i = 0;
+#if idsse2
+	__m128		s0 = _mm_setr_ps(scale[0], scale[1], scale[2], scale[0]);
+	__m128		s1 = _mm_setr_ps(scale[1], scale[2], scale[0], scale[1]);
+	__m128		s2 = _mm_setr_ps(scale[2], scale[0], scale[1], scale[2]);
+	__m128i		zero = _mm_setzero_si128();
+	__m128i		b, lo, hi;
+
+	/* four texels, twelve bytes, per pass */
+	for (; i + 4 <= size; i += 4, bl += 12, lightmap += 12) {
+		b = _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i *)lightmap),
+		    _mm_cvtsi32_si128(*(const int *)(lightmap + 8)));
+		lo = _mm_unpacklo_epi8(b, zero);
+		hi = _mm_unpackhi_epi8(b, zero);
+		_mm_storeu_ps(bl, _mm_add_ps(_mm_loadu_ps(bl),
+		    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), s0)));
+		_mm_storeu_ps(bl + 4, _mm_add_ps(_mm_loadu_ps(bl + 4),
+		    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), s1)));
+		_mm_storeu_ps(bl + 8, _mm_add_ps(_mm_loadu_ps(bl + 8),
+		    _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), s2)));
+	}
+#endif
+	for (; i < size; i++, bl += 3, lightmap += 3) {
+		bl[0] += lightmap[0] * scale[0];
+		bl[1] += lightmap[1] * scale[1];
+		bl[2] += lightmap[2] * scale[2];
+	}
+}
+
+/*
+ * ================ R_StoreLightTexel ================
+ * Clamped, desaturated (jitlight) and greyed (gl_coloredlightmaps) texel,
+ * alpha is the brightest channel.  colored < 0 leaves the colour alone.
+ */
+static void
+R_StoreLightTexel(const float *bl, byte *dest, float sat, float colored)
+{
+	int		r, g, b, a, max;
+
+	r = Q_ftol(bl[0]);
+	g = Q_ftol(bl[1]);
+	b = Q_ftol(bl[2]);
+
+	/* catch negative lights */
+	if (r < 0)
+		r = 0;
+	if (g < 0)
+		g = 0;
+	if (b < 0)
+		b = 0;
+
+	/* jitlight -- reduce oversaturation: */
+	/* greyscale value: */
+	a = (int)(r * 0.33f + g * 0.34f + b * 0.33f);
+
+	r = r * sat + a * (1 - sat);
+	g = g * sat + a * (1 - sat);
+	b = b * sat + a * (1 - sat);
+
+	/* determine the brightest of the three color components */
+	if (r > g)
+		max = r;
+	else
+		max = g;
+	if (b > max)
+		max = b;
+
+	/*
+	 * alpha is ONLY used for the mono lightmap case.  For this reason we
+	 * set it to the brightest of the color components so that things
+	 * don't get too dim.
+	 */
+	a = max;
+
+	/*
+	 * rescale all the color components if the intensity of the greatest
+	 * channel exceeds 1.0
+	 */
+	if (max > 255) {
+		float		t = 255.0f / max;
+
+		r = r * t;
+		g = g * t;
+		b = b * t;
+		a = a * t;
+	}
+	// NiceAss: Code from evilpope
+	if (colored >= 0) {
+		int grey = (r + b + g) / 3;
+
+		dest[0] = grey + (r - grey) * colored;
+		dest[1] = grey + (g - grey) * colored;
+		dest[2] = grey + (b - grey) * colored;
+	} else {
+		dest[0] = r;
+		dest[1] = g;
+		dest[2] = b;
+	}
+	dest[3] = a;
+}
+
+#if idsse2
+/*
+ * ================ R_StoreLightRow_SSE2 ================
+ * R_StoreLightTexel four texels at a time, in float because the values
+ * are small integers that convert exactly
+ */
+static void
+R_StoreLightRow_SSE2(const float *bl, byte *dest, int smax, float sat, float colored)
+{
+	__m128		zero = _mm_setzero_ps();
+	__m128		vsat = _mm_set1_ps(sat), vunsat = _mm_set1_ps(1 - sat);
+	__m128		w0 = _mm_set1_ps(0.33f), w1 = _mm_set1_ps(0.34f);
+	__m128		c255 = _mm_set1_ps(255), third = _mm_set1_ps(3), vcol = _mm_set1_ps(colored);
+	__m128		r, g, b, a, max, t, big, grey;
+	__m128i		out;
+	int		j;
+
+	for (j = 0; j + 4 <= smax; j += 4, bl += 12, dest += 16) {
+		/* truncating after the clamp is the same as clamping after */
+		r = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_max_ps(_mm_setr_ps(bl[0], bl[3], bl[6], bl[9]), zero)));
+		g = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_max_ps(_mm_setr_ps(bl[1], bl[4], bl[7], bl[10]), zero)));
+		b = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_max_ps(_mm_setr_ps(bl[2], bl[5], bl[8], bl[11]), zero)));
+
+		a = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, w0), _mm_mul_ps(g, w1)), _mm_mul_ps(b, w0));
+		a = _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvttps_epi32(a)), vunsat);
+		r = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(r, vsat), a)));
+		g = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(g, vsat), a)));
+		b = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(b, vsat), a)));
+
+		max = _mm_max_ps(_mm_max_ps(r, g), b);
+		big = _mm_cmpgt_ps(max, c255);
+		if (_mm_movemask_ps(big)) {
+			t = _mm_div_ps(c255, max);
+			r = _mm_or_ps(_mm_andnot_ps(big, r), _mm_and_ps(big, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(r, t)))));
+			g = _mm_or_ps(_mm_andnot_ps(big, g), _mm_and_ps(big, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(g, t)))));
+			b = _mm_or_ps(_mm_andnot_ps(big, b), _mm_and_ps(big, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(b, t)))));
+			max = _mm_or_ps(_mm_andnot_ps(big, max), _mm_and_ps(big, _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_mul_ps(max, t)))));
+		}
+
+		if (colored >= 0) {
+			grey = _mm_cvtepi32_ps(_mm_cvttps_epi32(_mm_div_ps(_mm_add_ps(_mm_add_ps(r, b), g), third)));
+			r = _mm_add_ps(grey, _mm_mul_ps(_mm_sub_ps(r, grey), vcol));
+			g = _mm_add_ps(grey, _mm_mul_ps(_mm_sub_ps(g, grey), vcol));
+			b = _mm_add_ps(grey, _mm_mul_ps(_mm_sub_ps(b, grey), vcol));
+		}
+
+		out = _mm_or_si128(_mm_or_si128(_mm_cvttps_epi32(r), _mm_slli_epi32(_mm_cvttps_epi32(g), 8)),
+		    _mm_or_si128(_mm_slli_epi32(_mm_cvttps_epi32(b), 16), _mm_slli_epi32(_mm_cvttps_epi32(max), 24)));
+		_mm_storeu_si128((__m128i *)dest, out);
+	}
+
+	for (; j < smax; j++, bl += 3, dest += 4)
+		R_StoreLightTexel(bl, dest, sat, colored);
+}
+#endif
+
+/*
+ * =============== R_BuildLightMapBlock
  *
- * Combine and scale multiple lightmaps into the floating format in blocklights
- * ===============
+ * Combine and scale multiple lightmaps into the floating format in
+ * blocklights, then into dest.  Doesn't touch any shared state, so the
+ * lightmap workers can run it. ===============
  */
-void
-R_BuildLightMap(msurface_t * surf, byte * dest, int stride)
+static void
+R_BuildLightMapBlock(msurface_t * surf, byte * dest, int stride, float *blocklights)
 {
 	int		smax, tmax;
 	int		r, g, b, a, max;
 	int		i, j, size;
 	byte           *lightmap;
 	float		scale[4];
-	int		nummaps;
 	float          *bl;
-	lightstyle_t   *style;
 	int		monolightmap;
 	float		sat;	/* jitlight */
+	float		colored;
+	int		maps;
 	extern cvar_t	*gl_coloredlightmaps;
 
-	if (surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))
-		ri.Sys_Error(ERR_DROP, "R_BuildLightMap called for non-lit surface");
-
 	smax = (surf->extents[0] >> 4) + 1;
 	tmax = (surf->extents[1] >> 4) + 1;
 	size = smax * tmax;
-	if (size > (sizeof(s_blocklights) >> 4))
-		ri.Sys_Error(ERR_DROP, "Bad s_blocklights size");
 
 	/* === jitlight */
 	sat = gl_lightmap_saturation->value;
@@ -473,170 +704,50 @@ R_BuildLightMap(msurface_t * surf, byte * dest, int stride)
 
 	/* set to full bright if no light data */
 	if (!surf->samples) {
-		int		maps;
-
 		for (i = 0; i < size * 3; i++)
-			s_blocklights[i] = 255;
-		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255;
-		    maps++) {
-			style = &r_refdef.lightstyles[surf->styles[maps]];
-		}
+			blocklights[i] = 255;
 		goto store;
 	}
-	/* count the # of maps */
-	for (nummaps = 0; nummaps < MAXLIGHTMAPS && surf->styles[nummaps] != 255;
-	    nummaps++);
-
-	lightmap = surf->samples;
 
 	/* add all the lightmaps */
-	if (nummaps == 1) {
-		int		maps;
+	memset(blocklights, 0, sizeof(blocklights[0]) * size * 3);
 
-		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255;
-		    maps++) {
-			bl = s_blocklights;
-
-			for (i = 0; i < 3; i++)
-				scale[i] = gl_modulate->value * r_refdef.lightstyles[surf->styles[maps]].rgb[i];
-
-			if (scale[0] == 1.0 &&
-			    scale[1] == 1.0 &&
-			    scale[2] == 1.0) {
-				for (i = 0; i < size; i++, bl += 3) {
-					bl[0] = lightmap[i * 3 + 0];
-					bl[1] = lightmap[i * 3 + 1];
-					bl[2] = lightmap[i * 3 + 2];
-				}
-			} else {
-				for (i = 0; i < size; i++, bl += 3) {
-					bl[0] = lightmap[i * 3 + 0] * scale[0];
-					bl[1] = lightmap[i * 3 + 1] * scale[1];
-					bl[2] = lightmap[i * 3 + 2] * scale[2];
-				}
-			}
-			lightmap += size * 3;	/* skip to next lightmap */
-		}
-	} else {
-		int		maps;
-
-		memset(s_blocklights, 0, sizeof(s_blocklights[0]) * size * 3);
-
-		for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255;
-		    maps++) {
-			bl = s_blocklights;
+	lightmap = surf->samples;
+	for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
+		for (i = 0; i < 3; i++)
+			scale[i] = gl_modulate->value * r_refdef.lightstyles[surf->styles[maps]].rgb[i];
 
-			for (i = 0; i < 3; i++)
-				scale[i] = gl_modulate->value * r_refdef.lightstyles[surf->styles[maps]].rgb[i];
-
-			if (scale[0] == 1.0 &&
-			    scale[1] == 1.0 &&
-			    scale[2] == 1.0) {
-				for (i = 0; i < size; i++, bl += 3) {
-					bl[0] += lightmap[i * 3 + 0];
-					bl[1] += lightmap[i * 3 + 1];
-					bl[2] += lightmap[i * 3 + 2];
-				}
-			} else {
-				for (i = 0; i < size; i++, bl += 3) {
-					bl[0] += lightmap[i * 3 + 0] * scale[0];
-					bl[1] += lightmap[i * 3 + 1] * scale[1];
-					bl[2] += lightmap[i * 3 + 2] * scale[2];
-				}
-			}
-			lightmap += size * 3;	/* skip to next lightmap */
-		}
+		R_AccumulateLightMap(blocklights, lightmap, size, scale);
+		lightmap += size * 3;	/* skip to next lightmap */
 	}
 
 	/* add all the dynamic lights */
 	if (surf->dlightframe == r_framecount)
-		R_AddDynamicLights(surf);
+		R_AddDynamicLights(surf, blocklights);
 
 	/* put into texture format */
 store:
-	stride -= (smax << 2);
-	bl = s_blocklights;
+	bl = blocklights;
 
 	monolightmap = gl_monolightmap->string[0];
 
 	if (monolightmap == '0') {
-		for (i = 0; i < tmax; i++, dest += stride) {
-			for (j = 0; j < smax; j++) {
-
-				r = Q_ftol(bl[0]);
-				g = Q_ftol(bl[1]);
-				b = Q_ftol(bl[2]);
-
-				/* catch negative lights */
-				if (r < 0)
-					r = 0;
-				if (g < 0)
-					g = 0;
-				if (b < 0)
-					b = 0;
-
-				/* jitlight -- reduce oversaturation: */
-				/* greyscale value: */
-				a = (int)((float)r * 0.33 + (float)g * 0.34 + (float)b * 0.33);
-
-				r = r * sat + a * (1.0 - sat);
-				g = g * sat + a * (1.0 - sat);
-				b = b * sat + a * (1.0 - sat);
-
-				/*
-				 * * determine the brightest of the three
-				 * color components
-				 */
-				if (r > g)
-					max = r;
-				else
-					max = g;
-				if (b > max)
-					max = b;
-
-				/*
-				 * * alpha is ONLY used for the mono lightmap
-				 * case.  For this reason * we set it to the
-				 * brightest of the color components so that *
-				 * things don't get too dim.
-				 */
-				a = max;
-
-				/*
-				 * * rescale all the color components if the
-				 * intensity of the greatest * channel
-				 * exceeds 1.0
-				 */
-				if (max > 255) {
-					float		t = 255.0 / max;
-
-					r = r * t;
-					g = g * t;
-					b = b * t;
-					a = a * t;
-				}
-				// NiceAss: Code from evilpope
-				if( gl_coloredlightmaps->value < 1 && gl_coloredlightmaps->value >= 0 )
-				{
-					int grey = (r + b +g)/3;
-					
-					dest[0] = grey + ( r - grey ) * gl_coloredlightmaps->value;
-					dest[1] = grey + ( g - grey ) * gl_coloredlightmaps->value;
-					dest[2] = grey + ( b - grey ) * gl_coloredlightmaps->value;
-				}
-				else
-				{
-					dest[0] = r;
-					dest[1] = g;
-					dest[2] = b;
-				}
-				dest[3] = a;
-
-				bl += 3;
-				dest += 4;
-			}
+		if (gl_coloredlightmaps->value < 1 && gl_coloredlightmaps->value >= 0)
+			colored = gl_coloredlightmaps->value;
+		else
+			colored = -1;
+
+		for (i = 0; i < tmax; i++, dest += stride, bl += smax * 3) {
+#if idsse2
+			R_StoreLightRow_SSE2(bl, dest, smax, sat, colored);
+#else
+			for (j = 0; j < smax; j++)
+				R_StoreLightTexel(bl + j * 3, dest + j * 4, sat, colored);
+#endif
 		}
 	} else {
+		stride -= (smax << 2);
+
 		for (i = 0; i < tmax; i++, dest += stride) {
 			for (j = 0; j < smax; j++) {
 
@@ -722,6 +833,192 @@ store:
 	}
 }
 
+/*
+ * =============== R_CheckLightMap ===============
+ * Called at load time for every surface that gets a lightmap, so that
+ * R_BuildLightMaps never has to check.
+ */
+void
+R_CheckLightMap(msurface_t * surf)
+{
+	int		smax, tmax;
+
+	if (surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))
+		ri.Sys_Error(ERR_DROP, "R_CheckLightMap called for non-lit surface");
+
+	smax = (surf->extents[0] >> 4) + 1;
+	tmax = (surf->extents[1] >> 4) + 1;
+	if (smax * tmax > MAX_BLOCKLIGHTS)
+		ri.Sys_Error(ERR_DROP, "Bad s_blocklights size");
+}
+
+/*
+ * =============================================================
+ *
+ * LIGHTMAP WORKERS
+ *
+ * R_BuildLightMaps rebuilds a batch of surfaces, spread over
+ * gl_lightmapthreads workers plus the calling thread when the batch is
+ * big enough to be worth waking them.
+ *
+ * =============================================================
+ */
+
+#define	MAX_LIGHTMAP_WORKERS	8
+#define	LIGHTMAP_WORKER_MIN	16	/* surfaces, below that it's all inline */
+
+static qthread_t *lm_workers[MAX_LIGHTMAP_WORKERS];
+static int	lm_numworkers;
+static qmutex_t *lm_lock;
+static qcond_t *lm_wake, *lm_idle;
+static qboolean	lm_quit;
+static int	lm_generation;
+static int	lm_numidle;
+
+/* the batch being built */
+static msurface_t **lm_surfs;
+static byte   **lm_dests;
+static int	lm_count, lm_stride;
+static volatile int lm_next;
+
+/*
+ * ================ R_LightMapWork ================
+ */
+static void
+R_LightMapWork(float *blocklights)
+{
+	int		i;
+
+	while ((i = Sys_AtomicAdd(&lm_next, 1) - 1) < lm_count)
+		R_BuildLightMapBlock(lm_surfs[i], lm_dests[i], lm_stride, blocklights);
+}
+
+/*
+ * ================ R_LightMapWorker ================
+ */
+static void
+R_LightMapWorker(void *arg)
+{
+	float		blocklights[MAX_BLOCKLIGHTS * 3];
+	int		seen = 0;
+
+	Sys_LockMutex(lm_lock);
+	while (1) {
+		while (!lm_quit && seen == lm_generation)
+			Sys_CondWait(lm_wake, lm_lock);
+		if (lm_quit)
+			break;
+		seen = lm_generation;
+		Sys_UnlockMutex(lm_lock);
+
+		R_LightMapWork(blocklights);
+
+		Sys_LockMutex(lm_lock);
+		if (++lm_numidle == lm_numworkers)
+			Sys_CondSignal(lm_idle);
+	}
+	Sys_UnlockMutex(lm_lock);
+}
+
+/*
+ * ================ R_StopLightMapWorkers ================
+ */
+void
+R_StopLightMapWorkers(void)
+{
+	int		i;
+
+	if (!lm_lock)
+		return;
+
+	Sys_LockMutex(lm_lock);
+	lm_quit = true;
+	Sys_CondBroadcast(lm_wake);
+	Sys_UnlockMutex(lm_lock);
+
+	for (i = 0; i < lm_numworkers; i++)
+		Sys_WaitThread(lm_workers[i]);
+	lm_numworkers = 0;
+
+	Sys_DestroyCond(lm_idle);
+	Sys_DestroyCond(lm_wake);
+	Sys_DestroyMutex(lm_lock);
+	lm_idle = lm_wake = NULL;
+	lm_lock = NULL;
+}
+
+/*
+ * ================ R_StartLightMapWorkers ================
+ */
+static void
+R_StartLightMapWorkers(void)
+{
+	int		count;
+
+	gl_lightmapthreads->modified = false;
+
+	count = gl_lightmapthreads->value;
+	if (count < 0)
+		count = Sys_CPUCount() - 1;
+	if (count > MAX_LIGHTMAP_WORKERS)
+		count = MAX_LIGHTMAP_WORKERS;
+
+	lm_lock = Sys_CreateMutex();
+	lm_wake = Sys_CreateCond();
+	lm_idle = Sys_CreateCond();
+	lm_quit = false;
+	lm_generation = 0;
+
+	for (lm_numworkers = 0; lm_numworkers < count; lm_numworkers++) {
+		lm_workers[lm_numworkers] = Sys_CreateThread(R_LightMapWorker, NULL);
+		if (!lm_workers[lm_numworkers])
+			break;
+	}
+
+	if (lm_numworkers)
+		ri.Con_Printf(PRINT_DEVELOPER, "Lightmap workers: %d\n", lm_numworkers);
+}
+
+/*
+ * ================ R_BuildLightMaps ================
+ * Builds count surfaces into dests[i], which must not overlap.  The
+ * surfaces must be lit and fit MAX_BLOCKLIGHTS, which
+ * R_CheckLightMap made sure of at load time.
+ */
+void
+R_BuildLightMaps(msurface_t ** surfs, byte ** dests, int count, int stride)
+{
+	if (gl_lightmapthreads->modified)
+		R_StopLightMapWorkers();
+	if (!lm_lock)
+		R_StartLightMapWorkers();
+
+	lm_surfs = surfs;
+	lm_dests = dests;
+	lm_count = count;
+	lm_stride = stride;
+	lm_next = 0;
+
+	if (!lm_numworkers || count < LIGHTMAP_WORKER_MIN) {
+		R_LightMapWork(s_blocklights);
+		return;
+	}
+
+	Sys_LockMutex(lm_lock);
+	lm_numidle = 0;
+	lm_generation++;
+	Sys_CondBroadcast(lm_wake);
+	Sys_UnlockMutex(lm_lock);
+
+	R_LightMapWork(s_blocklights);
+
+	/* nobody may still be reading the batch when it's handed back */
+	Sys_LockMutex(lm_lock);
+	while (lm_numidle < lm_numworkers)
+		Sys_CondWait(lm_idle, lm_lock);
+	Sys_UnlockMutex(lm_lock);
+}
+
 void
 R_LightPointDynamics(vec3_t p, vec3_t color, m_dlight_t * list, int *amount, int max)
 {
@@ -802,100 +1099,149 @@ R_LightPointDynamics(vec3_t p, vec3_t color, m_dlight_t * list, int *amount, int
 }
 
 /*
- * =================== R_StainNode
- *
- * Stainmaps ===================
+ * Stains are queued and applied a few at a time, up to
+ * gl_stainmaps_budget lightmap texels per frame, so a burst of blood
+ * doesn't stall a single frame.  They only change the surface samples;
+ * the lightmaps are rebuilt and uploaded with the rest of the frame's
+ * lightmap changes once the surfaces are seen.
  */
-void
-R_StainNode(stain_t * st, mnode_t * node)
-{
-	msurface_t     *surf;
-	float		dist;
-	int		c;
 
-	if (node->contents != -1) {
-		return;
-	}
-	dist = DotProduct(st->origin, node->plane->normal) - node->plane->dist;
-	if (dist > st->size) {
-		R_StainNode(st, node->children[0]);
-		return;
-	}
-	if (dist < -st->size) {
-		R_StainNode(st, node->children[1]);
-		return;
-	}
-	ri.Cvar_SetValue("gl_dlight_cutoff", 0);
-	for (c = node->numsurfaces, surf = r_worldmodel->surfaces + node->firstsurface; c; c--, surf++) {
-		mtexinfo_t     *tex;
-		vec3_t		impact, local;
-		byte           *bl;
-		int		i, sd, td, s, t, smax, tmax;
-		float		fdist, frad, fminlight, fsacc, ftacc;
-		long		col;
-
-		smax = (surf->extents[0] >> 4) + 1;
-		tmax = (surf->extents[1] >> 4) + 1;
-		tex = surf->texinfo;
+#define	MAX_STAIN_QUEUE	512
 
-		if ((tex->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))) {
-			continue;
-		}
-		frad = st->size;
-		fdist = DotProduct(st->origin, surf->plane->normal) - surf->plane->dist;
-		if ((surf->flags & SURF_PLANEBACK)) {
-			fdist *= -1;
-		}
-		frad -= fabs(fdist);
-		fminlight = gl_dlight_cutoff->value;
-		if (frad < fminlight) {
-			continue;
-		}
-		fminlight = frad - fminlight;
+static stain_t	stain_queue[MAX_STAIN_QUEUE];
+static int	stain_head, stain_count;
 
-		impact[0] = st->origin[0] - surf->plane->normal[0] * fdist;
-		impact[1] = st->origin[1] - surf->plane->normal[1] * fdist;
-		impact[2] = st->origin[2] - surf->plane->normal[2] * fdist;
+/*
+ * =================== R_StainSurface
+ *
+ * Returns the number of texels looked at. ===================
+ */
+static int
+R_StainSurface(stain_t * st, msurface_t * surf)
+{
+	mtexinfo_t     *tex;
+	vec3_t		impact, local;
+	byte           *bl;
+	int		i, sd, td, s, t, smax, tmax, s0, s1, t0, t1;
+	float		fdist, frad, fminlight, fsacc, ftacc;
+	long		col;
 
-		local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
-		local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
+	tex = surf->texinfo;
+	if ((tex->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP)))
+		return 0;
+	if (!surf->samples)
+		return 0;
+
+	smax = (surf->extents[0] >> 4) + 1;
+	tmax = (surf->extents[1] >> 4) + 1;
 
-		if (!surf->samples) {
-			return;
+	frad = st->size;
+	fdist = DotProduct(st->origin, surf->plane->normal) - surf->plane->dist;
+	if ((surf->flags & SURF_PLANEBACK)) {
+		fdist *= -1;
+	}
+	frad -= fabs(fdist);
+	fminlight = gl_dlight_cutoff->value;
+	if (frad < fminlight) {
+		return 0;
+	}
+	fminlight = frad - fminlight;
+
+	impact[0] = st->origin[0] - surf->plane->normal[0] * fdist;
+	impact[1] = st->origin[1] - surf->plane->normal[1] * fdist;
+	impact[2] = st->origin[2] - surf->plane->normal[2] * fdist;
+
+	local[0] = DotProduct(impact, tex->vecs[0]) + tex->vecs[0][3] - surf->texturemins[0];
+	local[1] = DotProduct(impact, tex->vecs[1]) + tex->vecs[1][3] - surf->texturemins[1];
+
+	/*
+	 * only the texels that can be within reach, with a texel to spare
+	 * for the truncation below
+	 */
+	s0 = max(0, (int)floor((local[0] - fminlight) / 16) - 1);
+	s1 = min(smax - 1, (int)ceil((local[0] + fminlight) / 16) + 1);
+	t0 = max(0, (int)floor((local[1] - fminlight) / 16) - 1);
+	t1 = min(tmax - 1, (int)ceil((local[1] + fminlight) / 16) + 1);
+	if (s0 > s1 || t0 > t1)
+		return 0;
+
+	surf->cached_light[0] = -1;	/* have the lightmap rebuilt */
+
+	for (t = t0, ftacc = t0 * 16; t <= t1; t++, ftacc += 16) {
+		td = local[1] - ftacc;
+		if (td < 0) {
+			td = -td;
 		}
-		bl = surf->samples;
-		surf->cached_light[0] = 0;
-		for (t = 0, ftacc = 0; t < tmax; t++, ftacc += 16) {
-			td = local[1] - ftacc;
-			if (td < 0) {
-				td = -td;
+		bl = surf->samples + (t * smax + s0) * 3;
+		for (s = s0, fsacc = s0 * 16; s <= s1; s++, fsacc += 16, bl += 3) {
+			sd = Q_ftol(local[0] - fsacc);
+			if (sd < 0) {
+				sd = -sd;
 			}
-			for (s = 0, fsacc = 0; s < smax; s++, fsacc += 16, bl += 3) {
-				sd = Q_ftol(local[0] - fsacc);
-				if (sd < 0) {
-					sd = -sd;
-				}
-				fdist = (sd > td) ? sd + (td >> 1) : td + (sd >> 1);
-				if (fdist < fminlight) {
-					int		test;
-
-					for (i = 0; i < 3; i++) {
-						test = bl[i] + ((frad - fdist) * st->color[i]);
-						if (test < 255 && test > 0) {
-							col = bl[i] * st->color[i];
-							clamp(col, 0, 255);
-							bl[i] = (byte) col;
-						}
+			fdist = (sd > td) ? sd + (td >> 1) : td + (sd >> 1);
+			if (fdist < fminlight) {
+				int		test;
+
+				for (i = 0; i < 3; i++) {
+					test = bl[i] + ((frad - fdist) * st->color[i]);
+					if (test < 255 && test > 0) {
+						col = bl[i] * st->color[i];
+						clamp(col, 0, 255);
+						bl[i] = (byte) col;
 					}
 				}
 			}
 		}
 	}
 
-	R_StainNode(st, node->children[0]);
-	R_StainNode(st, node->children[1]);
+	return (s1 - s0 + 1) * (t1 - t0 + 1);
+}
+
+/*
+ * =================== R_StainNode
+ *
+ * Stainmaps, returns the number of texels looked at. ===================
+ */
+int
+R_StainNode(stain_t * st, mnode_t * node)
+{
+	msurface_t     *surf;
+	float		dist;
+	int		c, texels;
+
+	/* straight down to the node the stain straddles */
+	while (1) {
+		if (node->contents != -1)
+			return 0;
+		dist = DotProduct(st->origin, node->plane->normal) - node->plane->dist;
+		if (dist > st->size)
+			node = node->children[0];
+		else if (dist < -st->size)
+			node = node->children[1];
+		else
+			break;
+	}
+
+	texels = 0;
+	for (c = node->numsurfaces, surf = r_worldmodel->surfaces + node->firstsurface; c; c--, surf++)
+		texels += R_StainSurface(st, surf);
+
+	texels += R_StainNode(st, node->children[0]);
+	texels += R_StainNode(st, node->children[1]);
+
+	return texels;
 }
 
+/*
+ * =================== R_ClearStains
+ *
+ * Drops the stains meant for the last map. ===================
+ */
+void
+R_ClearStains(void)
+{
+	stain_head = stain_count = 0;
+}
 
 /*
  * =================== R_ApplyStains
@@ -906,9 +1252,27 @@ void
 R_ApplyStains(void)
 {
 	stain_t        *st;
-	int		i;
+	int		i, budget;
 
+	/* newest are kept when the queue overflows */
 	for (i = 0, st = r_refdef.newstains; i < r_refdef.num_newstains; i++, st++) {
-		R_StainNode(st, r_worldmodel->nodes);
+		stain_queue[(stain_head + stain_count) % MAX_STAIN_QUEUE] = *st;
+		if (stain_count < MAX_STAIN_QUEUE)
+			stain_count++;
+		else
+			stain_head = (stain_head + 1) % MAX_STAIN_QUEUE;
 	}
+	if (!stain_count || (r_refdef.rdflags & RDF_NOWORLDMODEL))
+		return;
+
+	if (gl_dlight_cutoff->value)
+		ri.Cvar_SetValue("gl_dlight_cutoff", 0);
+
+	/* at least one a frame, however big */
+	budget = gl_stainmaps_budget->value;
+	do {
+		budget -= R_StainNode(&stain_queue[stain_head], r_worldmodel->nodes);
+		stain_head = (stain_head + 1) % MAX_STAIN_QUEUE;
+		stain_count--;
+	} while (stain_count && budget > 0);
 }
@@ -100,7 +100,8 @@ typedef struct image_s {
 	
 	qboolean	is_cin;
 	float		replace_scale;
-	
+
+	struct image_s *hash_next;			/* GL_FindImage name hash */
 } image_t;
 
 #define	TEXNUM_LIGHTMAPS	1024
@@ -173,8 +174,13 @@ extern entity_t *currententity;
 extern model_t *currentmodel;
 extern int	r_visframecount;
 extern int	r_framecount;
-extern cplane_t	frustum[4];
+extern cplane_t	frustum[5];
+extern int	r_numfrustumplanes;	/* 5 while drawing a reflection */
+extern qboolean	g_drawing_refl;	/* set by gl_refl.c while a reflection is drawn */
 extern int	c_brush_polys, c_alias_polys;
+extern int	c_world_batches;
+extern int	c_lightmap_builds, c_lightmap_uploads;
+extern int	c_mark_leafs, c_mark_nodes;
 
 
 extern int	gl_filter_min, gl_filter_max;
@@ -220,6 +226,7 @@ extern cvar_t  *gl_particles;
 
 extern cvar_t  *gl_dlight_cutoff;
 extern cvar_t  *gl_stainmaps;
+extern cvar_t  *gl_stainmaps_budget;
 
 extern cvar_t  *r_model_lightlerp;
 extern cvar_t  *r_model_dlights;
@@ -305,6 +312,8 @@ extern cvar_t  *gl_flare_force_style;
 extern cvar_t  *gl_flare_intensity;
 extern cvar_t  *gl_flare_maxdist;
 extern cvar_t  *gl_flare_scale;
+extern cvar_t  *gl_flares_occlusion;
+extern cvar_t  *gl_profile;
 
 /* Knightmare- allow disabling the nVidia water warp */
 extern cvar_t  *gl_water_pixel_shader_warp;
@@ -312,13 +321,22 @@ extern cvar_t  *gl_blooms;
 extern cvar_t  *gl_glares;
 extern cvar_t  *gl_glares_size;
 extern cvar_t  *gl_glares_intens;
+extern cvar_t  *gl_glares_async;
 
 extern cvar_t  *gl_detailtextures;
+extern cvar_t  *gl_worldbatch;
+extern cvar_t  *gl_alias_floatframes;
+extern cvar_t  *gl_imagethreads;
+extern cvar_t  *gl_loadprogress;
+extern cvar_t  *gl_texcache;
+extern cvar_t  *gl_lightmapthreads;
+extern cvar_t  *gl_loadthreads;
 
 extern cvar_t  *gl_reflection_fragment_program;
 extern cvar_t  *gl_reflection;			/* MPO */
 extern cvar_t  *gl_reflection_debug;		/* MPO	for debugging the reflection */
 extern cvar_t  *gl_reflection_max;		/* MPO  max number of water reflections */
+extern cvar_t  *gl_reflection_scale;		/* reflection texture size relative to the screen */
 extern cvar_t  *gl_reflection_shader;		/* MPO	use fragment shaders */
 extern cvar_t  *gl_reflection_shader_image;
 extern cvar_t  *gl_reflection_water_surface;
@@ -362,6 +380,12 @@ typedef struct {
 	int		style;
 	vec3_t		color;
 	vec3_t		origin;
+	image_t        *image;		/* resolved when the flare is added */
+
+	mleaf_t        *leaf;		/* for PVS culling, looked up on first use */
+	qboolean	visible;
+	mleaf_t        *visleaf;	/* view leaf the trace was made from */
+	qboolean	querying;	/* occlusion query waiting to be read */
 } flare_t;
 
 extern int	r_numflares;
@@ -397,6 +421,7 @@ void		drawPlayerReflection(void);
 void		GL_DrawRadar(void);
 void		R_PreRenderDynamic(refdef_t * fd);
 void		R_RenderGlares(refdef_t * fd);
+void		R_ShutdownGlares(void);
 
 void		UpdateHardwareGamma(void);
 
@@ -421,6 +446,10 @@ void		R_RenderMirrorView(refdef_t * fd);
 void		GL_ScreenShot_f(void);
 void		GL_ScreenShot_JPG(void);
 void		GL_ScreenShot_PNG(void);
+void		GL_Capture_f(void);
+void		GL_StopCapture(void);
+void		GL_ShutdownScreenShots(void);
+void		R_CaptureFrame(void);
 void		R_DrawAliasModel(entity_t * e);
 void		R_DrawAliasMD3Model(entity_t * e);
 void		R_DrawAliasShadow(entity_t * e);
@@ -428,6 +457,7 @@ void		R_DrawBrushModel(entity_t * e);
 void		R_DrawSpriteModel(entity_t * e);
 void		R_DrawBeam(entity_t * e);
 void		R_DrawWorld(void);
+void		R_InitAliasKernels(void);
 void		R_RenderDlights(void);
 void		R_DrawAlphaSurfaces(void);
 void		R_DrawAlphaSurfaces_Jitspoe(void);
@@ -439,6 +469,8 @@ void		GL_SubdivideLightmappedSurface(msurface_t * fa, float subdivide_size);	/*
 qboolean	R_CullBox(vec3_t mins, vec3_t maxs);
 void		R_RotateForEntity(entity_t * e);
 void		R_MarkLeaves(void);
+void		R_MarkReflLeaves(int *clusters, int numclusters);
+void		R_ViewClusters(vec3_t org, int *cluster, int *cluster2);
 void		MYgluPerspective(GLdouble fovy, GLdouble aspect, GLdouble zNear, GLdouble zFar); /* MPO */
 double		calc_wave(GLfloat x, GLfloat y);	/* Dukey */
 
@@ -448,6 +480,8 @@ void		R_AddSkySurface(msurface_t * fa);
 void		R_ClearSkyBox(void);
 void		R_DrawSkyBox(void);
 void		R_MarkLights(dlight_t * light, int bit, mnode_t * node);
+void		R_BuildLightMaps(msurface_t ** surfs, byte ** dests, int count, int stride);
+void		R_StopLightMapWorkers(void);
 void		R_MarkStains(dlight_t * light, int bit, mnode_t * node);
 void		GL_ClearDecals(void);
 void		R_AddDecals(void);
@@ -469,7 +503,11 @@ void		Draw_Fill (int x, int y, int w, int h, int c);
 void		Draw_FadeScreen(void);
 void		Draw_FadeBox(int x, int y, int w, int h, float alpha);
 void		Draw_StretchRaw(int x, int y, int w, int h, int cols, int rows, byte * data);
+void		Draw_LoadingProgress(int done, int total);
+void		Draw_Flush2D(void);
 image_t        *Draw_FindPic(char *name);	/* MPO need this so we can call this method in gl_refl.c */
+image_t        *Draw_FindWholePic(char *name);
+extern qboolean	scrap_skip;
 
 void		R_BeginFrame(float camera_separation);
 void		R_SwapBuffers(int);
@@ -491,6 +529,7 @@ image_t        *GL_LoadPic(char *name, byte * pic, int width, int height, imaget
 image_t        *GL_FindImage(char *name, imagetype_t type);
 void		GL_TextureMode(char *string);
 void		GL_ImageList_f(void);
+void		GL_ImageBench_f(void);
 
 void		GL_SetTexturePalette(unsigned palette[256]);
 
@@ -499,15 +538,48 @@ void		GL_ShutdownImages(void);
 
 void		GL_FreeUnusedImages(void);
 
+qboolean	GL_QueueImage(char *name, imagetype_t type);
+void		GL_FinishImageJobs(void);
+
+extern qboolean	r_registering;	/* between R_BeginRegistration and R_EndRegistration */
+
+qboolean	R_ProbeFailed(char *name);
+void		R_MarkProbeFailed(char *name);
+void		R_ClearFailedProbes(void);
+
 void		GL_TextureAlphaMode(char *string);
 void		GL_TextureSolidMode(char *string);
 
 void		R_ApplyStains(void);
-void		R_StainNode(stain_t * st, mnode_t * node);
+void		R_ClearStains(void);
+int		R_StainNode(stain_t * st, mnode_t * node);
 
 void		R_RenderFlares(void);
 void		R_RenderFlare(flare_t *light);
 void		GL_AddFlareSurface(msurface_t * surf);
+void		GL_ClearFlares(void);
+void		GL_RegisterFlares(void);
+void		GL_ShutdownFlares(void);
+
+/* gl_profile.c, exclusive per section timings */
+typedef enum {
+	PROF_REFRESH,		/* rest of R_RenderFrame */
+	PROF_MARKLEAVES,
+	PROF_WORLD,
+	PROF_ENTITIES,
+	PROF_PARTICLES,
+	PROF_DECALS,
+	PROF_GLARES,
+	PROF_REFLECTIONS,	/* everything drawn into reflection textures */
+	PROF_2D,
+	PROF_NUM_SECTIONS
+} profsection_t;
+
+void		R_ProfileBegin(profsection_t section);
+void		R_ProfileEnd(profsection_t section);
+void		R_ProfileFrame(void);
+void		R_GetProfile(refprofile_t * profile);
+void		R_ShutdownProfile(void);
 
 
 /*
@@ -623,6 +695,10 @@ typedef struct {
 	qboolean	hwgamma;
 	qboolean	fragment_program;	/* MPO does gfx support fragment programs */
 	qboolean	nv_fog;
+	qboolean	vbo;			/* GL_ARB_vertex_buffer_object */
+	qboolean	pbo;			/* GL_ARB_pixel_buffer_object, for async readback */
+	qboolean	occlusion;		/* GL_ARB_occlusion_query */
+	qboolean	timerquery;		/* GL_ARB_timer_query, for gl_profile 2 */
 
 } glstate_t;
 
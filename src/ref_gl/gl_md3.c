@@ -31,6 +31,10 @@
  */
 #include "gl_local.h"
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+
 float		shadelight_md3[3];
 
 m_dlight_t	model_dlights_md3[MAX_MODEL_DLIGHTS];
@@ -42,54 +46,92 @@ extern cvar_t  *gl_shading;
  * ================= Mod_LoadAliasMD3Model =================
  */
 
-//
-/* Some Vic code here not fully used */
-//
+/*
+ * ================ R_BuildTriangleNeighbors ================
+ *
+ * For each edge a->b of a triangle the neighbour is the highest numbered
+ * other triangle using the edge as b->a.  Edges used by more than two
+ * triangles, in either direction, are treated as seams.  The directed edges
+ * are hashed on their unordered vertex pair, so this is linear in the number
+ * of triangles instead of quadratic.
+ */
+typedef struct {
+	index_t		u, v;
+	int		tri;
+	int		next;
+} md3edge_t;
+
+#define	MD3_EDGE_HASH(a, b)	((a) < (b) ? ((a) * 0x9e3779b1u) ^ (b) : ((b) * 0x9e3779b1u) ^ (a))
 
-int
-R_FindTriangleWithEdge(index_t * indexes, int numtris, index_t start, index_t end, int ignore)
+void
+R_BuildTriangleNeighbors(int *neighbors, index_t * indexes, int numtris)
 {
-	int		i;
-	int		match, count;
-
-	count = 0;
-	match = -1;
-
-	for (i = 0; i < numtris; i++, indexes += 3) {
-		if ((indexes[0] == start && indexes[1] == end)
-		    || (indexes[1] == start && indexes[2] == end)
-		    || (indexes[2] == start && indexes[0] == end)) {
-			if (i != ignore)
-				match = i;
-			count++;
-		} else if ((indexes[1] == start && indexes[0] == end)
-			    || (indexes[2] == start && indexes[1] == end)
-		    || (indexes[0] == start && indexes[2] == end)) {
-			count++;
+	int		i, k, e, match, count, lasttri;
+	int		hashsize, *hashhead;
+	unsigned	h;
+	index_t		a, b, *index;
+	md3edge_t      *edges, *edge;
+
+	if (numtris <= 0)
+		return;
+
+	for (hashsize = 64; hashsize < numtris * 6; hashsize <<= 1);
+	hashhead = malloc(hashsize * sizeof(*hashhead));
+	edges = malloc(numtris * 3 * sizeof(*edges));
+	if (!hashhead || !edges)
+		ri.Sys_Error(ERR_DROP, "R_BuildTriangleNeighbors: out of memory");
+	memset(hashhead, -1, hashsize * sizeof(*hashhead));
+
+	/*
+	 * Triangles go in in ascending order and are pushed on the chain head,
+	 * so every chain runs in descending triangle order and the edges of one
+	 * triangle sit next to each other.
+	 */
+	for (i = 0, index = indexes, edge = edges; i < numtris; i++, index += 3) {
+		for (k = 0; k < 3; k++, edge++) {
+			edge->u = index[k];
+			edge->v = index[(k + 1) % 3];
+			edge->tri = i;
+			h = MD3_EDGE_HASH(edge->u, edge->v) & (hashsize - 1);
+			edge->next = hashhead[h];
+			hashhead[h] = edge - edges;
 		}
 	}
 
-	/* detect edges shared by three triangles and make them seams */
-	if (count > 2)
-		match = -1;
-
-	return match;
-}
+	for (i = 0, index = indexes; i < numtris; i++, index += 3) {
+		for (k = 0; k < 3; k++) {
+			a = index[k];
+			b = index[(k + 1) % 3];
+			h = MD3_EDGE_HASH(a, b) & (hashsize - 1);
+
+			match = -1;
+			count = 0;
+			lasttri = -1;
+			for (e = hashhead[h]; e != -1; e = edge->next) {
+				edge = &edges[e];
+				if (edge->u == b && edge->v == a) {
+					if (match == -1 && edge->tri != i)
+						match = edge->tri;
+				} else if (edge->u != a || edge->v != b) {
+					continue;
+				}
+				/* a triangle is only counted once per edge */
+				if (edge->tri != lasttri) {
+					lasttri = edge->tri;
+					count++;
+				}
+			}
 
-/*
- * =============== R_BuildTriangleNeighbors ===============
- */
-void
-R_BuildTriangleNeighbors(int *neighbors, index_t * indexes, int numtris)
-{
-	int		i, *n;
-	index_t        *index;
+			/* detect edges shared by three triangles and make them seams */
+			if (count > 2)
+				match = -1;
 
-	for (i = 0, index = indexes, n = neighbors; i < numtris; i++, index += 3, n += 3) {
-		n[0] = R_FindTriangleWithEdge(indexes, numtris, index[1], index[0], i);
-		n[1] = R_FindTriangleWithEdge(indexes, numtris, index[2], index[1], i);
-		n[2] = R_FindTriangleWithEdge(indexes, numtris, index[0], index[2], i);
+			neighbors[i * 3 + k] = match;
+		}
 	}
+
+	free(edges);
+	free(hashhead);
 }
 
 //
@@ -117,6 +159,8 @@ Mod_LoadAliasMD3Model(model_t * mod, void *buffer)
 	maliasmodel_t  *poutmodel;
 	char		name[MAX_QPATH];
 	float		lat, lng;
+	long long	adjtime, start;
+	int		adjtris;
 
 	pinmodel = (dmd3_t *) buffer;
 	version = LittleLong(pinmodel->version);
@@ -192,6 +236,8 @@ Mod_LoadAliasMD3Model(model_t * mod, void *buffer)
 	/* load the meshes */
 	pinmesh = (dmd3mesh_t *) ((byte *) pinmodel + LittleLong(pinmodel->ofs_meshes));
 	poutmesh = poutmodel->meshes = Hunk_Alloc(sizeof(maliasmesh_t) * poutmodel->num_meshes);
+	adjtime = 0;
+	adjtris = 0;
 
 	for (i = 0; i < poutmodel->num_meshes; i++, poutmesh++) {
 		memcpy(poutmesh->name, pinmesh->name, MD3_MAX_PATH);
@@ -276,10 +322,15 @@ Mod_LoadAliasMD3Model(model_t * mod, void *buffer)
 		pinmesh = (dmd3mesh_t *) ((byte *) pinmesh + LittleLong(pinmesh->meshsize));
 
 		poutmesh->trneighbors = Hunk_Alloc(sizeof(int) * poutmesh->num_tris * 3);
+		start = Sys_Microseconds();
 		R_BuildTriangleNeighbors(poutmesh->trneighbors, poutmesh->indexes, poutmesh->num_tris);
-
+		adjtime += Sys_Microseconds() - start;
+		adjtris += poutmesh->num_tris;
 	}
 	mod->type = mod_alias_md3;
+
+	ri.Con_Printf(PRINT_DEVELOPER, "%s: adjacency for %d triangles in %.3f ms\n",
+	    mod->name, adjtris, adjtime / 1000.0);
 }
 
 void
@@ -314,6 +365,35 @@ light_md3_model(vec3_t normal, vec3_t color)
 		color[0] = color[1] = color[2] = 0;
 }
 
+/* padded to four floats for SSE and vertex arrays */
+static vec4_t	md3_lerped[MD3_MAX_VERTS];
+
+/*
+ * ================ GL_LerpMD3Verts ================
+ */
+static void
+GL_LerpMD3Verts(int nverts, const maliasvertex_t * v, const maliasvertex_t * ov, float *lerp,
+    const float move[3], float frontlerp, float backlerp)
+{
+	int		i;
+#if idsse2
+	__m128		m = _mm_setr_ps(move[0], move[1], move[2], 0);
+	__m128		f = _mm_set1_ps(frontlerp);
+	__m128		b = _mm_set1_ps(backlerp);
+
+	/* the fourth lane picks up normal[0] and is never read back */
+	for (i = 0; i < nverts; i++, v++, ov++, lerp += 4)
+		_mm_storeu_ps(lerp, _mm_add_ps(m, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ov->point), b),
+		    _mm_mul_ps(_mm_loadu_ps(v->point), f))));
+#else
+	for (i = 0; i < nverts; i++, v++, ov++, lerp += 4) {
+		lerp[0] = move[0] + ov->point[0] * backlerp + v->point[0] * frontlerp;
+		lerp[1] = move[1] + ov->point[1] * backlerp + v->point[1] * frontlerp;
+		lerp[2] = move[2] + ov->point[2] * backlerp + v->point[2] * frontlerp;
+	}
+#endif
+}
+
 void
 GL_DrawAliasMD3FrameLerp(maliasmodel_t * paliashdr, maliasmesh_t mesh, float backlerp)
 {
@@ -321,8 +401,7 @@ GL_DrawAliasMD3FrameLerp(maliasmodel_t * paliashdr, maliasmesh_t mesh, float bac
 	maliasframe_t  *frame, *oldframe;
 	vec3_t		move, delta, vectors[3];
 	maliasvertex_t *v, *ov;
-	vec3_t		tempVertexArray[4096];
-	vec3_t		tempNormalsArray[4096];
+	vec3_t		tempNormalsArray[MD3_MAX_VERTS];
 	vec3_t		color1, color2, color3;
 	float		alpha;
 	float		frontlerp;
@@ -360,6 +439,29 @@ GL_DrawAliasMD3FrameLerp(maliasmodel_t * paliashdr, maliasmesh_t mesh, float bac
 		move[i] = backlerp * move[i] + frontlerp * frame->translate[i];
 	}
 
+	v = mesh.vertexes + currententity->frame * mesh.num_verts;
+	ov = mesh.vertexes + currententity->oldframe * mesh.num_verts;
+	GL_LerpMD3Verts(mesh.num_verts, v, ov, md3_lerped[0], move, frontlerp, backlerp);
+
+	if (gl_vertex_arrays->value) {
+		/* the per vertex colors below all come out as shadelight_md3 */
+		qglColor4f(shadelight_md3[0], shadelight_md3[1], shadelight_md3[2], alpha);
+
+		qglEnableClientState(GL_VERTEX_ARRAY);
+		qglVertexPointer(3, GL_FLOAT, 16, md3_lerped);
+		qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+		qglTexCoordPointer(2, GL_FLOAT, sizeof(maliascoord_t), mesh.stcoords);
+
+		qglDrawElements(GL_TRIANGLES, mesh.num_tris * 3, GL_UNSIGNED_INT, mesh.indexes);
+
+		qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+		qglDisableClientState(GL_VERTEX_ARRAY);
+
+		if (currententity->flags & (RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE | RF_SHELL_HALF_DAM))
+			qglEnable(GL_TEXTURE_2D);
+		return;
+	}
+
 	v = mesh.vertexes + currententity->frame * mesh.num_verts;
 	ov = mesh.vertexes + currententity->oldframe * mesh.num_verts;
 	for (i = 0; i < mesh.num_verts; i++, v++, ov++) {
@@ -367,10 +469,6 @@ GL_DrawAliasMD3FrameLerp(maliasmodel_t * paliashdr, maliasmesh_t mesh, float bac
 		    v->normal[0] + (ov->normal[0] - v->normal[0]) * backlerp,
 		    v->normal[1] + (ov->normal[1] - v->normal[1]) * backlerp,
 		    v->normal[2] + (ov->normal[2] - v->normal[2]) * backlerp);
-		VectorSet(tempVertexArray[i],
-		    move[0] + ov->point[0] * backlerp + v->point[0] * frontlerp,
-		    move[1] + ov->point[1] * backlerp + v->point[1] * frontlerp,
-		    move[2] + ov->point[2] * backlerp + v->point[2] * frontlerp);
 	}
 	qglBegin(GL_TRIANGLES);
 
@@ -383,15 +481,15 @@ GL_DrawAliasMD3FrameLerp(maliasmodel_t * paliashdr, maliasmesh_t mesh, float bac
 		}
 		qglColor4f(shadelight_md3[0], shadelight_md3[1], shadelight_md3[2], alpha);
 		qglTexCoord2f(mesh.stcoords[mesh.indexes[3 * j + 0]].st[0], mesh.stcoords[mesh.indexes[3 * j + 0]].st[1]);
-		qglVertex3fv(tempVertexArray[mesh.indexes[3 * j + 0]]);
+		qglVertex3fv(md3_lerped[mesh.indexes[3 * j + 0]]);
 
 		qglColor4f(shadelight_md3[0], shadelight_md3[1], shadelight_md3[2], alpha);
 		qglTexCoord2f(mesh.stcoords[mesh.indexes[3 * j + 1]].st[0], mesh.stcoords[mesh.indexes[3 * j + 1]].st[1]);
-		qglVertex3fv(tempVertexArray[mesh.indexes[3 * j + 1]]);
+		qglVertex3fv(md3_lerped[mesh.indexes[3 * j + 1]]);
 
 		qglColor4f(shadelight_md3[0], shadelight_md3[1], shadelight_md3[2], alpha);
 		qglTexCoord2f(mesh.stcoords[mesh.indexes[3 * j + 2]].st[0], mesh.stcoords[mesh.indexes[3 * j + 2]].st[1]);
-		qglVertex3fv(tempVertexArray[mesh.indexes[3 * j + 2]]);
+		qglVertex3fv(md3_lerped[mesh.indexes[3 * j + 2]]);
 	}
 	qglEnd();
 
@@ -23,6 +23,13 @@
 
 #include "gl_refl.h"		/* MPO */
 
+#if idsse2
+#include <emmintrin.h>
+#endif
+#if idavx2
+#include <immintrin.h>
+#endif
+
 /*
  * =============================================================
  *
@@ -39,6 +46,18 @@ float		r_avertexnormals[NUMVERTEXNORMALS][3] = {
 
 static vec4_t	s_lerped[MAX_VERTS];
 
+/* per draw vertex arrays for GL_DrawAliasArrays */
+static vec4_t	s_drawverts[MAX_ALIAS_DRAWVERTS];
+static vec4_t	s_drawcolors[MAX_ALIAS_DRAWVERTS];
+static vec3_t	s_drawnormals[MAX_ALIAS_DRAWVERTS];
+static float	s_drawst[MAX_ALIAS_DRAWVERTS][2];
+
+#if idavx2
+static qboolean	r_alias_avx2;
+#endif
+
+extern qboolean	g_glLighting;
+
 extern vec3_t	lightspot;
 
 vec3_t		viewdir;
@@ -60,28 +79,301 @@ float		r_avertexnormal_dots[SHADEDOT_QUANT][256] =
 
 float          *shadedots = r_avertexnormal_dots[0];
 
+#define RF_SHELL_ANY	(RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE | RF_SHELL_HALF_DAM)
+
+/*
+ * ================ GL_LerpVerts_C ================
+ */
+static void
+GL_LerpVerts_C(int nverts, const dtrivertx_t * v, const dtrivertx_t * ov, float *lerp,
+    const float move[3], const float frontv[3], const float backv[3])
+{
+	int		i;
+
+	for (i = 0; i < nverts; i++, v++, ov++, lerp += 4) {
+		lerp[0] = move[0] + ov->v[0] * backv[0] + v->v[0] * frontv[0];
+		lerp[1] = move[1] + ov->v[1] * backv[1] + v->v[1] * frontv[1];
+		lerp[2] = move[2] + ov->v[2] * backv[2] + v->v[2] * frontv[2];
+	}
+}
+
+#if idsse2
+/*
+ * dtrivertx_t is four bytes, so one vertex widens into one register with the
+ * light normal index in w, which the zero w of the scales drops again
+ */
+static void
+GL_LerpVerts_SSE2(int nverts, const dtrivertx_t * v, const dtrivertx_t * ov, float *lerp,
+    const float move[3], const float frontv[3], const float backv[3])
+{
+	__m128		m = _mm_setr_ps(move[0], move[1], move[2], 0);
+	__m128		f = _mm_setr_ps(frontv[0], frontv[1], frontv[2], 0);
+	__m128		b = _mm_setr_ps(backv[0], backv[1], backv[2], 0);
+	__m128i		zero = _mm_setzero_si128();
+	__m128i		pv, pov, lo, olo, hi, ohi;
+	int		i;
+
+	for (i = 0; i + 4 <= nverts; i += 4, lerp += 16) {
+		pv = _mm_loadu_si128((const __m128i *)(v + i));
+		pov = _mm_loadu_si128((const __m128i *)(ov + i));
+		lo = _mm_unpacklo_epi8(pv, zero);
+		hi = _mm_unpackhi_epi8(pv, zero);
+		olo = _mm_unpacklo_epi8(pov, zero);
+		ohi = _mm_unpackhi_epi8(pov, zero);
+
+#define LERP_ONE(vw, ovw, out) \
+		_mm_storeu_ps((out), _mm_add_ps(m, _mm_add_ps( \
+		    _mm_mul_ps(_mm_cvtepi32_ps(ovw), b), \
+		    _mm_mul_ps(_mm_cvtepi32_ps(vw), f))))
+
+		LERP_ONE(_mm_unpacklo_epi16(lo, zero), _mm_unpacklo_epi16(olo, zero), lerp);
+		LERP_ONE(_mm_unpackhi_epi16(lo, zero), _mm_unpackhi_epi16(olo, zero), lerp + 4);
+		LERP_ONE(_mm_unpacklo_epi16(hi, zero), _mm_unpacklo_epi16(ohi, zero), lerp + 8);
+		LERP_ONE(_mm_unpackhi_epi16(hi, zero), _mm_unpackhi_epi16(ohi, zero), lerp + 12);
+#undef LERP_ONE
+	}
+
+	GL_LerpVerts_C(nverts - i, v + i, ov + i, lerp, move, frontv, backv);
+}
+#endif
+
+#if idavx2
+static AVX2_FUNC void
+GL_LerpVerts_AVX2(int nverts, const dtrivertx_t * v, const dtrivertx_t * ov, float *lerp,
+    const float move[3], const float frontv[3], const float backv[3])
+{
+	__m256		m = _mm256_setr_ps(move[0], move[1], move[2], 0, move[0], move[1], move[2], 0);
+	__m256		f = _mm256_setr_ps(frontv[0], frontv[1], frontv[2], 0, frontv[0], frontv[1], frontv[2], 0);
+	__m256		b = _mm256_setr_ps(backv[0], backv[1], backv[2], 0, backv[0], backv[1], backv[2], 0);
+	__m256		pv, pov;
+	int		i;
+
+	/* two vertexes per register */
+	for (i = 0; i + 2 <= nverts; i += 2, lerp += 8) {
+		pv = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(v + i))));
+		pov = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(ov + i))));
+		_mm256_storeu_ps(lerp, _mm256_add_ps(m, _mm256_add_ps(_mm256_mul_ps(pov, b), _mm256_mul_ps(pv, f))));
+	}
+
+	GL_LerpVerts_C(nverts - i, v + i, ov + i, lerp, move, frontv, backv);
+}
+#endif
+
+#if !idsse2
+/*
+ * ================ GL_LerpFloatVerts_C
+ *
+ * Lerps preconverted frames (maliasarrays_t frames), where scale and
+ * translate are already applied ================
+ */
+static void
+GL_LerpFloatVerts_C(int nverts, int pad, const float *fv, const float *ofv, float *lerp,
+    const float move[3], float frontlerp, float backlerp)
+{
+	int		i, k;
+
+	for (i = 0; i < nverts; i++, lerp += 4) {
+		for (k = 0; k < 3; k++)
+			lerp[k] = move[k] + ofv[k * pad + i] * backlerp + fv[k * pad + i] * frontlerp;
+	}
+}
+
+#endif
+
+#if idsse2
+static void
+GL_LerpFloatVerts_SSE2(int nverts, int pad, const float *fv, const float *ofv, float *lerp,
+    const float move[3], float frontlerp, float backlerp)
+{
+	__m128		f = _mm_set1_ps(frontlerp);
+	__m128		b = _mm_set1_ps(backlerp);
+	__m128		mx = _mm_set1_ps(move[0]);
+	__m128		my = _mm_set1_ps(move[1]);
+	__m128		mz = _mm_set1_ps(move[2]);
+	__m128		x, y, z, w;
+	int		i;
+
+	/* frames are padded to 8 and s_lerped is MAX_VERTS long */
+	for (i = 0; i < nverts; i += 4, lerp += 16) {
+		x = _mm_add_ps(mx, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ofv + i), b),
+		    _mm_mul_ps(_mm_loadu_ps(fv + i), f)));
+		y = _mm_add_ps(my, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ofv + pad + i), b),
+		    _mm_mul_ps(_mm_loadu_ps(fv + pad + i), f)));
+		z = _mm_add_ps(mz, _mm_add_ps(_mm_mul_ps(_mm_loadu_ps(ofv + 2 * pad + i), b),
+		    _mm_mul_ps(_mm_loadu_ps(fv + 2 * pad + i), f)));
+		w = _mm_setzero_ps();
+
+		_MM_TRANSPOSE4_PS(x, y, z, w);
+		_mm_storeu_ps(lerp, x);
+		_mm_storeu_ps(lerp + 4, y);
+		_mm_storeu_ps(lerp + 8, z);
+		_mm_storeu_ps(lerp + 12, w);
+	}
+}
+#endif
+
+#if idavx2
+static AVX2_FUNC void
+GL_LerpFloatVerts_AVX2(int nverts, int pad, const float *fv, const float *ofv, float *lerp,
+    const float move[3], float frontlerp, float backlerp)
+{
+	__m256		f = _mm256_set1_ps(frontlerp);
+	__m256		b = _mm256_set1_ps(backlerp);
+	__m256		mx = _mm256_set1_ps(move[0]);
+	__m256		my = _mm256_set1_ps(move[1]);
+	__m256		mz = _mm256_set1_ps(move[2]);
+	__m256		x, y, z;
+	__m128		x0, y0, z0, w0, x1, y1, z1, w1;
+	int		i;
+
+	for (i = 0; i < nverts; i += 8, lerp += 32) {
+		x = _mm256_add_ps(mx, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(ofv + i), b),
+		    _mm256_mul_ps(_mm256_loadu_ps(fv + i), f)));
+		y = _mm256_add_ps(my, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(ofv + pad + i), b),
+		    _mm256_mul_ps(_mm256_loadu_ps(fv + pad + i), f)));
+		z = _mm256_add_ps(mz, _mm256_add_ps(_mm256_mul_ps(_mm256_loadu_ps(ofv + 2 * pad + i), b),
+		    _mm256_mul_ps(_mm256_loadu_ps(fv + 2 * pad + i), f)));
+
+		x0 = _mm256_castps256_ps128(x);
+		y0 = _mm256_castps256_ps128(y);
+		z0 = _mm256_castps256_ps128(z);
+		w0 = _mm_setzero_ps();
+		x1 = _mm256_extractf128_ps(x, 1);
+		y1 = _mm256_extractf128_ps(y, 1);
+		z1 = _mm256_extractf128_ps(z, 1);
+		w1 = _mm_setzero_ps();
+
+		_MM_TRANSPOSE4_PS(x0, y0, z0, w0);
+		_MM_TRANSPOSE4_PS(x1, y1, z1, w1);
+		_mm256_storeu_ps(lerp, _mm256_insertf128_ps(_mm256_castps128_ps256(x0), y0, 1));
+		_mm256_storeu_ps(lerp + 8, _mm256_insertf128_ps(_mm256_castps128_ps256(z0), w0, 1));
+		_mm256_storeu_ps(lerp + 16, _mm256_insertf128_ps(_mm256_castps128_ps256(x1), y1, 1));
+		_mm256_storeu_ps(lerp + 24, _mm256_insertf128_ps(_mm256_castps128_ps256(z1), w1, 1));
+	}
+}
+#endif
+
+/*
+ * ================ GL_AddShellNormals ================
+ */
+static void
+GL_AddShellNormals(int nverts, const dtrivertx_t * verts, float *lerp)
+{
+	int		i;
+	float          *normal;
+
+	for (i = 0; i < nverts; i++, lerp += 4) {
+		normal = r_avertexnormals[verts[i].lightnormalindex];
+		lerp[0] += normal[0] * POWERSUIT_SCALE;
+		lerp[1] += normal[1] * POWERSUIT_SCALE;
+		lerp[2] += normal[2] * POWERSUIT_SCALE;
+	}
+}
+
 void
 GL_LerpVerts(int nverts, dtrivertx_t * v, dtrivertx_t * ov, dtrivertx_t * verts, float *lerp, float move[3], float frontv[3], float backv[3])
 {
-	int		i;
+#if idavx2
+	if (r_alias_avx2)
+		GL_LerpVerts_AVX2(nverts, v, ov, lerp, move, frontv, backv);
+	else
+#endif
+#if idsse2
+		GL_LerpVerts_SSE2(nverts, v, ov, lerp, move, frontv, backv);
+#else
+		GL_LerpVerts_C(nverts, v, ov, lerp, move, frontv, backv);
+#endif
 
 	/* PMM -- added RF_SHELL_DOUBLE, RF_SHELL_HALF_DAM */
-	if (currententity->flags & (RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE | RF_SHELL_HALF_DAM)) {
-		for (i = 0; i < nverts; i++, v++, ov++, lerp += 4) {
-			float          *normal = r_avertexnormals[verts[i].lightnormalindex];
+	if (currententity->flags & RF_SHELL_ANY)
+		GL_AddShellNormals(nverts, verts, lerp);
+}
+
+/*
+ * ================ GL_LerpFloatVerts ================
+ */
+static void
+GL_LerpFloatVerts(int nverts, maliasarrays_t * arrays, dtrivertx_t * verts, float *lerp,
+    float move[3], float frontlerp, float backlerp)
+{
+	const float    *fv, *ofv;
+	int		pad = arrays->frame_stride / 3;
+
+	fv = arrays->frames + currententity->frame * arrays->frame_stride;
+	ofv = arrays->frames + currententity->oldframe * arrays->frame_stride;
 
-			lerp[0] = move[0] + ov->v[0] * backv[0] + v->v[0] * frontv[0] + normal[0] * POWERSUIT_SCALE;
-			lerp[1] = move[1] + ov->v[1] * backv[1] + v->v[1] * frontv[1] + normal[1] * POWERSUIT_SCALE;
-			lerp[2] = move[2] + ov->v[2] * backv[2] + v->v[2] * frontv[2] + normal[2] * POWERSUIT_SCALE;
+#if idavx2
+	if (r_alias_avx2)
+		GL_LerpFloatVerts_AVX2(nverts, pad, fv, ofv, lerp, move, frontlerp, backlerp);
+	else
+#endif
+#if idsse2
+		GL_LerpFloatVerts_SSE2(nverts, pad, fv, ofv, lerp, move, frontlerp, backlerp);
+#else
+		GL_LerpFloatVerts_C(nverts, pad, fv, ofv, lerp, move, frontlerp, backlerp);
+#endif
+
+	if (currententity->flags & RF_SHELL_ANY)
+		GL_AddShellNormals(nverts, verts, lerp);
+}
+
+/*
+ * ================ GL_GatherAliasVerts
+ *
+ * Copies the lerped frame vertexes out to the draw vertexes and shades them
+ * the way the glcmd loop does, through shadedots.  colors may be NULL.
+ * ================
+ */
+static void
+GL_GatherAliasVerts(maliasarrays_t * arrays, dtrivertx_t * verts, float *colors, float alpha)
+{
+	int		i, x;
+	float		l;
+#if idsse2
+	__m128		shade = _mm_setr_ps(shadelight[0], shadelight[1], shadelight[2], 0);
+	__m128		a = _mm_setr_ps(0, 0, 0, alpha);
+
+	for (i = 0; i < arrays->num_verts; i++) {
+		x = arrays->xyz[i];
+		_mm_storeu_ps(s_drawverts[i], _mm_loadu_ps(s_lerped[x]));
+		if (colors) {
+			l = shadedots[verts[x].lightnormalindex];
+			_mm_storeu_ps(colors + i * 4, _mm_add_ps(_mm_mul_ps(_mm_set1_ps(l), shade), a));
 		}
-	} else {
-		for (i = 0; i < nverts; i++, v++, ov++, lerp += 4) {
-			lerp[0] = move[0] + ov->v[0] * backv[0] + v->v[0] * frontv[0];
-			lerp[1] = move[1] + ov->v[1] * backv[1] + v->v[1] * frontv[1];
-			lerp[2] = move[2] + ov->v[2] * backv[2] + v->v[2] * frontv[2];
+	}
+#else
+	for (i = 0; i < arrays->num_verts; i++) {
+		x = arrays->xyz[i];
+		Vector4Copy(s_lerped[x], s_drawverts[i]);
+		if (colors) {
+			l = shadedots[verts[x].lightnormalindex];
+			colors[i * 4 + 0] = l * shadelight[0];
+			colors[i * 4 + 1] = l * shadelight[1];
+			colors[i * 4 + 2] = l * shadelight[2];
+			colors[i * 4 + 3] = alpha;
 		}
 	}
+#endif
+}
 
+/*
+ * ================ R_InitAliasKernels ================
+ */
+void
+R_InitAliasKernels(void)
+{
+#if idavx2
+	r_alias_avx2 = Sys_HaveAVX2() ? true : false;
+	if (r_alias_avx2) {
+		ri.Con_Printf(PRINT_ALL, "Alias model lerp: AVX2\n");
+		return;
+	}
+#endif
+#if idsse2
+	ri.Con_Printf(PRINT_ALL, "Alias model lerp: SSE2\n");
+#else
+	ri.Con_Printf(PRINT_ALL, "Alias model lerp: C\n");
+#endif
 }
 
 /*
@@ -210,11 +502,85 @@ lightAliasModel(vec3_t baselight, dtrivertx_t * verts, dtrivertx_t * ov, float b
 	}
 }
 
+/*
+ * ============= GL_DrawAliasArrays
+ *
+ * Vertex array version of the glcmd loops below, one glDrawElements for the
+ * whole frame =============
+ */
+static void
+GL_DrawAliasArrays(maliasarrays_t * arrays, dtrivertx_t * verts, float alpha)
+{
+	qboolean	shell, colored;
+	float		highest, *c;
+	int		i, j;
+	float		cellcolors[16] = {
+		0.1, 0.1,
+		0.3, 0.3, 0.3,
+		0.5, 0.5, 0.5, 0.5,
+		1.0, 1.0, 1.0, 1.0, 1.0, 1.0
+	};
+
+	shell = (currententity->flags & RF_SHELL_ANY) ? true : false;
+	colored = !shell && !(currententity->flags & RF_TRANS_ADDITIVE);
+
+	GL_GatherAliasVerts(arrays, verts, colored ? s_drawcolors[0] : NULL, alpha);
+
+	if (colored && r_cellshading->value && !(currententity->flags & RF_TRANSLUCENT)) {
+		for (i = 0, c = s_drawcolors[0]; i < arrays->num_verts; i++, c += 4) {
+			highest = 0;
+			for (j = 0; j < 3; j++) {
+				c[j] = cellcolors[(int)(c[j] * 16.0) & 15];
+				if (c[j] > highest)
+					highest = c[j];
+			}
+			c[0] = c[1] = c[2] = highest;
+		}
+	}
+
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglVertexPointer(3, GL_FLOAT, 16, s_drawverts);
+
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	if (shell) {
+		/* c14 shell texture scrolls with the vertexes */
+		for (i = 0; i < arrays->num_verts; i++) {
+			s_drawst[i][0] = (s_drawverts[i][1] + s_drawverts[i][0]) / 40.0;
+			s_drawst[i][1] = s_drawverts[i][2] / 40.0 - r_refdef.time / 2.0;
+		}
+		qglTexCoordPointer(2, GL_FLOAT, 0, s_drawst);
+
+		if (!(currententity->flags & RF_TRANS_ADDITIVE))
+			qglColor4f(shadelight[0], shadelight[1], shadelight[2], 1.0);
+	} else {
+		qglTexCoordPointer(2, GL_FLOAT, 0, arrays->st);
+
+		if (colored) {
+			qglEnableClientState(GL_COLOR_ARRAY);
+			qglColorPointer(4, GL_FLOAT, 0, s_drawcolors);
+		}
+		if (g_glLighting) {
+			for (i = 0; i < arrays->num_verts; i++)
+				VectorCopy(r_avertexnormals[verts[arrays->xyz[i]].lightnormalindex], s_drawnormals[i]);
+			qglEnableClientState(GL_NORMAL_ARRAY);
+			qglNormalPointer(GL_FLOAT, 0, s_drawnormals);
+		}
+	}
+
+	qglDrawElements(GL_TRIANGLES, arrays->num_indexes, GL_UNSIGNED_SHORT, arrays->indexes);
+
+	qglDisableClientState(GL_NORMAL_ARRAY);
+	qglDisableClientState(GL_COLOR_ARRAY);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglDisableClientState(GL_VERTEX_ARRAY);
+}
+
 extern image_t *draw_chars;
 void
 GL_DrawAliasFrameLerp(dmdl_t * paliashdr, float backlerp)
 {
 	float		l;
+	maliasarrays_t *arrays = currentmodel->aliasarrays;
 	daliasframe_t  *frame, *oldframe;
 	dtrivertx_t    *v, *ov, *verts;
 	int            *order;
@@ -258,95 +624,30 @@ GL_DrawAliasFrameLerp(dmdl_t * paliashdr, float backlerp)
 	move[1] = -DotProduct(delta, vectors[1]);	/* left */
 	move[2] = DotProduct(delta, vectors[2]);	/* up */
 
-	VectorAdd(move, oldframe->translate, move);
-
-	for (i = 0; i < 3; i++) {
-		move[i] = backlerp * move[i] + frontlerp * frame->translate[i];
-	}
-
-	for (i = 0; i < 3; i++) {
-		frontv[i] = frontlerp * frame->scale[i];
-		backv[i] = backlerp * oldframe->scale[i];
-	}
-
 	lerp = s_lerped[0];
 
-	GL_LerpVerts(paliashdr->num_xyz, v, ov, verts, lerp, move, frontv, backv);
-
-	if (!(currententity->flags & RF_VIEWERMODEL)) {
-		if (gl_vertex_arrays->value) {
-			float		colorArray[MAX_VERTS * 4];
-
-			qglEnableClientState(GL_VERTEX_ARRAY);
-			qglVertexPointer(3, GL_FLOAT, 16, s_lerped);	/* padded for SIMD */
-
-			if (currententity->flags & 
-			    (RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE | RF_SHELL_HALF_DAM)) {
-				if (!(currententity->flags & RF_TRANS_ADDITIVE))
-					qglColor4f(shadelight[0], shadelight[1], shadelight[2], 1.0);
-			} else {
-				qglEnableClientState(GL_COLOR_ARRAY);
-				qglColorPointer(3, GL_FLOAT, 0, colorArray);
-
-				/* pre light everything */
-				for (i = 0; i < paliashdr->num_xyz; i++) {
-					float	l = shadedots[verts[i].lightnormalindex];
-
-					colorArray[i * 3 + 0] = l * shadelight[0];
-					colorArray[i * 3 + 1] = l * shadelight[1];
-					colorArray[i * 3 + 2] = l * shadelight[2];
-				}
-			}
-
-			if (qglLockArraysEXT != 0)
-				qglLockArraysEXT(0, paliashdr->num_xyz);
-
-			while (1) {
-				/* get the vertex count and primitive type */
-				count = *order++;
-				if (!count)
-					break;	/* done */
-				if (count < 0) {
-					count = -count;
-					qglBegin(GL_TRIANGLE_FAN);
-				} else {
-					qglBegin(GL_TRIANGLE_STRIP);
-				}
-
-				/* PMM - added double damage shell */
-				if (currententity->flags & 
-				    (RF_SHELL_RED | RF_SHELL_GREEN | RF_SHELL_BLUE | RF_SHELL_DOUBLE | RF_SHELL_HALF_DAM)) {
-					do {
-						index_xyz = order[2];
-						order += 3;
-						/* c14 added the line below */
-						qglTexCoord2f((s_lerped[index_xyz][1] + s_lerped[index_xyz][0]) / 40.0,
-								s_lerped[index_xyz][2] / 40.0 - r_refdef.time / 2.0);
-						qglVertex3fv(s_lerped[index_xyz]);
-
-					} while (--count);
-				} else {
-					do {
+	if (arrays && arrays->frames) {
+		/* scale and translate are already in the float frames */
+		VectorScale(move, backlerp, move);
+		GL_LerpFloatVerts(paliashdr->num_xyz, arrays, verts, lerp, move, frontlerp, backlerp);
+	} else {
+		VectorAdd(move, oldframe->translate, move);
 
-						/*
-						 * texture coordinates come
-						 * from the draw list
-						 */
-						qglTexCoord2f(((float *)order)[0], ((float *)order)[1]);
-						index_xyz = order[2];
+		for (i = 0; i < 3; i++) {
+			move[i] = backlerp * move[i] + frontlerp * frame->translate[i];
+		}
 
-						order += 3;
-						
-						qglNormal3fv(r_avertexnormals[verts[index_xyz].lightnormalindex]);
-						qglArrayElement(index_xyz);
+		for (i = 0; i < 3; i++) {
+			frontv[i] = frontlerp * frame->scale[i];
+			backv[i] = backlerp * oldframe->scale[i];
+		}
 
-					} while (--count);
-				}
-				qglEnd();
-			}
+		GL_LerpVerts(paliashdr->num_xyz, v, ov, verts, lerp, move, frontv, backv);
+	}
 
-			if (qglUnlockArraysEXT != 0)
-				qglUnlockArraysEXT();
+	if (!(currententity->flags & RF_VIEWERMODEL)) {
+		if (gl_vertex_arrays->value && arrays) {
+			GL_DrawAliasArrays(arrays, verts, alpha);
 		} else {
 			while (1) {
 				/* get the vertex count and primitive type */
@@ -748,7 +1049,7 @@ R_CullAliasModel(vec3_t bbox[8], entity_t * e)
 		for (p = 0; p < 8; p++) {
 			int		mask = 0;
 
-			for (f = 0; f < 4; f++) {
+			for (f = 0; f < r_numfrustumplanes; f++) {
 				float		dp = DotProduct(frustum[f].normal, bbox[p]);
 
 				if ((dp - frustum[f].dist) < 0) {
@@ -42,6 +42,11 @@ byte		mod_novis [MAX_MAP_LEAFS / 8];
 model_t		mod_known[MAX_MOD_KNOWN];
 int		mod_numknown;
 
+#define	MOD_HASH_SIZE	256
+static model_t *mod_hash[MOD_HASH_SIZE];
+
+qboolean	r_registering;
+
 /* the inline * models from the current map are kept seperate */
 model_t		mod_inline[MAX_MOD_KNOWN];
 
@@ -118,15 +123,35 @@ Mod_DecompressVis(byte * in, model_t * model)
 }
 
 /*
- * ============== Mod_ClusterPVS ==============
+ * ============== Mod_ClusterPVS
+ *
+ * The returned row stays valid until the next call.  Rows are kept in a small
+ * direct mapped cache, so crossing back and forth between clusters doesn't
+ * decompress them again. ==============
  */
 byte           *
 Mod_ClusterPVS(int cluster, model_t * model)
 {
+	byte           *row;
+	int		slot, rowbytes;
+
 	if (cluster == -1 || !model->vis)
 		return mod_novis;
-	return Mod_DecompressVis((byte *) model->vis + model->vis->bitofs[cluster][DVIS_PVS],
-	    model);
+
+	if (!model->pvscache)
+		return Mod_DecompressVis((byte *) model->vis + model->vis->bitofs[cluster][DVIS_PVS],
+		    model);
+
+	rowbytes = PVS_ROW_BYTES(model->vis->numclusters);
+	slot = cluster & (PVS_CACHE_SIZE - 1);
+	row = model->pvscache + slot * rowbytes;
+
+	if (model->pvscacheclusters[slot] != cluster) {
+		memcpy(row, Mod_DecompressVis((byte *) model->vis + model->vis->bitofs[cluster][DVIS_PVS],
+		    model), (model->vis->numclusters + 7) >> 3);
+		model->pvscacheclusters[slot] = cluster;
+	}
+	return row;
 }
 
 
@@ -185,6 +210,7 @@ Mod_ForName(char *name, qboolean crash)
 {
 	model_t        *mod;
 	unsigned       *buf;
+	unsigned	hash;
 	int		i;
 
 	if (!name[0])
@@ -198,13 +224,16 @@ Mod_ForName(char *name, qboolean crash)
 		return &mod_inline[i];
 	}
 	/* search the currently loaded models */
-	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++) {
-		if (!mod->name[0])
-			continue;
+	hash = Com_HashKey(name, MOD_HASH_SIZE);
+	for (mod = mod_hash[hash]; mod; mod = mod->hash_next) {
 		if (!strcmp(mod->name, name))
 			return mod;
 	}
 
+	/* optional models, such as .md3 replacements, that weren't there before */
+	if (!crash && R_ProbeFailed(name))
+		return NULL;
+
 	/* find a free model slot spot */
 	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++) {
 		if (!mod->name[0])
@@ -222,6 +251,7 @@ Mod_ForName(char *name, qboolean crash)
 	if (!buf) {
 		if (crash)
 			ri.Sys_Error(ERR_DROP, "Mod_NumForName: %s not found", mod->name);
+		R_MarkProbeFailed(mod->name);
 		memset(mod->name, 0, sizeof(mod->name));
 		return NULL;
 	}
@@ -234,7 +264,8 @@ Mod_ForName(char *name, qboolean crash)
 
 	    switch (LittleLong(*(unsigned *)buf)) {
 	case IDALIASHEADER:
-		loadmodel->extradata = Hunk_Begin(0x200000);
+		/* preconverted float frames take up to 12 megs more */
+		loadmodel->extradata = Hunk_Begin(gl_alias_floatframes->value ? 0x1000000 : 0x200000);
 		Mod_LoadAliasModel(mod, buf);
 		break;
 
@@ -268,6 +299,9 @@ Mod_ForName(char *name, qboolean crash)
 
 	ri.FS_FreeFile(buf);
 
+	mod->hash_next = mod_hash[hash];
+	mod_hash[hash] = mod;
+
 	return mod;
 }
 
@@ -322,6 +356,57 @@ Mod_LoadVisibility(lump_t * l)
 		loadmodel->vis->bitofs[i][0] = LittleLong(loadmodel->vis->bitofs[i][0]);
 		loadmodel->vis->bitofs[i][1] = LittleLong(loadmodel->vis->bitofs[i][1]);
 	}
+
+	i = PVS_CACHE_SIZE * PVS_ROW_BYTES(loadmodel->vis->numclusters);
+	loadmodel->pvscache = Hunk_Alloc(i);
+	memset(loadmodel->pvscache, 0, i);
+	loadmodel->pvscacheclusters = Hunk_Alloc(PVS_CACHE_SIZE * sizeof(int));
+	for (i = 0; i < PVS_CACHE_SIZE; i++)
+		loadmodel->pvscacheclusters[i] = -1;
+}
+
+/*
+ * ================= Mod_LoadClusterLeafs
+ *
+ * Builds the cluster to leafs table R_MarkLeaves walks.  Leafs keep their
+ * order within a cluster. =================
+ */
+void
+Mod_LoadClusterLeafs(void)
+{
+	mleaf_t        *leaf;
+	int		i, c, numclusters;
+
+	loadmodel->clusterleafstart = NULL;
+	loadmodel->clusterleafs = NULL;
+
+	if (!loadmodel->vis)
+		return;
+
+	numclusters = loadmodel->vis->numclusters;
+	loadmodel->clusterleafstart = Hunk_Alloc((numclusters + 1) * sizeof(int));
+	memset(loadmodel->clusterleafstart, 0, (numclusters + 1) * sizeof(int));
+	loadmodel->clusterleafs = Hunk_Alloc(loadmodel->numleafs * sizeof(int));
+
+	/* count, then turn the counts into start offsets */
+	for (i = 0, leaf = loadmodel->leafs; i < loadmodel->numleafs; i++, leaf++) {
+		c = leaf->cluster;
+		if (c >= 0 && c < numclusters)
+			loadmodel->clusterleafstart[c + 1]++;
+	}
+	for (c = 0; c < numclusters; c++)
+		loadmodel->clusterleafstart[c + 1] += loadmodel->clusterleafstart[c];
+
+	for (i = 0, leaf = loadmodel->leafs; i < loadmodel->numleafs; i++, leaf++) {
+		c = leaf->cluster;
+		if (c >= 0 && c < numclusters)
+			loadmodel->clusterleafs[loadmodel->clusterleafstart[c]++] = i;
+	}
+
+	/* the fill advanced every start to the next cluster's, shift them back */
+	for (c = numclusters; c > 0; c--)
+		loadmodel->clusterleafstart[c] = loadmodel->clusterleafstart[c - 1];
+	loadmodel->clusterleafstart[0] = 0;
 }
 
 
@@ -447,6 +532,15 @@ Mod_LoadTexinfo(lump_t * l)
 	loadmodel->texinfo = out;
 	loadmodel->numtexinfo = count;
 
+	/* get the workers decoding replacement textures while we go */
+	for (i = 0; i < count; i++) {
+		Com_sprintf(name, sizeof(name), "textures/%s.tga", in[i].texture);
+		if (!GL_QueueImage(name, it_wall)) {
+			Com_sprintf(name, sizeof(name), "textures/%s.wal", in[i].texture);
+			GL_QueueImage(name, it_wall);
+		}
+	}
+
 	for (i = 0; i < count; i++, in++, out++) {
 		for (j = 0; j < 8; j++)
 			out->vecs[0][j] = LittleFloat(in->vecs[0][j]);
@@ -471,6 +565,7 @@ Mod_LoadTexinfo(lump_t * l)
 			out->image = r_notexture;
 		}
 	}
+	GL_FinishImageJobs();
 
 	/* count animation frames */
 	for (i = 0; i < count; i++) {
@@ -534,10 +629,31 @@ CalcSurfaceExtents(msurface_t * s)
 }
 
 
+void		GL_AllocSurfacePolygon(msurface_t * fa);
 void		GL_BuildPolygonFromSurface(msurface_t * fa);
 void		GL_CreateSurfaceLightmap(msurface_t * surf);
 void		GL_EndBuildingLightmaps(void);
 void		GL_BeginBuildingLightmaps(model_t * m);
+void		GL_BuildWorldVertexBuffer(model_t * m);
+
+/*
+ * ================ Mod_LoadPhase
+ *
+ * Prints how long the load step that just ended took, with developer 1.
+ * NULL only starts the clock. ================
+ */
+static long long mod_phasestart;
+
+static void
+Mod_LoadPhase(const char *name)
+{
+	long long	now;
+
+	now = Sys_Microseconds();
+	if (name)
+		ri.Con_Printf(PRINT_DEVELOPER, "  %-16s %8.2f ms\n", name, (now - mod_phasestart) / 1000.0);
+	mod_phasestart = now;
+}
 
 /*
  * ================
@@ -549,31 +665,18 @@ void		GL_BeginBuildingLightmaps(model_t * m);
 void
 GL_cleaupLightsArray(void)
 {
-	int		i;
-	int		j;
+	int		i, j;
 
-	for (i = 0; i < numberOfWallLights; i++) {
+	for (i = j = 0; i < numberOfWallLights; i++)
 		if (wallLightArray[i] != NULL)
-			continue;
-
-		for (j = i + 1; j < numberOfWallLights; j++) {
-			if (wallLightArray[j] == NULL)
-				continue;
-			wallLightArray[i] = wallLightArray[j];
-			wallLightArray[j] = NULL;
-			break;
-		}
-	}
-
-	/* Count number of lights left. */
-	for (i = 0; i < numberOfWallLights; i++)
-		if (wallLightArray[i] == NULL)
-			break;
+			wallLightArray[j++] = wallLightArray[i];
+	for (i = j; i < numberOfWallLights; i++)
+		wallLightArray[i] = NULL;
 
 	ri.Con_Printf(PRINT_DEVELOPER, "Number of wall lights: %d.\n",
 	    numberOfWallLights);
 
-	numberOfWallLights = i;
+	numberOfWallLights = j;
 
 	ri.Con_Printf(PRINT_DEVELOPER,
 	    "Number of wall lights: %d (after clean-up).\n",
@@ -585,42 +688,68 @@ GL_cleaupLightsArray(void)
  * GL_mergeCloseLights
  *
  * Basically deletes lights which are too close to each other because they are
- * not needed.
+ * not needed.  Lights are hashed into a grid of WALLLIGHT_MERGE_DIST cells,
+ * so only the 27 cells around a light have to be searched.  Going through
+ * them in array order keeps the same lights as comparing every pair did.
  * ================
  */
+#define	WALLLIGHT_MERGE_DIST	100
+#define	WALLLIGHT_HASH		1024	/* power of two */
+
+static int
+GL_WallLightCell(int x, int y, int z)
+{
+	unsigned	h;
+
+	/* unsigned so the products wrap instead of overflowing */
+	h = ((unsigned)x * 73856093u) ^ ((unsigned)y * 19349663u) ^ ((unsigned)z * 83492791u);
+	return (int)(h & (WALLLIGHT_HASH - 1));
+}
+
 void
 GL_mergeCloseLights(void)
 {
-	int		i, j;
-	float		distanceSquared;
+	static int	hash[WALLLIGHT_HASH];
+	static int	next[MAX_WALL_LIGHTS];
+	static int	cell[MAX_WALL_LIGHTS][3];
+	int		i, j, x, y, z;
 	vec3_t		displacement;
 
+	for (i = 0; i < WALLLIGHT_HASH; i++)
+		hash[i] = -1;
+
 	for (i = 0; i < numberOfWallLights; i++) {
-		for (j = 0; j < numberOfWallLights; j++) {
-			if (wallLightArray[i] == NULL)
-				continue;
-			if (wallLightArray[j] == NULL)
-				continue;
-
-			/* Otherwise we are gonna delete all lights. */
-			if (i == j)
-				continue;
-
-			VectorSubtract(wallLightArray[i]->origin, wallLightArray[j]->origin, displacement);
-
-			distanceSquared = displacement[0] * displacement[0];
-			distanceSquared += displacement[1] * displacement[1];
-			distanceSquared += displacement[2] * displacement[2];
-
-			/*
-			 * TODO:
-			 * Perhaps only want to merge lights of the same
-			 * colour. That would make sense but this will do for
-			 * now.
-			 */
-			if (distanceSquared < 100 * 100)
-				wallLightArray[j] = NULL;
-		}
+		for (j = 0; j < 3; j++)
+			cell[i][j] = floor(wallLightArray[i]->origin[j] / WALLLIGHT_MERGE_DIST);
+		j = GL_WallLightCell(cell[i][0], cell[i][1], cell[i][2]);
+		next[i] = hash[j];
+		hash[j] = i;
+	}
+
+	for (i = 0; i < numberOfWallLights; i++) {
+		if (wallLightArray[i] == NULL)
+			continue;
+
+		for (x = cell[i][0] - 1; x <= cell[i][0] + 1; x++)
+			for (y = cell[i][1] - 1; y <= cell[i][1] + 1; y++)
+				for (z = cell[i][2] - 1; z <= cell[i][2] + 1; z++)
+					for (j = hash[GL_WallLightCell(x, y, z)]; j != -1; j = next[j]) {
+						/* Otherwise we are gonna delete all lights. */
+						if (j == i || wallLightArray[j] == NULL)
+							continue;
+
+						VectorSubtract(wallLightArray[i]->origin, wallLightArray[j]->origin, displacement);
+
+						/*
+						 * TODO:
+						 * Perhaps only want to merge lights of the same
+						 * colour. That would make sense but this will do for
+						 * now.
+						 */
+						if (DotProduct(displacement, displacement) <
+						    WALLLIGHT_MERGE_DIST * WALLLIGHT_MERGE_DIST)
+							wallLightArray[j] = NULL;
+					}
 	}
 	GL_cleaupLightsArray();
 }
@@ -659,39 +788,104 @@ GL_buildDynamicWallLights(msurface_t * surf)
 }
 
 /*
- * ================= Mod_LoadFaces =================
+ * =============================================================
+ *
+ * FACE LOADING
+ *
+ * The work on a face that reads the model and writes nothing but the face is
+ * split into contiguous chunks, run by gl_loadthreads threads and the loading
+ * one.  Whatever allocates from the hunk or packs lightmaps stays on the
+ * loading thread and goes in face order, so a map always comes out with the
+ * same memory and lightmap layout.  The lightmap texels themselves are built
+ * on the lightmap workers by GL_EndBuildingLightmaps.
+ *
+ * =============================================================
  */
-void
-Mod_LoadFaces(lump_t * l)
+
+#define	MAX_LOAD_THREADS	8
+#define	LOAD_CHUNK_MIN		512	/* faces, smaller chunks aren't worth a thread */
+
+typedef struct {
+	void		(*func) (int first, int last);
+	int		first, last;
+} loadchunk_t;
+
+static dface_t *mod_faces;
+static volatile int mod_badface;	/* a face had a bad texinfo */
+
+static void
+Mod_LoadChunk(void *arg)
 {
-	dface_t        *in;
-	msurface_t     *out;
-	int		i, count, surfnum;
-	int		planenum, side;
-	int		ti;
+	loadchunk_t    *chunk = arg;
 
-	in = (void *)(mod_base + l->fileofs);
-	if (l->filelen % sizeof(*in))
-		ri.Sys_Error(ERR_DROP, "MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
-	count = l->filelen / sizeof(*in);
-	out = Hunk_Alloc(count * sizeof(*out));
+	chunk->func(chunk->first, chunk->last);
+}
 
-	loadmodel->surfaces = out;
-	loadmodel->numsurfaces = count;
+/*
+ * ================ Mod_ForAllFaces ================
+ */
+static void
+Mod_ForAllFaces(void (*func) (int first, int last), int count)
+{
+	loadchunk_t	chunks[MAX_LOAD_THREADS + 1];
+	qthread_t      *threads[MAX_LOAD_THREADS];
+	int		i, numchunks, numthreads;
+
+	numchunks = gl_loadthreads->value;
+	if (numchunks < 0)
+		numchunks = Sys_CPUCount() - 1;
+	if (numchunks > MAX_LOAD_THREADS)
+		numchunks = MAX_LOAD_THREADS;
+	numchunks++;		/* the loading thread */
+	if (numchunks > count / LOAD_CHUNK_MIN)
+		numchunks = count / LOAD_CHUNK_MIN;
+	if (numchunks < 1)
+		numchunks = 1;
+
+	for (i = 0; i < numchunks; i++) {
+		chunks[i].func = func;
+		chunks[i].first = count * i / numchunks;
+		chunks[i].last = count * (i + 1) / numchunks;
+	}
 
-	currentmodel = loadmodel;
+	numthreads = 0;
+	for (i = 1; i < numchunks; i++) {
+		threads[numthreads] = Sys_CreateThread(Mod_LoadChunk, &chunks[i]);
+		if (threads[numthreads])
+			numthreads++;
+		else
+			Mod_LoadChunk(&chunks[i]);
+	}
 
-	GL_BeginBuildingLightmaps(loadmodel);
+	Mod_LoadChunk(&chunks[0]);
 
-	/* Clear flares and wall lights. */
-	r_numflares = 0;
-	numberOfWallLights = 0;
+	for (i = 0; i < numthreads; i++)
+		Sys_WaitThread(threads[i]);
+}
+
+/*
+ * ================ Mod_DecodeFaces
+ *
+ * Swaps the faces in and finds their extents. ================
+ */
+static void
+Mod_DecodeFaces(int first, int last)
+{
+	dface_t        *in;
+	msurface_t     *out;
+	int		i, surfnum;
+	int		planenum, side;
+	int		ti;
+
+	for (surfnum = first; surfnum < last; surfnum++) {
+		in = &mod_faces[surfnum];
+		out = &loadmodel->surfaces[surfnum];
 
-	for (surfnum = 0; surfnum < count; surfnum++, in++, out++) {
 		out->firstedge = LittleLong(in->firstedge);
 		out->numedges = LittleShort(in->numedges);
 		out->flags = 0;
 		out->polys = NULL;
+		out->firstworldvert = -1;
 
 		planenum = LittleShort(in->planenum);
 		side = LittleShort(in->side);
@@ -700,9 +894,12 @@ Mod_LoadFaces(lump_t * l)
 
 		out->plane = loadmodel->planes + planenum;
 
+		/* errors can only be raised from the loading thread */
 		ti = LittleShort(in->texinfo);
-		if (ti < 0 || ti >= loadmodel->numtexinfo)
-			ri.Sys_Error(ERR_DROP, "MOD_LoadBmodel: bad texinfo number");
+		if (ti < 0 || ti >= loadmodel->numtexinfo) {
+			mod_badface = true;
+			ti = 0;
+		}
 		out->texinfo = loadmodel->texinfo + ti;
 
 		CalcSurfaceExtents(out);
@@ -726,30 +923,97 @@ Mod_LoadFaces(lump_t * l)
 				out->extents[i] = 16384;
 				out->texturemins[i] = -8192;
 			}
-			/* Cut up polygon for warps. */
-			GL_SubdivideSurface(out);
 		}
+	}
+}
 
-		/* Create lightmaps and polygons. */
-		if (!(out->texinfo->flags & SURF_WARP)) {
-			if (!(out->texinfo->flags & (SURF_SKY | SURF_TRANS33 |
-			    SURF_TRANS66)))
-				GL_CreateSurfaceLightmap(out);
+/*
+ * ================ Mod_BuildFacePolygons ================
+ */
+static void
+Mod_BuildFacePolygons(int first, int last)
+{
+	msurface_t     *out;
+	int		surfnum;
 
-			GL_BuildPolygonFromSurface(out);
-			GL_FindPolyCenters(out);
+	for (surfnum = first; surfnum < last; surfnum++) {
+		out = &loadmodel->surfaces[surfnum];
+		if (out->texinfo->flags & SURF_WARP)
+			continue;
 
-			if (!(out->texinfo->flags & (SURF_SKY | SURF_TRANS33 |
-			    SURF_TRANS66)) &&
-			    (out->texinfo->flags & SURF_LIGHT)) {
-				GL_buildDynamicWallLights(out);
-				GL_AddFlareSurface(out);
-			}
+		GL_BuildPolygonFromSurface(out);
+		GL_FindPolyCenters(out);
+	}
+}
+
+/*
+ * ================= Mod_LoadFaces =================
+ */
+void
+Mod_LoadFaces(lump_t * l)
+{
+	msurface_t     *out;
+	int		count, surfnum;
+
+	mod_faces = (void *)(mod_base + l->fileofs);
+	if (l->filelen % sizeof(*mod_faces))
+		ri.Sys_Error(ERR_DROP, "MOD_LoadBmodel: funny lump size in %s", loadmodel->name);
+	count = l->filelen / sizeof(*mod_faces);
+	out = Hunk_Alloc(count * sizeof(*out));
+
+	loadmodel->surfaces = out;
+	loadmodel->numsurfaces = count;
+
+	currentmodel = loadmodel;
+
+	GL_BeginBuildingLightmaps(loadmodel);
+
+	/* Clear flares and wall lights. */
+	GL_ClearFlares();
+	R_ClearStains();
+	numberOfWallLights = 0;
+
+	mod_badface = 0;
+	Mod_ForAllFaces(Mod_DecodeFaces, count);
+	if (mod_badface)
+		ri.Sys_Error(ERR_DROP, "MOD_LoadBmodel: bad texinfo number");
+	Mod_LoadPhase("faces");
+
+	/* Place lightmaps and allocate polygons, in face order. */
+	for (surfnum = 0, out = loadmodel->surfaces; surfnum < count; surfnum++, out++) {
+		/* Cut up polygon for warps. */
+		if (out->texinfo->flags & SURF_WARP) {
+			GL_SubdivideSurface(out);
+			continue;
 		}
+
+		if (!(out->texinfo->flags & (SURF_SKY | SURF_TRANS33 |
+		    SURF_TRANS66)))
+			GL_CreateSurfaceLightmap(out);
+
+		GL_AllocSurfacePolygon(out);
 	}
+	Mod_LoadPhase("lightmap packing");
 
+	Mod_ForAllFaces(Mod_BuildFacePolygons, count);
+	Mod_LoadPhase("polygons");
+
+	for (surfnum = 0, out = loadmodel->surfaces; surfnum < count; surfnum++, out++) {
+		if (!(out->texinfo->flags & (SURF_SKY | SURF_TRANS33 |
+		    SURF_TRANS66 | SURF_WARP)) &&
+		    (out->texinfo->flags & SURF_LIGHT)) {
+			GL_buildDynamicWallLights(out);
+			GL_AddFlareSurface(out);
+		}
+	}
 	GL_mergeCloseLights();
+	Mod_LoadPhase("wall lights");
+
 	GL_EndBuildingLightmaps();
+	Mod_LoadPhase("lightmaps");
+
+	GL_BuildWorldVertexBuffer(loadmodel);
+	Mod_LoadPhase("vertex buffer");
 }
 
 
@@ -849,6 +1113,8 @@ Mod_LoadLeafs(lump_t * l)
 		out->firstmarksurface = loadmodel->marksurfaces +
 		    LittleShort(in->firstleafface);
 		out->nummarksurfaces = LittleShort(in->numleaffaces);
+		out->decals = NULL;
+		out->decalgen = 0;
 
 		/* gl underwater warp */
 #if 0
@@ -986,6 +1252,7 @@ void
 Mod_LoadBrushModel(model_t * mod, void *buffer)
 {
 	int		i;
+	long long	start;
 	dheader_t      *header;
 	mmodel_t       *bm;
 
@@ -1007,19 +1274,27 @@ Mod_LoadBrushModel(model_t * mod, void *buffer)
 
 	/* load into heap */
 
+	ri.Con_Printf(PRINT_DEVELOPER, "Loading %s:\n", mod->name);
+	start = Sys_Microseconds();
+	Mod_LoadPhase(NULL);
+
 	Mod_LoadVertexes(&header->lumps[LUMP_VERTEXES]);
 	Mod_LoadEdges(&header->lumps[LUMP_EDGES]);
 	Mod_LoadSurfedges(&header->lumps[LUMP_SURFEDGES]);
 	Mod_LoadLighting(&header->lumps[LUMP_LIGHTING]);
 	Mod_LoadPlanes(&header->lumps[LUMP_PLANES]);
+	Mod_LoadPhase("geometry");
 	Mod_LoadTexinfo(&header->lumps[LUMP_TEXINFO]);
+	Mod_LoadPhase("textures");
 	Mod_LoadFaces(&header->lumps[LUMP_FACES]);
 	Mod_LoadMarksurfaces(&header->lumps[LUMP_LEAFFACES]);
 	Mod_LoadVisibility(&header->lumps[LUMP_VISIBILITY]);
 	Mod_LoadLeafs(&header->lumps[LUMP_LEAFS]);
+	Mod_LoadClusterLeafs();
 	Mod_LoadNodes(&header->lumps[LUMP_NODES]);
 	Mod_LoadSubmodels(&header->lumps[LUMP_MODELS]);
 	mod->numframes = 2;	/* regular and alternate animation */
+	Mod_LoadPhase("bsp tree");
 
 
 	/* set up the submodels */
@@ -1046,6 +1321,9 @@ Mod_LoadBrushModel(model_t * mod, void *buffer)
 
 		starmod->numleafs = bm->visleafs;
 	}
+
+	ri.Con_Printf(PRINT_DEVELOPER, "  %-16s %8.2f ms\n", "total",
+	    (Sys_Microseconds() - start) / 1000.0);
 }
 
 /*
@@ -1059,6 +1337,145 @@ Mod_LoadBrushModel(model_t * mod, void *buffer)
  * =================================================================
  */
 
+/*
+ * ================= Mod_BuildAliasArrays
+ *
+ * Turns the strips and fans of the glcmds into one indexed triangle list.
+ * glcmd vertexes that share both the frame vertex and the st become a
+ * single draw vertex. =================
+ */
+static void
+Mod_BuildAliasArrays(model_t * mod, dmdl_t * pheader)
+{
+	maliasarrays_t *arrays;
+	daliasframe_t  *frame;
+	int            *order, *end;
+	int		count, i, j, k, maxverts, numverts, numindexes, pad;
+	int            *hashhead, *hashnext, *strip;
+	unsigned short *xyz, *indexes, *index;
+	float          *st, *out, s, t;
+
+	mod->aliasarrays = NULL;
+
+	/* count glcmd vertexes and triangles */
+	maxverts = numindexes = 0;
+	order = (int *)((byte *) pheader + pheader->ofs_glcmds);
+	end = order + pheader->num_glcmds;
+	while (order < end && (count = *order++) != 0) {
+		if (count < 0)
+			count = -count;
+		if (count < 3 || order + count * 3 > end)
+			return;
+		maxverts += count;
+		numindexes += (count - 2) * 3;
+		order += count * 3;
+	}
+	if (!maxverts || maxverts > MAX_ALIAS_DRAWVERTS)
+		return;
+
+	xyz = malloc(maxverts * sizeof(*xyz));
+	st = malloc(maxverts * 2 * sizeof(*st));
+	hashnext = malloc(maxverts * sizeof(*hashnext));
+	strip = malloc(maxverts * sizeof(*strip));
+	hashhead = malloc(pheader->num_xyz * sizeof(*hashhead));
+	indexes = malloc(numindexes * sizeof(*indexes));
+	if (!xyz || !st || !hashnext || !strip || !hashhead || !indexes)
+		goto done;
+
+	for (i = 0; i < pheader->num_xyz; i++)
+		hashhead[i] = -1;
+
+	numverts = 0;
+	index = indexes;
+	order = (int *)((byte *) pheader + pheader->ofs_glcmds);
+	while (order < end && (count = *order++) != 0) {
+		qboolean	fan = count < 0;
+
+		if (fan)
+			count = -count;
+
+		for (k = 0; k < count; k++, order += 3) {
+			s = ((float *)order)[0];
+			t = ((float *)order)[1];
+			i = order[2];
+			if (i < 0 || i >= pheader->num_xyz)
+				goto done;
+
+			for (j = hashhead[i]; j >= 0; j = hashnext[j]) {
+				if (st[j * 2 + 0] == s && st[j * 2 + 1] == t)
+					break;
+			}
+			if (j < 0) {
+				j = numverts++;
+				xyz[j] = i;
+				st[j * 2 + 0] = s;
+				st[j * 2 + 1] = t;
+				hashnext[j] = hashhead[i];
+				hashhead[i] = j;
+			}
+			strip[k] = j;
+		}
+
+		/* keep the winding GL would give the strip or fan */
+		for (k = 2; k < count; k++, index += 3) {
+			if (fan) {
+				index[0] = strip[0];
+				index[1] = strip[k - 1];
+			} else if (k & 1) {
+				index[0] = strip[k - 1];
+				index[1] = strip[k - 2];
+			} else {
+				index[0] = strip[k - 2];
+				index[1] = strip[k - 1];
+			}
+			index[2] = strip[k];
+		}
+	}
+
+	arrays = Hunk_Alloc(sizeof(*arrays));
+	arrays->num_verts = numverts;
+	arrays->num_indexes = numindexes;
+	arrays->xyz = Hunk_Alloc(numverts * sizeof(*arrays->xyz));
+	memcpy(arrays->xyz, xyz, numverts * sizeof(*arrays->xyz));
+	arrays->st = Hunk_Alloc(numverts * 2 * sizeof(*arrays->st));
+	memcpy(arrays->st, st, numverts * 2 * sizeof(*arrays->st));
+	arrays->indexes = Hunk_Alloc(numindexes * sizeof(*arrays->indexes));
+	memcpy(arrays->indexes, indexes, numindexes * sizeof(*arrays->indexes));
+
+	arrays->frames = NULL;
+	arrays->frame_stride = 0;
+	if (gl_alias_floatframes->value) {
+		pad = (pheader->num_xyz + 7) & ~7;
+		arrays->frame_stride = pad * 3;
+		arrays->frames = Hunk_Alloc(pheader->num_frames * arrays->frame_stride * sizeof(float));
+
+		for (i = 0; i < pheader->num_frames; i++) {
+			frame = (daliasframe_t *) ((byte *) pheader
+			    + pheader->ofs_frames + i * pheader->framesize);
+			out = arrays->frames + i * arrays->frame_stride;
+
+			for (j = 0; j < pad; j++) {
+				for (k = 0; k < 3; k++) {
+					if (j < pheader->num_xyz)
+						out[k * pad + j] = frame->verts[j].v[k] * frame->scale[k] + frame->translate[k];
+					else
+						out[k * pad + j] = 0;
+				}
+			}
+		}
+	}
+
+	mod->aliasarrays = arrays;
+
+done:
+	free(xyz);
+	free(st);
+	free(hashnext);
+	free(strip);
+	free(hashhead);
+	free(indexes);
+}
+
 /*
  * ================= Mod_LoadAliasModel =================
  */
@@ -1151,14 +1568,19 @@ Mod_LoadAliasModel(model_t * mod, void *buffer)
 	for (i = 0; i < pheader->num_glcmds; i++)
 		poutcmd[i] = LittleLong(pincmd[i]);
 
+	Mod_BuildAliasArrays(mod, pheader);
+
 
 	/* register all skins */
 	memcpy((char *)pheader + pheader->ofs_skins, (char *)pinmodel + pheader->ofs_skins,
 	    pheader->num_skins * MAX_SKINNAME);
+	for (i = 0; i < pheader->num_skins; i++)
+		GL_QueueImage((char *)pheader + pheader->ofs_skins + i * MAX_SKINNAME, it_skin);
 	for (i = 0; i < pheader->num_skins; i++) {
 		mod->skins[i] = GL_FindImage((char *)pheader + pheader->ofs_skins + i * MAX_SKINNAME
 		    ,it_skin);
 	}
+	GL_FinishImageJobs();
 
 	mod->mins[0] = -32;
 	mod->mins[1] = -32;
@@ -1245,6 +1667,9 @@ R_BeginRegistration(char *model)
 
 	registration_sequence++;
 	r_oldviewcluster = -1;	/* force markleafs */
+	r_registering = true;
+	GL_FinishImageJobs();	/* in case the last batch was cut short by a drop */
+	R_ClearFailedProbes();
 
 	Com_sprintf(fullname, sizeof(fullname), "maps/%s.bsp", model);
 	GL_ClearDecals();	/* Decals  */
@@ -1340,6 +1765,8 @@ R_EndRegistration(void)
 	int		i;
 	model_t        *mod;
 
+	r_registering = false;
+
 	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++) {
 		if (!mod->name[0])
 			continue;
@@ -1348,6 +1775,7 @@ R_EndRegistration(void)
 		}
 	}
 
+	GL_RegisterFlares();
 	GL_FreeUnusedImages();
 }
 
@@ -1364,6 +1792,21 @@ R_EndRegistration(void)
 void
 Mod_Free(model_t * mod)
 {
+	model_t       **link;
+
+	if (mod->name[0]) {
+		for (link = &mod_hash[Com_HashKey(mod->name, MOD_HASH_SIZE)]; *link; link = &(*link)->hash_next) {
+			if (*link == mod) {
+				*link = mod->hash_next;
+				break;
+			}
+		}
+	}
+
+	if (mod->worldvbo)
+		qglDeleteBuffersARB(1, &mod->worldvbo);
+	if (mod->worldverts)
+		free(mod->worldverts);
 	Hunk_Free(mod->extradata);
 	memset(mod, 0, sizeof(*mod));
 }
@@ -81,6 +81,10 @@ typedef struct mtexinfo_s {
 
 #define	VERTEXSIZE	9	/* was 7 Dukey */
 
+/* decompressed PVS rows cached per model, rows padded to whole ints */
+#define	PVS_CACHE_SIZE		64
+#define	PVS_ROW_BYTES(c)	((((c) + 31) >> 5) << 2)
+
 typedef struct glpoly_s {
 	vec3_t		center;
 	struct glpoly_s *next;
@@ -137,12 +141,15 @@ typedef struct msurface_s {
 	int		lightmaptexturenum;
 	byte		styles[MAXLIGHTMAPS];
 	float		cached_light[MAXLIGHTMAPS];	/* values currently used in lightmap */
+	int		cached_dlight;			/* r_framecount it was built with dlights, 0 if without */
 	byte           *samples;			/* [numstyles*surfsize] */
 	byte           *stain_samples;
 
 	wallLight_t    *wallLight;			/* used to create opengl lights. */
 	int		fragmentframe;			/* Vic's awesome decals */
 	vec3_t		center;
+
+	int		firstworldvert;			/* in the world vertex buffer, -1 if not batched */
 } msurface_t;
 
 #define CONTENTS_NODE -1
@@ -181,6 +188,9 @@ typedef struct mleaf_s {
 
 	msurface_t    **firstmarksurface;
 	int		nummarksurfaces;
+
+	struct cdecal_s *decals;	/* valid while decalgen is current */
+	int		decalgen;
 } mleaf_t;
 
 /*
@@ -253,6 +263,24 @@ typedef struct maliasmodel_s {
 } maliasmodel_t;
 
 
+/*
+ * MD2 glcmds flattened into indexed triangles at load time, so a frame can
+ * be submitted with a single glDrawElements
+ */
+#define	MAX_ALIAS_DRAWVERTS	8192	/* glcmd vertexes, more uses the glcmd loops */
+
+typedef struct {
+	int		num_verts;	/* distinct (xyz, st) pairs in the glcmds */
+	int		num_indexes;
+	unsigned short *xyz;		/* frame vertex of each draw vertex */
+	float          *st;		/* num_verts * 2 */
+	unsigned short *indexes;
+
+	/* optional preconverted frames: x[], y[], z[] per frame, padded to 8 */
+	float          *frames;
+	int		frame_stride;
+} maliasarrays_t;
+
 /* =================================================================== */
 
 //
@@ -320,14 +348,30 @@ typedef struct model_s {
 
 	dvis_t         *vis;
 
+	/* leafs of each cluster, clusterleafs[clusterleafstart[c] .. [c + 1]] */
+	int            *clusterleafstart;
+	int            *clusterleafs;
+
+	/* recently decompressed PVS rows, see Mod_ClusterPVS */
+	byte           *pvscache;
+	int            *pvscacheclusters;
+
 	byte           *lightdata;
 	byte           *staindata;
 
+	/* static vertex buffer for batched world surfaces */
+	int		numworldverts;
+	float          *worldverts;	/* NULL when uploaded to worldvbo */
+	unsigned int	worldvbo;
+
 	/* for alias models and skins */
 	image_t        *skins[MAX_MD2SKINS];
+	maliasarrays_t *aliasarrays;	/* MD2 vertex array data, may be NULL */
 
 	int		extradatasize;
 	void           *extradata;
+
+	struct model_s *hash_next;	/* Mod_ForName name hash */
 } model_t;
 
 /*
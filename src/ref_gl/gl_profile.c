@@ -0,0 +1,246 @@
+/*
+ * This program is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free
+ * Software Foundation; either version 2 of the License, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program; if not, write to the Free Software Foundation, Inc., 59
+ * Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ */
+/* gl_profile.c -- per section frame timings */
+
+#include "gl_local.h"
+
+/*
+ * gl_profile 1 times the renderer passes on the CPU, gl_profile 2 also puts
+ * a GL_ARB_timer_query timestamp at every section change and reads them back
+ * PROF_GPU_FRAMES frames later so the pipeline never waits.  Times are
+ * exclusive: a section started inside another one pauses it, except that
+ * everything drawn for the reflection textures is charged to "reflections".
+ * The client fetches the last frame through re.GetProfile.
+ */
+
+#define	PROF_MAX_DEPTH		8
+#define	PROF_MAX_STAMPS		256	/* timestamps per frame */
+#define	PROF_GPU_FRAMES		4
+
+static const char *prof_names[PROF_NUM_SECTIONS] = {
+	"refresh",
+	"markleaves",
+	"world",
+	"entities",
+	"particles",
+	"decals",
+	"glares",
+	"reflections",
+	"2d"
+};
+
+typedef struct {
+	GLuint		queries[PROF_MAX_STAMPS];
+	int		sections[PROF_MAX_STAMPS];	/* running after the stamp, -1 = none */
+	int		numstamps;
+} profframe_t;
+
+static int	prof_mode;		/* gl_profile for the current frame */
+static profsection_t prof_stack[PROF_MAX_DEPTH];
+static int	prof_depth;
+static int	prof_folded;		/* begins swallowed by a reflection */
+static long long prof_last;
+static long long prof_cpu[PROF_NUM_SECTIONS];
+
+static profframe_t prof_frames[PROF_GPU_FRAMES];
+static int	prof_frame;
+static qboolean	prof_queries;		/* prof_frames[].queries allocated */
+
+static float	prof_cpuresult[PROF_NUM_SECTIONS];
+static float	prof_gpuresult[PROF_NUM_SECTIONS];
+static qboolean	prof_gpuvalid;
+
+/*
+ * ================ R_ProfileSwitch ================
+ * Charges the time since the last change to the running section
+ */
+static void
+R_ProfileSwitch(void)
+{
+	long long	now;
+
+	now = Sys_Microseconds();
+	if (prof_depth)
+		prof_cpu[prof_stack[prof_depth - 1]] += now - prof_last;
+	prof_last = now;
+}
+
+/*
+ * ================ R_ProfileStamp ================
+ * Marks on the GPU where the section now on top of the stack starts
+ */
+static void
+R_ProfileStamp(void)
+{
+	profframe_t    *f;
+
+	if (prof_mode < 2 || !prof_queries)
+		return;
+
+	f = &prof_frames[prof_frame];
+	if (f->numstamps == PROF_MAX_STAMPS)
+		return;
+
+	qglQueryCounter(f->queries[f->numstamps], GL_TIMESTAMP);
+	f->sections[f->numstamps] = prof_depth ? prof_stack[prof_depth - 1] : -1;
+	f->numstamps++;
+}
+
+/*
+ * ================ R_ProfileBegin ================
+ */
+void
+R_ProfileBegin(profsection_t section)
+{
+	if (!prof_mode)
+		return;
+
+	if (prof_folded || prof_depth == PROF_MAX_DEPTH ||
+	    (prof_depth && prof_stack[prof_depth - 1] == PROF_REFLECTIONS)) {
+		prof_folded++;
+		return;
+	}
+
+	R_ProfileSwitch();
+	prof_stack[prof_depth++] = section;
+	R_ProfileStamp();
+}
+
+/*
+ * ================ R_ProfileEnd ================
+ */
+void
+R_ProfileEnd(profsection_t section)
+{
+	if (!prof_mode)
+		return;
+
+	if (prof_folded) {
+		prof_folded--;
+		return;
+	}
+	if (!prof_depth)
+		return;
+
+	R_ProfileSwitch();
+	prof_depth--;
+	R_ProfileStamp();
+}
+
+/*
+ * ================ R_ProfileReadFrame ================
+ * Sums the intervals between the timestamps of an old frame
+ */
+static void
+R_ProfileReadFrame(profframe_t * f)
+{
+	GLuint64	stamp, prev;
+	int		i;
+
+	for (i = 0; i < PROF_NUM_SECTIONS; i++)
+		prof_gpuresult[i] = 0;
+
+	prev = 0;
+	for (i = 0; i < f->numstamps; i++) {
+		qglGetQueryObjectui64v(f->queries[i], GL_QUERY_RESULT_ARB, &stamp);
+		if (i && f->sections[i - 1] >= 0)
+			prof_gpuresult[f->sections[i - 1]] += (stamp - prev) / 1000000.0;
+		prev = stamp;
+	}
+
+	prof_gpuvalid = true;
+}
+
+/*
+ * ================ R_ProfileFrame ================
+ * Called from R_EndFrame, publishes this frame and sets up the next one
+ */
+void
+R_ProfileFrame(void)
+{
+	profframe_t    *f;
+	int		i;
+
+	if (prof_mode) {
+		for (i = 0; i < PROF_NUM_SECTIONS; i++) {
+			prof_cpuresult[i] = prof_cpu[i] / 1000.0;
+			prof_cpu[i] = 0;
+		}
+	}
+
+	/* the oldest frame in flight is read and then recorded over */
+	prof_frame = (prof_frame + 1) % PROF_GPU_FRAMES;
+	f = &prof_frames[prof_frame];
+	if (f->numstamps && prof_mode >= 2)
+		R_ProfileReadFrame(f);
+	f->numstamps = 0;
+
+	prof_mode = gl_profile->value;
+	prof_depth = 0;
+	prof_folded = 0;
+
+	if (prof_mode < 2 || !gl_state.timerquery)
+		prof_gpuvalid = false;
+	if (prof_mode >= 2 && gl_state.timerquery && !prof_queries) {
+		for (i = 0; i < PROF_GPU_FRAMES; i++) {
+			qglGenQueriesARB(PROF_MAX_STAMPS, prof_frames[i].queries);
+			prof_frames[i].numstamps = 0;
+		}
+		prof_queries = true;
+	}
+}
+
+/*
+ * ================ R_GetProfile ================
+ */
+void
+R_GetProfile(refprofile_t * profile)
+{
+	int		i;
+
+	if (!prof_mode) {
+		profile->numsections = 0;
+		return;
+	}
+
+	profile->numsections = PROF_NUM_SECTIONS;
+	for (i = 0; i < PROF_NUM_SECTIONS; i++) {
+		profile->names[i] = prof_names[i];
+		profile->cpu[i] = prof_cpuresult[i];
+		profile->gpu[i] = prof_gpuvalid ? prof_gpuresult[i] : -1;
+	}
+}
+
+/*
+ * ================ R_ShutdownProfile ================
+ */
+void
+R_ShutdownProfile(void)
+{
+	int		i;
+
+	if (prof_queries) {
+		for (i = 0; i < PROF_GPU_FRAMES; i++) {
+			qglDeleteQueriesARB(PROF_MAX_STAMPS, prof_frames[i].queries);
+			prof_frames[i].numstamps = 0;
+		}
+		prof_queries = false;
+	}
+
+	prof_mode = 0;
+	prof_gpuvalid = false;
+}
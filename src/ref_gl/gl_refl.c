@@ -91,8 +91,8 @@ setupShaders(void)
 	brightenTexture = false;/* dont brighten these textures we need them
 				 * as they are.  */
 
-	distortTex = Draw_FindPic(gl_reflection_shader_image->string);
-	waterNormalTex = Draw_FindPic("/textures/water/normal.pcx");
+	distortTex = Draw_FindWholePic(gl_reflection_shader_image->string);
+	waterNormalTex = Draw_FindWholePic("/textures/water/normal.pcx");
 
 	brightenTexture = true;	/* reset so normal textures load with extra
 				 * brightness  */
@@ -122,6 +122,9 @@ R_shutdown_refl(void)
 	}
 	R_clear_refl();		/* set number of reflections to 0 */
 
+	if (g_tex_num && maxReflections)
+		qglDeleteTextures(maxReflections, (GLuint *) g_tex_num);
+
 	free(g_refl_X);		/* free all other malloc'd stuff */
 	free(g_refl_Y);
 	free(g_refl_Z);
@@ -129,6 +132,11 @@ R_shutdown_refl(void)
 	free(g_waterDistance);
 	free(g_waterDistance2);
 	free(waterNormals);
+	g_refl_X = g_refl_Y = g_refl_Z = NULL;
+	g_waterDistance = g_waterDistance2 = NULL;
+	g_tex_num = NULL;
+	waterNormals = NULL;
+	maxReflections = 0;
 	/* free( playerEntity		);	//fix this later */
 }
 
@@ -144,6 +152,7 @@ R_init_refl(int maxNoReflections)
 	int		power;
 	int		maxSize;
 	int		i;
+	float		scale;
 	unsigned char  *buf = NULL;
 
 	R_setupArrays(maxNoReflections);	/* setup number of reflections */
@@ -162,7 +171,16 @@ R_init_refl(int maxNoReflections)
 	 */
 	/* so maybe its best to leave this alone. */
 
-	for (power = 2; power < vid.height; power *= 2) {
+	/* gl_reflection_scale renders them at a fraction of the screen size */
+	scale = gl_reflection_scale->value;
+	if (scale > 1 || scale <= 0)
+		scale = 1;
+	else if (scale < 0.125)
+		scale = 0.125;
+	gl_reflection_scale->modified = false;
+
+	REFL_TEXW = REFL_TEXH = 64;
+	for (power = 64; power < vid.height * scale; power *= 2) {
 
 		REFL_TEXW = power;
 		REFL_TEXH = power;
@@ -287,6 +305,30 @@ calculateDistance(float x, float y, float z)
 }
 
 
+/*
+ * ================ R_FindRefl
+ *
+ * returns the reflection rendered for a plane, or -1. Planes that only
+ * differ by rounding, like the water of separate brushes at the same
+ * height, count as the same ================
+ */
+#define	REFL_NORMAL_EPSILON	0.001
+#define	REFL_DIST_EPSILON	1.0
+
+int
+R_FindRefl(vec3_t normal, float dist)
+{
+	int		i;
+
+	for (i = 0; i < g_num_refl; i++) {
+		if (DotProduct(normal, waterNormals[i]) > 1 - REFL_NORMAL_EPSILON &&
+		    fabs(dist - g_waterDistance2[i]) < REFL_DIST_EPSILON)
+			return i;
+	}
+
+	return -1;
+}
+
 /*
  * ================ R_add_refl
  *
@@ -297,25 +339,21 @@ R_add_refl(float x, float y, float z, float normalX, float normalY, float normal
 {
 
 	float		distance;
+	vec3_t		normal;
 	int		i;
 
 	if (!maxReflections)
 		return;		/* safety check. */
 
-	if (gl_reflection_max->value != maxReflections) {
+	if (gl_reflection_max->value != maxReflections || gl_reflection_scale->modified) {
 		R_init_refl(gl_reflection_max->value);
 	}
-	/* check for duplicates .. */
-	for (i = 0; i < g_num_refl; i++) {
-
-		if (normalX == waterNormals[i][0] &&
-		    normalY == waterNormals[i][1] &&
-		    normalZ == waterNormals[i][2] &&
-		    distance2 == g_waterDistance2[i])
-			return;
-
-		/* same water normal and same distance from plane */
-	}
+	/* coplanar water shares one reflection */
+	normal[0] = normalX;
+	normal[1] = normalY;
+	normal[2] = normalZ;
+	if (R_FindRefl(normal, distance2) >= 0)
+		return;
 
 	distance = calculateDistance(x, y, z);	/* used to calc closest water
 						 * surface */
@@ -545,9 +583,35 @@ R_DrawDebugReflTexture()
 void
 R_UpdateReflTex(refdef_t * fd)
 {
+	int		clusters[MAX_REFL_CLUSTERS + 2];
+	int		i, numclusters;
+	mleaf_t        *leaf;
+	vec3_t		org;
+
 	if (!g_num_refl)
 		return;		/* nothing to do here */
 
+	/*
+	 * every pass sees what the view sees plus what is visible from just
+	 * across its plane, marked once for all of them.  This runs before the
+	 * main view's R_SetupFrame, so the view clusters are found here rather
+	 * than taken from last frame.
+	 */
+	R_ViewClusters(fd->vieworg, &clusters[0], &clusters[1]);
+	numclusters = 2;
+	for (i = 0; i < g_num_refl && numclusters < MAX_REFL_CLUSTERS + 2; i++) {
+		VectorCopy(fd->vieworg, org);
+		if (fd->rdflags & RDF_UNDERWATER)
+			org[2] = g_refl_Z[i] - 1;	/* just above water level */
+		else
+			org[2] = g_refl_Z[i] + 1;	/* just below water level */
+
+		leaf = Mod_PointInLeaf(org, r_worldmodel);
+		if (!(leaf->contents & CONTENTS_SOLID) && leaf->cluster != -1)
+			clusters[numclusters++] = leaf->cluster;
+	}
+	R_MarkReflLeaves(clusters, numclusters);
+
 	g_drawing_refl = true;	/* begin drawing reflection */
 
 	g_last_known_fov = fd->fov_y;
@@ -569,6 +633,7 @@ R_UpdateReflTex(refdef_t * fd)
 	}
 
 	g_drawing_refl = false;					/* done drawing refl */
+	r_numfrustumplanes = 4;
 	qglClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);	/* clear stuff now cause we want to render scene */
 }
 
@@ -17,6 +17,7 @@ void		R_shutdown_refl(void);
 void		R_setupArrays(int maxNoReflections);
 void		R_clear_refl(void);
 void		R_add_refl(float x, float y, float z, float normalX, float normalY, float normalZ, float distance2);
+int		R_FindRefl(vec3_t normal, float dist);
 int		txm_genTexObject(unsigned char *texData, int w, int h,
                                  int format, qboolean repeat, qboolean mipmap);
 void		R_RecursiveFindRefl(mnode_t * node);
@@ -27,8 +28,9 @@ void		R_LoadReflMatrix();
 void		R_ClearReflMatrix();
 void		setupClippingPlanes();
 
+#define	MAX_REFL_CLUSTERS	32	/* PVS clusters marked for the reflections */
+
 /* vars other files need access to */
-extern qboolean	g_drawing_refl;
 extern qboolean	g_refl_enabled;
 extern unsigned int g_reflTexW, g_reflTexH;
 extern float	g_refl_aspect;
@@ -84,12 +84,14 @@ image_t        *r_bholetexture;
 entity_t       *currententity;
 model_t        *currentmodel;
 
-cplane_t	frustum[4];
+cplane_t	frustum[5];	/* the reflection plane is the fifth */
+int		r_numfrustumplanes = 4;
 
 int		r_visframecount;/* bumped when going to a new PVS */
 int		r_framecount;	/* used for dlight push checking */
 
 int		c_brush_polys, c_alias_polys;
+int		c_world_batches;
 
 float		v_blend[4];	/* final blending color */
 
@@ -143,6 +145,7 @@ cvar_t         *r_model_alpha;
 cvar_t         *r_lefthand;
 
 cvar_t         *gl_stainmaps;
+cvar_t         *gl_stainmaps_budget;
 
 cvar_t         *r_lightlevel;	/* FIXME: This is a HACK to get the client's light level */
 
@@ -229,6 +232,7 @@ cvar_t         *gl_decals_time;
 cvar_t         *gl_glares;
 cvar_t         *gl_glares_size;
 cvar_t         *gl_glares_intens;
+cvar_t         *gl_glares_async;
 cvar_t         *gl_dlight_cutoff;
 
 cvar_t         *gl_minimap;
@@ -246,6 +250,8 @@ cvar_t         *gl_flare_force_style;
 cvar_t         *gl_flare_intensity;
 cvar_t         *gl_flare_maxdist;
 cvar_t         *gl_flare_scale;
+cvar_t         *gl_flares_occlusion;
+cvar_t         *gl_profile;
 
 cvar_t         *gl_coloredlightmaps; /* NiceAss */
 
@@ -261,6 +267,7 @@ cvar_t         *gl_reflection_fragment_program;
 cvar_t         *gl_reflection;			/* MPO	alpha transparency, 1.0 is full bright */
 cvar_t         *gl_reflection_debug;		/* MPO	for debugging the reflection */
 cvar_t         *gl_reflection_max;		/* MPO  max number of water reflections */
+cvar_t         *gl_reflection_scale;		/* reflection texture size relative to the screen */
 cvar_t         *gl_reflection_shader;		/* MPO	enable/disable fragment shaders */
 cvar_t         *gl_reflection_shader_image;
 cvar_t         *gl_reflection_water_surface;	/* MPO	enable/disable fragment shaders */
@@ -269,6 +276,14 @@ cvar_t         *gl_reflection_water_surface;	/* MPO	enable/disable fragment shad
 cvar_t         *gl_detailtextures;
 /* MH - detail textures begin */
 
+cvar_t         *gl_worldbatch;
+cvar_t         *gl_alias_floatframes;
+cvar_t         *gl_imagethreads;
+cvar_t         *gl_loadprogress;
+cvar_t         *gl_texcache;
+cvar_t         *gl_lightmapthreads;
+cvar_t         *gl_loadthreads;
+
 /* mpo - needed for fragment shaders */
 void            (APIENTRY * qglGenProgramsARB) (GLint n, GLuint * programs);
 void            (APIENTRY * qglDeleteProgramsARB) (GLint n, const GLuint * programs);
@@ -279,6 +294,20 @@ void            (APIENTRY * qglProgramLocalParameter4fARB) (GLenum target, GLuin
 
 /* mpo - needed for fragment shaders */
 
+void            (APIENTRY * qglBindBufferARB) (GLenum target, GLuint buffer);
+void            (APIENTRY * qglDeleteBuffersARB) (GLsizei n, const GLuint * buffers);
+void            (APIENTRY * qglGenBuffersARB) (GLsizei n, GLuint * buffers);
+void            (APIENTRY * qglBufferDataARB) (GLenum target, GLsizeiptrARB size, const GLvoid * data, GLenum usage);
+void           *(APIENTRY * qglMapBufferARB) (GLenum target, GLenum access);
+GLboolean(APIENTRY * qglUnmapBufferARB) (GLenum target);
+void            (APIENTRY * qglGenQueriesARB) (GLsizei n, GLuint * ids);
+void            (APIENTRY * qglDeleteQueriesARB) (GLsizei n, const GLuint * ids);
+void            (APIENTRY * qglBeginQueryARB) (GLenum target, GLuint id);
+void            (APIENTRY * qglEndQueryARB) (GLenum target);
+void            (APIENTRY * qglGetQueryObjectuivARB) (GLuint id, GLenum pname, GLuint * params);
+void            (APIENTRY * qglQueryCounter) (GLuint id, GLenum target);
+void            (APIENTRY * qglGetQueryObjectui64v) (GLuint id, GLenum pname, GLuint64 * params);
+
 /*
  * ================= GL_Stencil
  *
@@ -313,7 +342,7 @@ R_CullBox(vec3_t mins, vec3_t maxs)
 	if (r_nocull->value)
 		return false;
 
-	for (i = 0; i < 4; i++)
+	for (i = 0; i < r_numfrustumplanes; i++)
 		if (BoxOnPlaneSide(mins, maxs, &frustum[i]) == 2)
 			return true;
 	return false;
@@ -488,42 +517,106 @@ typedef struct sortedent_s {
 
 sortedent_t	theents[MAX_ENTITIES];
 
-int
-transCompare(const void *arg1, const void *arg2)
-{
-	const sortedent_t *a1, *a2;
+/*
+ * ================ R_RadixSortDescending
+ *
+ * Orders the indexes 0 .. count-1 by decreasing key, equal keys keep their
+ * order.  Three 11 bit passes over the keys, which are the bit patterns of
+ * non negative floats and so order like the floats themselves. ================
+ */
+#define	RADIX_BITS	11
+#define	RADIX_SIZE	(1 << RADIX_BITS)
 
-	a1 = (sortedent_t *) arg1;
-	a2 = (sortedent_t *) arg2;
-	return (a2->len - a1->len);
-}
+typedef union {
+	float		f;
+	unsigned	u;
+} sortkey_t;
 
-sortedent_t
-NewSortEnt(entity_t * ent, qboolean waterstart)
+static void
+R_RadixSortDescending(const sortkey_t * keys, int count, int *order)
 {
-	vec3_t		result;
-	sortedent_t	s_ent;
+	static int	scratch[MAX_PARTICLES];
+	int		counts[RADIX_SIZE];
+	int            *src, *dst, *t;
+	int		i, pass, shift, sum, c;
+	unsigned	key;
+
+	for (i = 0; i < count; i++)
+		order[i] = i;
+
+	/* three passes leave the result in scratch, copied back below */
+	src = order;
+	dst = scratch;
+	for (pass = 0, shift = 0; pass < 3; pass++, shift += RADIX_BITS) {
+		memset(counts, 0, sizeof(counts));
+		for (i = 0; i < count; i++)
+			counts[(~keys[i].u >> shift) & (RADIX_SIZE - 1)]++;
+
+		/* every key has the same digit, the pass wouldn't move anything */
+		if (counts[(~keys[0].u >> shift) & (RADIX_SIZE - 1)] == count)
+			continue;
 
-	s_ent.ent = ent;
+		for (i = 0, sum = 0; i < RADIX_SIZE; i++) {
+			c = counts[i];
+			counts[i] = sum;
+			sum += c;
+		}
+		for (i = 0; i < count; i++) {
+			key = (~keys[src[i]].u >> shift) & (RADIX_SIZE - 1);
+			dst[counts[key]++] = src[i];
+		}
 
-	VectorSubtract(ent->origin, r_origin, result);
-	s_ent.len = (result[0] * result[0]) + (result[1] * result[1]) + (result[2] * result[2]);
+		t = src;
+		src = dst;
+		dst = t;
+	}
 
-	s_ent.inwater = (Mod_PointInLeaf(ent->origin, r_worldmodel)->contents & MASK_WATER);
-	if (ent->flags & RF_WEAPONMODEL || ent->flags & RF_VIEWERMODEL)
-		s_ent.inwater = waterstart;
+	if (src != order)
+		memcpy(order, src, count * sizeof(*order));
+}
+
+/* the squared distance from the view as a sort key */
+static sortkey_t
+R_DistanceKey(vec3_t origin)
+{
+	vec3_t		delta;
+	sortkey_t	key;
 
-	return s_ent;
+	VectorSubtract(origin, r_origin, delta);
+	key.f = DotProduct(delta, delta);
+	return key;
 }
+
 void
 R_SortEntitiesOnList(qboolean inwater)
 {
+	static sortkey_t keys[MAX_ENTITIES];
+	static int	order[MAX_ENTITIES];
+	entity_t       *ent;
+	sortedent_t    *s;
 	int		i;
 
+	if (!r_refdef.num_entities)
+		return;
+
 	for (i = 0; i < r_refdef.num_entities; i++)
-		theents[i] = NewSortEnt(&r_refdef.entities[i], inwater);
+		keys[i] = R_DistanceKey(r_refdef.entities[i].origin);
+
+	R_RadixSortDescending(keys, r_refdef.num_entities, order);
+
+	for (i = 0, s = theents; i < r_refdef.num_entities; i++, s++) {
+		ent = &r_refdef.entities[order[i]];
+		s->ent = ent;
+		s->len = keys[order[i]].f;
 
-	qsort((void *)theents, r_refdef.num_entities, sizeof(sortedent_t), transCompare);
+		/* solid entities never look at it */
+		if (ent->flags & (RF_WEAPONMODEL | RF_VIEWERMODEL))
+			s->inwater = inwater;
+		else if (ent->flags & RF_TRANSLUCENT)
+			s->inwater = (Mod_PointInLeaf(ent->origin, r_worldmodel)->contents & MASK_WATER);
+		else
+			s->inwater = false;
+	}
 }
 
 void
@@ -727,29 +820,27 @@ typedef struct sortedpart_s {
 
 sortedpart_t	theparts[MAX_PARTICLES];
 
-sortedpart_t
-NewSortPart(particle_t * p)
-{
-	vec3_t		result;
-	sortedpart_t	s_part;
-
-	s_part.p = p;
-	VectorSubtract(p->origin, r_origin, result);
-	s_part.len = (result[0] * result[0]) + (result[1] * result[1]) + (result[2] * result[2]);
-	s_part.inwater = (Mod_PointInLeaf(p->origin, r_worldmodel)->contents & MASK_WATER);
-
-	return s_part;
-}
-
 void
 R_SortParticlesOnList(int num_particles, const particle_t particles[])
 {
+	static sortkey_t keys[MAX_PARTICLES];
+	static int	order[MAX_PARTICLES];
+	sortedpart_t   *s;
 	int		i;
 
+	if (!num_particles)
+		return;
+
 	for (i = 0; i < num_particles; i++)
-		theparts[i] = NewSortPart((particle_t *) & particles[i]);
+		keys[i] = R_DistanceKey((float *)particles[i].origin);
 
-	qsort((void *)theparts, num_particles, sizeof(sortedpart_t), transCompare);
+	R_RadixSortDescending(keys, num_particles, order);
+
+	for (i = 0, s = theparts; i < num_particles; i++, s++) {
+		s->p = (particle_t *) & particles[order[i]];
+		s->len = keys[order[i]].f;
+		s->inwater = s->p->inwater;
+	}
 }
 
 int
@@ -784,6 +875,83 @@ AngleFind(float input)
 {
 	return 180.0 / input;
 }
+
+/*
+ * Plain camera facing particles are streamed into the vertex arrays and
+ * drawn together until the texture or blend mode changes, or a particle
+ * that needs its own state comes along.
+ */
+#define	PART_UNBATCHED	(PART_SPARK | PART_BEAM | PART_LIGHTNING | PART_DIRECTION | PART_ANGLED | PART_DEPTHHACK)
+
+static int	r_partverts;
+static int	r_parttexnum;
+
+static void
+R_FlushParticleBatch(void)
+{
+	if (!r_partverts)
+		return;
+
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglEnableClientState(GL_COLOR_ARRAY);
+
+	qglTexCoordPointer(2, GL_FLOAT, sizeof(tex_array[0]), tex_array[0]);
+	qglVertexPointer(3, GL_FLOAT, sizeof(vert_array[0]), vert_array[0]);
+	qglColorPointer(4, GL_FLOAT, sizeof(col_array[0]), col_array[0]);
+
+	qglDrawArrays(GL_QUADS, 0, r_partverts);
+
+	qglDisableClientState(GL_VERTEX_ARRAY);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglDisableClientState(GL_COLOR_ARRAY);
+
+	r_partverts = 0;
+}
+
+static void
+R_BatchParticle(const particle_t * p, float size, vec3_t coord[4], const byte color[4])
+{
+	static const float st[4][2] = {{0, 1}, {0, 0}, {1, 0}, {1, 1}};
+	vec3_t		angl_coord[4], angles;
+	vec3_t		ang_up, ang_right, ang_forward;
+	float		r, g, b, a;
+	int		i;
+
+	if (r_partverts + 4 > MAX_ARRAY)
+		R_FlushParticleBatch();
+
+	/* if we have roll, we do calcs */
+	if (p->angle[2]) {
+		VectorSubtract(p->origin, r_refdef.vieworg, angl_coord[0]);
+
+		vectoanglerolled(angl_coord[0], p->angle[2], angles);
+		AngleVectors(angles, ang_forward, ang_right, ang_up);
+
+		VectorScale(ang_right, 0.75, ang_right);
+		VectorScale(ang_up, 0.75, ang_up);
+
+		VectorAdd(ang_up, ang_right, angl_coord[0]);
+		VectorSubtract(ang_right, ang_up, angl_coord[1]);
+		VectorNegate(angl_coord[0], angl_coord[2]);
+		VectorNegate(angl_coord[1], angl_coord[3]);
+		coord = angl_coord;
+	}
+
+	r = color[0] * (1.0f / 255);
+	g = color[1] * (1.0f / 255);
+	b = color[2] * (1.0f / 255);
+	a = color[3] * (1.0f / 255);
+
+	for (i = 0; i < 4; i++, r_partverts++) {
+		VA_SetElem2(tex_array[r_partverts], st[i][0], st[i][1]);
+		VA_SetElem4(col_array[r_partverts], r, g, b, a);
+		VA_SetElem3(vert_array[r_partverts],
+		    p->origin[0] + coord[i][0] * size,
+		    p->origin[1] + coord[i][1] * size,
+		    p->origin[2] + coord[i][2] * size);
+	}
+}
 void
 GL_DrawParticles(int num_particles, qboolean inWater)
 {
@@ -791,7 +959,8 @@ GL_DrawParticles(int num_particles, qboolean inWater)
 	float		size, lighting = gl_particlelighting->value;
 	int		oldrender = 0, rendertype = 0;
 
-	byte		alpha;
+	byte		alpha, color[4];
+	qboolean	batched;
 
 	vec3_t		up = {vup[0] * 0.75, vup[1] * 0.75, vup[2] * 0.75};
 	vec3_t		right = {vright[0] * 0.75, vright[1] * 0.75, vright[2] * 0.75};
@@ -842,14 +1011,20 @@ GL_DrawParticles(int num_particles, qboolean inWater)
 
 		oldrender = rendertype;
 		rendertype = (p->flags & PART_TRANS) ? 1 : 0;
+		batched = !(p->flags & PART_UNBATCHED);
+		if (rendertype != oldrender || !batched || texParticle(p->image) != r_parttexnum)
+			R_FlushParticleBatch();
+
 		if (rendertype != oldrender) {
 			if (rendertype == 1)
 				qglBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 			else
 				qglBlendFunc(GL_SRC_ALPHA, GL_ONE);
 		}
-		if (!(p->flags & PART_SPARK))
-			GL_Bind(texParticle(p->image));
+		if (!(p->flags & PART_SPARK)) {
+			r_parttexnum = texParticle(p->image);
+			GL_Bind(r_parttexnum);
+		}
 
 		alpha = p->alpha * 254.0;
 		size = (p->size > 0.1) ? p->size : 0.1;
@@ -874,9 +1049,21 @@ GL_DrawParticles(int num_particles, qboolean inWater)
 						shadelight[j] *= 255 / lightest;
 			}
 
-			qglColor4ub(shadelight[0], shadelight[1], shadelight[2], alpha);
-		} else
-			qglColor4ub(p->red, p->green, p->blue, alpha);
+			color[0] = shadelight[0];
+			color[1] = shadelight[1];
+			color[2] = shadelight[2];
+		} else {
+			color[0] = p->red;
+			color[1] = p->green;
+			color[2] = p->blue;
+		}
+		color[3] = alpha;
+
+		if (batched) {
+			R_BatchParticle(p, size, coord, color);
+			continue;
+		}
+		qglColor4ubv(color);
 
 		/*
 		 * id move this somewhere less dirty, but im too damn lazy -
@@ -1310,6 +1497,8 @@ GL_DrawParticles(int num_particles, qboolean inWater)
 			qglDepthRange(gldepthmin, gldepthmax);
 	}
 
+	R_FlushParticleBatch();
+
 	qglDepthRange(gldepthmin, gldepthmax);
 	qglBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 	GL_TexEnv(GL_MODULATE);
@@ -1566,10 +1755,54 @@ R_SetFrustum(void)
 		frustum[i].dist = DotProduct(r_origin, frustum[i].normal);
 		frustum[i].signbits = SignbitsForPlane(&frustum[i]);
 	}
+
+	/*
+	 * a reflection only shows what is in front of the water, the same
+	 * side setupClippingPlanes keeps
+	 */
+	r_numfrustumplanes = 4;
+	if (g_drawing_refl) {
+		if (r_refdef.rdflags & RDF_UNDERWATER) {
+			VectorNegate(waterNormals[g_active_refl], frustum[4].normal);
+			frustum[4].dist = -g_waterDistance2[g_active_refl];
+		} else {
+			VectorCopy(waterNormals[g_active_refl], frustum[4].normal);
+			frustum[4].dist = g_waterDistance2[g_active_refl];
+		}
+		frustum[4].type = PLANE_ANYZ;
+		frustum[4].signbits = SignbitsForPlane(&frustum[4]);
+		r_numfrustumplanes = 5;
+	}
 }
 
 /* ======================================================================= */
 
+/*
+ * =============== R_ViewClusters
+ *
+ * The cluster of a view origin, and the one just above or below it so
+ * crossing solid water doesn't draw wrong
+ * ===============
+ */
+void
+R_ViewClusters(vec3_t org, int *cluster, int *cluster2)
+{
+	mleaf_t        *leaf;
+	vec3_t		temp;
+
+	leaf = Mod_PointInLeaf(org, r_worldmodel);
+	*cluster = *cluster2 = leaf->cluster;
+
+	VectorCopy(org, temp);
+	if (!leaf->contents)	/* look down a bit */
+		temp[2] -= 16;
+	else			/* look up a bit */
+		temp[2] += 16;
+	leaf = Mod_PointInLeaf(temp, r_worldmodel);
+	if (!(leaf->contents & CONTENTS_SOLID))
+		*cluster2 = leaf->cluster;
+}
+
 /*
  * =============== R_SetupFrame ===============
  */
@@ -1577,7 +1810,6 @@ void
 R_SetupFrame(void)
 {
 	int		i;
-	mleaf_t        *leaf;
 
 	r_framecount++;
 
@@ -1601,26 +1833,7 @@ R_SetupFrame(void)
 		distance = DotProduct(r_origin, waterNormals[g_active_refl]) - g_waterDistance2[g_active_refl];
 		VectorMA(r_refdef.vieworg, distance * -2, waterNormals[g_active_refl], r_origin);
 
-		if (!(r_refdef.rdflags & RDF_NOWORLDMODEL)) {
-			vec3_t		temp;
-
-			temp[0] = g_refl_X[g_active_refl];	/* sets PVS over x */
-			temp[1] = g_refl_Y[g_active_refl];	/* and y coordinate of water surface */
-
-			VectorCopy(r_origin, temp);
-			if (r_refdef.rdflags & RDF_UNDERWATER) {
-				temp[2] = g_refl_Z[g_active_refl] - 1;	/* just above water level */
-			} else {
-				temp[2] = g_refl_Z[g_active_refl] + 1;	/* just below water level */
-			}
-
-			leaf = Mod_PointInLeaf(temp, r_worldmodel);
-
-			if (!(leaf->contents & CONTENTS_SOLID) &&
-			    (leaf->cluster != r_viewcluster)) {
-				r_viewcluster2 = leaf->cluster;
-			}
-		}
+		/* the PVS was set up for all reflections by R_UpdateReflTex */
 		return;
 	}
 	/* stop MPO */
@@ -1629,38 +1842,16 @@ R_SetupFrame(void)
 	if (!(r_refdef.rdflags & RDF_NOWORLDMODEL)) {
 		r_oldviewcluster = r_viewcluster;
 		r_oldviewcluster2 = r_viewcluster2;
-		leaf = Mod_PointInLeaf(r_origin, r_worldmodel);
-		r_viewcluster = r_viewcluster2 = leaf->cluster;
-
-		/*
-		 * check above and below so crossing solid water doesn't draw
-		 * wrong
-		 */
-		if (!leaf->contents) {	/* look down a bit */
-			vec3_t		temp;
-
-			VectorCopy(r_origin, temp);
-			temp[2] -= 16;
-			leaf = Mod_PointInLeaf(temp, r_worldmodel);
-			if (!(leaf->contents & CONTENTS_SOLID) &&
-			    (leaf->cluster != r_viewcluster2))
-				r_viewcluster2 = leaf->cluster;
-		} else {	/* look up a bit */
-			vec3_t		temp;
-
-			VectorCopy(r_origin, temp);
-			temp[2] += 16;
-			leaf = Mod_PointInLeaf(temp, r_worldmodel);
-			if (!(leaf->contents & CONTENTS_SOLID) &&
-			    (leaf->cluster != r_viewcluster2))
-				r_viewcluster2 = leaf->cluster;
-		}
+		R_ViewClusters(r_origin, &r_viewcluster, &r_viewcluster2);
 	}
 	for (i = 0; i < 4; i++)
 		v_blend[i] = r_refdef.blend[i];
 
 	c_brush_polys = 0;
 	c_alias_polys = 0;
+	c_world_batches = 0;
+	c_lightmap_builds = 0;
+	c_lightmap_uploads = 0;
 
 	/* clear out the portion of the screen that the NOWORLDMODEL defines */
 	if (r_refdef.rdflags & RDF_NOWORLDMODEL) {
@@ -1935,15 +2126,18 @@ R_RenderView(refdef_t * fd)
 	if (r_speeds->value) {
 		c_brush_polys = 0;
 		c_alias_polys = 0;
+		c_world_batches = 0;
+		c_lightmap_builds = 0;
+		c_lightmap_uploads = 0;
 	}
 	R_PushDlights();
 
 	if (gl_finish->value)
 		qglFinish();
 
-	if ((r_refdef.num_newstains > 0) && (gl_stainmaps->value)) {
+	/* the reflections see the same stains */
+	if (gl_stainmaps->value && !g_drawing_refl)
 		R_ApplyStains();
-	}
 	R_SetupGL();		/* MPO moved here .. */
 
 	R_SetupFrame();
@@ -1954,11 +2148,15 @@ R_RenderView(refdef_t * fd)
 
 	/* R_SetupGL (); */
 
+	R_ProfileBegin(PROF_MARKLEAVES);
 	R_MarkLeaves();		/* done here so we know if we're in water */
+	R_ProfileEnd(PROF_MARKLEAVES);
 
 	drawPlayerReflection();
 
+	R_ProfileBegin(PROF_WORLD);
 	R_DrawWorld();
+	R_ProfileEnd(PROF_WORLD);
 
 #ifdef QMAX
 	if (r_refdef.rdflags & RDF_NOWORLDMODEL || !gl_transrendersort->value) {
@@ -1972,7 +2170,9 @@ R_RenderView(refdef_t * fd)
 	}
 #endif
 
+	R_ProfileBegin(PROF_DECALS);
 	R_AddDecals(); /* Decals */
+	R_ProfileEnd(PROF_DECALS);
 	
 	if (gl_flares->value) {
 		if (gl_fogenable->value /*|| gl_fogunderwater->value*/) {
@@ -1987,21 +2187,27 @@ R_RenderView(refdef_t * fd)
 
 	setupModelLighting();	/* dukey sets up opengl dynamic lighting for entitites. */
 
+	R_ProfileBegin(PROF_ENTITIES);
 #ifdef QMAX
 	R_DrawEntitiesOnList((inWater) ? false : true, true);
 #else
 	R_DrawEntitiesOnList();
 #endif
+	R_ProfileEnd(PROF_ENTITIES);
 
 	/* R_RenderDlights (); */
 #ifdef QMAX
+	R_ProfileBegin(PROF_PARTICLES);
 	R_DrawParticles((inWater) ? false : true);
+	R_ProfileEnd(PROF_PARTICLES);
 #else
 
 	if (!gl_ext_texture_compression->value) {
 		R_BloomBlend(fd);	/* BLOOMS */
 	}
+	R_ProfileBegin(PROF_PARTICLES);
 	R_DrawParticles();
+	R_ProfileEnd(PROF_PARTICLES);
 #endif
 
 	if (gl_alpha_surfaces->value) {
@@ -2011,14 +2217,20 @@ R_RenderView(refdef_t * fd)
 	}
 
 #ifdef QMAX
+	R_ProfileBegin(PROF_ENTITIES);
 	R_DrawEntitiesOnList((inWater) ? true : false, false);
+	R_ProfileEnd(PROF_ENTITIES);
 
 	if (!gl_ext_texture_compression->value) {
 		R_BloomBlend(fd);	/* BLOOMS */
 	}
+	R_ProfileBegin(PROF_PARTICLES);
 	R_DrawParticles((inWater) ? true : false);
+	R_ProfileEnd(PROF_PARTICLES);
 #else
+	R_ProfileBegin(PROF_PARTICLES);
 	R_DrawParticles();
+	R_ProfileEnd(PROF_PARTICLES);
 #endif
 
 	/* start MPO */
@@ -2096,12 +2308,17 @@ R_RenderView(refdef_t * fd)
 int
 R_DrawRSpeeds(char *S)
 {
-	return sprintf(S, "%4i wpoly %4i epoly %i tex %i lmaps",
+	return sprintf(S, "%4i wpoly %4i epoly %i tex %i lmaps %i batches %i lmbuilds %i lmuploads %i vleafs %i vnodes",
 
 	c_brush_polys,
 	c_alias_polys,
 	c_visible_textures,
-	c_visible_lightmaps);
+	c_visible_lightmaps,
+	c_world_batches,
+	c_lightmap_builds,
+	c_lightmap_uploads,
+	c_mark_leafs,
+	c_mark_nodes);
 }
 
 unsigned int	blurtex = 0;
@@ -2151,6 +2368,8 @@ R_MotionBlur (void)
 void
 R_SetGL2D(void)
 {
+	Draw_Flush2D();
+
 	/* set 2D virtual screen size */
 	qglViewport(0, 0, vid.width, vid.height);
 	qglMatrixMode(GL_PROJECTION);
@@ -2180,6 +2399,7 @@ R_SetGL2D(void)
 
 		for (i = 0; i < n; i++)
 			Draw_Char(r_refdef.width - 4 + ((i - n) * 8), r_refdef.height - 40, 128 + S[i], 255);
+		Draw_Flush2D();
 	}
 }
 
@@ -2267,6 +2487,9 @@ R_SetLightLevel(void)
 void
 R_RenderFrame(refdef_t * fd)
 {
+	Draw_Flush2D();
+	R_ProfileBegin(PROF_REFRESH);
+
 	/* start MPO */
 	if (gl_reflection->value) {
 
@@ -2276,7 +2499,9 @@ R_RenderFrame(refdef_t * fd)
 		R_clear_refl();	/* clear our reflections found in last frame */
 		R_RecursiveFindRefl(r_worldmodel->nodes);	/* find reflections for
 								 * this frame */
+		R_ProfileBegin(PROF_REFLECTIONS);
 		R_UpdateReflTex(fd);	/* render reflections to textures */
+		R_ProfileEnd(PROF_REFLECTIONS);
 	} else {
 		R_clear_refl();
 	}
@@ -2285,7 +2510,9 @@ R_RenderFrame(refdef_t * fd)
 	R_RenderView(fd);
 	R_SetLightLevel();
 	R_SetGL2D();
+	R_ProfileBegin(PROF_GLARES);
 	R_RenderGlares(fd);
+	R_ProfileEnd(PROF_GLARES);
 
 	/* start MPO */
 	/* if debugging is enabled and reflections are enabled.. draw it */
@@ -2293,6 +2520,7 @@ R_RenderFrame(refdef_t * fd)
 		R_DrawDebugReflTexture();
 	}
 	/* end MPO */
+	R_ProfileEnd(PROF_REFRESH);
 }
 
 
@@ -2323,6 +2551,7 @@ R_Register(void)
 	gl_particles = ri.Cvar_Get("gl_particles", "0", CVAR_ARCHIVE);
 #endif
 	gl_stainmaps = ri.Cvar_Get("gl_stainmaps", "0", CVAR_ARCHIVE);
+	gl_stainmaps_budget = ri.Cvar_Get("gl_stainmaps_budget", "16384", CVAR_ARCHIVE);
 	gl_dlight_cutoff = ri.Cvar_Get("gl_dlight_cutoff", "0", CVAR_ARCHIVE);
 	gl_shellstencil = ri.Cvar_Get("gl_shellstencil", "1", CVAR_ARCHIVE);
 	gl_nosubimage = ri.Cvar_Get("gl_nosubimage", "0", 0);
@@ -2352,7 +2581,7 @@ R_Register(void)
 	gl_texturesolidmode = ri.Cvar_Get("gl_texturesolidmode", "default", CVAR_ARCHIVE);
 	gl_lockpvs = ri.Cvar_Get("gl_lockpvs", "0", 0);
 	gl_ext_mtexcombine = ri.Cvar_Get("gl_ext_mtexcombine", "1", CVAR_ARCHIVE);
-	gl_vertex_arrays = ri.Cvar_Get("gl_vertex_arrays", "0", CVAR_ARCHIVE);
+	gl_vertex_arrays = ri.Cvar_Get("gl_vertex_arrays", "1", CVAR_ARCHIVE);
 	gl_ext_multitexture = ri.Cvar_Get("gl_ext_multitexture", "1", CVAR_ARCHIVE);
 	gl_ext_pointparameters = ri.Cvar_Get("gl_ext_pointparameters", "1", CVAR_ARCHIVE);
 	gl_ext_compiled_vertex_array = ri.Cvar_Get("gl_ext_compiled_vertex_array", "1", CVAR_ARCHIVE);
@@ -2388,6 +2617,7 @@ R_Register(void)
 	gl_reflection = ri.Cvar_Get("gl_reflection", "0", CVAR_ARCHIVE);
 	gl_reflection_debug = ri.Cvar_Get("gl_reflection_debug", "0", 0);
 	gl_reflection_max = ri.Cvar_Get("gl_reflection_max", "2", 0);
+	gl_reflection_scale = ri.Cvar_Get("gl_reflection_scale", "1", CVAR_ARCHIVE);
 	gl_reflection_shader = ri.Cvar_Get("gl_reflection_shader", "0", CVAR_ARCHIVE);
 	gl_reflection_shader_image = ri.Cvar_Get("gl_reflection_shader_image",
 	                                          "/textures/water/distortion.pcx", CVAR_ARCHIVE);
@@ -2399,18 +2629,28 @@ R_Register(void)
 	gl_minimap_x = ri.Cvar_Get("gl_minimap_x", "800", CVAR_ARCHIVE);
 	gl_minimap_y = ri.Cvar_Get("gl_minimap_y", "400", CVAR_ARCHIVE);
 	gl_detailtextures = ri.Cvar_Get("gl_detailtextures", "0.0", CVAR_ARCHIVE);
+	gl_worldbatch = ri.Cvar_Get("gl_worldbatch", "1", CVAR_ARCHIVE);
+	gl_alias_floatframes = ri.Cvar_Get("gl_alias_floatframes", "0", CVAR_ARCHIVE);
+	gl_imagethreads = ri.Cvar_Get("gl_imagethreads", "-1", CVAR_ARCHIVE);
+	gl_loadprogress = ri.Cvar_Get("gl_loadprogress", "1", CVAR_ARCHIVE);
+	gl_texcache = ri.Cvar_Get("gl_texcache", "0", CVAR_ARCHIVE);
+	gl_lightmapthreads = ri.Cvar_Get("gl_lightmapthreads", "-1", CVAR_ARCHIVE);
+	gl_loadthreads = ri.Cvar_Get("gl_loadthreads", "-1", CVAR_ARCHIVE);
 	gl_shading = ri.Cvar_Get("gl_shading", "1", CVAR_ARCHIVE);
 	gl_decals = ri.Cvar_Get("gl_decals", "1", CVAR_ARCHIVE);
 	gl_decals_time = ri.Cvar_Get("gl_decals_time", "30", CVAR_ARCHIVE);
 	gl_glares = ri.Cvar_Get("gl_glares", "0", CVAR_ARCHIVE);
 	gl_glares_size = ri.Cvar_Get("gl_glares_size", "128", CVAR_ARCHIVE);
 	gl_glares_intens = ri.Cvar_Get("gl_glares_intens", "0.35", CVAR_ARCHIVE);
+	gl_glares_async = ri.Cvar_Get("gl_glares_async", "1", CVAR_ARCHIVE);
 	gl_flares = ri.Cvar_Get("gl_flares", "1", CVAR_ARCHIVE);
 	gl_flare_force_size = ri.Cvar_Get("gl_flare_force_size", "0", CVAR_ARCHIVE);
 	gl_flare_force_style = ri.Cvar_Get("gl_flare_force_style", "1", CVAR_ARCHIVE);
 	gl_flare_intensity = ri.Cvar_Get("gl_flare_intensity", "1", CVAR_ARCHIVE);
 	gl_flare_maxdist = ri.Cvar_Get("gl_flare_maxdist", "150", CVAR_ARCHIVE);
 	gl_flare_scale = ri.Cvar_Get("gl_flare_scale", "1.5", CVAR_ARCHIVE);
+	gl_flares_occlusion = ri.Cvar_Get("gl_flares_occlusion", "1", CVAR_ARCHIVE);
+	gl_profile = ri.Cvar_Get("gl_profile", "0", 0);
 	gl_coloredlightmaps = ri.Cvar_Get( "gl_coloredlightmaps", "1", 0);
 
 	r_lefthand = ri.Cvar_Get("hand", "0", CVAR_USERINFO | CVAR_ARCHIVE);
@@ -2436,10 +2676,12 @@ R_Register(void)
 	vid_ref = ri.Cvar_Get("vid_ref", "q2glx", CVAR_ARCHIVE);
 
 	ri.Cmd_AddCommand("imagelist", GL_ImageList_f);
+	ri.Cmd_AddCommand("imagebench", GL_ImageBench_f);
 	ri.Cmd_AddCommand("screenshot", GL_ScreenShot_f);
 	ri.Cmd_AddCommand("modellist", Mod_Modellist_f);
 	ri.Cmd_AddCommand("gl_strings", GL_Strings_f);
 	ri.Cmd_AddCommand("pngshot", GL_ScreenShot_PNG);
+	ri.Cmd_AddCommand("capture", GL_Capture_f);
 }
 
 /*
@@ -2690,6 +2932,72 @@ R_Init(void *hinstance, void *hWnd)
 		ri.Con_Printf(PRINT_ALL, "...GL_SGIS_multitexture not found\n");
 	}
 
+	gl_state.vbo = false;
+	if (strstr(gl_config.extensions_string, "GL_ARB_vertex_buffer_object")) {
+		qglBindBufferARB = (void *)qwglGetProcAddress("glBindBufferARB");
+		qglDeleteBuffersARB = (void *)qwglGetProcAddress("glDeleteBuffersARB");
+		qglGenBuffersARB = (void *)qwglGetProcAddress("glGenBuffersARB");
+		qglBufferDataARB = (void *)qwglGetProcAddress("glBufferDataARB");
+
+		if (qglBindBufferARB && qglDeleteBuffersARB && qglGenBuffersARB && qglBufferDataARB) {
+			ri.Con_Printf(PRINT_ALL, "...using GL_ARB_vertex_buffer_object\n");
+			gl_state.vbo = true;
+		} else {
+			ri.Con_Printf(PRINT_ALL, "...GL_ARB_vertex_buffer_object failed\n");
+		}
+	} else {
+		ri.Con_Printf(PRINT_ALL, "...GL_ARB_vertex_buffer_object not found\n");
+	}
+
+	gl_state.pbo = false;
+	if (gl_state.vbo && strstr(gl_config.extensions_string, "GL_ARB_pixel_buffer_object")) {
+		qglMapBufferARB = (void *)qwglGetProcAddress("glMapBufferARB");
+		qglUnmapBufferARB = (void *)qwglGetProcAddress("glUnmapBufferARB");
+
+		if (qglMapBufferARB && qglUnmapBufferARB) {
+			ri.Con_Printf(PRINT_ALL, "...using GL_ARB_pixel_buffer_object\n");
+			gl_state.pbo = true;
+		} else {
+			ri.Con_Printf(PRINT_ALL, "...GL_ARB_pixel_buffer_object failed\n");
+		}
+	} else {
+		ri.Con_Printf(PRINT_ALL, "...GL_ARB_pixel_buffer_object not found\n");
+	}
+
+	gl_state.occlusion = false;
+	if (strstr(gl_config.extensions_string, "GL_ARB_occlusion_query")) {
+		qglGenQueriesARB = (void *)qwglGetProcAddress("glGenQueriesARB");
+		qglDeleteQueriesARB = (void *)qwglGetProcAddress("glDeleteQueriesARB");
+		qglBeginQueryARB = (void *)qwglGetProcAddress("glBeginQueryARB");
+		qglEndQueryARB = (void *)qwglGetProcAddress("glEndQueryARB");
+		qglGetQueryObjectuivARB = (void *)qwglGetProcAddress("glGetQueryObjectuivARB");
+
+		if (qglGenQueriesARB && qglDeleteQueriesARB && qglBeginQueryARB &&
+		    qglEndQueryARB && qglGetQueryObjectuivARB) {
+			ri.Con_Printf(PRINT_ALL, "...using GL_ARB_occlusion_query\n");
+			gl_state.occlusion = true;
+		} else {
+			ri.Con_Printf(PRINT_ALL, "...GL_ARB_occlusion_query failed\n");
+		}
+	} else {
+		ri.Con_Printf(PRINT_ALL, "...GL_ARB_occlusion_query not found\n");
+	}
+
+	gl_state.timerquery = false;
+	if (gl_state.occlusion && strstr(gl_config.extensions_string, "GL_ARB_timer_query")) {
+		qglQueryCounter = (void *)qwglGetProcAddress("glQueryCounter");
+		qglGetQueryObjectui64v = (void *)qwglGetProcAddress("glGetQueryObjectui64v");
+
+		if (qglQueryCounter && qglGetQueryObjectui64v) {
+			ri.Con_Printf(PRINT_ALL, "...using GL_ARB_timer_query\n");
+			gl_state.timerquery = true;
+		} else {
+			ri.Con_Printf(PRINT_ALL, "...GL_ARB_timer_query failed\n");
+		}
+	} else {
+		ri.Con_Printf(PRINT_ALL, "...GL_ARB_timer_query not found\n");
+	}
+
 	if (strstr(gl_config.extensions_string, "GL_SGIS_generate_mipmap")) {
 		ri.Con_Printf(PRINT_ALL, "...using GL_SGIS_generate_mipmap\n");
 		gl_state.sgis_mipmap = true;
@@ -2870,6 +3178,7 @@ R_Init(void *hinstance, void *hWnd)
 	/* mpo === jitwater */
 	
 	GL_SetDefaultState();
+	R_InitAliasKernels();
 
 	/*
 	 * * draw our stereo patterns
@@ -2914,13 +3223,25 @@ R_Shutdown(void)
 	ri.Cmd_RemoveCommand("modellist");
 	ri.Cmd_RemoveCommand("screenshot");
 	ri.Cmd_RemoveCommand("imagelist");
+	ri.Cmd_RemoveCommand("imagebench");
 	ri.Cmd_RemoveCommand("gl_strings");
 	ri.Cmd_RemoveCommand ("pngshot");
+	ri.Cmd_RemoveCommand("capture");
 
+	GL_ShutdownScreenShots();
 	Mod_FreeAll();
 
+	R_StopLightMapWorkers();
+	GL_ShutdownFlares();
+	R_ShutdownProfile();
+	R_ShutdownGlares();
 	GL_ShutdownImages();
 
+	/*
+	 * * shutdown our reflective arrays, while the context is still there
+	 */
+	R_shutdown_refl();
+
 	/*
 	 * * shut down OS specific OpenGL stuff like contexts, etc.
 	 */
@@ -2930,11 +3251,6 @@ R_Shutdown(void)
 	 * * shutdown our QGL subsystem
 	 */
 	QGL_Shutdown();
-
-	/*
-	 * * shutdown our reflective arrays
-	 */
-	R_shutdown_refl();
 }
 
 
@@ -3077,6 +3393,18 @@ R_BeginFrame(float camera_separation)
 	R_Clear();
 }
 
+/*
+ * ================ R_EndFrame ================
+ */
+void
+R_EndFrame(void)
+{
+	Draw_Flush2D();
+	R_ProfileFrame();
+	R_CaptureFrame();
+	GLimp_EndFrame();
+}
+
 /*
  * ============= R_SetPalette =============
  */
@@ -3323,11 +3651,12 @@ GetRefAPI(refimport_t rimp)
 
 	re.CinematicSetPalette = R_SetPalette;
 	re.BeginFrame = R_BeginFrame;
-	re.EndFrame = GLimp_EndFrame;
+	re.EndFrame = R_EndFrame;
 
 	re.AppActivate = GLimp_AppActivate;
 
 	re.AddDecal = R_AddDecal;
+	re.GetProfile = R_GetProfile;
 
 	Swap_Init();
 
@@ -425,65 +425,144 @@ typedef struct _TargaHeader {
 	unsigned char	pixel_size, attributes;
 } TargaHeader;
 
+/*
+ * Screenshots and "capture" frames are read back at the end of the frame,
+ * through pixel buffer objects that are mapped a frame later when they are
+ * available, and compressed by a small pool of encoder threads.  Capture
+ * frames that find the queue full are dropped and counted instead of
+ * holding up the game; screenshots always get in.
+ */
+
+typedef enum {
+	SHOT_TGA,
+	SHOT_JPG,
+	SHOT_PNG,
+	SHOT_Y4M
+} shotformat_t;
+
+typedef struct shotjob_s {
+	struct shotjob_s *next;
+	shotformat_t	format;
+	int		width, height;
+	int		quality;	/* jpeg */
+	int		sequence;	/* y4m frames go into the file in this order */
+	qboolean	report;		/* print "Wrote" when done */
+	char		path[MAX_OSPATH];
+	byte           *pixels;		/* RGB, bottom row first */
+	char		message[MAX_OSPATH + 64];	/* printed by the main thread */
+} shotjob_t;
+
+#define	SHOT_MAX_WORKERS	4
+#define	SHOT_MAX_QUEUED		8	/* capture frames waiting to be encoded */
+
+static qthread_t *shot_workers[SHOT_MAX_WORKERS];
+static int	shot_numworkers;
+static qmutex_t *shot_lock;
+static qcond_t *shot_wake;
+static qboolean	shot_quit;
+static shotjob_t *shot_head, *shot_tail;
+static int	shot_queued;
+static shotjob_t *shot_done;	/* encoded, waiting for GL_ReportShots */
+
+/* the screenshot asked for this frame, taken by R_CaptureFrame */
+static shotjob_t *shot_request;
+static int	shot_lastindex[SHOT_Y4M];
+
+/* readbacks issued last frame */
+static GLuint	shot_pbo[2];
+static int	shot_pbosize[2];
+static shotjob_t *shot_pending[2];
+
+/* continuous capture */
+static qboolean	capture_active;
+static shotformat_t capture_format;
+static char	capture_name[MAX_QPATH];
+static int	capture_width, capture_height;
+static int	capture_frames, capture_dropped;
+static float	capture_oldfixedtime;	/* put back by GL_StopCapture */
+static FILE    *capture_file;	/* y4m */
+static qmutex_t *capture_filelock;
+static qcond_t *capture_fileturn;
+static int	capture_nextsequence;	/* given to the next queued frame */
+static int	capture_filesequence;	/* next frame to go into the file */
 
 /*
- * ==================
- * GL_ScreenShot_JPG By Robert 'Heffo' Heffernan
+ * ================ GL_ShotMsg
+ *
+ * The encoders can't print, the console belongs to the main thread.
+ * ================
+ */
+static void
+GL_ShotMsg(shotjob_t * job, char *fmt,...)
+{
+	va_list		argptr;
+
+	va_start(argptr, fmt);
+	vsnprintf(job->message, sizeof(job->message), fmt, argptr);
+	va_end(argptr);
+}
+
+/*
+ * ================ GL_WriteTGA ================
+ */
+static void
+GL_WriteTGA(shotjob_t * job)
+{
+	byte		header[18];
+	byte           *row, *p;
+	int		x, y;
+	FILE           *f;
+
+	f = fopen(job->path, "wb");
+	if (!f) {
+		GL_ShotMsg(job, "SCR_ScreenShot_f: Couldn't create a file\n");
+		return;
+	}
+
+	memset(header, 0, 18);
+	header[2] = 2;		/* uncompressed type */
+	header[12] = job->width & 255;
+	header[13] = job->width >> 8;
+	header[14] = job->height & 255;
+	header[15] = job->height >> 8;
+	header[16] = 24;	/* pixel size */
+	fwrite(header, 1, 18, f);
+
+	/* swap rgb to bgr, tga is bottom up too */
+	row = malloc(job->width * 3);
+	for (y = 0; y < job->height; y++) {
+		p = job->pixels + y * job->width * 3;
+		for (x = 0; x < job->width; x++, p += 3) {
+			row[x * 3 + 0] = p[2];
+			row[x * 3 + 1] = p[1];
+			row[x * 3 + 2] = p[0];
+		}
+		fwrite(row, 1, job->width * 3, f);
+	}
+	free(row);
+
+	fclose(f);
+}
+
+/*
+ * ================== GL_WriteJPG By Robert 'Heffo' Heffernan
  * ==================
  */
-void
-GL_ScreenShot_JPG(void)
+static void
+GL_WriteJPG(shotjob_t * job)
 {
 	struct jpeg_compress_struct cinfo;
 	struct jpeg_error_mgr jerr;
-	byte           *rgbdata;
 	JSAMPROW	s[1];
 	FILE           *file;
-	char		picname[80], checkname[MAX_OSPATH];
-	int		i, offset;
+	int		offset;
 
-	/* Create the scrnshots directory if it doesn't exist */
-	Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot", ri.FS_Gamedir());
-	Sys_Mkdir(checkname);
-
-	/* Knightmare- changed screenshot filenames, up to 100 screenies */
-	/* Find a file name to save it to  */
-	/* strcpy(picname,"quake00.jpg"); */
-
-	for (i = 0; i <= 999; i++) {
-		/* picname[5] = i/10 + '0';  */
-		/* picname[6] = i%10 + '0';  */
-		int		one       , ten, hundred;
-
-		hundred = i * 0.01;
-		ten = (i - hundred * 100) * 0.1;
-		one = i - hundred * 100 - ten * 10;
-
-		Com_sprintf(picname, sizeof(picname), "QuDos_%i%i%i.jpg", hundred, ten, one);
-		Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot/%s", ri.FS_Gamedir(), picname);
-		file = fopen(checkname, "rb");
-		if (!file)
-			break;	/* file doesn't exist */
-		fclose(file);
-	}
-	if (i == 1000) {
-		ri.Con_Printf(PRINT_ALL, "SCR_JPGScreenShot_f: Couldn't create a file\n");
-		return;
-	}
 	/* Open the file for Binary Output */
-	file = fopen(checkname, "wb");
+	file = fopen(job->path, "wb");
 	if (!file) {
-		ri.Con_Printf(PRINT_ALL, "SCR_JPGScreenShot_f: Couldn't create a file\n");
+		GL_ShotMsg(job, "SCR_JPGScreenShot_f: Couldn't create a file\n");
 		return;
 	}
-	/* Allocate room for a copy of the framebuffer */
-	rgbdata = malloc(vid.width * vid.height * 3);
-	if (!rgbdata) {
-		fclose(file);
-		return;
-	}
-	/* Read the framebuffer into our storage */
-	qglReadPixels(0, 0, vid.width, vid.height, GL_RGB, GL_UNSIGNED_BYTE, rgbdata);
 
 	/* Initialise the JPEG compression object */
 	cinfo.err = jpeg_std_error(&jerr);
@@ -491,14 +570,12 @@ GL_ScreenShot_JPG(void)
 	jpeg_stdio_dest(&cinfo, file);
 
 	/* Setup JPEG Parameters */
-	cinfo.image_width = vid.width;
-	cinfo.image_height = vid.height;
+	cinfo.image_width = job->width;
+	cinfo.image_height = job->height;
 	cinfo.in_color_space = JCS_RGB;
 	cinfo.input_components = 3;
 	jpeg_set_defaults(&cinfo);
-	if ((gl_screenshot_jpeg_quality->value >= 101) || (gl_screenshot_jpeg_quality->value <= 0))
-		ri.Cvar_Set("gl_screenshot_jpeg_quality", "85");
-	jpeg_set_quality(&cinfo, gl_screenshot_jpeg_quality->value, TRUE);
+	jpeg_set_quality(&cinfo, job->quality, TRUE);
 
 	/* Start Compression */
 	jpeg_start_compress(&cinfo, true);
@@ -506,7 +583,7 @@ GL_ScreenShot_JPG(void)
 	/* Feed Scanline data */
 	offset = (cinfo.image_width * cinfo.image_height * 3) - (cinfo.image_width * 3);
 	while (cinfo.next_scanline < cinfo.image_height) {
-		s[0] = &rgbdata[offset - (cinfo.next_scanline * (cinfo.image_width * 3))];
+		s[0] = &job->pixels[offset - (cinfo.next_scanline * (cinfo.image_width * 3))];
 		jpeg_write_scanlines(&cinfo, s, 1);
 	}
 
@@ -518,79 +595,46 @@ GL_ScreenShot_JPG(void)
 
 	/* Close File */
 	fclose(file);
-
-	/* Free Temp Framebuffer */
-	free(rgbdata);
-
-	/* Done! */
-	ri.Con_Printf(PRINT_ALL, "Wrote %s\n", picname);
 }
 
-
 /*
- * ==================
- * GL_ScreenShot_PNG
+ * ================== GL_WritePNG
  *
  * Thanks Echon/Incith.
  * ==================
  */
-void
-GL_ScreenShot_PNG(void)
+static void
+GL_WritePNG(shotjob_t * job)
 {
-	byte           *buffer;
-	char		picname[MAX_OSPATH];
-	char		checkname[MAX_OSPATH];
-	int		i, k;
+	int		k;
 	FILE           *f;
 	png_structp	png_ptr;
 	png_infop	info_ptr;
 	png_bytep      *row_pointers;
 
-	/* Create the scrnshots directory if it doesn't exist */
-	Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot", ri.FS_Gamedir());
-	Sys_Mkdir(checkname);
-	for (i = 0; i <= 999; i++) {
-		Com_sprintf(picname, sizeof(picname), "QuDos_%i%i%i.png", (int)(i / 100) % 10, (int)(i / 10) % 10, i % 10);
-		Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot/%s", ri.FS_Gamedir(), picname);
-		f = fopen(checkname, "rb");
-		if (!f)
-			break;	/* file doesn't exist */
-		fclose(f);
-	}
-	if (i == 1000) {
-		ri.Con_Printf(PRINT_ALL, "GL_ScreenShot_PNG: Couldn't create a file\n");
-		return;
-	}
 	/* Open the file for Binary Output */
-	f = fopen(checkname, "wb");
+	f = fopen(job->path, "wb");
 	if (!f) {
-		ri.Con_Printf(PRINT_ALL, "GL_ScreenShot_PPG: Couldn't create a file\n");
-		return;
-	}
-	/* Allocate room for a copy of the framebuffer */
-	buffer = malloc(vid.width * vid.height * 3);
-	if (!buffer) {
-		fclose(f);
+		GL_ShotMsg(job, "GL_ScreenShot_PNG: Couldn't create a file\n");
 		return;
 	}
-	/* Read the framebuffer into our storage */
-	qglReadPixels(0, 0, vid.width, vid.height, GL_RGB, GL_UNSIGNED_BYTE, buffer);
 
 	png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
-
 	if (!png_ptr) {
-		ri.Con_Printf(0, "LibPNG Error! (%s)\n", picname);
+		GL_ShotMsg(job, "LibPNG Error! (%s)\n", job->path);
+		fclose(f);
 		return;
 	}
 	info_ptr = png_create_info_struct(png_ptr);
 	if (!info_ptr) {
 		png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
-		ri.Con_Printf(0, "LibPNG Error! (%s)\n", picname);
+		GL_ShotMsg(job, "LibPNG Error! (%s)\n", job->path);
+		fclose(f);
 		return;
 	}
 	png_init_io(png_ptr, f);
 
-	png_set_IHDR(png_ptr, info_ptr, vid.width, vid.height, 8, PNG_COLOR_TYPE_RGB,
+	png_set_IHDR(png_ptr, info_ptr, job->width, job->height, 8, PNG_COLOR_TYPE_RGB,
 	    PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, PNG_FILTER_TYPE_BASE);
 
 	png_set_compression_level(png_ptr, Z_DEFAULT_COMPRESSION);
@@ -598,89 +642,605 @@ GL_ScreenShot_PNG(void)
 
 	png_write_info(png_ptr, info_ptr);
 
-	row_pointers = malloc(vid.height * sizeof(png_bytep));
-	for (k = 0; k < vid.height; k++)
-		row_pointers[k] = buffer + (vid.height - 1 - k) * 3 * vid.width;
+	row_pointers = malloc(job->height * sizeof(png_bytep));
+	for (k = 0; k < job->height; k++)
+		row_pointers[k] = job->pixels + (job->height - 1 - k) * 3 * job->width;
 
 	png_write_image(png_ptr, row_pointers);
 	png_write_end(png_ptr, info_ptr);
 
 	png_destroy_write_struct(&png_ptr, &info_ptr);
+	free(row_pointers);
 
 	fclose(f);
-	free(buffer);
+}
+
+/*
+ * ================ GL_WriteY4M
+ *
+ * Converts to 4:2:0 JPEG range YCbCr and appends it to the capture file,
+ * waiting for the frames queued before it. ================
+ */
+static void
+GL_WriteY4M(shotjob_t * job)
+{
+	byte           *yuv, *y0, *cb, *cr, *p0, *p1;
+	int		w = job->width, h = job->height;
+	int		x, y, r, g, b;
+
+	yuv = malloc(w * h * 3 / 2);
+	cb = yuv + w * h;
+	cr = cb + w * h / 4;
+
+	for (y = 0; y < h; y += 2) {
+		/* top row first, the pixels are bottom up */
+		p0 = job->pixels + (h - 1 - y) * w * 3;
+		p1 = p0 - w * 3;
+		y0 = yuv + y * w;
+
+		for (x = 0; x < w; x += 2, p0 += 6, p1 += 6) {
+			y0[x] = (77 * p0[0] + 150 * p0[1] + 29 * p0[2]) >> 8;
+			y0[x + 1] = (77 * p0[3] + 150 * p0[4] + 29 * p0[5]) >> 8;
+			y0[x + w] = (77 * p1[0] + 150 * p1[1] + 29 * p1[2]) >> 8;
+			y0[x + w + 1] = (77 * p1[3] + 150 * p1[4] + 29 * p1[5]) >> 8;
+
+			r = p0[0] + p0[3] + p1[0] + p1[3];
+			g = p0[1] + p0[4] + p1[1] + p1[4];
+			b = p0[2] + p0[5] + p1[2] + p1[5];
+			*cb++ = ((-43 * r - 85 * g + 128 * b) >> 10) + 128;
+			*cr++ = ((128 * r - 107 * g - 21 * b) >> 10) + 128;
+		}
+	}
+
+	Sys_LockMutex(capture_filelock);
+	while (capture_filesequence != job->sequence)
+		Sys_CondWait(capture_fileturn, capture_filelock);
+	if (capture_file) {
+		fputs("FRAME\n", capture_file);
+		fwrite(yuv, 1, w * h * 3 / 2, capture_file);
+	}
+	capture_filesequence++;
+	Sys_CondBroadcast(capture_fileturn);
+	Sys_UnlockMutex(capture_filelock);
 
-	/* Done! */
-	ri.Con_Printf(0, "Wrote %s\n", picname);
+	free(yuv);
 }
 
+/*
+ * ================ GL_EncodeShot
+ *
+ * Runs on the encoders, the job is handed back through GL_FinishShot.
+ * ================
+ */
+static void
+GL_EncodeShot(shotjob_t * job)
+{
+	switch (job->format) {
+	case SHOT_JPG:
+		GL_WriteJPG(job);
+		break;
+	case SHOT_PNG:
+		GL_WritePNG(job);
+		break;
+	case SHOT_Y4M:
+		GL_WriteY4M(job);
+		break;
+	default:
+		GL_WriteTGA(job);
+		break;
+	}
+
+	if (job->report && !job->message[0])
+		GL_ShotMsg(job, "Wrote %s\n", COM_SkipPath(job->path));
+
+	free(job->pixels);
+	job->pixels = NULL;
+}
 
 /*
- * ================== GL_ScreenShot_f ==================
+ * ================ GL_FinishShot
+ *
+ * Main thread only. ================
+ */
+static void
+GL_FinishShot(shotjob_t * job)
+{
+	if (job->message[0])
+		ri.Con_Printf(PRINT_ALL, "%s", job->message);
+	free(job);
+}
+
+/*
+ * ================ GL_ReportShots
+ *
+ * Prints what the encoders had to say and frees their finished jobs.
+ * ================
+ */
+static void
+GL_ReportShots(void)
+{
+	shotjob_t      *job, *next;
+
+	if (!shot_lock)
+		return;
+
+	Sys_LockMutex(shot_lock);
+	job = shot_done;
+	shot_done = NULL;
+	Sys_UnlockMutex(shot_lock);
+
+	for (; job; job = next) {
+		next = job->next;
+		GL_FinishShot(job);
+	}
+}
+
+/*
+ * ================ GL_ShotWorker ================
+ */
+static void
+GL_ShotWorker(void *arg)
+{
+	shotjob_t      *job;
+
+	Sys_LockMutex(shot_lock);
+	while (1) {
+		while (!shot_quit && !shot_head)
+			Sys_CondWait(shot_wake, shot_lock);
+
+		/* whatever is queued still gets written before quitting */
+		if (!shot_head)
+			break;
+
+		job = shot_head;
+		shot_head = job->next;
+		if (!shot_head)
+			shot_tail = NULL;
+		if (!job->report)
+			shot_queued--;
+		Sys_UnlockMutex(shot_lock);
+
+		GL_EncodeShot(job);
+
+		Sys_LockMutex(shot_lock);
+		job->next = shot_done;
+		shot_done = job;
+	}
+	Sys_UnlockMutex(shot_lock);
+}
+
+/*
+ * ================ GL_StartShotWorkers ================
+ */
+static void
+GL_StartShotWorkers(void)
+{
+	int		count;
+
+	if (shot_lock)
+		return;
+
+	count = bound(1, Sys_CPUCount() / 2, SHOT_MAX_WORKERS);
+
+	shot_lock = Sys_CreateMutex();
+	shot_wake = Sys_CreateCond();
+	capture_filelock = Sys_CreateMutex();
+	capture_fileturn = Sys_CreateCond();
+	shot_quit = false;
+
+	for (shot_numworkers = 0; shot_numworkers < count; shot_numworkers++) {
+		shot_workers[shot_numworkers] = Sys_CreateThread(GL_ShotWorker, NULL);
+		if (!shot_workers[shot_numworkers])
+			break;
+	}
+}
+
+/*
+ * ================ GL_QueueShot
+ *
+ * Hands the job to the encoders, or encodes it right away when there are no
+ * threads.  Returns false when a capture frame was dropped.
+ * ================
+ */
+static qboolean
+GL_QueueShot(shotjob_t * job)
+{
+	GL_StartShotWorkers();
+
+	if (!shot_numworkers) {
+		if (job->format == SHOT_Y4M)
+			job->sequence = capture_nextsequence++;
+		GL_EncodeShot(job);
+		GL_FinishShot(job);
+		return true;
+	}
+
+	Sys_LockMutex(shot_lock);
+	if (!job->report) {
+		if (shot_queued == SHOT_MAX_QUEUED) {
+			Sys_UnlockMutex(shot_lock);
+			free(job->pixels);
+			free(job);
+			return false;
+		}
+		shot_queued++;
+	}
+	if (job->format == SHOT_Y4M)
+		job->sequence = capture_nextsequence++;
+
+	job->next = NULL;
+	if (shot_tail)
+		shot_tail->next = job;
+	else
+		shot_head = job;
+	shot_tail = job;
+	Sys_CondSignal(shot_wake);
+	Sys_UnlockMutex(shot_lock);
+
+	return true;
+}
+
+/*
+ * ================ GL_ShutdownScreenShots
+ *
+ * Waits for everything queued to be written. ================
  */
 void
-GL_ScreenShot_f(void)
+GL_ShutdownScreenShots(void)
 {
-	byte           *buffer;
-	char		picname[80];
-	char		checkname[MAX_OSPATH];
-	int		i, c, temp;
+	int		i;
+
+	GL_StopCapture();
+
+	/* readbacks that never got collected are lost */
+	for (i = 0; i < 2; i++) {
+		if (shot_pending[i]) {
+			free(shot_pending[i]);
+			shot_pending[i] = NULL;
+		}
+	}
+	if (shot_pbo[0]) {
+		qglDeleteBuffersARB(2, shot_pbo);
+		shot_pbo[0] = shot_pbo[1] = 0;
+		shot_pbosize[0] = shot_pbosize[1] = 0;
+	}
+	if (shot_request) {
+		free(shot_request);
+		shot_request = NULL;
+	}
+
+	if (!shot_lock)
+		return;
+
+	Sys_LockMutex(shot_lock);
+	shot_quit = true;
+	Sys_CondBroadcast(shot_wake);
+	Sys_UnlockMutex(shot_lock);
+
+	for (i = 0; i < shot_numworkers; i++)
+		Sys_WaitThread(shot_workers[i]);
+	shot_numworkers = 0;
+
+	GL_ReportShots();
+
+	Sys_DestroyCond(capture_fileturn);
+	Sys_DestroyMutex(capture_filelock);
+	Sys_DestroyCond(shot_wake);
+	Sys_DestroyMutex(shot_lock);
+	capture_fileturn = shot_wake = NULL;
+	capture_filelock = shot_lock = NULL;
+}
+
+/*
+ * ================ GL_NewShot ================
+ */
+static shotjob_t *
+GL_NewShot(shotformat_t format, int width, int height)
+{
+	shotjob_t      *job;
+
+	job = malloc(sizeof(*job));
+	memset(job, 0, sizeof(*job));
+	job->format = format;
+	job->width = width;
+	job->height = height;
+
+	if ((gl_screenshot_jpeg_quality->value >= 101) || (gl_screenshot_jpeg_quality->value <= 0))
+		ri.Cvar_Set("gl_screenshot_jpeg_quality", "85");
+	job->quality = gl_screenshot_jpeg_quality->value;
+
+	return job;
+}
+
+/*
+ * ================ R_CaptureFrame
+ *
+ * Called at the end of every frame, before the buffers are swapped.
+ * Collects last frame's readbacks and starts this frame's, if there is a
+ * screenshot asked for or a capture running. ================
+ */
+void
+R_CaptureFrame(void)
+{
+	shotjob_t      *jobs[2], *job;
+	byte           *data;
+	int		i, n, size;
+
+	GL_ReportShots();
+
+	/* last frame's, in the order they were taken */
+	for (i = 0; i < 2; i++) {
+		job = shot_pending[i];
+		if (!job)
+			continue;
+		shot_pending[i] = NULL;
+
+		size = job->width * job->height * 3;
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, shot_pbo[i]);
+		data = qglMapBufferARB(GL_PIXEL_PACK_BUFFER_ARB, GL_READ_ONLY_ARB);
+		if (!data) {
+			free(job);
+			continue;
+		}
+		job->pixels = malloc(size);
+		memcpy(job->pixels, data, size);
+		qglUnmapBufferARB(GL_PIXEL_PACK_BUFFER_ARB);
+
+		if (!GL_QueueShot(job))
+			capture_dropped++;
+	}
+	if (shot_pbo[0])
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+
+	/* what to take this frame */
+	n = 0;
+	if (shot_request) {
+		jobs[n++] = shot_request;
+		shot_request = NULL;
+	}
+	if (capture_active) {
+		if (vid.width < capture_width || vid.height < capture_height) {
+			ri.Con_Printf(PRINT_ALL, "Video mode changed, capture stopped\n");
+			GL_StopCapture();
+		} else {
+			job = GL_NewShot(capture_format, capture_width, capture_height);
+			if (capture_format != SHOT_Y4M)
+				Com_sprintf(job->path, sizeof(job->path), "%s/capture/%s_%06d.%s",
+				    ri.FS_Gamedir(), capture_name, capture_frames,
+				    capture_format == SHOT_JPG ? "jpg" : capture_format == SHOT_PNG ? "png" : "tga");
+			capture_frames++;
+			jobs[n++] = job;
+		}
+	}
+	if (!n)
+		return;
+
+	qglPixelStorei(GL_PACK_ALIGNMENT, 1);
+	for (i = 0; i < n; i++) {
+		job = jobs[i];
+		size = job->width * job->height * 3;
+
+		if (!gl_state.pbo) {
+			/* no way around waiting for the read, the encoding still goes */
+			job->pixels = malloc(size);
+			qglReadPixels(0, 0, job->width, job->height, GL_RGB, GL_UNSIGNED_BYTE, job->pixels);
+			if (!GL_QueueShot(job))
+				capture_dropped++;
+			continue;
+		}
+
+		if (!shot_pbo[0])
+			qglGenBuffersARB(2, shot_pbo);
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, shot_pbo[i]);
+		if (shot_pbosize[i] < size) {
+			qglBufferDataARB(GL_PIXEL_PACK_BUFFER_ARB, size, NULL, GL_STREAM_READ_ARB);
+			shot_pbosize[i] = size;
+		}
+		qglReadPixels(0, 0, job->width, job->height, GL_RGB, GL_UNSIGNED_BYTE, NULL);
+		shot_pending[i] = job;
+	}
+	if (gl_state.pbo)
+		qglBindBufferARB(GL_PIXEL_PACK_BUFFER_ARB, 0);
+	qglPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+/*
+ * ================ GL_RequestShot
+ *
+ * Finds a free name and has R_CaptureFrame take the shot at the end of the
+ * frame.  Numbering carries on from the last shot so names that are still
+ * being written aren't handed out twice.
+ * ================
+ */
+static void
+GL_RequestShot(shotformat_t format)
+{
+	char		picname[80], checkname[MAX_OSPATH];
+	int		i, max;
 	FILE           *f;
-	qboolean	png = false;
 
-	/* Heffo - JPEG Screenshots */
-	if (gl_screenshot_jpeg->value) {
-		GL_ScreenShot_JPG();
+	if (shot_request) {
+		ri.Con_Printf(PRINT_ALL, "Screenshot already pending\n");
 		return;
 	}
-	if (!Q_stricmp(ri.Cmd_Argv(0), "pngshot"))
-		png = true;
 
-	/* create the scrnshots directory if it doesn't exist */
+	/* Create the scrnshots directory if it doesn't exist */
 	Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot", ri.FS_Gamedir());
 	Sys_Mkdir(checkname);
 
-	/* find a file name to save it to  */
-	Q_strncpyz(picname, "quake00.tga", sizeof(picname));
+	/* Knightmare- changed screenshot filenames, up to 1000 screenies */
+	max = format == SHOT_TGA ? 100 : 1000;
+	for (i = shot_lastindex[format]; i < max; i++) {
+		if (format == SHOT_JPG)
+			Com_sprintf(picname, sizeof(picname), "QuDos_%03i.jpg", i);
+		else if (format == SHOT_PNG)
+			Com_sprintf(picname, sizeof(picname), "QuDos_%03i.png", i);
+		else
+			Com_sprintf(picname, sizeof(picname), "quake%02i.tga", i);
 
-	for (i = 0; i <= 99; i++) {
-		picname[5] = i / 10 + '0';
-		picname[6] = i % 10 + '0';
 		Com_sprintf(checkname, sizeof(checkname), "%s/scrnshot/%s", ri.FS_Gamedir(), picname);
 		f = fopen(checkname, "rb");
 		if (!f)
 			break;	/* file doesn't exist */
 		fclose(f);
 	}
-	if (i == 100) {
+	if (i == max) {
 		ri.Con_Printf(PRINT_ALL, "SCR_ScreenShot_f: Couldn't create a file\n");
 		return;
 	}
-	buffer = malloc(vid.width * vid.height * 3 + 18);
-	memset(buffer, 0, 18);
-	buffer[2] = 2;		/* uncompressed type */
-	buffer[12] = vid.width & 255;
-	buffer[13] = vid.width >> 8;
-	buffer[14] = vid.height & 255;
-	buffer[15] = vid.height >> 8;
-	buffer[16] = 24;	/* pixel size */
+	shot_lastindex[format] = i + 1;
+
+	shot_request = GL_NewShot(format, vid.width, vid.height);
+	shot_request->report = true;
+	Q_strncpyz(shot_request->path, checkname, sizeof(shot_request->path));
+}
+
+void
+GL_ScreenShot_JPG(void)
+{
+	GL_RequestShot(SHOT_JPG);
+}
+
+void
+GL_ScreenShot_PNG(void)
+{
+	GL_RequestShot(SHOT_PNG);
+}
+
+/*
+ * ================== GL_ScreenShot_f ==================
+ */
+void
+GL_ScreenShot_f(void)
+{
+	/* Heffo - JPEG Screenshots */
+	if (gl_screenshot_jpeg->value)
+		GL_RequestShot(SHOT_JPG);
+	else
+		GL_RequestShot(SHOT_TGA);
+}
+
+/*
+ * ================ GL_StopCapture ================
+ */
+void
+GL_StopCapture(void)
+{
+	int		i;
+
+	if (!capture_active)
+		return;
+	capture_active = false;
+
+	ri.Cvar_SetValue("fixedtime", capture_oldfixedtime);
+
+	/* frames still in the pixel buffers don't make it */
+	for (i = 0; i < 2; i++) {
+		if (shot_pending[i] && !shot_pending[i]->report) {
+			free(shot_pending[i]);
+			shot_pending[i] = NULL;
+			capture_dropped++;
+		}
+	}
+
+	/* let the queued frames through before closing the file */
+	if (capture_file) {
+		if (shot_lock) {
+			Sys_LockMutex(capture_filelock);
+			while (capture_filesequence != capture_nextsequence)
+				Sys_CondWait(capture_fileturn, capture_filelock);
+			Sys_UnlockMutex(capture_filelock);
+		}
+		fclose(capture_file);
+		capture_file = NULL;
+	}
+
+	ri.Con_Printf(PRINT_ALL, "Captured %i frames, %i dropped\n", capture_frames, capture_dropped);
+}
+
+/*
+ * ================ GL_Capture_f
+ *
+ * capture <fps> [tga|jpg|png] [name]: numbered frames in <gamedir>/capture
+ * capture <fps> y4m [name]: raw video in <gamedir>/capture/<name>.y4m
+ * capture stop
+ *
+ * The game is run at a fixed 1000/fps msec step so every frame is taken.
+ * ================
+ */
+void
+GL_Capture_f(void)
+{
+	char		path[MAX_OSPATH];
+	char           *fmt, *name;
+	int		fps;
+
+	if (ri.Cmd_Argc() < 2) {
+		ri.Con_Printf(PRINT_ALL, "Usage: capture <fps> [tga|jpg|png|y4m] [name]\n"
+		    "       capture stop\n");
+		return;
+	}
 
-	qglReadPixels(0, 0, vid.width, vid.height, GL_RGB, GL_UNSIGNED_BYTE, buffer + 18);
+	GL_StopCapture();
+	if (!Q_stricmp(ri.Cmd_Argv(1), "stop"))
+		return;
 
-	/* swap rgb to bgr */
-	c = 18 + vid.width * vid.height * 3;
-	for (i = 18; i < c; i += 3) {
-		temp = buffer[i];
-		buffer[i] = buffer[i + 2];
-		buffer[i + 2] = temp;
+	fps = atoi(ri.Cmd_Argv(1));
+	if (fps <= 0 || fps > 1000) {
+		ri.Con_Printf(PRINT_ALL, "capture: bad frame rate\n");
+		return;
 	}
 
-	f = fopen(checkname, "wb");
-	fwrite(buffer, 1, c, f);
-	fclose(f);
+	fmt = ri.Cmd_Argc() > 2 ? ri.Cmd_Argv(2) : (gl_screenshot_jpeg->value ? "jpg" : "tga");
+	if (!Q_stricmp(fmt, "y4m"))
+		capture_format = SHOT_Y4M;
+	else if (!Q_stricmp(fmt, "png"))
+		capture_format = SHOT_PNG;
+	else if (!Q_stricmp(fmt, "jpg"))
+		capture_format = SHOT_JPG;
+	else if (!Q_stricmp(fmt, "tga"))
+		capture_format = SHOT_TGA;
+	else {
+		ri.Con_Printf(PRINT_ALL, "capture: unknown format %s\n", fmt);
+		return;
+	}
+
+	/* servers can stuff commands, the name stays a plain file name */
+	name = ri.Cmd_Argc() > 3 ? ri.Cmd_Argv(3) : capture_format == SHOT_Y4M ? "movie" : "frame";
+	if (!name[0] || strstr(name, "..") || strchr(name, '/') || strchr(name, '\\') || strchr(name, ':')) {
+		ri.Con_Printf(PRINT_ALL, "capture: bad name %s\n", name);
+		return;
+	}
+	Q_strncpyz(capture_name, name, sizeof(capture_name));
+
+	Com_sprintf(path, sizeof(path), "%s/capture", ri.FS_Gamedir());
+	Sys_Mkdir(path);
+
+	capture_width = vid.width;
+	capture_height = vid.height;
+	if (capture_format == SHOT_Y4M) {
+		/* 4:2:0 wants even sizes */
+		capture_width &= ~1;
+		capture_height &= ~1;
+
+		Com_sprintf(path, sizeof(path), "%s/capture/%s.y4m", ri.FS_Gamedir(), capture_name);
+		GL_StartShotWorkers();
+		capture_file = fopen(path, "wb");
+		if (!capture_file) {
+			ri.Con_Printf(PRINT_ALL, "capture: couldn't create %s\n", path);
+			return;
+		}
+		fprintf(capture_file, "YUV4MPEG2 W%i H%i F%i:1 Ip A1:1 C420jpeg\n",
+		    capture_width, capture_height, fps);
+		capture_nextsequence = capture_filesequence = 0;
+	}
+
+	capture_frames = capture_dropped = 0;
+	capture_active = true;
+	capture_oldfixedtime = ri.Cvar_Get("fixedtime", "0", 0)->value;
+	ri.Cvar_SetValue("fixedtime", 1000 / fps);
 
-	free(buffer);
-	ri.Con_Printf(PRINT_ALL, "Wrote %s\n", picname);
+	ri.Con_Printf(PRINT_ALL, "Capturing at %i fps, \"capture stop\" to end\n", fps);
 }
 
 /*
@@ -49,10 +49,6 @@ typedef struct {
 	msurface_t     *lightmap_surfaces[MAX_LIGHTMAPS];
 
 	int		allocated  [BLOCK_WIDTH];
-
-	/* the lightmap texture data needs to be kept in */
-	/* main memory so texsubimage can update properly */
-	byte		lightmap_buffer[4 * BLOCK_WIDTH * BLOCK_HEIGHT];
 } gllightmapstate_t;
 
 static gllightmapstate_t gl_lms;
@@ -67,13 +63,67 @@ static msurface_t *r_detailsurfaces;
 
 /* MH - detail textures end */
 
+/*
+ * world surfaces sharing a texture and a lightmap are drawn with a single
+ * glDrawElements call out of the model's static vertex buffer
+ */
+#define	MAX_WORLD_BATCHES	1024
+#define	WORLD_BATCH_HASH	256
+
+typedef struct worldbatch_s {
+	image_t        *image;
+	int		lightmap;
+	int		firstindex;
+	int		numindexes;
+	msurface_t     *surfaces;	/* chained through texturechain */
+	struct worldbatch_s *hashnext;
+} worldbatch_t;
+
+static worldbatch_t r_worldbatches[MAX_WORLD_BATCHES];
+static worldbatch_t *r_worldbatchhash[WORLD_BATCH_HASH];
+static int	r_numworldbatches;
+static qboolean	r_worldbatching;
+
+static unsigned int *r_worldindexes;
+static int	r_maxworldindexes;
+
+/* visible world surfaces in walk order, drawn once their lightmaps are current */
+static msurface_t **r_worldsurfaces;
+static int	r_numworldsurfaces, r_maxworldsurfaces;
+
+/*
+ * Every lightmap page stays in main memory once it is built.  Surfaces whose
+ * light changed are rebuilt straight into their own page by
+ * R_FlushLightmaps, which then uploads the rectangle around them once per
+ * page, before anything is drawn from it.
+ */
+typedef struct {
+	int		x0, y0, x1, y1;		/* x1 is 0 while the page is clean */
+} lmrect_t;
+
+#define	LM_PAGE_SIZE	(BLOCK_WIDTH * BLOCK_HEIGHT * LIGHTMAP_BYTES)
+
+static byte    *lm_pages[MAX_LIGHTMAPS];
+static lmrect_t	lm_dirty[MAX_LIGHTMAPS];
+
+static msurface_t **lm_updates;
+static byte   **lm_updatedests;
+static int	lm_numupdates, lm_maxupdates;
+
+int		c_lightmap_builds, c_lightmap_uploads;
+
+/* size of the current PVS, counted by R_MarkLeaves when it remarks */
+int		c_mark_leafs, c_mark_nodes;
+
 
 static void	LM_InitBlock(void);
-static void	LM_UploadBlock(qboolean dynamic);
+static void	LM_UploadBlock(int page);
 static qboolean	LM_AllocBlock(int w, int h, int *x, int *y);
+static void	R_QueueLightmap(msurface_t * surf);
+static void	R_FlushLightmaps(void);
 
 extern void	R_SetCacheState(msurface_t * surf);
-extern void	R_BuildLightMap(msurface_t * surf, byte * dest, int stride);
+extern void	R_CheckLightMap(msurface_t * surf);
 
 /*
  * =============================================================
@@ -277,7 +327,7 @@ void
 R_BlendLightmaps(void)
 {
 	int		i;
-	msurface_t     *surf, *newdrawsurf = 0;
+	msurface_t     *surf;
 
 	/* don't bother if we're set to fullbright */
 	if (r_fullbright->value)
@@ -323,7 +373,8 @@ R_BlendLightmaps(void)
 		c_visible_lightmaps = 0;
 
 	/*
-	 * * render static lightmaps first
+	 * * every page is current, R_FlushLightmaps uploaded the
+	 * dynamic changes before anything was drawn
 	 */
 	for (i = 1; i < MAX_LIGHTMAPS; i++) {
 		if (gl_lms.lightmap_surfaces[i]) {
@@ -338,74 +389,6 @@ R_BlendLightmaps(void)
 		}
 	}
 
-	/*
-	 * * render dynamic lightmaps
-	 */
-	if (gl_dynamic->value) {
-		LM_InitBlock();
-
-		GL_Bind(gl_state.lightmap_textures + 0);
-
-		if (currentmodel == r_worldmodel)
-			c_visible_lightmaps++;
-
-		newdrawsurf = gl_lms.lightmap_surfaces[0];
-
-		for (surf = gl_lms.lightmap_surfaces[0]; surf != 0; surf = surf->lightmapchain) {
-			int		smax      , tmax;
-			byte           *base;
-
-			smax = (surf->extents[0] >> 4) + 1;
-			tmax = (surf->extents[1] >> 4) + 1;
-
-			if (LM_AllocBlock(smax, tmax, &surf->dlight_s, &surf->dlight_t)) {
-				base = gl_lms.lightmap_buffer;
-				base += (surf->dlight_t * BLOCK_WIDTH + surf->dlight_s) * LIGHTMAP_BYTES;
-
-				R_BuildLightMap(surf, base, BLOCK_WIDTH * LIGHTMAP_BYTES);
-			} else {
-				msurface_t     *drawsurf;
-
-				/* upload what we have so far */
-				LM_UploadBlock(true);
-
-				/* draw all surfaces that use this lightmap */
-				for (drawsurf = newdrawsurf; drawsurf != surf; drawsurf = drawsurf->lightmapchain) {
-					if (drawsurf->polys)
-						DrawGLPolyChain(drawsurf->polys,
-						    (drawsurf->light_s - drawsurf->dlight_s) * (1.0 / 128.0),
-						    (drawsurf->light_t - drawsurf->dlight_t) * (1.0 / 128.0));
-				}
-
-				newdrawsurf = drawsurf;
-
-				/* clear the block */
-				LM_InitBlock();
-
-				/* try uploading the block now */
-				if (!LM_AllocBlock(smax, tmax, &surf->dlight_s, &surf->dlight_t)) {
-					ri.Sys_Error(ERR_FATAL, "Consecutive calls to LM_AllocBlock(%d,%d) failed (dynamic)\n", smax, tmax);
-				}
-				base = gl_lms.lightmap_buffer;
-				base += (surf->dlight_t * BLOCK_WIDTH + surf->dlight_s) * LIGHTMAP_BYTES;
-
-				R_BuildLightMap(surf, base, BLOCK_WIDTH * LIGHTMAP_BYTES);
-			}
-		}
-
-		/*
-		 * * draw remainder of dynamic lightmaps that haven't been
-		 * uploaded yet
-		 */
-		if (newdrawsurf)
-			LM_UploadBlock(true);
-
-		for (surf = newdrawsurf; surf != 0; surf = surf->lightmapchain) {
-			if (surf->polys)
-				DrawGLPolyChain(surf->polys, (surf->light_s - surf->dlight_s) * (1.0 / 128.0), (surf->light_t - surf->dlight_t) * (1.0 / 128.0));
-		}
-	}
-
 	/*
 	 * * restore state
 	 */
@@ -420,9 +403,7 @@ R_BlendLightmaps(void)
 void
 R_RenderBrushPoly(msurface_t * fa)
 {
-	int		maps;
 	image_t        *image;
-	qboolean	is_dynamic = false;
 
 	c_brush_polys++;
 
@@ -472,52 +453,9 @@ R_RenderBrushPoly(msurface_t * fa)
 	/* PGM */
 	/* ====== */
 
-	/*
-	 * * check for lightmap modification
-	 */
-	for (maps = 0; maps < MAXLIGHTMAPS && fa->styles[maps] != 255; maps++) {
-		if (r_refdef.lightstyles[fa->styles[maps]].white != fa->cached_light[maps])
-			goto dynamic;
-	}
-
-	/* dynamic this frame or dynamic previously */
-	if ((fa->dlightframe == r_framecount)) {
-dynamic:
-		if (gl_dynamic->value) {
-			if (!(fa->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))) {
-				is_dynamic = true;
-			}
-		}
-	}
-	if (is_dynamic) {
-		if ((fa->styles[maps] >= 32 || fa->styles[maps] == 0) && (fa->dlightframe != r_framecount)) {
-			unsigned	temp   [34 * 34];
-			int		smax      , tmax;
-
-			smax = (fa->extents[0] >> 4) + 1;
-			tmax = (fa->extents[1] >> 4) + 1;
-
-			R_BuildLightMap(fa, (void *)temp, smax * 4);
-			R_SetCacheState(fa);
-
-			GL_Bind(gl_state.lightmap_textures + fa->lightmaptexturenum);
-
-			qglTexSubImage2D(GL_TEXTURE_2D, 0,
-			    fa->light_s, fa->light_t,
-			    smax, tmax,
-			    GL_LIGHTMAP_FORMAT,
-			    GL_UNSIGNED_BYTE, temp);
-
-			fa->lightmapchain = gl_lms.lightmap_surfaces[fa->lightmaptexturenum];
-			gl_lms.lightmap_surfaces[fa->lightmaptexturenum] = fa;
-		} else {
-			fa->lightmapchain = gl_lms.lightmap_surfaces[0];
-			gl_lms.lightmap_surfaces[0] = fa;
-		}
-	} else {
-		fa->lightmapchain = gl_lms.lightmap_surfaces[fa->lightmaptexturenum];
-		gl_lms.lightmap_surfaces[fa->lightmaptexturenum] = fa;
-	}
+	/* the lightmap page was brought up to date by R_FlushLightmaps */
+	fa->lightmapchain = gl_lms.lightmap_surfaces[fa->lightmaptexturenum];
+	gl_lms.lightmap_surfaces[fa->lightmaptexturenum] = fa;
 }
 
 
@@ -782,10 +720,8 @@ GL_RenderLightmappedPoly(msurface_t * surf)
 {
 	int		nv = surf->polys->numverts;
 	int		i;
-	int		map;
 	float          *v;
 	image_t        *image = R_TextureAnimation(surf->texinfo);
-	qboolean	is_dynamic = false;
 	unsigned	lmtex = surf->lightmaptexturenum;
 	glpoly_t       *p;
 
@@ -810,137 +746,47 @@ GL_RenderLightmappedPoly(msurface_t * surf)
 	/* MH - detail textures end */
 
 
-	for (map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++) {
-		if (r_refdef.lightstyles[surf->styles[map]].white != surf->cached_light[map])
-			goto dynamic;
-	}
-
-	/* dynamic this frame or dynamic previously */
-	if ((surf->dlightframe == r_framecount)) {
-dynamic:
-		if (gl_dynamic->value) {
-			if (!(surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))) {
-				is_dynamic = true;
-			}
-		}
-	}
-	if (is_dynamic) {
-		unsigned	temp[128 * 128];
-		int		smax, tmax;
-
-		if ((surf->styles[map] >= 32 || surf->styles[map] == 0) && (surf->dlightframe != r_framecount)) {
-			smax = (surf->extents[0] >> 4) + 1;
-			tmax = (surf->extents[1] >> 4) + 1;
-
-			R_BuildLightMap(surf, (void *)temp, smax * 4);
-			R_SetCacheState(surf);
-
-			GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + surf->lightmaptexturenum);
-
-			lmtex = surf->lightmaptexturenum;
-
-			qglTexSubImage2D(GL_TEXTURE_2D, 0,
-			    surf->light_s, surf->light_t,
-			    smax, tmax,
-			    GL_LIGHTMAP_FORMAT,
-			    GL_UNSIGNED_BYTE, temp);
-
-		} else {
-			smax = (surf->extents[0] >> 4) + 1;
-			tmax = (surf->extents[1] >> 4) + 1;
-
-			R_BuildLightMap(surf, (void *)temp, smax * 4);
-
-			GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + 0);
-
-			lmtex = 0;
-
-			qglTexSubImage2D(GL_TEXTURE_2D, 0,
-			    surf->light_s, surf->light_t,
-			    smax, tmax,
-			    GL_LIGHTMAP_FORMAT,
-			    GL_UNSIGNED_BYTE, temp);
-
-		}
-
-		c_brush_polys++;
+	/* the lightmap page was brought up to date by R_FlushLightmaps */
+	c_brush_polys++;
 
-		GL_MBind(GL_TEXTURE0, image->texnum);
-		GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + lmtex);
+	GL_MBind(GL_TEXTURE0, image->texnum);
+	GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + lmtex);
 
-		/* ========== */
-		/* PGM */
-		if (surf->texinfo->flags & SURF_FLOWING) {
-			float		scroll;
+	/* ========== */
+	/* PGM */
+	if (surf->texinfo->flags & SURF_FLOWING) {
+		float		scroll;
 
-			scroll = -64 * ((r_refdef.time / 40.0) - (int)(r_refdef.time / 40.0));
-			if (scroll == 0.0)
-				scroll = -64.0;
+		scroll = -64 * ((r_refdef.time / 40.0) - (int)(r_refdef.time / 40.0));
+		if (scroll == 0.0)
+			scroll = -64.0;
 
-			for (p = surf->polys; p; p = p->chain) {
-				v = p->verts[0];
-				RenderPolyFunc(nv, v, scroll);
-			}
-		} else {
-			for (p = surf->polys; p; p = p->chain) {
-				v = p->verts[0];
-				qglBegin(GL_POLYGON);
-				for (i = 0; i < nv; i++, v += VERTEXSIZE) {
-					qglMTexCoord2fSGIS(GL_TEXTURE0, v[3], v[4]);
-					qglMTexCoord2fSGIS(GL_TEXTURE1, v[5], v[6]);
-					if ((gl_detailtextures->value > 0) && (maxTextureUnits > 2)) {
-						qglMTexCoord2fSGIS(GL_TEXTURE2, v[7] * gl_detailtextures->value, v[8] * gl_detailtextures->value);
-					}
-					qglVertex3fv(v);
-				}
-				qglEnd();
-				/* RenderPolyFunc(nv, v, 0); */
-			}
+		for (p = surf->polys; p; p = p->chain) {
+			v = p->verts[0];
+			RenderPolyFunc(nv, v, scroll);
 		}
-		/* PGM */
-		/* ========== */
 	} else {
-		c_brush_polys++;
-
-		GL_MBind(GL_TEXTURE0, image->texnum);
-		GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + lmtex);
-
-		/* ========== */
 		/* PGM */
-		if (surf->texinfo->flags & SURF_FLOWING) {
-			float		scroll;
-
-			scroll = -64 * ((r_refdef.time / 40.0) - (int)(r_refdef.time / 40.0));
-			if (scroll == 0.0)
-				scroll = -64.0;
-
-			for (p = surf->polys; p; p = p->chain) {
-				v = p->verts[0];
-				RenderPolyFunc(nv, v, scroll);
-			}
-		} else {
-			/* PGM */
-			/* ========== */
-			for (p = surf->polys; p; p = p->chain) {
-				v = p->verts[0];
-				qglBegin(GL_POLYGON);
-				for (i = 0; i < nv; i++, v += VERTEXSIZE) {
-					qglMTexCoord2fSGIS(GL_TEXTURE0, v[3], v[4]);
-					qglMTexCoord2fSGIS(GL_TEXTURE1, v[5], v[6]);
-					if ((gl_detailtextures->value > 0) && (maxTextureUnits > 2)) {
-						qglMTexCoord2fSGIS(GL_TEXTURE2, v[7] * gl_detailtextures->value, v[8] * gl_detailtextures->value);
-					}
-					qglVertex3fv(v);
+		/* ========== */
+		for (p = surf->polys; p; p = p->chain) {
+			v = p->verts[0];
+			qglBegin(GL_POLYGON);
+			for (i = 0; i < nv; i++, v += VERTEXSIZE) {
+				qglMTexCoord2fSGIS(GL_TEXTURE0, v[3], v[4]);
+				qglMTexCoord2fSGIS(GL_TEXTURE1, v[5], v[6]);
+				if ((gl_detailtextures->value > 0) && (maxTextureUnits > 2)) {
+					qglMTexCoord2fSGIS(GL_TEXTURE2, v[7] * gl_detailtextures->value, v[8] * gl_detailtextures->value);
 				}
-				qglEnd();
-				/* RenderPolyFunc(nv, v, 0); */
+				qglVertex3fv(v);
 			}
-			/* ========== */
-			/* PGM */
+			qglEnd();
+			/* RenderPolyFunc(nv, v, 0); */
 		}
-		/* PGM */
 		/* ========== */
+		/* PGM */
 	}
+	/* PGM */
+	/* ========== */
 
 	if ((gl_detailtextures->value) && (maxTextureUnits > 2)) {
 		GL_Enable3dTextureUnit(false);
@@ -1118,9 +964,21 @@ R_DrawInlineBModel(void)
 	r_detailsurfaces = NULL;
 	/* MH - detail textures end */
 
+	/* bring the lightmaps of the facing surfaces up to date first */
+	for (i = 0; i < currentmodel->nummodelsurfaces; i++, psurf++) {
+		pplane = psurf->plane;
+		dot = DotProduct(modelorg, pplane->normal) - pplane->dist;
+
+		if (((psurf->flags & SURF_PLANEBACK) && (dot < -BACKFACE_EPSILON)) ||
+		    (!(psurf->flags & SURF_PLANEBACK) && (dot > BACKFACE_EPSILON)))
+			R_QueueLightmap(psurf);
+	}
+	R_FlushLightmaps();
+
 	//
 	/* draw texture */
 	    //
+	    psurf = &currentmodel->surfaces[currentmodel->firstmodelsurface];
 	    for (i = 0; i < currentmodel->nummodelsurfaces; i++, psurf++) {
 		/* find which side of the node we are on */
 		pplane = psurf->plane;
@@ -1300,6 +1158,175 @@ R_DrawBrushModel(entity_t * e)
  * =============================================================
  */
 
+/*
+ * ================ R_BatchWorldSurface
+ *
+ * Adds a lightmapped world surface to its (texture, lightmap) batch.
+ * Returns false if the surface has to be drawn immediately instead: warped
+ * or flowing textures, caustics, and lightmaps that are only valid in the
+ * dynamic block for this frame. ================
+ */
+static qboolean
+R_BatchWorldSurface(msurface_t * surf)
+{
+	worldbatch_t   *batch;
+	image_t        *image;
+	unsigned	hash;
+
+	if (surf->firstworldvert < 0 || (surf->texinfo->flags & SURF_FLOWING))
+		return false;
+
+	image = R_TextureAnimation(surf->texinfo);
+
+	if ((surf->flags & SURF_UNDERWATER) && !image->has_alpha && gl_water_caustics->value)
+		return false;
+
+	hash = (image->texnum * MAX_LIGHTMAPS + surf->lightmaptexturenum) & (WORLD_BATCH_HASH - 1);
+	for (batch = r_worldbatchhash[hash]; batch; batch = batch->hashnext) {
+		if (batch->image == image && batch->lightmap == surf->lightmaptexturenum)
+			break;
+	}
+
+	if (!batch) {
+		if (r_numworldbatches == MAX_WORLD_BATCHES)
+			return false;
+
+		batch = &r_worldbatches[r_numworldbatches++];
+		batch->image = image;
+		batch->lightmap = surf->lightmaptexturenum;
+		batch->numindexes = 0;
+		batch->surfaces = NULL;
+		batch->hashnext = r_worldbatchhash[hash];
+		r_worldbatchhash[hash] = batch;
+	}
+
+	surf->texturechain = batch->surfaces;
+	batch->surfaces = surf;
+	batch->numindexes += (surf->polys->numverts - 2) * 3;
+
+	c_brush_polys++;
+
+	return true;
+}
+
+/*
+ * ================ R_DrawWorldBatches
+ *
+ * Builds the index buffer for the batches collected by R_RecursiveWorldNode
+ * and draws each of them in one call. ================
+ */
+static void
+R_DrawWorldBatches(void)
+{
+	worldbatch_t   *batch;
+	msurface_t     *surf;
+	unsigned int   *index;
+	float          *verts;
+	int		i, j, numindexes, base;
+
+	if (!r_numworldbatches)
+		return;
+
+	numindexes = 0;
+	for (i = 0, batch = r_worldbatches; i < r_numworldbatches; i++, batch++) {
+		batch->firstindex = numindexes;
+		numindexes += batch->numindexes;
+	}
+
+	if (numindexes > r_maxworldindexes) {
+		r_maxworldindexes = numindexes + 4096;
+		r_worldindexes = realloc(r_worldindexes, r_maxworldindexes * sizeof(*r_worldindexes));
+		if (!r_worldindexes)
+			ri.Sys_Error(ERR_FATAL, "R_DrawWorldBatches: out of memory for %d indexes", r_maxworldindexes);
+	}
+
+	for (i = 0, batch = r_worldbatches; i < r_numworldbatches; i++, batch++) {
+		index = r_worldindexes + batch->firstindex;
+		for (surf = batch->surfaces; surf; surf = surf->texturechain) {
+			base = surf->firstworldvert;
+			for (j = 2; j < surf->polys->numverts; j++) {
+				index[0] = base;
+				index[1] = base + j - 1;
+				index[2] = base + j;
+				index += 3;
+			}
+		}
+	}
+
+	if (r_worldmodel->worldvbo) {
+		qglBindBufferARB(GL_ARRAY_BUFFER_ARB, r_worldmodel->worldvbo);
+		verts = NULL;
+	} else {
+		verts = r_worldmodel->worldverts;
+	}
+
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglVertexPointer(3, GL_FLOAT, VERTEXSIZE * sizeof(float), verts);
+
+	GL_SelectTexture(GL_TEXTURE0);
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglTexCoordPointer(2, GL_FLOAT, VERTEXSIZE * sizeof(float), verts + 3);
+
+	GL_SelectTexture(GL_TEXTURE1);
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglTexCoordPointer(2, GL_FLOAT, VERTEXSIZE * sizeof(float), verts + 5);
+
+	for (i = 0, batch = r_worldbatches; i < r_numworldbatches; i++, batch++) {
+		GL_MBind(GL_TEXTURE0, batch->image->texnum);
+		GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + batch->lightmap);
+
+		qglDrawElements(GL_TRIANGLES, batch->numindexes, GL_UNSIGNED_INT,
+		    r_worldindexes + batch->firstindex);
+		c_world_batches++;
+
+		/* the chains are only valid until the next pass */
+		batch->surfaces = NULL;
+	}
+
+	GL_SelectTexture(GL_TEXTURE1);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	GL_SelectTexture(GL_TEXTURE0);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglDisableClientState(GL_VERTEX_ARRAY);
+
+	if (r_worldmodel->worldvbo)
+		qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+}
+
+/*
+ * ================ R_DrawWorldSurfaces
+ *
+ * Draws the surfaces R_RecursiveWorldNode collected, in the same order,
+ * after bringing their lightmaps up to date. ================
+ */
+static void
+R_DrawWorldSurfaces(void)
+{
+	msurface_t     *surf;
+	image_t        *image;
+	int		i;
+
+	R_FlushLightmaps();
+
+	for (i = 0; i < r_numworldsurfaces; i++) {
+		surf = r_worldsurfaces[i];
+
+		if (qglMTexCoord2fSGIS && !(surf->flags & SURF_DRAWTURB)) {
+			if (!r_worldbatching || !R_BatchWorldSurface(surf))
+				GL_RenderLightmappedPoly(surf);
+		} else {
+			/* the polygon is visible, so add it to the texture */
+			/* sorted chain */
+			/* FIXME: this is a hack for animation */
+			image = R_TextureAnimation(surf->texinfo);
+			surf->texturechain = image->texturechain;
+			image->texturechain = surf;
+		}
+	}
+
+	r_numworldsurfaces = 0;
+}
+
 /*
  * ================ R_RecursiveWorldNode ================
  */
@@ -1311,7 +1338,6 @@ R_RecursiveWorldNode(mnode_t * node)
 	msurface_t     *surf, **mark;
 	mleaf_t        *pleaf;
 	float		dot;
-	image_t        *image;
 
 	if (node->contents == CONTENTS_SOLID)
 		return;		/* solid */
@@ -1388,20 +1414,9 @@ R_RecursiveWorldNode(mnode_t * node)
 			surf->texturechain = r_alpha_surfaces;
 			r_alpha_surfaces = surf;
 		} else {
-			if (qglMTexCoord2fSGIS && !(surf->flags & SURF_DRAWTURB)) {
-				GL_RenderLightmappedPoly(surf);
-			} else {
-
-				/*
-				 * the polygon is visible, so add it to the
-				 * texture
-				 */
-				/* sorted chain */
-				/* FIXME: this is a hack for animation */
-				image = R_TextureAnimation(surf->texinfo);
-				surf->texturechain = image->texturechain;
-				image->texturechain = surf;
-			}
+			/* drawn by R_DrawWorldSurfaces */
+			r_worldsurfaces[r_numworldsurfaces++] = surf;
+			R_QueueLightmap(surf);
 		}
 		if (gl_showtris->value && qglMTexCoord2fSGIS)	/*** DMP added extra check to avoid func call overhead in this inner loop */
 			R_DrawTriangleOutlines(surf);
@@ -1489,6 +1504,22 @@ R_DrawWorld(void)
 	r_detailsurfaces = NULL;
 	/* MH - detail textures end */
 
+	/*
+	 * batching needs a client texture unit per array and leaves detail
+	 * texturing to the legacy path
+	 */
+	r_worldbatching = gl_worldbatch->value && qglClientActiveTextureARB &&
+	    r_worldmodel->numworldverts && !gl_detailtextures->value;
+	r_numworldbatches = 0;
+	memset(r_worldbatchhash, 0, sizeof(r_worldbatchhash));
+
+	if (r_worldmodel->numsurfaces > r_maxworldsurfaces) {
+		free(r_worldsurfaces);
+		r_maxworldsurfaces = r_worldmodel->numsurfaces;
+		r_worldsurfaces = malloc(r_maxworldsurfaces * sizeof(*r_worldsurfaces));
+	}
+	r_numworldsurfaces = 0;
+
 	if (qglMTexCoord2fSGIS) {
 		GL_EnableMultitexture(true);
 
@@ -1539,10 +1570,13 @@ R_DrawWorld(void)
 			}
 		}
 		R_RecursiveWorldNode(r_worldmodel->nodes);
+		R_DrawWorldSurfaces();
+		R_DrawWorldBatches();
 
 		GL_EnableMultitexture(false);
 	} else {
 		R_RecursiveWorldNode(r_worldmodel->nodes);
+		R_DrawWorldSurfaces();
 	}
 
 	/*
@@ -1570,6 +1604,51 @@ R_DrawWorld(void)
 }
 
 
+/*
+ * =============== R_MarkVisLeaves
+ *
+ * Marks the leafs of every cluster set in vis, and their parents
+ * ===============
+ */
+static void
+R_MarkVisLeaves(byte * vis)
+{
+	mnode_t        *node;
+	int		i, c, l, end;
+	int		numclusters, words;
+
+	r_visframecount++;
+	c_mark_leafs = 0;
+	c_mark_nodes = 0;
+
+	numclusters = r_worldmodel->vis->numclusters;
+	words = (numclusters + 31) >> 5;
+
+	/* only the leafs of the visible clusters, skipping empty words */
+	for (i = 0; i < words; i++) {
+		if (!((int *)vis)[i])
+			continue;
+
+		end = min((i + 1) * 32, numclusters);
+		for (c = i * 32; c < end; c++) {
+			if (!(vis[c >> 3] & (1 << (c & 7))))
+				continue;
+
+			for (l = r_worldmodel->clusterleafstart[c]; l < r_worldmodel->clusterleafstart[c + 1]; l++) {
+				c_mark_leafs++;
+				node = (mnode_t *) & r_worldmodel->leafs[r_worldmodel->clusterleafs[l]];
+				do {
+					if (node->visframe == r_visframecount)
+						break;
+					node->visframe = r_visframecount;
+					c_mark_nodes++;
+					node = node->parent;
+				} while (node);
+			}
+		}
+	}
+}
+
 /*
  * =============== R_MarkLeaves
  *
@@ -1580,11 +1659,12 @@ void
 R_MarkLeaves(void)
 {
 	byte           *vis;
-	byte		fatvis[MAX_MAP_LEAFS / 8];
-	mnode_t        *node;
-	int		i, c;
-	mleaf_t        *leaf;
-	int		cluster;
+	int		fatvis[MAX_MAP_LEAFS / 32];
+	int		i, words;
+
+	/* the reflection passes share the marking done by R_MarkReflLeaves */
+	if (g_drawing_refl)
+		return;
 
 	if (r_oldviewcluster == r_viewcluster && r_oldviewcluster2 == r_viewcluster2 && !r_novis->value && r_viewcluster != -1)
 		return;
@@ -1594,56 +1674,86 @@ R_MarkLeaves(void)
 	if (gl_lockpvs->value)
 		return;
 
-	r_visframecount++;
 	r_oldviewcluster = r_viewcluster;
 	r_oldviewcluster2 = r_viewcluster2;
 
 	if (r_novis->value || r_viewcluster == -1 || !r_worldmodel->vis) {
+		r_visframecount++;
 		/* mark everything */
 		for (i = 0; i < r_worldmodel->numleafs; i++)
 			r_worldmodel->leafs[i].visframe = r_visframecount;
 		for (i = 0; i < r_worldmodel->numnodes; i++)
 			r_worldmodel->nodes[i].visframe = r_visframecount;
+		c_mark_leafs = r_worldmodel->numleafs;
+		c_mark_nodes = r_worldmodel->numnodes;
 		return;
 	}
+
 	vis = Mod_ClusterPVS(r_viewcluster, r_worldmodel);
+	words = (r_worldmodel->vis->numclusters + 31) >> 5;
+
 	/* may have to combine two clusters because of solid water boundaries */
 	if (r_viewcluster2 != r_viewcluster) {
-		memcpy(fatvis, vis, (r_worldmodel->numleafs + 7) / 8);
+		memcpy(fatvis, vis, words * 4);
 		vis = Mod_ClusterPVS(r_viewcluster2, r_worldmodel);
-		c = (r_worldmodel->numleafs + 31) / 32;
-		for (i = 0; i < c; i++)
-			((int *)fatvis)[i] |= ((int *)vis)[i];
-		vis = fatvis;
-	}
-	for (i = 0, leaf = r_worldmodel->leafs; i < r_worldmodel->numleafs; i++, leaf++) {
-		cluster = leaf->cluster;
-		if (cluster == -1)
-			continue;
-		if (vis[cluster >> 3] & (1 << (cluster & 7))) {
-			node = (mnode_t *) leaf;
-			do {
-				if (node->visframe == r_visframecount)
-					break;
-				node->visframe = r_visframecount;
-				node = node->parent;
-			} while (node);
-		}
+		for (i = 0; i < words; i++)
+			fatvis[i] |= ((int *)vis)[i];
+		vis = (byte *) fatvis;
 	}
 
-#if 0
-	for (i = 0; i < r_worldmodel->vis->numclusters; i++) {
-		if (vis[i >> 3] & (1 << (i & 7))) {
-			node = (mnode_t *) & r_worldmodel->leafs[i];	/* FIXME: cluster */
-			do {
-				if (node->visframe == r_visframecount)
-					break;
-				node->visframe = r_visframecount;
-				node = node->parent;
-			} while (node);
-		}
+	R_MarkVisLeaves(vis);
+}
+
+/*
+ * =============== R_MarkReflLeaves
+ *
+ * All reflection passes of a frame share one marking: the PVS of the two
+ * view clusters that start the list plus that of the clusters just across
+ * each reflective plane.  It is only redone when the map or one of them
+ * changes, and the main view keeps using it until its own cluster changes,
+ * a superset only costs some frustum culls.
+ * ===============
+ */
+void
+R_MarkReflLeaves(int *clusters, int numclusters)
+{
+	static model_t *markmodel;
+	static int	markframe = -1;
+	static int	markclusters[MAX_REFL_CLUSTERS + 2];
+	static int	nummarkclusters = -1;
+	byte           *vis;
+	int		fatvis[MAX_MAP_LEAFS / 32];
+	int		i, j, words;
+
+	if (r_novis->value || gl_lockpvs->value || clusters[0] == -1 || !r_worldmodel->vis)
+		return;
+
+	if (markmodel == r_worldmodel && markframe == r_visframecount &&
+	    nummarkclusters == numclusters &&
+	    !memcmp(markclusters, clusters, numclusters * sizeof(int)))
+		return;
+
+	words = (r_worldmodel->vis->numclusters + 31) >> 5;
+
+	vis = Mod_ClusterPVS(clusters[0], r_worldmodel);
+	memcpy(fatvis, vis, words * 4);
+	for (j = 1; j < numclusters; j++) {
+		if (clusters[j] == clusters[0] || (j > 1 && clusters[j] == clusters[1]))
+			continue;
+		vis = Mod_ClusterPVS(clusters[j], r_worldmodel);
+		for (i = 0; i < words; i++)
+			fatvis[i] |= ((int *)vis)[i];
 	}
-#endif
+
+	R_MarkVisLeaves((byte *) fatvis);
+
+	markmodel = r_worldmodel;
+	markframe = r_visframecount;
+	if (numclusters <= MAX_REFL_CLUSTERS + 2) {
+		memcpy(markclusters, clusters, numclusters * sizeof(int));
+		nummarkclusters = numclusters;
+	} else
+		nummarkclusters = -1;
 }
 
 
@@ -1665,48 +1775,39 @@ LM_InitBlock(void)
 }
 
 static void
-LM_UploadBlock(qboolean dynamic)
+LM_UploadBlock(int page)
 {
-	int		texture;
-	int		height = 0;
-
-	if (dynamic) {
-		texture = 0;
-	} else {
-		texture = gl_lms.current_lightmap_texture;
-	}
-
-	GL_Bind(gl_state.lightmap_textures + texture);
+	GL_Bind(gl_state.lightmap_textures + page);
 	qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
 	qglTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-	if (dynamic) {
-		int		i;
+	qglTexImage2D(GL_TEXTURE_2D,
+	    0,
+	    gl_lms.internal_format,
+	    BLOCK_WIDTH, BLOCK_HEIGHT,
+	    0,
+	    GL_LIGHTMAP_FORMAT,
+	    GL_UNSIGNED_BYTE,
+	    lm_pages[page]);
 
-		for (i = 0; i < BLOCK_WIDTH; i++) {
-			if (gl_lms.allocated[i] > height)
-				height = gl_lms.allocated[i];
-		}
+	lm_dirty[page].x1 = 0;
+}
 
-		qglTexSubImage2D(GL_TEXTURE_2D,
-		    0,
-		    0, 0,
-		    BLOCK_WIDTH, height,
-		    GL_LIGHTMAP_FORMAT,
-		    GL_UNSIGNED_BYTE,
-		    gl_lms.lightmap_buffer);
-	} else {
-		qglTexImage2D(GL_TEXTURE_2D,
-		    0,
-		    gl_lms.internal_format,
-		    BLOCK_WIDTH, BLOCK_HEIGHT,
-		    0,
-		    GL_LIGHTMAP_FORMAT,
-		    GL_UNSIGNED_BYTE,
-		    gl_lms.lightmap_buffer);
-		if (++gl_lms.current_lightmap_texture == MAX_LIGHTMAPS)
-			ri.Sys_Error(ERR_DROP, "LM_UploadBlock() - MAX_LIGHTMAPS exceeded\n");
+/*
+ * ================ LM_QueueSurface
+ *
+ * Adds the surface to the ones R_FlushLightmaps or GL_EndBuildingLightmaps
+ * will build. ================
+ */
+static void
+LM_QueueSurface(msurface_t * surf)
+{
+	if (lm_numupdates == lm_maxupdates) {
+		lm_maxupdates = lm_maxupdates ? lm_maxupdates * 2 : 256;
+		lm_updates = realloc(lm_updates, lm_maxupdates * sizeof(*lm_updates));
+		lm_updatedests = realloc(lm_updatedests, lm_maxupdates * sizeof(*lm_updatedests));
 	}
+	lm_updates[lm_numupdates++] = surf;
 }
 
 /* returns a texture number and the position inside it */
@@ -1743,32 +1844,152 @@ LM_AllocBlock(int w, int h, int *x, int *y)
 }
 
 /*
- * ================ GL_BuildPolygonFromSurface ================
+ * ================ R_QueueLightmap
+ *
+ * Queues the surface for R_FlushLightmaps if its lightstyles changed, if it
+ * is lit by dynamic lights this frame, or if it was and no longer is.  A
+ * negative cached_light[0] asks for a rebuild, R_StainSurface sets it.
+ * ================
+ */
+static void
+R_QueueLightmap(msurface_t * surf)
+{
+	int		map;
+	qboolean	dlit;
+
+	if (surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))
+		return;
+	if (!lm_pages[surf->lightmaptexturenum])
+		return;
+
+	dlit = gl_dynamic->value && surf->dlightframe == r_framecount;
+
+	if (dlit ? surf->cached_dlight == r_framecount : !surf->cached_dlight) {
+		/* nothing dynamic to add or take away, check the styles */
+		if (!gl_dynamic->value && surf->cached_light[0] >= 0)
+			return;
+		for (map = 0; map < MAXLIGHTMAPS && surf->styles[map] != 255; map++) {
+			if (r_refdef.lightstyles[surf->styles[map]].white != surf->cached_light[map])
+				break;
+		}
+		if (map == MAXLIGHTMAPS || surf->styles[map] == 255)
+			return;
+	}
+
+	LM_QueueSurface(surf);
+
+	/* the state it will be built with, which also keeps it from being queued twice */
+	surf->cached_dlight = dlit ? r_framecount : 0;
+	R_SetCacheState(surf);
+}
+
+/*
+ * ================ R_FlushLightmaps
+ *
+ * Rebuilds the queued surfaces into their pages and uploads the changed
+ * rectangle of each page. ================
+ */
+static void
+R_FlushLightmaps(void)
+{
+	msurface_t     *surf;
+	lmrect_t       *r;
+	int		i, smax, tmax;
+
+	if (!lm_numupdates)
+		return;
+
+	for (i = 0; i < lm_numupdates; i++) {
+		surf = lm_updates[i];
+		lm_updatedests[i] = lm_pages[surf->lightmaptexturenum] +
+		    (surf->light_t * BLOCK_WIDTH + surf->light_s) * LIGHTMAP_BYTES;
+	}
+
+	R_BuildLightMaps(lm_updates, lm_updatedests, lm_numupdates, BLOCK_WIDTH * LIGHTMAP_BYTES);
+
+	for (i = 0; i < lm_numupdates; i++) {
+		surf = lm_updates[i];
+		smax = (surf->extents[0] >> 4) + 1;
+		tmax = (surf->extents[1] >> 4) + 1;
+
+		r = &lm_dirty[surf->lightmaptexturenum];
+		if (!r->x1) {
+			r->x0 = surf->light_s;
+			r->y0 = surf->light_t;
+			r->x1 = surf->light_s + smax;
+			r->y1 = surf->light_t + tmax;
+		} else {
+			r->x0 = min(r->x0, surf->light_s);
+			r->y0 = min(r->y0, surf->light_t);
+			r->x1 = max(r->x1, surf->light_s + smax);
+			r->y1 = max(r->y1, surf->light_t + tmax);
+		}
+	}
+
+	c_lightmap_builds += lm_numupdates;
+	lm_numupdates = 0;
+
+	qglPixelStorei(GL_UNPACK_ROW_LENGTH, BLOCK_WIDTH);
+	for (i = 1; i < gl_lms.current_lightmap_texture; i++) {
+		r = &lm_dirty[i];
+		if (!r->x1)
+			continue;
+
+		if (qglMTexCoord2fSGIS)
+			GL_MBind(GL_TEXTURE1, gl_state.lightmap_textures + i);
+		else
+			GL_Bind(gl_state.lightmap_textures + i);
+
+		qglTexSubImage2D(GL_TEXTURE_2D, 0,
+		    r->x0, r->y0,
+		    r->x1 - r->x0, r->y1 - r->y0,
+		    GL_LIGHTMAP_FORMAT,
+		    GL_UNSIGNED_BYTE,
+		    lm_pages[i] + (r->y0 * BLOCK_WIDTH + r->x0) * LIGHTMAP_BYTES);
+
+		r->x1 = 0;
+		c_lightmap_uploads++;
+	}
+	qglPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+/*
+ * ================ GL_AllocSurfacePolygon
+ *
+ * Hunk space for the polygon GL_BuildPolygonFromSurface fills in.
+ * ================
+ */
+void
+GL_AllocSurfacePolygon(msurface_t * fa)
+{
+	glpoly_t       *poly;
+
+	poly = Hunk_Alloc(sizeof(glpoly_t) + (fa->numedges - 4) * VERTEXSIZE * sizeof(float));
+	poly->next = fa->polys;
+	poly->flags = fa->flags;
+	fa->polys = poly;
+	poly->numverts = fa->numedges;
+}
+
+/*
+ * ================ GL_BuildPolygonFromSurface
+ *
+ * Only reads the model and writes fa->polys, Mod_LoadFaces runs it on
+ * several threads at once. ================
  */
 void
 GL_BuildPolygonFromSurface(msurface_t * fa)
 {
 	int		i, lindex, lnumverts;
 	medge_t        *pedges, *r_pedge;
-	int		vertpage;
 	float          *vec;
 	float		s, t;
 	glpoly_t       *poly;
-	vec3_t		total;
 
 	/* reconstruct the polygon */
 	pedges = currentmodel->edges;
 	lnumverts = fa->numedges;
-	vertpage = 0;
-
-	VectorClear(total);
-	
-	/* draw texture */
-	poly = Hunk_Alloc(sizeof(glpoly_t) + (lnumverts - 4) * VERTEXSIZE * sizeof(float));
-	poly->next = fa->polys;
-	poly->flags = fa->flags;
-	fa->polys = poly;
-	poly->numverts = lnumverts;
+	poly = fa->polys;
 
 	for (i = 0; i < lnumverts; i++) {
 		lindex = currentmodel->surfedges[fa->firstedge + i];
@@ -1786,7 +2007,6 @@ GL_BuildPolygonFromSurface(msurface_t * fa)
 		t = DotProduct(vec, fa->texinfo->vecs[1]) + fa->texinfo->vecs[1][3];
 		t /= fa->texinfo->image->height;
 
-		VectorAdd(total, vec, total);
 		VectorCopy(vec, poly->verts[i]);
 		poly->verts[i][3] = s;
 		poly->verts[i][4] = t;
@@ -1846,28 +2066,32 @@ GL_BuildPolygonFromSurface(msurface_t * fa)
 
 		/* MH - detail textures end */
 	}
-
-	poly->numverts = lnumverts;
-
 }
 
 /*
- * ======================== GL_CreateSurfaceLightmap ========================
+ * ======================== GL_CreateSurfaceLightmap
+ *
+ * Places the surface in the current page.  Surfaces have to come in the same
+ * order every time so the pages come out the same; the texels are built
+ * later, all at once, by GL_EndBuildingLightmaps.
+ * ========================
  */
 void
 GL_CreateSurfaceLightmap(msurface_t * surf)
 {
 	int		smax, tmax;
-	byte           *base;
 
 	if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB))
 		return;
 
+	R_CheckLightMap(surf);
+
 	smax = (surf->extents[0] >> 4) + 1;
 	tmax = (surf->extents[1] >> 4) + 1;
 
 	if (!LM_AllocBlock(smax, tmax, &surf->light_s, &surf->light_t)) {
-		LM_UploadBlock(false);
+		if (++gl_lms.current_lightmap_texture == MAX_LIGHTMAPS)
+			ri.Sys_Error(ERR_DROP, "GL_CreateSurfaceLightmap() - MAX_LIGHTMAPS exceeded\n");
 		LM_InitBlock();
 		if (!LM_AllocBlock(smax, tmax, &surf->light_s, &surf->light_t)) {
 			ri.Sys_Error(ERR_FATAL, "Consecutive calls to LM_AllocBlock(%d,%d) failed\n", smax, tmax);
@@ -1875,11 +2099,9 @@ GL_CreateSurfaceLightmap(msurface_t * surf)
 	}
 	surf->lightmaptexturenum = gl_lms.current_lightmap_texture;
 
-	base = gl_lms.lightmap_buffer;
-	base += (surf->light_t * BLOCK_WIDTH + surf->light_s) * LIGHTMAP_BYTES;
-
 	R_SetCacheState(surf);
-	R_BuildLightMap(surf, base, BLOCK_WIDTH * LIGHTMAP_BYTES);
+	surf->cached_dlight = 0;
+	LM_QueueSurface(surf);
 }
 
 /*
@@ -1932,6 +2154,8 @@ GL_BeginBuildingLightmaps(model_t * m)
 	unsigned	dummy[128 * 128];
 
 	memset(gl_lms.allocated, 0, sizeof(gl_lms.allocated));
+	memset(lm_dirty, 0, sizeof(lm_dirty));
+	lm_numupdates = 0;
 
 	r_framecount = 1;	/* no dlightcache */
 
@@ -2012,11 +2236,95 @@ GL_BeginBuildingLightmaps(model_t * m)
 }
 
 /*
- * ======================= GL_EndBuildingLightmaps =======================
+ * ======================= GL_EndBuildingLightmaps
+ *
+ * Builds every surface placed by GL_CreateSurfaceLightmap straight into its
+ * page, on the lightmap workers, then uploads the pages.
+ * =======================
  */
 void
 GL_EndBuildingLightmaps(void)
 {
-	LM_UploadBlock(false);
+	msurface_t     *surf;
+	int		i, numpages;
+
+	numpages = gl_lms.current_lightmap_texture + 1;
+	for (i = 1; i < numpages; i++) {
+		if (!lm_pages[i])
+			lm_pages[i] = malloc(LM_PAGE_SIZE);
+		memset(lm_pages[i], 0, LM_PAGE_SIZE);
+	}
+
+	for (i = 0; i < lm_numupdates; i++) {
+		surf = lm_updates[i];
+		lm_updatedests[i] = lm_pages[surf->lightmaptexturenum] +
+		    (surf->light_t * BLOCK_WIDTH + surf->light_s) * LIGHTMAP_BYTES;
+	}
+	R_BuildLightMaps(lm_updates, lm_updatedests, lm_numupdates, BLOCK_WIDTH * LIGHTMAP_BYTES);
+	lm_numupdates = 0;
+
+	for (i = 1; i < numpages; i++)
+		LM_UploadBlock(i);
+	gl_lms.current_lightmap_texture = numpages;
+
 	GL_EnableMultitexture(false);
 }
+
+/*
+ * ======================= GL_BuildWorldVertexBuffer
+ *
+ * Packs the polygons built by GL_BuildPolygonFromSurface for every surface
+ * R_BatchWorldSurface can draw into one array, uploaded to a static vertex
+ * buffer object when the driver has them. =======================
+ */
+void
+GL_BuildWorldVertexBuffer(model_t * m)
+{
+	msurface_t     *surf;
+	float          *verts, *v;
+	int		i, numverts;
+
+	numverts = 0;
+	for (i = 0, surf = m->surfaces; i < m->numsurfaces; i++, surf++) {
+		surf->firstworldvert = -1;
+		if (!surf->polys || surf->polys->next || (surf->flags & SURF_DRAWTURB))
+			continue;
+		if (surf->texinfo->flags & (SURF_SKY | SURF_TRANS33 | SURF_TRANS66 | SURF_WARP))
+			continue;
+		surf->firstworldvert = numverts;
+		numverts += surf->polys->numverts;
+	}
+
+	if (!numverts)
+		return;
+
+	verts = malloc(numverts * VERTEXSIZE * sizeof(float));
+	if (!verts) {
+		ri.Con_Printf(PRINT_ALL, "GL_BuildWorldVertexBuffer: out of memory, batching disabled\n");
+		for (i = 0, surf = m->surfaces; i < m->numsurfaces; i++, surf++)
+			surf->firstworldvert = -1;
+		return;
+	}
+
+	for (i = 0, surf = m->surfaces; i < m->numsurfaces; i++, surf++) {
+		if (surf->firstworldvert < 0)
+			continue;
+		v = verts + surf->firstworldvert * VERTEXSIZE;
+		memcpy(v, surf->polys->verts, surf->polys->numverts * VERTEXSIZE * sizeof(float));
+	}
+
+	m->numworldverts = numverts;
+
+	if (gl_state.vbo) {
+		qglGenBuffersARB(1, &m->worldvbo);
+		qglBindBufferARB(GL_ARRAY_BUFFER_ARB, m->worldvbo);
+		qglBufferDataARB(GL_ARRAY_BUFFER_ARB, numverts * VERTEXSIZE * sizeof(float), verts, GL_STATIC_DRAW_ARB);
+		qglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+		free(verts);
+	} else {
+		m->worldverts = verts;
+	}
+
+	ri.Con_Printf(PRINT_DEVELOPER, "%s: %i world vertexes (%s)\n", m->name, numverts,
+	    m->worldvbo ? "vertex buffer" : "vertex array");
+}
@@ -231,6 +231,119 @@ CreateDSTTex()
 
 /* end MrG */
 
+/*
+ * The water warp and waves are periodic in their arguments, so they are
+ * looked up in tables over one period instead of calling sin() and cos()
+ * for every vertex of every frame.
+ */
+#define	WARP_TABLE_SIZE	1024
+#define	WARP_INDEX(x)	((int)((x) * (WARP_TABLE_SIZE / (2 * M_PI))) & (WARP_TABLE_SIZE - 1))
+#define	WARP_SIN(x)	(r_warpsin[WARP_INDEX(x)])
+#define	WARP_COS(x)	(r_warpsin[(WARP_INDEX(x) + WARP_TABLE_SIZE / 4) & (WARP_TABLE_SIZE - 1)])
+
+static float	r_warpsin[WARP_TABLE_SIZE];	/* sin(x) */
+static float	r_warps[WARP_TABLE_SIZE];	/* 10 * sin(cos(x)) */
+static float	r_warpt[WARP_TABLE_SIZE];	/* 10 * cos(sin(x)) */
+static qboolean	r_warptables;
+
+static unsigned	r_warpindexes[MAX_ARRAY * 3];
+
+/*
+ * ============= R_InitWarpTables =============
+ */
+static void
+R_InitWarpTables(void)
+{
+	double		x;
+	int		i;
+
+	for (i = 0; i < WARP_TABLE_SIZE; i++) {
+		x = i * (2 * M_PI / WARP_TABLE_SIZE);
+		r_warpsin[i] = sin(x);
+		r_warps[i] = 10 * sin(cos(x));
+		r_warpt[i] = 10 * cos(sin(x));
+	}
+	r_warptables = true;
+}
+
+/*
+ * ============= R_WaterWave
+ *
+ * Height added by gl_water_waves to a still water vertex. =============
+ */
+static float
+R_WaterWave(float *v)
+{
+	float		z;
+
+	z = WARP_SIN(v[2] * 0.05 + r_refdef.time);
+	return gl_water_waves->value * z *
+	    (WARP_SIN(v[0] * 0.025 + r_refdef.time) + WARP_SIN(v[1] * 0.025 + r_refdef.time * 2));
+}
+
+/*
+ * ============= R_DrawWarpArrays
+ *
+ * Warps every poly of the surface into the vertex arrays and draws them
+ * with one call. =============
+ */
+static void
+R_DrawWarpArrays(msurface_t * fa, float scroll)
+{
+	glpoly_t       *p;
+	float          *v, os, ot;
+	int		i, flags, numverts, numindexes;
+
+	if (!r_warptables)
+		R_InitWarpTables();
+
+	flags = fa->texinfo->flags;
+
+	qglEnableClientState(GL_VERTEX_ARRAY);
+	qglEnableClientState(GL_TEXTURE_COORD_ARRAY);
+	qglTexCoordPointer(2, GL_FLOAT, sizeof(tex_array[0]), tex_array[0]);
+	qglVertexPointer(3, GL_FLOAT, sizeof(vert_array[0]), vert_array[0]);
+
+	numverts = numindexes = 0;
+	for (p = fa->polys; p; p = p->next) {
+		if (numverts + p->numverts > MAX_ARRAY) {
+			qglDrawElements(GL_TRIANGLES, numindexes, GL_UNSIGNED_INT, r_warpindexes);
+			numverts = numindexes = 0;
+		}
+
+		for (i = 2; i < p->numverts; i++) {
+			r_warpindexes[numindexes++] = numverts;
+			r_warpindexes[numindexes++] = numverts + i - 1;
+			r_warpindexes[numindexes++] = numverts + i;
+		}
+
+		for (i = 0, v = p->verts[0]; i < p->numverts; i++, v += VERTEXSIZE, numverts++) {
+			os = v[3];
+			ot = v[4];
+
+			VA_SetElem2(tex_array[numverts],
+			    (os + r_warps[WARP_INDEX(ot + r_refdef.time)] + scroll) * (1.0 / 64),
+			    (ot + r_warpt[WARP_INDEX(os + r_refdef.time)]) * (1.0 / 64));
+
+			VectorCopy(v, vert_array[numverts]);
+			if (!(flags & SURF_FLOWING)) {
+				vert_array[numverts][2] += R_WaterWave(v);
+			} else {
+				if (flags & SURF_WAVES_1)
+					vert_array[numverts][2] += 3 * WARP_SIN(ot * 0.05 + r_refdef.time) * WARP_SIN(os * 0.05 + r_refdef.time);
+				if (flags & SURF_WAVES_2)
+					vert_array[numverts][2] += 10 * WARP_COS(ot * 0.05 + r_refdef.time) * WARP_COS(os * 0.05 + r_refdef.time);
+			}
+		}
+	}
+
+	if (numindexes)
+		qglDrawElements(GL_TRIANGLES, numindexes, GL_UNSIGNED_INT, r_warpindexes);
+
+	qglDisableClientState(GL_VERTEX_ARRAY);
+	qglDisableClientState(GL_TEXTURE_COORD_ARRAY);
+}
+
 /*
  * ============= EmitWaterPolys
  *
@@ -296,6 +409,12 @@ EmitWaterPolys_original(msurface_t * fa)
 		scroll = -64 * ((r_refdef.time * 0.5) - (int)(r_refdef.time * 0.5));
 	else
 		scroll = 0;
+
+	if (!(gl_config.NV_texshaders && gl_water_pixel_shader_warp->value)) {
+		R_DrawWarpArrays(fa, scroll);
+		return;
+	}
+
 	for (bp = fa->polys; bp; bp = bp->next) {
 		p = bp;
 
@@ -376,6 +495,7 @@ EmitWaterPolys(msurface_t * fa)
 	float		distance;	/* plane distance  */
 	cplane_t       *plane;
 	vec3_t		nv;		/* Water waves */
+	qboolean	shader;
 
 	if (g_drawing_refl)
 		return;		/* we don't want any water drawn while we are doing our reflection */
@@ -401,36 +521,31 @@ EmitWaterPolys(msurface_t * fa)
 	 * find out which reflection we have that corresponds to the surface
 	 * that we're drawing
 	 */
-	for (g_active_refl = 0; g_active_refl < g_num_refl; g_active_refl++) {
-
-		/* if we find which reflection to bind */
-		if (plane->normal[0] == waterNormals[g_active_refl][0] &&
-		    plane->normal[1] == waterNormals[g_active_refl][1] &&
-		    plane->normal[2] == waterNormals[g_active_refl][2] &&
-		    distance == g_waterDistance2[g_active_refl]) {
-
-			GL_MBind(GL_TEXTURE0, g_tex_num[g_active_refl]);	/* Reflection texture */
+	g_active_refl = R_FindRefl(plane->normal, distance);
+	if (g_active_refl < 0) {
+		g_active_refl = g_num_refl;
+	} else {
+		/* bind the reflection */
+		GL_MBind(GL_TEXTURE0, g_tex_num[g_active_refl]);	/* Reflection texture */
 
-			if (gl_state.fragment_program && gl_reflection_shader->value) {
-				ri.Cvar_Set("gl_reflection_water_surface", "0");
-				ri.Cvar_Set("gl_water_pixel_shader_warp", "0");
-				qglEnable(GL_FRAGMENT_PROGRAM_ARB);
-				qglBindProgramARB(GL_FRAGMENT_PROGRAM_ARB, gWaterProgramId);
-				qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 0, r_refdef.time * 0.2, 1.0, 1.0, 1.0);
-				qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 1, r_refdef.time * -0.2, 10.0, 1.0, 1.0);
-				qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 2,
-				    r_refdef.vieworg[0], r_refdef.vieworg[1], r_refdef.vieworg[2], 1.0);
+		if (gl_state.fragment_program && gl_reflection_shader->value) {
+			ri.Cvar_Set("gl_reflection_water_surface", "0");
+			ri.Cvar_Set("gl_water_pixel_shader_warp", "0");
+			qglEnable(GL_FRAGMENT_PROGRAM_ARB);
+			qglBindProgramARB(GL_FRAGMENT_PROGRAM_ARB, gWaterProgramId);
+			qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 0, r_refdef.time * 0.2, 1.0, 1.0, 1.0);
+			qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 1, r_refdef.time * -0.2, 10.0, 1.0, 1.0);
+			qglProgramLocalParameter4fARB(GL_FRAGMENT_PROGRAM_ARB, 2,
+			    r_refdef.vieworg[0], r_refdef.vieworg[1], r_refdef.vieworg[2], 1.0);
 
 
 
-				GL_MBind(GL_TEXTURE1, distortTex->texnum);	/* Distortion texture */
-				GL_MBind(GL_TEXTURE2, waterNormalTex->texnum);	/* Normal texture */
-			}
-			ri.Cvar_Set("gl_reflection_water_surface", "1");
-			ri.Cvar_Set("gl_water_pixel_shader_warp", "?");
-			GL_SelectTexture(GL_TEXTURE0);
-			break;
+			GL_MBind(GL_TEXTURE1, distortTex->texnum);	/* Distortion texture */
+			GL_MBind(GL_TEXTURE2, waterNormalTex->texnum);	/* Normal texture */
 		}
+		ri.Cvar_Set("gl_reflection_water_surface", "1");
+		ri.Cvar_Set("gl_water_pixel_shader_warp", "?");
+		GL_SelectTexture(GL_TEXTURE0);
 	}
 
 
@@ -448,6 +563,18 @@ EmitWaterPolys(msurface_t * fa)
 
 		R_LoadReflMatrix();
 
+		if (!r_warptables)
+			R_InitWarpTables();
+
+		shader = gl_state.fragment_program && gl_reflection_shader->value;
+		if (shader) {	/* for testing atm */
+			ri.Cvar_Set("gl_water_pixel_shader_warp", "0");
+			ri.Cvar_Set("gl_reflection_water_surface", "0");
+		} else {
+			ri.Cvar_Set("gl_reflection_water_surface", "1");
+			ri.Cvar_Set("gl_water_pixel_shader_warp", "?");
+		}
+
 		/* draw reflected water layer on top of regular */
 		for (bp = fa->polys; bp; bp = bp->next) {
 			p = bp;
@@ -455,25 +582,18 @@ EmitWaterPolys(msurface_t * fa)
 			qglBegin(GL_TRIANGLE_FAN);
 			for (i = 0, v = p->verts[0]; i < p->numverts; i++, v += VERTEXSIZE) {
 
-				if (gl_state.fragment_program && gl_reflection_shader->value) {	/* for testing atm */
-					ri.Cvar_Set("gl_water_pixel_shader_warp", "0");
-					ri.Cvar_Set("gl_reflection_water_surface", "0");
+				if (shader) {
 					qglMultiTexCoord3fvARB(GL_TEXTURE0, v);
 					qglMultiTexCoord3fvARB(GL_TEXTURE1, v);
 					qglMultiTexCoord3fvARB(GL_TEXTURE2, v);
 				} else {
-
 					qglTexCoord3f(v[0], v[1] + calc_wave(v[0], v[1]), v[2]);
-					ri.Cvar_Set("gl_reflection_water_surface", "1");
-					ri.Cvar_Set("gl_water_pixel_shader_warp", "?");
-
 				}
 				/* =============== Water waves ============ */
 				if (!(fa->texinfo->flags & SURF_FLOWING)) {
 					nv[0] = v[0];
 					nv[1] = v[1];
-					nv[2] = v[2] + gl_water_waves->value * sin(v[0] * 0.025 + r_refdef.time) * sin(v[2] * 0.05 + r_refdef.time)
-					    + gl_water_waves->value * sin(v[1] * 0.025 + r_refdef.time * 2) * sin(v[2] * 0.05 + r_refdef.time);
+					nv[2] = v[2] + R_WaterWave(v);
 
 					qglVertex3fv(nv);
 				} else
@@ -698,6 +818,179 @@ ClipSkyPolygon(int nump, vec3_t vecs, int stage)
 	ClipSkyPolygon(newc[1], newv[1][0], stage + 1);
 }
 
+/*
+ * The sky box bounds only have to cover the sky, drawing more of the box is
+ * harmless as the world is depth tested in front of it.  So instead of
+ * clipping every visible sky polygon every frame, bounds are worked out
+ * once for the sky in the PVS as seen from anywhere in the view cluster's
+ * box, and kept until the leafs are marked again.
+ */
+static qboolean	sky_usecache;	/* this view uses sky_cachemins/maxs */
+static qboolean	sky_visible;	/* some sky surface was drawn this view */
+static int	sky_cachevisframe = -1;
+static model_t *sky_cachemodel;
+static vec3_t	sky_cachebox[2];
+static float	sky_cachemins[2][6], sky_cachemaxs[2][6];
+
+/*
+ * ================= R_SkyPolygonBounds
+ *
+ * Widens the cached bounds to what the polygon covers from any point in
+ * the cluster box.  The directions are within the hull of the polygon's
+ * corners seen from the box's corners, so a face is skipped when all of
+ * those are outside one of its edges, and bounded by them when all are in
+ * front of it.  A face they reach behind is taken whole.
+ * =================
+ */
+static void
+R_SkyPolygonBounds(glpoly_t * p)
+{
+	vec3_t		d, ad;
+	float		st, mins[2][6], maxs[2][6];
+	int		out[6][4], front[6];
+	int		i, j, k, axis, n, numpoints;
+
+	memset(out, 0, sizeof(out));
+	memset(front, 0, sizeof(front));
+	for (axis = 0; axis < 6; axis++) {
+		mins[0][axis] = mins[1][axis] = 999999;
+		maxs[0][axis] = maxs[1][axis] = -999999;
+	}
+
+	numpoints = p->numverts * 8;
+	for (i = 0; i < p->numverts; i++) {
+		for (j = 0; j < 8; j++) {
+			for (k = 0; k < 3; k++)
+				d[k] = p->verts[i][k] - sky_cachebox[(j >> k) & 1][k];
+
+			for (axis = 0; axis < 6; axis++) {
+				/* s, t and depth in the face's frame, as DrawSkyPolygon */
+				for (k = 0; k < 3; k++) {
+					n = vec_to_st[axis][k];
+					ad[k] = n < 0 ? -d[-n - 1] : d[n - 1];
+				}
+
+				if (ad[0] > ad[2])
+					out[axis][0]++;
+				if (ad[0] < -ad[2])
+					out[axis][1]++;
+				if (ad[1] > ad[2])
+					out[axis][2]++;
+				if (ad[1] < -ad[2])
+					out[axis][3]++;
+
+				if (ad[2] < 0.001)
+					continue;
+				front[axis]++;
+
+				for (k = 0; k < 2; k++) {
+					st = ad[k] / ad[2];
+					if (st < mins[k][axis])
+						mins[k][axis] = st;
+					if (st > maxs[k][axis])
+						maxs[k][axis] = st;
+				}
+			}
+		}
+	}
+
+	for (axis = 0; axis < 6; axis++) {
+		for (k = 0; k < 4; k++)
+			if (out[axis][k] == numpoints)
+				break;
+		if (k < 4)
+			continue;	/* can't be seen on this face */
+
+		if (front[axis] < numpoints) {
+			mins[0][axis] = mins[1][axis] = -1;
+			maxs[0][axis] = maxs[1][axis] = 1;
+		}
+
+		for (k = 0; k < 2; k++) {
+			sky_cachemins[k][axis] = min(sky_cachemins[k][axis], max(mins[k][axis], -1));
+			sky_cachemaxs[k][axis] = max(sky_cachemaxs[k][axis], min(maxs[k][axis], 1));
+		}
+	}
+}
+
+/*
+ * ================= R_SkyClusterBox =================
+ */
+static qboolean
+R_SkyClusterBox(int cluster)
+{
+	mleaf_t        *leaf;
+	int		i;
+
+	if (cluster < 0 || !r_worldmodel->vis || !r_worldmodel->clusterleafs ||
+	    cluster >= r_worldmodel->vis->numclusters)
+		return false;
+
+	for (i = r_worldmodel->clusterleafstart[cluster]; i < r_worldmodel->clusterleafstart[cluster + 1]; i++) {
+		leaf = r_worldmodel->leafs + r_worldmodel->clusterleafs[i];
+		AddPointToBounds(leaf->minmaxs, sky_cachebox[0], sky_cachebox[1]);
+		AddPointToBounds(leaf->minmaxs + 3, sky_cachebox[0], sky_cachebox[1]);
+	}
+
+	return true;
+}
+
+/*
+ * ================= R_BuildSkyCache
+ *
+ * Returns false when the view can't be covered by the cache. =================
+ */
+static qboolean
+R_BuildSkyCache(void)
+{
+	msurface_t    **mark, *surf;
+	mleaf_t        *leaf;
+	int		i, c;
+
+	if (sky_cachevisframe == r_visframecount && sky_cachemodel == r_worldmodel)
+		goto check;
+
+	sky_cachevisframe = r_visframecount;
+	sky_cachemodel = r_worldmodel;
+
+	ClearBounds(sky_cachebox[0], sky_cachebox[1]);
+	if (!R_SkyClusterBox(r_viewcluster))
+		goto fail;
+	if (r_viewcluster2 != r_viewcluster && !R_SkyClusterBox(r_viewcluster2))
+		goto fail;
+
+	for (i = 0; i < 6; i++) {
+		sky_cachemins[0][i] = sky_cachemins[1][i] = 999999;
+		sky_cachemaxs[0][i] = sky_cachemaxs[1][i] = -999999;
+	}
+
+	/* the same surface can be in many leafs, adding it again changes nothing */
+	for (i = 0, leaf = r_worldmodel->leafs; i < r_worldmodel->numleafs; i++, leaf++) {
+		if (leaf->visframe != r_visframecount)
+			continue;
+		for (c = leaf->nummarksurfaces, mark = leaf->firstmarksurface; c; c--, mark++) {
+			surf = *mark;
+			if ((surf->texinfo->flags & SURF_SKY) && surf->polys)
+				R_SkyPolygonBounds(surf->polys);
+		}
+	}
+
+check:
+	if (sky_cachebox[0][0] > sky_cachebox[1][0])
+		return false;
+
+	/* noclipping out of the world, or a view moved off its leaf */
+	for (i = 0; i < 3; i++)
+		if (r_origin[i] < sky_cachebox[0][i] || r_origin[i] > sky_cachebox[1][i])
+			return false;
+
+	return true;
+
+fail:
+	ClearBounds(sky_cachebox[0], sky_cachebox[1]);
+	return false;
+}
+
 /*
  * ================= R_AddSkySurface =================
  */
@@ -708,6 +1001,10 @@ R_AddSkySurface(msurface_t * fa)
 	vec3_t		verts[MAX_CLIP_VERTS];
 	glpoly_t       *p;
 
+	sky_visible = true;
+	if (sky_usecache)
+		return;
+
 	/* calculate vertex values for sky box */
 	for (p = fa->polys; p; p = p->next) {
 		for (i = 0; i < p->numverts; i++) {
@@ -730,6 +1027,11 @@ R_ClearSkyBox(void)
 		skymins[0][i] = skymins[1][i] = 999999;
 		skymaxs[0][i] = skymaxs[1][i] = -999999;
 	}
+
+	sky_visible = false;
+
+	/* a rotating sky is drawn whole anyway, and reflections look from elsewhere */
+	sky_usecache = !skyrotate && !g_drawing_refl && r_worldmodel && R_BuildSkyCache();
 }
 
 
@@ -788,6 +1090,13 @@ R_DrawSkyBox(void)
 	qglColor4f(1, 1, 1, 0.5);
 	qglDisable(GL_DEPTH_TEST);
 #endif
+	if (sky_usecache) {
+		if (!sky_visible)
+			return;
+		memcpy(skymins, sky_cachemins, sizeof(skymins));
+		memcpy(skymaxs, sky_cachemaxs, sizeof(skymaxs));
+	}
+
 	if (skyrotate) {	/* check for no sky at all */
 		for (i = 0; i < 6; i++)
 			if (skymins[0][i] < skymaxs[0][i]
@@ -848,6 +1157,11 @@ R_SetSky(char *name, float rotate, vec3_t axis)
 	skyrotate = rotate;
 	VectorCopy(axis, skyaxis);
 
+	for (i = 0; i < 6; i++) {
+		Com_sprintf(pathname, sizeof(pathname), "env/%s%s.pcx", skyname, suf[i]);
+		GL_QueueImage(pathname, it_sky);
+	}
+
 	for (i = 0; i < 6; i++) {
 		/* chop down rotating skies for less memory */
 		if (gl_skymip->value || skyrotate)
@@ -868,4 +1182,5 @@ R_SetSky(char *name, float rotate, vec3_t axis)
 			sky_max = 511.0 * DIV512;
 		}
 	}
+	GL_FinishImageJobs();
 }
@@ -501,6 +501,27 @@ extern void     (APIENTRY * qglProgramLocalParameter4fARB) (GLenum target, GLuin
 
 /* mpo - needed for fragment shaders */
 
+/* GL_ARB_vertex_buffer_object, for the static world vertex buffer */
+extern void     (APIENTRY * qglBindBufferARB) (GLenum target, GLuint buffer);
+extern void     (APIENTRY * qglDeleteBuffersARB) (GLsizei n, const GLuint * buffers);
+extern void     (APIENTRY * qglGenBuffersARB) (GLsizei n, GLuint * buffers);
+extern void     (APIENTRY * qglBufferDataARB) (GLenum target, GLsizeiptrARB size, const GLvoid * data, GLenum usage);
+
+/* GL_ARB_pixel_buffer_object, maps the buffers pixels were read back into */
+extern void    *(APIENTRY * qglMapBufferARB) (GLenum target, GLenum access);
+extern GLboolean(APIENTRY * qglUnmapBufferARB) (GLenum target);
+
+/* GL_ARB_occlusion_query, for flare visibility */
+extern void     (APIENTRY * qglGenQueriesARB) (GLsizei n, GLuint * ids);
+extern void     (APIENTRY * qglDeleteQueriesARB) (GLsizei n, const GLuint * ids);
+extern void     (APIENTRY * qglBeginQueryARB) (GLenum target, GLuint id);
+extern void     (APIENTRY * qglEndQueryARB) (GLenum target);
+extern void     (APIENTRY * qglGetQueryObjectuivARB) (GLuint id, GLenum pname, GLuint * params);
+
+/* GL_ARB_timer_query, for the profiler */
+extern void     (APIENTRY * qglQueryCounter) (GLuint id, GLenum target);
+extern void     (APIENTRY * qglGetQueryObjectui64v) (GLuint id, GLenum pname, GLuint64 * params);
+
 /* nVidia extensions */
 
 extern PFNGLCOMBINERPARAMETERFVNVPROC qglCombinerParameterfvNV;
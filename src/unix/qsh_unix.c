@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <dirent.h>
 #include <unistd.h>
+#include <pthread.h>
 
 #include "../qcommon/qcommon.h"
 
@@ -145,6 +146,27 @@ Sys_Milliseconds(void)
 	return curtime;
 }
 
+/*
+ * ================ Sys_Microseconds ================
+ *
+ * Finer timer for profiling, does not touch curtime.
+ */
+long long
+Sys_Microseconds(void)
+{
+	struct timeval	tp;
+
+	gettimeofday(&tp, NULL);
+
+	return (long long)tp.tv_sec * 1000000 + tp.tv_usec;
+}
+
+void
+Sys_Sleep(int msec)
+{
+	usleep(msec * 1000);
+}
+
 void
 Sys_Mkdir(char *path)
 {
@@ -272,3 +294,165 @@ Sys_FindClose(void)
 		fdir = NULL;
 	}
 }
+
+/*
+ * ==================================================================
+ *
+ * THREADS
+ *
+ * ==================================================================
+ */
+
+struct qthread_s {
+	pthread_t	handle;
+	void		(*func)(void *);
+	void           *arg;
+};
+
+struct qmutex_s {
+	pthread_mutex_t	handle;
+};
+
+struct qcond_s {
+	pthread_cond_t	handle;
+};
+
+static void *
+Sys_ThreadMain(void *arg)
+{
+	qthread_t      *thread = arg;
+
+	thread->func(thread->arg);
+
+	return NULL;
+}
+
+/*
+ * ================ Sys_CreateThread ================
+ * Returns NULL if the thread could not be started, callers are expected
+ * to fall back to doing the work inline.
+ */
+qthread_t *
+Sys_CreateThread(void (*func)(void *), void *arg)
+{
+	qthread_t      *thread;
+
+	thread = malloc(sizeof(*thread));
+	if (!thread)
+		return NULL;
+
+	thread->func = func;
+	thread->arg = arg;
+
+	if (pthread_create(&thread->handle, NULL, Sys_ThreadMain, thread)) {
+		free(thread);
+		return NULL;
+	}
+
+	return thread;
+}
+
+void
+Sys_WaitThread(qthread_t *thread)
+{
+	if (!thread)
+		return;
+
+	pthread_join(thread->handle, NULL);
+	free(thread);
+}
+
+qmutex_t *
+Sys_CreateMutex(void)
+{
+	qmutex_t       *mutex;
+
+	mutex = malloc(sizeof(*mutex));
+	if (!mutex)
+		Sys_Error("Sys_CreateMutex: out of memory");
+
+	pthread_mutex_init(&mutex->handle, NULL);
+
+	return mutex;
+}
+
+void
+Sys_DestroyMutex(qmutex_t *mutex)
+{
+	if (!mutex)
+		return;
+
+	pthread_mutex_destroy(&mutex->handle);
+	free(mutex);
+}
+
+void
+Sys_LockMutex(qmutex_t *mutex)
+{
+	pthread_mutex_lock(&mutex->handle);
+}
+
+void
+Sys_UnlockMutex(qmutex_t *mutex)
+{
+	pthread_mutex_unlock(&mutex->handle);
+}
+
+qcond_t *
+Sys_CreateCond(void)
+{
+	qcond_t        *cond;
+
+	cond = malloc(sizeof(*cond));
+	if (!cond)
+		Sys_Error("Sys_CreateCond: out of memory");
+
+	pthread_cond_init(&cond->handle, NULL);
+
+	return cond;
+}
+
+void
+Sys_DestroyCond(qcond_t *cond)
+{
+	if (!cond)
+		return;
+
+	pthread_cond_destroy(&cond->handle);
+	free(cond);
+}
+
+void
+Sys_CondWait(qcond_t *cond, qmutex_t *mutex)
+{
+	pthread_cond_wait(&cond->handle, &mutex->handle);
+}
+
+void
+Sys_CondSignal(qcond_t *cond)
+{
+	pthread_cond_signal(&cond->handle);
+}
+
+void
+Sys_CondBroadcast(qcond_t *cond)
+{
+	pthread_cond_broadcast(&cond->handle);
+}
+
+/*
+ * ================ Sys_CPUCount ================
+ */
+int
+Sys_CPUCount(void)
+{
+	long		count = -1;
+
+#ifdef _SC_NPROCESSORS_ONLN
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+	if (count < 1)
+		count = 1;
+
+	return count;
+}